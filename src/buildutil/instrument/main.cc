@@ -27,7 +27,9 @@
 #include <cstring>
 #include <iomanip>
 #include <iostream>
+#include <map>
 #include <memory>
+#include <string>
 #include <type_traits>
 #include <unordered_map>
 #include <vector>
@@ -64,6 +66,15 @@ enum long_opts
     opt_max_rows,
 };
 
+/** Options that only apply to sampling profiler streams. */
+struct SampleOptions
+{
+    /// Emit folded stacks (for flamegraph.pl) instead of a flat profile.
+    bool folded;
+    /// Only consider samples from this CPU (-1 for all).
+    int cpu;
+};
+
 struct InstrumentedFunction
 {
     /**
@@ -255,7 +266,205 @@ int processRecords(FILE *fp, const char *kernel, int max_records)
     return true;
 }
 
-int handleFile(const char *filename, const char *kernel, int max_records)
+/**
+ * Resolves addresses to function names, caching results as each lookup runs
+ * addr2line and a profile will see the same addresses many times over.
+ */
+class SymbolCache
+{
+  public:
+    SymbolCache(const char *kernel) : m_Kernel(kernel), m_Names()
+    {
+    }
+
+    const std::string &lookup(uintptr_t address)
+    {
+        auto it = m_Names.find(address);
+        if (it != m_Names.end())
+        {
+            return it->second;
+        }
+
+        return m_Names[address] = resolve(address);
+    }
+
+  private:
+    std::string resolve(uintptr_t address)
+    {
+        char buf[256];
+        snprintf(
+            buf, 256, "addr2line -C -f -e %s %lx", m_Kernel, address);
+
+        FILE *fp = popen(buf, "r");
+        if (!fp)
+        {
+            return std::string("(unknown)");
+        }
+
+        // Only the first line (the function name) is interesting.
+        char line[256];
+        std::string result;
+        if (fgets(line, sizeof line, fp))
+        {
+            result = line;
+            result.erase(
+                std::remove(result.begin(), result.end(), '\n'),
+                result.end());
+        }
+        pclose(fp);
+
+        if (result.empty() || result == "??")
+        {
+            snprintf(buf, 256, "0x%lx", address);
+            result = buf;
+        }
+
+        return result;
+    }
+
+    const char *m_Kernel;
+    std::unordered_map<uintptr_t, std::string> m_Names;
+};
+
+/**
+ * Returns the function for each frame of \p record, outermost first.
+ */
+std::vector<std::string>
+sampleStack(const SampleRecord &record, SymbolCache &symbols)
+{
+    std::vector<std::string> stack;
+    if (record.flags & INSTRUMENT_SAMPLE_USER)
+    {
+        stack.push_back("[user]");
+        return stack;
+    }
+
+    for (size_t i = record.depth; i > 0; --i)
+    {
+        uintptr_t address = extendPointer(record.frames[i - 1]);
+
+        // Return addresses point just past the call, which may well be the
+        // start of the next function - look up the call itself instead.
+        if (i > 1)
+        {
+            --address;
+        }
+
+        stack.push_back(symbols.lookup(address));
+    }
+
+    return stack;
+}
+
+/**
+ * Processes a stream of sampling profiler records, producing either a flat
+ * profile or folded stacks.
+ */
+int processSamples(
+    FILE *fp, const char *kernel, int max_records,
+    const SampleOptions &options)
+{
+    SymbolCache symbols(kernel);
+
+    // function -> samples where it was running / anywhere on the stack.
+    std::unordered_map<std::string, size_t> self, inclusive;
+    // folded stack -> samples.
+    std::map<std::string, size_t> folded;
+    size_t total = 0;
+
+    SampleRecord records[RECORDS_PER_READ];
+    while (!feof(fp))
+    {
+        ssize_t record_count =
+            fread(records, sizeof(SampleRecord), RECORDS_PER_READ, fp);
+        for (ssize_t i = 0; i < record_count; ++i)
+        {
+            const SampleRecord &record = records[i];
+            if (record.magic != INSTRUMENT_SAMPLE_MAGIC)
+            {
+                std::cerr << "Aborting file read due to sample magic mismatch"
+                          << std::endl;
+                return 1;
+            }
+
+            if (options.cpu >= 0 &&
+                record.cpu != static_cast<uint32_t>(options.cpu))
+            {
+                continue;
+            }
+
+            std::vector<std::string> stack = sampleStack(record, symbols);
+            if (stack.empty())
+            {
+                continue;
+            }
+
+            ++total;
+
+            if (options.folded)
+            {
+                std::string key;
+                for (auto &frame : stack)
+                {
+                    if (!key.empty())
+                    {
+                        key += ";";
+                    }
+                    key += frame;
+                }
+                ++folded[key];
+                continue;
+            }
+
+            ++self[stack.back()];
+
+            // Recursion shouldn't count a function more than once.
+            std::sort(stack.begin(), stack.end());
+            stack.erase(std::unique(stack.begin(), stack.end()), stack.end());
+            for (auto &frame : stack)
+            {
+                ++inclusive[frame];
+            }
+        }
+    }
+
+    if (options.folded)
+    {
+        for (auto &it : folded)
+        {
+            std::cout << it.first << " " << it.second << std::endl;
+        }
+
+        return 0;
+    }
+
+    std::vector<std::pair<std::string, size_t>> vec(self.begin(), self.end());
+    std::sort(
+        vec.begin(), vec.end(),
+        [](const std::pair<std::string, size_t> &left,
+           const std::pair<std::string, size_t> &right) {
+            return left.second > right.second;
+        });
+
+    std::cout << total << " samples" << std::endl;
+    std::cout << "   self%   total%  function" << std::endl;
+
+    int i = 0;
+    for (auto it = vec.begin(); it != vec.end() && i < max_records; ++it, ++i)
+    {
+        double selfPercent = (it->second * 100.0) / total;
+        double totalPercent = (inclusive[it->first] * 100.0) / total;
+        std::cout << std::fixed << std::setprecision(2) << std::setw(8)
+                  << selfPercent << " " << std::setw(8) << totalPercent
+                  << "  " << it->first << std::endl;
+    }
+
+    return 0;
+}
+
+int handleFile(
+    const char *filename, const char *kernel, int max_records,
+    const SampleOptions &options)
 {
     FILE *fp = fopen(filename, "rb");
     if (!fp)
@@ -278,7 +487,11 @@ int handleFile(const char *filename, const char *kernel, int max_records)
 
     // Choose which type of read to perform.
     int rc = 0;
-    if (global_flags & INSTRUMENT_GLOBAL_LITE)
+    if (global_flags & INSTRUMENT_GLOBAL_SAMPLES)
+    {
+        rc = processSamples(fp, kernel, max_records, options);
+    }
+    else if (global_flags & INSTRUMENT_GLOBAL_LITE)
     {
         rc = processRecords<LiteInstrumentationRecord>(fp, kernel, max_records);
     }
@@ -309,12 +522,17 @@ void usage()
               << std::endl;
     std::cerr << "  --max-rows, -m   Maximum rows to output (default is 10)."
               << std::endl;
+    std::cerr << "  --folded, -f     Print folded stacks (for flamegraph.pl) "
+                 "rather than a flat profile. Sample streams only."
+              << std::endl;
+    std::cerr << "  --cpu, -c        Only use samples taken on the given CPU."
+              << std::endl;
     std::cerr << std::endl;
 }
 
 void version()
 {
-    std::cerr << "instrument v1.0, Copyright (C) 2014, Pedigree Developers"
+    std::cerr << "instrument v1.1, Copyright (C) 2014, Pedigree Developers"
               << std::endl;
 }
 
@@ -323,10 +541,13 @@ int main(int argc, char *argv[])
     const char *input_file = 0;
     const char *kernel_file = 0;
     int maximum = 10;
+    SampleOptions options = {false, -1};
     const struct option long_options[] = {
         {"input-file", required_argument, 0, 'i'},
         {"kernel-path", required_argument, 0, 'k'},
         {"max-rows", optional_argument, 0, 'm'},
+        {"folded", no_argument, 0, 'f'},
+        {"cpu", required_argument, 0, 'c'},
         {"version", no_argument, 0, 'v'},
         {"help", no_argument, 0, 'h'},
         {0, 0, 0, 0},
@@ -335,7 +556,7 @@ int main(int argc, char *argv[])
     opterr = 1;
     while (1)
     {
-        int c = getopt_long(argc, argv, "i:m:k:vVh", long_options, NULL);
+        int c = getopt_long(argc, argv, "i:m:k:fc:vVh", long_options, NULL);
         if (c < 0)
         {
             break;
@@ -347,6 +568,31 @@ int main(int argc, char *argv[])
                 input_file = optarg;
                 break;
 
+            case 'k':
+                kernel_file = optarg;
+                break;
+
+            case 'f':
+                options.folded = true;
+                break;
+
+            case 'c':
+            {
+                char *end = 0;
+                int cpu = strtol(optarg, &end, 10);
+                if (end != optarg)
+                {
+                    options.cpu = cpu;
+                }
+                else
+                {
+                    std::cerr << "Could not convert CPU '" << optarg
+                              << "' to a number." << std::endl;
+                    return 1;
+                }
+            }
+            break;
+
             case 'm':
             {
                 // Perform conversion and handle errors.
@@ -398,5 +644,5 @@ int main(int argc, char *argv[])
         kernel_file = "build/kernel/kernel.debug";
     }
 
-    return handleFile(input_file, kernel_file, maximum);
+    return handleFile(input_file, kernel_file, maximum, options);
 }
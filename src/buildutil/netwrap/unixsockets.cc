@@ -23,6 +23,7 @@
 #include <stdio.h>
 #include <unistd.h>
 
+#include <chrono>
 #include <thread>
 
 #include "modules/system/vfs/VFS.h"
@@ -39,6 +40,41 @@
 
 UnixFilesystem *g_pUnixFilesystem = 0;
 
+// Amount of data pushed through a stream socket for the throughput test.
+static const size_t ThroughputSize = 64 << 20;
+
+// Size of each send() and recv() in the throughput test.
+static const size_t ThroughputBlock = 64 << 10;
+
+// Size of each message in the round trip test.
+static const size_t MessageSize = 16;
+
+// Number of request/response pairs in the round trip test.
+static const size_t RoundTrips = 10000;
+
+static double secondsSince(std::chrono::steady_clock::time_point start)
+{
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+// Receives exactly len bytes from a stream socket.
+static bool recvAll(int fd, char *buf, size_t len)
+{
+    size_t got = 0;
+    while (got < len)
+    {
+        ssize_t n = posix_recv(fd, buf + got, len - got, 0);
+        if (n <= 0)
+        {
+            return false;
+        }
+        got += n;
+    }
+    return true;
+}
+
 class StreamingStderrLogger : public Log::LogCallback
 {
   public:
@@ -179,6 +215,25 @@ int main(int argc, char **argv)
     assert(socklen_misc == socklen);
     assert(!strcmp(sun_misc.sun_path, sun1.sun_path));
 
+    printf("  --> oversized datagram\n");
+
+    // The lengths wrap around to a small total if they're simply added up.
+    struct iovec iov[2];
+    iov[0].iov_base = buf;
+    iov[0].iov_len = ~static_cast<size_t>(0);
+    iov[1].iov_base = buf;
+    iov[1].iov_len = 2;
+
+    struct msghdr mh;
+    memset(&mh, 0, sizeof(mh));
+    mh.msg_name = &sun2;
+    mh.msg_namelen = socklen;
+    mh.msg_iov = iov;
+    mh.msg_iovlen = 2;
+    errno = 0;
+    assert(posix_sendmsg(s1, &mh, 0) == -1);
+    assert(errno == EMSGSIZE);
+
     // clean up existing bound unix sockets
     VFS::instance().remove(String("unix»/s1"));
     VFS::instance().remove(String("unix»/s2"));
@@ -301,6 +356,59 @@ int main(int argc, char **argv)
 
     // final test is to have two threads connect to each other
 
+    printf("=> Streaming performance...\n");
+    printf("  --> throughput\n");
+
+    auto start = std::chrono::steady_clock::now();
+    std::thread sender([s2]() {
+        static char block[ThroughputBlock];
+        for (size_t sent = 0; sent < ThroughputSize; sent += ThroughputBlock)
+        {
+            ssize_t n = posix_send(s2, block, ThroughputBlock, 0);
+            assert(n == static_cast<ssize_t>(ThroughputBlock));
+        }
+    });
+
+    static char sink[ThroughputBlock];
+    size_t received = 0;
+    while (received < ThroughputSize)
+    {
+        ssize_t n = posix_recv(fd2, sink, ThroughputBlock, 0);
+        assert(n > 0);
+        received += n;
+    }
+    sender.join();
+
+    printf(
+        "      %zd MiB in %.3fs: %.1f MiB/s\n", ThroughputSize >> 20,
+        secondsSince(start), (ThroughputSize >> 20) / secondsSince(start));
+
+    printf("  --> round trip latency\n");
+
+    std::thread echo([fd2]() {
+        char message[MessageSize];
+        for (size_t i = 0; i < RoundTrips; ++i)
+        {
+            assert(recvAll(fd2, message, MessageSize));
+            assert(posix_send(fd2, message, MessageSize, 0) ==
+                   static_cast<ssize_t>(MessageSize));
+        }
+    });
+
+    start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < RoundTrips; ++i)
+    {
+        assert(posix_send(s2, buf, MessageSize, 0) ==
+               static_cast<ssize_t>(MessageSize));
+        assert(recvAll(s2, buf, MessageSize));
+    }
+    double elapsed = secondsSince(start);
+    echo.join();
+
+    printf(
+        "      %zd round trips of %zd bytes: %.2fus each\n", RoundTrips,
+        MessageSize, (elapsed * 1000000.0) / RoundTrips);
+
     fprintf(stderr, "All OK\n");
 
     Log::instance().removeCallback(&logger);
@@ -21,6 +21,7 @@
 
 #include <errno.h>
 #include <pthread.h>
+#include <sched.h>
 #include <setjmp.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -32,6 +33,7 @@
 #include <unistd.h>
 
 #include "pedigree/kernel/Spinlock.h"
+#include "pedigree/kernel/process/AdaptiveMutex.h"
 #include "pedigree/kernel/process/ConditionVariable.h"
 #include "pedigree/kernel/process/Mutex.h"
 #include "pedigree/kernel/process/Scheduler.h"
@@ -364,6 +366,89 @@ ssize_t Mutex::getValue()
     }
 }
 
+/** Adaptive lock implementation. */
+
+struct StandaloneWaitQueue
+{
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    size_t available;
+};
+
+AdaptiveWaitQueue::AdaptiveWaitQueue() : m_Private(0)
+{
+    StandaloneWaitQueue *queue = new StandaloneWaitQueue;
+    pthread_mutex_init(&queue->lock, 0);
+    pthread_cond_init(&queue->cond, 0);
+    queue->available = 0;
+
+    m_Private = reinterpret_cast<void *>(queue);
+}
+
+AdaptiveWaitQueue::~AdaptiveWaitQueue()
+{
+    StandaloneWaitQueue *queue =
+        reinterpret_cast<StandaloneWaitQueue *>(m_Private);
+    pthread_cond_destroy(&queue->cond);
+    pthread_mutex_destroy(&queue->lock);
+
+    delete queue;
+}
+
+void AdaptiveWaitQueue::wait()
+{
+    StandaloneWaitQueue *queue =
+        reinterpret_cast<StandaloneWaitQueue *>(m_Private);
+    pthread_mutex_lock(&queue->lock);
+    while (!queue->available)
+    {
+        pthread_cond_wait(&queue->cond, &queue->lock);
+    }
+    --queue->available;
+    pthread_mutex_unlock(&queue->lock);
+}
+
+void AdaptiveWaitQueue::wake(size_t n)
+{
+    StandaloneWaitQueue *queue =
+        reinterpret_cast<StandaloneWaitQueue *>(m_Private);
+    pthread_mutex_lock(&queue->lock);
+    queue->available += n;
+    if (n == 1)
+    {
+        pthread_cond_signal(&queue->cond);
+    }
+    else
+    {
+        pthread_cond_broadcast(&queue->cond);
+    }
+    pthread_mutex_unlock(&queue->lock);
+}
+
+uintptr_t AdaptiveMutex::currentOwner()
+{
+    // Any per-thread address will do as a unique identifier.
+    static __thread char identity;
+    return reinterpret_cast<uintptr_t>(&identity);
+}
+
+bool AdaptiveMutex::ownerRunning(uintptr_t owner)
+{
+    // We can't see into the host scheduler, so keep spinning until the spin
+    // limit says otherwise - unless there's nowhere else for the owner to run.
+    static long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    return cpus > 1;
+}
+
+void AdaptiveMutex::relax()
+{
+#if defined(__i386__) || defined(__x86_64__)
+    __builtin_ia32_pause();
+#else
+    sched_yield();
+#endif
+}
+
 /** Cache implementation. */
 void Cache::discover_range(uintptr_t &start, uintptr_t &end)
 {
@@ -429,9 +514,20 @@ void MemoryPool::free(uintptr_t buffer)
     ::free(reinterpret_cast<void *>(buffer));
 }
 
-bool MemoryPool::trim()
+bool MemoryPool::contains(uintptr_t buffer) const
 {
-    return true;
+    // Buffers come straight from the host heap.
+    return false;
+}
+
+size_t MemoryPool::trim()
+{
+    return 0;
+}
+
+size_t MemoryPool::unusedPages() const
+{
+    return 0;
 }
 
 void syscallError(int e)
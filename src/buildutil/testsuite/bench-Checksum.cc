@@ -0,0 +1,118 @@
+/*
+ * Copyright (c) 2008-2014, Pedigree Developers
+ *
+ * Please see the CONTRIB file in the root of the source tree for a full
+ * list of contributors.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#define PEDIGREE_EXTERNAL_SOURCE 1
+
+#include <stdlib.h>
+
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "pedigree/kernel/network/Checksum.h"
+
+// Bytes processed are reported, so bytes/s reads as checksum throughput.
+
+static const ChecksumKernels *
+KernelsOrSkip(benchmark::State &state, ChecksumVariant variant)
+{
+    const ChecksumKernels *k = checksumKernels(variant);
+    if (!k)
+    {
+        state.SkipWithError("variant not supported on this CPU");
+        return 0;
+    }
+
+    state.SetLabel(k->name);
+    return k;
+}
+
+static std::vector<uint8_t> RandomBytes(size_t n)
+{
+    std::vector<uint8_t> result(n);
+    for (auto &b : result)
+    {
+        b = rand();
+    }
+    return result;
+}
+
+static void BM_Checksum_Sum(benchmark::State &state, ChecksumVariant variant)
+{
+    const ChecksumKernels *k = KernelsOrSkip(state, variant);
+    if (!k)
+        return;
+
+    std::vector<uint8_t> src = RandomBytes(state.range(0));
+
+    while (state.KeepRunning())
+    {
+        benchmark::DoNotOptimize(k->sum(src.data(), state.range(0)));
+    }
+
+    state.SetBytesProcessed(int64_t(state.iterations()) * state.range(0));
+}
+
+static void
+BM_Checksum_CopyAndSum(benchmark::State &state, ChecksumVariant variant)
+{
+    const ChecksumKernels *k = KernelsOrSkip(state, variant);
+    if (!k)
+        return;
+
+    std::vector<uint8_t> src = RandomBytes(state.range(0));
+    std::vector<uint8_t> dest(state.range(0));
+
+    while (state.KeepRunning())
+    {
+        benchmark::DoNotOptimize(
+            k->copyAndSum(dest.data(), src.data(), state.range(0)));
+    }
+
+    state.SetBytesProcessed(int64_t(state.iterations()) * state.range(0));
+}
+
+// Misaligned by one byte, as IP payloads usually are behind a 14-byte
+// Ethernet header.
+static void
+BM_Checksum_SumUnaligned(benchmark::State &state, ChecksumVariant variant)
+{
+    const ChecksumKernels *k = KernelsOrSkip(state, variant);
+    if (!k)
+        return;
+
+    std::vector<uint8_t> src = RandomBytes(state.range(0) + 1);
+
+    while (state.KeepRunning())
+    {
+        benchmark::DoNotOptimize(k->sum(src.data() + 1, state.range(0)));
+    }
+
+    state.SetBytesProcessed(int64_t(state.iterations()) * state.range(0));
+}
+
+// From a TCP header through a full frame, a jumbo frame and a 64K segment.
+#define CHECKSUM_BENCHMARK(name)                                          \
+    BENCHMARK_CAPTURE(name, scalar, ChecksumScalar)->Range(20, 1 << 16); \
+    BENCHMARK_CAPTURE(name, sse2, ChecksumSse2)->Range(20, 1 << 16);     \
+    BENCHMARK_CAPTURE(name, avx2, ChecksumAvx2)->Range(20, 1 << 16)
+
+CHECKSUM_BENCHMARK(BM_Checksum_Sum);
+CHECKSUM_BENCHMARK(BM_Checksum_CopyAndSum);
+CHECKSUM_BENCHMARK(BM_Checksum_SumUnaligned);
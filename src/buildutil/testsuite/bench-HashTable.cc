@@ -25,6 +25,7 @@
 
 #include <benchmark/benchmark.h>
 
+#include "pedigree/kernel/utilities/FlatHashTable.h"
 #include "pedigree/kernel/utilities/HashTable.h"
 
 class HashedInteger
@@ -290,6 +291,166 @@ static void BM_HashTableLookupWithChains(benchmark::State &state)
         int64_t(state.iterations()) * int64_t(state.range(0)));
 }
 
+// HashTable and FlatHashTable side by side: the same workloads, templated on
+// the table type.
+
+typedef HashTable<HashedInteger, int64_t> ChainedTable;
+typedef FlatHashTable<HashedInteger, int64_t> FlatTable;
+
+template <class Table>
+static void BM_TableInsert(benchmark::State &state)
+{
+    int64_t value = 1;
+
+    while (state.KeepRunning())
+    {
+        state.PauseTiming();
+        Table table;
+        state.ResumeTiming();
+
+        for (size_t i = 0; i < state.range(0); ++i)
+        {
+            HashedInteger key(i);
+            table.insert(key, value);
+        }
+
+        state.PauseTiming();
+        state.counters["bytes_per_entry"] =
+            double(table.memoryUsage()) / state.range(0);
+        state.ResumeTiming();
+    }
+
+    state.SetItemsProcessed(
+        int64_t(state.iterations()) * int64_t(state.range(0)));
+}
+
+template <class Table>
+static void BM_TableLookupHit(benchmark::State &state)
+{
+    Table table;
+    int64_t value = 1;
+    for (size_t i = 0; i < state.range(0); ++i)
+    {
+        HashedInteger key(i);
+        table.insert(key, value);
+    }
+
+    while (state.KeepRunning())
+    {
+        for (size_t i = 0; i < state.range(0); ++i)
+        {
+            HashedInteger key(i);
+            benchmark::DoNotOptimize(table.lookup(key));
+        }
+    }
+
+    state.SetItemsProcessed(
+        int64_t(state.iterations()) * int64_t(state.range(0)));
+}
+
+template <class Table>
+static void BM_TableLookupMiss(benchmark::State &state)
+{
+    Table table;
+    int64_t value = 1;
+    for (size_t i = 0; i < state.range(0); ++i)
+    {
+        HashedInteger key(i);
+        table.insert(key, value);
+    }
+
+    while (state.KeepRunning())
+    {
+        for (size_t i = 0; i < state.range(0); ++i)
+        {
+            HashedInteger key(i + state.range(0));
+            benchmark::DoNotOptimize(table.lookup(key));
+        }
+    }
+
+    state.SetItemsProcessed(
+        int64_t(state.iterations()) * int64_t(state.range(0)));
+}
+
+template <class Table>
+static void BM_TableRemove(benchmark::State &state)
+{
+    int64_t value = 1;
+
+    while (state.KeepRunning())
+    {
+        state.PauseTiming();
+        Table table;
+        for (size_t i = 0; i < state.range(0); ++i)
+        {
+            HashedInteger key(i);
+            table.insert(key, value);
+        }
+        state.ResumeTiming();
+
+        for (size_t i = 0; i < state.range(0); ++i)
+        {
+            HashedInteger key(i);
+            table.remove(key);
+        }
+    }
+
+    state.SetItemsProcessed(
+        int64_t(state.iterations()) * int64_t(state.range(0)));
+}
+
+/// Keys spread over the whole 32-bit range, as real (string) hashes are.
+template <class Table>
+static void BM_TableLookupScattered(benchmark::State &state)
+{
+    Table table;
+    int64_t value = 1;
+    std::vector<HashedInteger> keys;
+    uint32_t x = 12345;
+    for (size_t i = 0; i < state.range(0); ++i)
+    {
+        x = x * 1103515245 + 12345;
+        keys.push_back(HashedInteger(x >> 1));
+        table.insert(keys.back(), value);
+    }
+
+    while (state.KeepRunning())
+    {
+        for (auto &key : keys)
+        {
+            benchmark::DoNotOptimize(table.lookup(key));
+        }
+    }
+
+    state.SetItemsProcessed(
+        int64_t(state.iterations()) * int64_t(state.range(0)));
+}
+
+template <class Table>
+static void BM_TableIterate(benchmark::State &state)
+{
+    Table table;
+    int64_t value = 1;
+    for (size_t i = 0; i < state.range(0); ++i)
+    {
+        HashedInteger key(i);
+        table.insert(key, value);
+    }
+
+    while (state.KeepRunning())
+    {
+        int64_t sum = 0;
+        for (auto it = table.begin(); it != table.end(); ++it)
+        {
+            sum += *it;
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+
+    state.SetItemsProcessed(
+        int64_t(state.iterations()) * int64_t(state.range(0)));
+}
+
 BENCHMARK(BM_HashTableInsertPreallocate)->Range(8, 16384);
 BENCHMARK(BM_HashTableInsertNoChains)->Range(8, 16384);
 BENCHMARK(BM_HashTableInsertNoChainsReserved)->Range(8, 16384);
@@ -299,3 +460,16 @@ BENCHMARK(BM_HashTableInsertNoChainsReservedLinear)->Range(8, 16384);
 BENCHMARK(BM_HashTableLookupNoChainsLinear)->Range(8, 16384);
 BENCHMARK(BM_HashTableInsertWithChains)->Range(8, 16384);
 BENCHMARK(BM_HashTableLookupWithChains)->Range(8, 16384);
+
+BENCHMARK_TEMPLATE(BM_TableInsert, ChainedTable)->Range(8, 16384);
+BENCHMARK_TEMPLATE(BM_TableInsert, FlatTable)->Range(8, 16384);
+BENCHMARK_TEMPLATE(BM_TableLookupHit, ChainedTable)->Range(8, 16384);
+BENCHMARK_TEMPLATE(BM_TableLookupHit, FlatTable)->Range(8, 16384);
+BENCHMARK_TEMPLATE(BM_TableLookupMiss, ChainedTable)->Range(8, 16384);
+BENCHMARK_TEMPLATE(BM_TableLookupMiss, FlatTable)->Range(8, 16384);
+BENCHMARK_TEMPLATE(BM_TableLookupScattered, ChainedTable)->Range(8, 16384);
+BENCHMARK_TEMPLATE(BM_TableLookupScattered, FlatTable)->Range(8, 16384);
+BENCHMARK_TEMPLATE(BM_TableRemove, ChainedTable)->Range(8, 4096);
+BENCHMARK_TEMPLATE(BM_TableRemove, FlatTable)->Range(8, 4096);
+BENCHMARK_TEMPLATE(BM_TableIterate, ChainedTable)->Range(8, 16384);
+BENCHMARK_TEMPLATE(BM_TableIterate, FlatTable)->Range(8, 16384);
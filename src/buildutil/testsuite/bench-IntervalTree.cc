@@ -0,0 +1,157 @@
+/*
+ * Copyright (c) 2008-2014, Pedigree Developers
+ *
+ * Please see the CONTRIB file in the root of the source tree for a full
+ * list of contributors.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+#define PEDIGREE_EXTERNAL_SOURCE 1
+
+#include <stdlib.h>
+
+#include <benchmark/benchmark.h>
+
+#include "pedigree/kernel/utilities/IntervalTree.h"
+#include "pedigree/kernel/utilities/List.h"
+
+// Mappings are a few pages long with gaps between them, like the libraries
+// and malloc arenas of a dynamically linked process.
+static const uintptr_t PageSize = 0x1000;
+static const uintptr_t MappingStride = 16 * PageSize;
+
+struct Mapping
+{
+    uintptr_t address;
+    size_t length;
+
+    bool matches(uintptr_t a) const
+    {
+        return (address <= a) && (a < (address + length));
+    }
+};
+
+static void makeMappings(Mapping *mappings, size_t n)
+{
+    for (size_t i = 0; i < n; ++i)
+    {
+        mappings[i].address = 0x40000000 + (i * MappingStride);
+        mappings[i].length = ((i % 8) + 1) * PageSize;
+    }
+}
+
+// Random address inside one of the n mappings, as a fault would be.
+static uintptr_t faultAddress(size_t n)
+{
+    size_t which = rand() % n;
+    return 0x40000000 + (which * MappingStride) +
+           ((rand() % ((which % 8) + 1)) * PageSize);
+}
+
+// What MemoryMapManager::trap used to do: walk every mapping.
+static void BM_FaultLookupList(benchmark::State &state)
+{
+    const size_t n = state.range(0);
+    Mapping *mappings = new Mapping[n];
+    makeMappings(mappings, n);
+
+    List<Mapping *> list;
+    for (size_t i = 0; i < n; ++i)
+    {
+        list.pushBack(&mappings[i]);
+    }
+
+    srand(0);
+    while (state.KeepRunning())
+    {
+        uintptr_t address = faultAddress(n);
+        Mapping *result = 0;
+        for (auto it : list)
+        {
+            if (it->matches(address))
+            {
+                result = it;
+                break;
+            }
+        }
+        benchmark::DoNotOptimize(result);
+    }
+
+    delete[] mappings;
+
+    state.SetItemsProcessed(int64_t(state.iterations()));
+    state.SetComplexityN(state.range(0));
+}
+
+static void BM_FaultLookupIntervalTree(benchmark::State &state)
+{
+    const size_t n = state.range(0);
+    Mapping *mappings = new Mapping[n];
+    makeMappings(mappings, n);
+
+    // Insert in a shuffled order, as mmap() calls don't arrive sorted. The
+    // stride is prime, so this visits every mapping once.
+    IntervalTree<Mapping *> tree;
+    for (size_t i = 0; i < n; ++i)
+    {
+        Mapping *m = &mappings[(i * 7919) % n];
+        tree.insert(m->address, m->address + m->length, m);
+    }
+
+    srand(0);
+    while (state.KeepRunning())
+    {
+        Mapping *result = 0;
+        benchmark::DoNotOptimize(tree.lookup(faultAddress(n), result));
+        benchmark::DoNotOptimize(result);
+    }
+
+    delete[] mappings;
+
+    state.SetItemsProcessed(int64_t(state.iterations()));
+    state.SetComplexityN(state.range(0));
+}
+
+// mmap() followed by munmap() with n other mappings present.
+static void BM_MapUnmapIntervalTree(benchmark::State &state)
+{
+    const size_t n = state.range(0);
+    Mapping *mappings = new Mapping[n];
+    makeMappings(mappings, n);
+
+    IntervalTree<Mapping *> tree;
+    for (size_t i = 0; i < n; ++i)
+    {
+        tree.insert(
+            mappings[i].address, mappings[i].address + mappings[i].length,
+            &mappings[i]);
+    }
+
+    Mapping extra = {0x40000000 + (n * MappingStride), PageSize};
+    while (state.KeepRunning())
+    {
+        tree.insert(extra.address, extra.address + extra.length, &extra);
+        tree.remove(extra.address, &extra);
+    }
+
+    delete[] mappings;
+
+    state.SetItemsProcessed(int64_t(state.iterations()));
+    state.SetComplexityN(state.range(0));
+}
+
+BENCHMARK(BM_FaultLookupList)->Range(16, 1 << 13)->Complexity();
+BENCHMARK(BM_FaultLookupIntervalTree)->Range(16, 1 << 13)->Complexity();
+BENCHMARK(BM_MapUnmapIntervalTree)->Range(16, 1 << 13)->Complexity();
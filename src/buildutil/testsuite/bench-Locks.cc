@@ -0,0 +1,124 @@
+/*
+ * Copyright (c) 2008-2014, Pedigree Developers
+ *
+ * Please see the CONTRIB file in the root of the source tree for a full
+ * list of contributors.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#define PEDIGREE_EXTERNAL_SOURCE 1
+
+#include <benchmark/benchmark.h>
+
+#include "pedigree/kernel/process/AdaptiveMutex.h"
+#include "pedigree/kernel/process/Mutex.h"
+#include "pedigree/kernel/process/RWLock.h"
+
+// Work done inside each critical section, so the lock is held for a realistic
+// (short) amount of time rather than being released immediately.
+static void criticalSection(size_t &value, size_t amount)
+{
+    for (size_t i = 0; i < amount; ++i)
+    {
+        benchmark::DoNotOptimize(++value);
+    }
+}
+
+template <class T>
+static void BM_LockContended(benchmark::State &state)
+{
+    static T lock;
+    static size_t value = 0;
+
+    while (state.KeepRunning())
+    {
+        lock.acquire();
+        criticalSection(value, state.range(0));
+        lock.release();
+    }
+
+    state.SetItemsProcessed(int64_t(state.iterations()));
+}
+
+// Nine reads for every write, as a read-mostly structure would see.
+template <class T>
+static void BM_LockReadMostly(benchmark::State &state)
+{
+    static T lock;
+    static size_t value = 0;
+
+    size_t n = 0;
+    while (state.KeepRunning())
+    {
+        lock.acquire();
+        if (++n % 10)
+        {
+            benchmark::DoNotOptimize(value);
+        }
+        else
+        {
+            criticalSection(value, 1);
+        }
+        lock.release();
+    }
+
+    state.SetItemsProcessed(int64_t(state.iterations()));
+}
+
+static void BM_RWLockReadMostly(benchmark::State &state)
+{
+    static RWLock lock;
+    static size_t value = 0;
+
+    size_t n = 0;
+    while (state.KeepRunning())
+    {
+        if (++n % 10)
+        {
+            lock.acquireRead();
+            benchmark::DoNotOptimize(value);
+            lock.releaseRead();
+        }
+        else
+        {
+            lock.acquireWrite();
+            criticalSection(value, 1);
+            lock.releaseWrite();
+        }
+    }
+
+    state.SetItemsProcessed(int64_t(state.iterations()));
+}
+
+BENCHMARK_TEMPLATE(BM_LockContended, Mutex)
+    ->Arg(1)
+    ->Arg(64)
+    ->ThreadRange(1, 8)
+    ->UseRealTime();
+BENCHMARK_TEMPLATE(BM_LockContended, AdaptiveMutex)
+    ->Arg(1)
+    ->Arg(64)
+    ->ThreadRange(1, 8)
+    ->UseRealTime();
+BENCHMARK_TEMPLATE(BM_LockContended, RWLock)
+    ->Arg(1)
+    ->Arg(64)
+    ->ThreadRange(1, 8)
+    ->UseRealTime();
+
+BENCHMARK_TEMPLATE(BM_LockReadMostly, Mutex)->ThreadRange(1, 8)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_LockReadMostly, AdaptiveMutex)
+    ->ThreadRange(1, 8)
+    ->UseRealTime();
+BENCHMARK(BM_RWLockReadMostly)->ThreadRange(1, 8)->UseRealTime();
@@ -0,0 +1,237 @@
+/*
+ * Copyright (c) 2008-2014, Pedigree Developers
+ *
+ * Please see the CONTRIB file in the root of the source tree for a full
+ * list of contributors.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+#define PEDIGREE_EXTERNAL_SOURCE 1
+
+#include <stdlib.h>
+
+#include <benchmark/benchmark.h>
+
+#include "pedigree/kernel/utilities/HashTable.h"
+#include "pedigree/kernel/utilities/PageIndex.h"
+
+// Same shape as the key File used for its data cache before PageIndex.
+class BlockKey
+{
+  public:
+    BlockKey() = default;
+    BlockKey(size_t block) : m_Block(block)
+    {
+    }
+
+    size_t hash() const
+    {
+        return m_Block;
+    }
+
+    bool operator==(const BlockKey &other) const
+    {
+        return m_Block == other.m_Block;
+    }
+
+  private:
+    size_t m_Block = ~static_cast<size_t>(0);
+};
+
+// Cached "page" addresses for a file of n blocks.
+static uintptr_t blockAddress(size_t block)
+{
+    return 0x80000000 + (block * 0x1000);
+}
+
+static void BM_FileCacheSequentialHashTable(benchmark::State &state)
+{
+    const size_t n = state.range(0);
+    HashTable<BlockKey, uintptr_t> table(0);
+    for (size_t i = 0; i < n; ++i)
+    {
+        table.insert(BlockKey(i), blockAddress(i));
+    }
+
+    size_t block = 0;
+    while (state.KeepRunning())
+    {
+        benchmark::DoNotOptimize(table.lookup(BlockKey(block)));
+        if (++block >= n)
+        {
+            block = 0;
+        }
+    }
+
+    state.SetItemsProcessed(int64_t(state.iterations()));
+}
+
+static void BM_FileCacheSequentialPageIndex(benchmark::State &state)
+{
+    const size_t n = state.range(0);
+    PageIndex index;
+    for (size_t i = 0; i < n; ++i)
+    {
+        index.insert(i, blockAddress(i));
+    }
+
+    size_t block = 0;
+    while (state.KeepRunning())
+    {
+        benchmark::DoNotOptimize(index.lookup(block));
+        if (++block >= n)
+        {
+            block = 0;
+        }
+    }
+
+    state.SetItemsProcessed(int64_t(state.iterations()));
+}
+
+static void BM_FileCacheRandomHashTable(benchmark::State &state)
+{
+    const size_t n = state.range(0);
+    HashTable<BlockKey, uintptr_t> table(0);
+    for (size_t i = 0; i < n; ++i)
+    {
+        table.insert(BlockKey(i), blockAddress(i));
+    }
+
+    srand(0);
+    while (state.KeepRunning())
+    {
+        benchmark::DoNotOptimize(table.lookup(BlockKey(rand() % n)));
+    }
+
+    state.SetItemsProcessed(int64_t(state.iterations()));
+}
+
+static void BM_FileCacheRandomPageIndex(benchmark::State &state)
+{
+    const size_t n = state.range(0);
+    PageIndex index;
+    for (size_t i = 0; i < n; ++i)
+    {
+        index.insert(i, blockAddress(i));
+    }
+
+    srand(0);
+    while (state.KeepRunning())
+    {
+        benchmark::DoNotOptimize(index.lookup(rand() % n));
+    }
+
+    state.SetItemsProcessed(int64_t(state.iterations()));
+}
+
+// Batches of 16 consecutive blocks, as File::read does for a large read.
+static void BM_FileCacheBatchHashTable(benchmark::State &state)
+{
+    const size_t n = state.range(0);
+    HashTable<BlockKey, uintptr_t> table(0);
+    for (size_t i = 0; i < n; ++i)
+    {
+        table.insert(BlockKey(i), blockAddress(i));
+    }
+
+    uintptr_t values[16];
+    size_t block = 0;
+    while (state.KeepRunning())
+    {
+        for (size_t i = 0; i < 16; ++i)
+        {
+            auto result = table.lookup(BlockKey(block + i));
+            values[i] = result.hasValue() ? result.value() : 0;
+        }
+        benchmark::DoNotOptimize(values);
+        block += 16;
+        if (block >= n)
+        {
+            block = 0;
+        }
+    }
+
+    state.SetItemsProcessed(int64_t(state.iterations()) * 16);
+}
+
+static void BM_FileCacheGangLookup(benchmark::State &state)
+{
+    const size_t n = state.range(0);
+    PageIndex index;
+    for (size_t i = 0; i < n; ++i)
+    {
+        index.insert(i, blockAddress(i));
+    }
+
+    size_t indices[16];
+    uintptr_t values[16];
+    size_t block = 0;
+    while (state.KeepRunning())
+    {
+        benchmark::DoNotOptimize(
+            index.gangLookup(block, block + 15, 16, indices, values));
+        block += 16;
+        if (block >= n)
+        {
+            block = 0;
+        }
+    }
+
+    state.SetItemsProcessed(int64_t(state.iterations()) * 16);
+}
+
+// Finding the few dirty blocks of a large, mostly clean file.
+static void BM_FileCacheTaggedWalk(benchmark::State &state)
+{
+    const size_t n = state.range(0);
+    PageIndex index;
+    for (size_t i = 0; i < n; ++i)
+    {
+        index.insert(i, blockAddress(i));
+        if ((i % 1024) == 0)
+        {
+            index.setTag(i, PageIndex::Dirty);
+        }
+    }
+
+    size_t indices[16];
+    while (state.KeepRunning())
+    {
+        size_t next = 0;
+        size_t found = 0;
+        while (true)
+        {
+            found = index.gangLookupTagged(
+                next, ~static_cast<size_t>(0), PageIndex::Dirty, 16, indices,
+                nullptr);
+            if (found < 16)
+            {
+                break;
+            }
+            next = indices[found - 1] + 1;
+        }
+        benchmark::DoNotOptimize(found);
+    }
+
+    state.SetItemsProcessed(int64_t(state.iterations()) * (n / 1024));
+}
+
+BENCHMARK(BM_FileCacheSequentialHashTable)->Range(1 << 10, 1 << 20);
+BENCHMARK(BM_FileCacheSequentialPageIndex)->Range(1 << 10, 1 << 20);
+BENCHMARK(BM_FileCacheRandomHashTable)->Range(1 << 10, 1 << 20);
+BENCHMARK(BM_FileCacheRandomPageIndex)->Range(1 << 10, 1 << 20);
+BENCHMARK(BM_FileCacheBatchHashTable)->Range(1 << 10, 1 << 20);
+BENCHMARK(BM_FileCacheGangLookup)->Range(1 << 10, 1 << 20);
+BENCHMARK(BM_FileCacheTaggedWalk)->Range(1 << 10, 1 << 20);
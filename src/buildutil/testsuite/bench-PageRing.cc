@@ -0,0 +1,143 @@
+/*
+ * Copyright (c) 2008-2014, Pedigree Developers
+ *
+ * Please see the CONTRIB file in the root of the source tree for a full
+ * list of contributors.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#define PEDIGREE_EXTERNAL_SOURCE 1
+
+#include <benchmark/benchmark.h>
+
+#include <memory>
+#include <thread>
+
+#include "pedigree/kernel/utilities/Buffer.h"
+#include "pedigree/kernel/utilities/PageRing.h"
+
+// Amount of data pushed through the pipeline in each iteration.
+static const size_t TransferSize = 4 << 20;
+
+// Size of each read on the consuming end, as cat would use.
+static const size_t ReadSize = 128 << 10;
+
+// Writes TransferSize bytes in blocks of blockSize, as dd would, then hangs up.
+template <class T>
+static void producer(T &pipe, const uint8_t *source, size_t blockSize)
+{
+    for (size_t offset = 0; offset < TransferSize; offset += blockSize)
+    {
+        pipe.write(source + offset, blockSize, true);
+    }
+    pipe.disableWrites();
+}
+
+template <class T>
+static size_t consumer(T &pipe, uint8_t *sink)
+{
+    size_t total = 0;
+    while (size_t n = pipe.read(sink, ReadSize, true))
+    {
+        total += n;
+    }
+    return total;
+}
+
+// dd bs=N | cat
+template <class T>
+static void BM_PipeThroughput(benchmark::State &state)
+{
+    std::unique_ptr<uint8_t[]> source(new uint8_t[TransferSize]);
+    std::unique_ptr<uint8_t[]> sink(new uint8_t[ReadSize]);
+    memset(source.get(), 0xAB, TransferSize);
+
+    while (state.KeepRunning())
+    {
+        T pipe(64 << 10);
+        std::thread writer(
+            producer<T>, std::ref(pipe), source.get(), state.range(0));
+        benchmark::DoNotOptimize(consumer(pipe, sink.get()));
+        writer.join();
+    }
+
+    state.SetBytesProcessed(int64_t(state.iterations()) * TransferSize);
+}
+
+// dd bs=N | cat | cat, with the middle stage either copying through a
+// buffer of its own or splicing pages between the two pipes.
+template <bool splice>
+static void BM_PipeRelay(benchmark::State &state)
+{
+    std::unique_ptr<uint8_t[]> source(new uint8_t[TransferSize]);
+    std::unique_ptr<uint8_t[]> sink(new uint8_t[ReadSize]);
+    std::unique_ptr<uint8_t[]> relay(new uint8_t[ReadSize]);
+    memset(source.get(), 0xAB, TransferSize);
+
+    while (state.KeepRunning())
+    {
+        PageRing first, second;
+        std::thread writer(
+            producer<PageRing>, std::ref(first), source.get(),
+            state.range(0));
+        std::thread middle([&]() {
+            while (true)
+            {
+                size_t n = 0;
+                if (splice)
+                {
+                    n = first.splice(second, ReadSize, true);
+                }
+                else if ((n = first.read(relay.get(), ReadSize, true)))
+                {
+                    second.write(relay.get(), n, true);
+                }
+
+                if (!n)
+                {
+                    break;
+                }
+            }
+            second.disableWrites();
+        });
+        benchmark::DoNotOptimize(consumer(second, sink.get()));
+        writer.join();
+        middle.join();
+    }
+
+    state.SetBytesProcessed(int64_t(state.iterations()) * TransferSize);
+}
+
+// PageRing's constructor takes a slot count rather than a size in bytes.
+class PageRingPipe : public PageRing
+{
+  public:
+    PageRingPipe(size_t size) : PageRing(size / PageRing::PageSize)
+    {
+    }
+};
+
+BENCHMARK_TEMPLATE(BM_PipeThroughput, Buffer<uint8_t>)
+    ->Arg(512)
+    ->Arg(4096)
+    ->Arg(65536)
+    ->UseRealTime();
+BENCHMARK_TEMPLATE(BM_PipeThroughput, PageRingPipe)
+    ->Arg(512)
+    ->Arg(4096)
+    ->Arg(65536)
+    ->UseRealTime();
+
+BENCHMARK_TEMPLATE(BM_PipeRelay, false)->Arg(4096)->Arg(65536)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_PipeRelay, true)->Arg(4096)->Arg(65536)->UseRealTime();
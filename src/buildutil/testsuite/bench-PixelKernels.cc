@@ -0,0 +1,226 @@
+/*
+ * Copyright (c) 2008-2014, Pedigree Developers
+ *
+ * Please see the CONTRIB file in the root of the source tree for a full
+ * list of contributors.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#define PEDIGREE_EXTERNAL_SOURCE 1
+
+#include <stdlib.h>
+
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "pedigree/kernel/graphics/PixelKernels.h"
+
+using namespace Graphics;
+
+// Items processed are pixels, so items/s reads as pixels per second.
+
+static const PixelKernels *KernelsOrSkip(
+    benchmark::State &state, KernelVariant variant)
+{
+    const PixelKernels *k = pixelKernels(variant);
+    if (!k)
+    {
+        state.SkipWithError("variant not supported on this CPU");
+        return 0;
+    }
+
+    state.SetLabel(k->name);
+    return k;
+}
+
+static std::vector<uint32_t> RandomPixels(size_t n)
+{
+    std::vector<uint32_t> result(n);
+    for (auto &p : result)
+    {
+        p = rand();
+    }
+    return result;
+}
+
+static void
+BM_PixelKernels_Copy(benchmark::State &state, KernelVariant variant)
+{
+    const PixelKernels *k = KernelsOrSkip(state, variant);
+    if (!k)
+        return;
+
+    std::vector<uint32_t> src = RandomPixels(state.range(0));
+    std::vector<uint32_t> dest(state.range(0));
+
+    while (state.KeepRunning())
+    {
+        k->copy(dest.data(), src.data(), state.range(0) * 4);
+        benchmark::DoNotOptimize(dest.data());
+    }
+
+    state.SetItemsProcessed(int64_t(state.iterations()) * state.range(0));
+    state.SetBytesProcessed(int64_t(state.iterations()) * state.range(0) * 4);
+}
+
+static void
+BM_PixelKernels_Fill32(benchmark::State &state, KernelVariant variant)
+{
+    const PixelKernels *k = KernelsOrSkip(state, variant);
+    if (!k)
+        return;
+
+    std::vector<uint32_t> dest(state.range(0));
+
+    while (state.KeepRunning())
+    {
+        k->fill32(dest.data(), 0xFF336699, state.range(0));
+        benchmark::DoNotOptimize(dest.data());
+    }
+
+    state.SetItemsProcessed(int64_t(state.iterations()) * state.range(0));
+}
+
+static void
+BM_PixelKernels_Fill16(benchmark::State &state, KernelVariant variant)
+{
+    const PixelKernels *k = KernelsOrSkip(state, variant);
+    if (!k)
+        return;
+
+    std::vector<uint16_t> dest(state.range(0));
+
+    while (state.KeepRunning())
+    {
+        k->fill16(dest.data(), 0x3339, state.range(0));
+        benchmark::DoNotOptimize(dest.data());
+    }
+
+    state.SetItemsProcessed(int64_t(state.iterations()) * state.range(0));
+}
+
+static void
+BM_PixelKernels_Argb8888ToRgb565(benchmark::State &state, KernelVariant variant)
+{
+    const PixelKernels *k = KernelsOrSkip(state, variant);
+    if (!k)
+        return;
+
+    std::vector<uint32_t> src = RandomPixels(state.range(0));
+    std::vector<uint16_t> dest(state.range(0));
+
+    while (state.KeepRunning())
+    {
+        k->argb8888ToRgb565(dest.data(), src.data(), state.range(0));
+        benchmark::DoNotOptimize(dest.data());
+    }
+
+    state.SetItemsProcessed(int64_t(state.iterations()) * state.range(0));
+}
+
+static void
+BM_PixelKernels_Rgb565ToArgb8888(benchmark::State &state, KernelVariant variant)
+{
+    const PixelKernels *k = KernelsOrSkip(state, variant);
+    if (!k)
+        return;
+
+    std::vector<uint32_t> src = RandomPixels(state.range(0) / 2);
+    std::vector<uint32_t> dest(state.range(0));
+
+    while (state.KeepRunning())
+    {
+        k->rgb565ToArgb8888(
+            dest.data(), reinterpret_cast<const uint16_t *>(src.data()),
+            state.range(0));
+        benchmark::DoNotOptimize(dest.data());
+    }
+
+    state.SetItemsProcessed(int64_t(state.iterations()) * state.range(0));
+}
+
+static void
+BM_PixelKernels_Rgb888ToArgb8888(benchmark::State &state, KernelVariant variant)
+{
+    const PixelKernels *k = KernelsOrSkip(state, variant);
+    if (!k)
+        return;
+
+    std::vector<uint32_t> src = RandomPixels(state.range(0));
+    std::vector<uint32_t> dest(state.range(0));
+
+    while (state.KeepRunning())
+    {
+        k->rgb888ToArgb8888(
+            dest.data(), reinterpret_cast<const uint8_t *>(src.data()),
+            state.range(0));
+        benchmark::DoNotOptimize(dest.data());
+    }
+
+    state.SetItemsProcessed(int64_t(state.iterations()) * state.range(0));
+}
+
+static void
+BM_PixelKernels_Argb8888ToRgb888(benchmark::State &state, KernelVariant variant)
+{
+    const PixelKernels *k = KernelsOrSkip(state, variant);
+    if (!k)
+        return;
+
+    std::vector<uint32_t> src = RandomPixels(state.range(0));
+    std::vector<uint8_t> dest(state.range(0) * 3);
+
+    while (state.KeepRunning())
+    {
+        k->argb8888ToRgb888(dest.data(), src.data(), state.range(0));
+        benchmark::DoNotOptimize(dest.data());
+    }
+
+    state.SetItemsProcessed(int64_t(state.iterations()) * state.range(0));
+}
+
+static void
+BM_PixelKernels_Blend(benchmark::State &state, KernelVariant variant)
+{
+    const PixelKernels *k = KernelsOrSkip(state, variant);
+    if (!k)
+        return;
+
+    std::vector<uint32_t> src = RandomPixels(state.range(0));
+    std::vector<uint32_t> dest = RandomPixels(state.range(0));
+
+    while (state.KeepRunning())
+    {
+        k->blendArgb8888(dest.data(), src.data(), state.range(0));
+        benchmark::DoNotOptimize(dest.data());
+    }
+
+    state.SetItemsProcessed(int64_t(state.iterations()) * state.range(0));
+}
+
+// From a short span (e.g. a glyph row) through to a full 1024x768 screen.
+#define PIXEL_KERNEL_BENCHMARK(name)                                 \
+    BENCHMARK_CAPTURE(name, scalar, KernelScalar)->Range(64, 1 << 20); \
+    BENCHMARK_CAPTURE(name, sse2, KernelSse2)->Range(64, 1 << 20);     \
+    BENCHMARK_CAPTURE(name, avx2, KernelAvx2)->Range(64, 1 << 20)
+
+PIXEL_KERNEL_BENCHMARK(BM_PixelKernels_Copy);
+PIXEL_KERNEL_BENCHMARK(BM_PixelKernels_Fill32);
+PIXEL_KERNEL_BENCHMARK(BM_PixelKernels_Fill16);
+PIXEL_KERNEL_BENCHMARK(BM_PixelKernels_Argb8888ToRgb565);
+PIXEL_KERNEL_BENCHMARK(BM_PixelKernels_Rgb565ToArgb8888);
+PIXEL_KERNEL_BENCHMARK(BM_PixelKernels_Rgb888ToArgb8888);
+PIXEL_KERNEL_BENCHMARK(BM_PixelKernels_Argb8888ToRgb888);
+PIXEL_KERNEL_BENCHMARK(BM_PixelKernels_Blend);
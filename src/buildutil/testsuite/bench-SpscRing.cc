@@ -0,0 +1,141 @@
+/*
+ * Copyright (c) 2008-2014, Pedigree Developers
+ *
+ * Please see the CONTRIB file in the root of the source tree for a full
+ * list of contributors.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+#define PEDIGREE_EXTERNAL_SOURCE 1
+
+#include <benchmark/benchmark.h>
+
+#include <memory>
+#include <thread>
+
+#include "pedigree/kernel/utilities/Buffer.h"
+#include "pedigree/kernel/utilities/SpscRing.h"
+
+// Amount of data pushed through the stream in each iteration.
+static const size_t TransferSize = 4 << 20;
+
+// Size of each read on the receiving end.
+static const size_t ReadSize = 64 << 10;
+
+// Number of round trips in each latency iteration.
+static const size_t RoundTrips = 1000;
+
+// UnixSocket streams used to be a short-write Buffer.
+typedef Buffer<uint8_t, true> SocketBuffer;
+
+// Sends TransferSize bytes in blocks of blockSize, then hangs up.
+template <class T>
+static void sender(T &stream, const uint8_t *source, size_t blockSize)
+{
+    for (size_t offset = 0; offset < TransferSize; offset += blockSize)
+    {
+        stream.write(source + offset, blockSize, true);
+    }
+    stream.disableWrites();
+}
+
+// One direction of a stream socket pair, bulk transfer.
+template <class T>
+static void BM_StreamThroughput(benchmark::State &state)
+{
+    std::unique_ptr<uint8_t[]> source(new uint8_t[TransferSize]);
+    std::unique_ptr<uint8_t[]> sink(new uint8_t[ReadSize]);
+    memset(source.get(), 0xAB, TransferSize);
+
+    while (state.KeepRunning())
+    {
+        T stream(64 << 10);
+        std::thread writer(
+            sender<T>, std::ref(stream), source.get(), state.range(0));
+
+        size_t total = 0;
+        while (size_t n = stream.read(sink.get(), ReadSize, true))
+        {
+            total += n;
+        }
+        benchmark::DoNotOptimize(total);
+
+        writer.join();
+    }
+
+    state.SetBytesProcessed(int64_t(state.iterations()) * TransferSize);
+}
+
+// Ping-pong of small messages over a pair of streams (request/response).
+template <class T>
+static void BM_StreamRoundTrip(benchmark::State &state)
+{
+    const size_t messageSize = state.range(0);
+
+    while (state.KeepRunning())
+    {
+        T request(64 << 10), response(64 << 10);
+        std::thread server([&]() {
+            std::unique_ptr<uint8_t[]> message(new uint8_t[messageSize]());
+            for (size_t i = 0; i < RoundTrips; ++i)
+            {
+                size_t got = 0;
+                while (got < messageSize)
+                {
+                    got += request.read(
+                        message.get() + got, messageSize - got, true);
+                }
+                response.write(message.get(), messageSize, true);
+            }
+        });
+
+        std::unique_ptr<uint8_t[]> message(new uint8_t[messageSize]());
+        for (size_t i = 0; i < RoundTrips; ++i)
+        {
+            request.write(message.get(), messageSize, true);
+
+            size_t got = 0;
+            while (got < messageSize)
+            {
+                got += response.read(
+                    message.get() + got, messageSize - got, true);
+            }
+        }
+
+        server.join();
+    }
+
+    state.SetItemsProcessed(int64_t(state.iterations()) * RoundTrips);
+}
+
+BENCHMARK_TEMPLATE(BM_StreamThroughput, SocketBuffer)
+    ->Arg(512)
+    ->Arg(4096)
+    ->Arg(65536)
+    ->UseRealTime();
+BENCHMARK_TEMPLATE(BM_StreamThroughput, SpscRing)
+    ->Arg(512)
+    ->Arg(4096)
+    ->Arg(65536)
+    ->UseRealTime();
+
+BENCHMARK_TEMPLATE(BM_StreamRoundTrip, SocketBuffer)
+    ->Arg(16)
+    ->Arg(512)
+    ->UseRealTime();
+BENCHMARK_TEMPLATE(BM_StreamRoundTrip, SpscRing)
+    ->Arg(16)
+    ->Arg(512)
+    ->UseRealTime();
@@ -503,6 +503,96 @@ static void BM_CxxStringCompareRawFuncWorstCase(benchmark::State &state)
     state.SetComplexityN(state.range(0));
 }
 
+// Path-component-sized strings (the common case for directory entries, map
+// keys and log fragments), with the length as the argument.
+
+static void fillComponent(char *buf, size_t n)
+{
+    for (size_t i = 0; i < n; ++i)
+    {
+        buf[i] = 'a' + (i % 26);
+    }
+    buf[n] = 0;
+}
+
+static void BM_CxxStringComponentCreate(benchmark::State &state)
+{
+    char buf[256];
+    fillComponent(buf, state.range(0));
+
+    while (state.KeepRunning())
+    {
+        String s(buf, state.range(0));
+        benchmark::DoNotOptimize(s);
+    }
+
+    state.SetItemsProcessed(int64_t(state.iterations()));
+}
+
+static void BM_CxxStringComponentCopy(benchmark::State &state)
+{
+    char buf[256];
+    fillComponent(buf, state.range(0));
+    String source(buf, state.range(0));
+
+    while (state.KeepRunning())
+    {
+        String s(source);
+        benchmark::DoNotOptimize(s);
+    }
+
+    state.SetItemsProcessed(int64_t(state.iterations()));
+}
+
+static void BM_CxxStringComponentMove(benchmark::State &state)
+{
+    char buf[256];
+    fillComponent(buf, state.range(0));
+    String a(buf, state.range(0));
+
+    while (state.KeepRunning())
+    {
+        String b(pedigree_std::move(a));
+        a = pedigree_std::move(b);
+        benchmark::DoNotOptimize(a);
+    }
+
+    state.SetItemsProcessed(int64_t(state.iterations()));
+}
+
+static void BM_CxxStringComponentHash(benchmark::State &state)
+{
+    char buf[256];
+    fillComponent(buf, state.range(0));
+
+    while (state.KeepRunning())
+    {
+        String s(buf, state.range(0));
+        benchmark::DoNotOptimize(s.hash());
+    }
+
+    state.SetItemsProcessed(int64_t(state.iterations()));
+}
+
+static void BM_CxxStringComponentVector(benchmark::State &state)
+{
+    char buf[256];
+    fillComponent(buf, state.range(0));
+    String source(buf, state.range(0));
+
+    while (state.KeepRunning())
+    {
+        Vector<String> v;
+        for (size_t i = 0; i < 16; ++i)
+        {
+            v.pushBack(source);
+        }
+        benchmark::DoNotOptimize(v);
+    }
+
+    state.SetItemsProcessed(int64_t(state.iterations()) * 16);
+}
+
 BENCHMARK(BM_CxxStringCreation);
 BENCHMARK(BM_CxxStringCreationConstexpr);
 BENCHMARK(BM_CxxStringCopyToStatic);
@@ -529,3 +619,8 @@ BENCHMARK(BM_CxxStringCompareRawWorstCase)->Range(8, 4096)->Complexity();
 BENCHMARK(BM_CxxStringCompareRawFuncBestCase)->Range(8, 4096)->Complexity();
 BENCHMARK(BM_CxxStringCompareRawFuncAverageCase)->Range(8, 4096)->Complexity();
 BENCHMARK(BM_CxxStringCompareRawFuncWorstCase)->Range(8, 4096)->Complexity();
+BENCHMARK(BM_CxxStringComponentCreate)->Arg(8)->Arg(16)->Arg(23)->Arg(40);
+BENCHMARK(BM_CxxStringComponentCopy)->Arg(8)->Arg(16)->Arg(23)->Arg(40);
+BENCHMARK(BM_CxxStringComponentMove)->Arg(8)->Arg(16)->Arg(23)->Arg(40);
+BENCHMARK(BM_CxxStringComponentHash)->Arg(8)->Arg(16)->Arg(23)->Arg(40);
+BENCHMARK(BM_CxxStringComponentVector)->Arg(8)->Arg(23)->Arg(40);
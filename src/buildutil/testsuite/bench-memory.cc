@@ -251,3 +251,79 @@ BENCHMARK(BM_Memory_DoubleWordSetZero)->Range(8, 8 << 16);
 BENCHMARK(BM_Memory_QuadWordSet)->Range(8, 8 << 16);
 BENCHMARK(BM_Memory_QuadWordSetZero)->Range(8, 8 << 16);
 BENCHMARK(BM_Memory_MemoryCompare)->Range(8, 8 << 16);
+
+// Per-variant copies and sets across each size class: small (overlapping
+// moves), medium (unrolled loop), rep string and non-temporal.
+static void BM_Memory_VariantCopy(benchmark::State &state)
+{
+    int variant = state.range(0);
+    if (!MemoryVariantSupported(variant))
+    {
+        state.SkipWithError("variant not supported on this CPU");
+        return;
+    }
+
+    int old = MemorySelectVariant(variant);
+    state.SetLabel(MemoryVariantName(variant));
+
+    char *src = new char[state.range(1) + 1];
+    char *dest = new char[state.range(1) + 1];
+    memset(src, 'a', state.range(1) + 1);
+
+    while (state.KeepRunning())
+    {
+        // Misaligned source, as most callers don't promise alignment.
+        ForwardMemoryCopy(dest, src + 1, state.range(1));
+        benchmark::ClobberMemory();
+    }
+
+    state.SetBytesProcessed(
+        int64_t(state.iterations()) * int64_t(state.range(1)));
+
+    delete[] dest;
+    delete[] src;
+
+    MemorySelectVariant(old);
+}
+
+static void BM_Memory_VariantByteSet(benchmark::State &state)
+{
+    int variant = state.range(0);
+    if (!MemoryVariantSupported(variant))
+    {
+        state.SkipWithError("variant not supported on this CPU");
+        return;
+    }
+
+    int old = MemorySelectVariant(variant);
+    state.SetLabel(MemoryVariantName(variant));
+
+    char *buf = new char[state.range(1)];
+
+    while (state.KeepRunning())
+    {
+        ByteSet(buf, 0xAB, state.range(1));
+        benchmark::ClobberMemory();
+    }
+
+    state.SetBytesProcessed(
+        int64_t(state.iterations()) * int64_t(state.range(1)));
+
+    delete[] buf;
+
+    MemorySelectVariant(old);
+}
+
+static void VariantSizeClasses(benchmark::internal::Benchmark *b)
+{
+    for (int v = 0; v < MemoryVariantCount; ++v)
+    {
+        for (int n : {7, 16, 61, 240, 1000, 4096, 65536, 8 << 20})
+        {
+            b->Args({v, n});
+        }
+    }
+}
+
+BENCHMARK(BM_Memory_VariantCopy)->Apply(VariantSizeClasses);
+BENCHMARK(BM_Memory_VariantByteSet)->Apply(VariantSizeClasses);
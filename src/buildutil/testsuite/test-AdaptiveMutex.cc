@@ -0,0 +1,112 @@
+/*
+ * Copyright (c) 2008-2014, Pedigree Developers
+ *
+ * Please see the CONTRIB file in the root of the source tree for a full
+ * list of contributors.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#define PEDIGREE_EXTERNAL_SOURCE 1
+
+#include <gtest/gtest.h>
+
+#include <thread>
+#include <vector>
+
+#include "pedigree/kernel/process/AdaptiveMutex.h"
+
+TEST(PedigreeAdaptiveMutex, Uncontended)
+{
+    AdaptiveMutex m;
+
+    EXPECT_EQ(m.getValue(), 1);
+    EXPECT_TRUE(m.acquire());
+    EXPECT_EQ(m.getValue(), 0);
+    m.release();
+    EXPECT_EQ(m.getValue(), 1);
+}
+
+TEST(PedigreeAdaptiveMutex, TryAcquireFailsWhenHeld)
+{
+    AdaptiveMutex m;
+
+    EXPECT_TRUE(m.tryAcquire());
+    EXPECT_FALSE(m.tryAcquire());
+    m.release();
+    EXPECT_TRUE(m.tryAcquire());
+    m.release();
+}
+
+TEST(PedigreeAdaptiveMutex, StartsLocked)
+{
+    AdaptiveMutex m(true);
+
+    EXPECT_EQ(m.getValue(), 0);
+    EXPECT_FALSE(m.tryAcquire());
+    m.release();
+    EXPECT_TRUE(m.tryAcquire());
+    m.release();
+}
+
+TEST(PedigreeAdaptiveMutex, WaiterSleepsAndWakes)
+{
+    AdaptiveMutex m;
+    int value = 0;
+
+    m.acquire();
+    std::thread waiter([&m, &value]() {
+        m.acquire();
+        value = 1;
+        m.release();
+    });
+
+    // Long enough for the waiter to give up spinning and go to sleep.
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    EXPECT_EQ(value, 0);
+    m.release();
+
+    waiter.join();
+    EXPECT_EQ(value, 1);
+    EXPECT_EQ(m.getValue(), 1);
+}
+
+TEST(PedigreeAdaptiveMutex, Contended)
+{
+    AdaptiveMutex m;
+    size_t counter = 0;
+
+    const size_t nThreads = 8;
+    const size_t nIterations = 20000;
+
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < nThreads; ++i)
+    {
+        threads.emplace_back([&m, &counter, nIterations]() {
+            for (size_t j = 0; j < nIterations; ++j)
+            {
+                m.acquire();
+                ++counter;
+                m.release();
+            }
+        });
+    }
+
+    for (auto &t : threads)
+    {
+        t.join();
+    }
+
+    EXPECT_EQ(counter, nThreads * nIterations);
+    EXPECT_EQ(m.getValue(), 1);
+}
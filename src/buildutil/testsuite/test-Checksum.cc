@@ -0,0 +1,154 @@
+/*
+ * Copyright (c) 2008-2014, Pedigree Developers
+ *
+ * Please see the CONTRIB file in the root of the source tree for a full
+ * list of contributors.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#define PEDIGREE_EXTERNAL_SOURCE 1
+
+#include <gtest/gtest.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "pedigree/kernel/network/Checksum.h"
+
+static std::vector<uint8_t> randomBytes(size_t n)
+{
+    std::vector<uint8_t> result(n);
+    for (auto &b : result)
+    {
+        b = rand() & 0xFF;
+    }
+    return result;
+}
+
+/// Straight from RFC 1071, summing 16-bit words in memory order.
+static uint16_t referenceSum(const uint8_t *p, size_t n)
+{
+    uint64_t sum = 0;
+    for (; n > 1; n -= 2, p += 2)
+    {
+        uint16_t w;
+        memcpy(&w, p, 2);
+        sum += w;
+    }
+    if (n)
+    {
+        uint16_t w = 0;
+        memcpy(&w, p, 1);
+        sum += w;
+    }
+
+    while (sum >> 16)
+        sum = (sum & 0xFFFF) + (sum >> 16);
+    return sum;
+}
+
+class PedigreeChecksum : public ::testing::TestWithParam<ChecksumVariant>
+{
+  protected:
+    void SetUp() override
+    {
+        // Variants the CPU can't run just test the scalar kernels again.
+        m_pKernels = checksumKernels(GetParam());
+        if (!m_pKernels)
+        {
+            m_pKernels = checksumKernels(ChecksumScalar);
+        }
+    }
+
+    const ChecksumKernels *m_pKernels;
+};
+
+TEST(PedigreeChecksumScalar, Rfc1071Example)
+{
+    // The worked example from RFC 1071 section 3.
+    const uint8_t data[] = {0x00, 0x01, 0xf2, 0x03, 0xf4, 0xf5, 0xf6, 0xf7};
+
+    uint16_t expected = 0;
+    uint8_t *e = reinterpret_cast<uint8_t *>(&expected);
+    e[0] = 0xdd;
+    e[1] = 0xf2;
+
+    const ChecksumKernels *k = checksumKernels(ChecksumScalar);
+    EXPECT_EQ(k->sum(data, sizeof(data)), expected);
+}
+
+TEST(PedigreeChecksumScalar, Empty)
+{
+    EXPECT_EQ(checksumKernels(ChecksumScalar)->sum(nullptr, 0), 0);
+    EXPECT_EQ(checksumSum(nullptr, 0), 0);
+}
+
+TEST_P(PedigreeChecksum, MatchesReference)
+{
+    std::vector<uint8_t> data = randomBytes(70000);
+
+    // Every length up to a few vector widths, then some large odd ones.
+    for (size_t n = 0; n < 300; ++n)
+    {
+        EXPECT_EQ(
+            m_pKernels->sum(data.data(), n), referenceSum(data.data(), n))
+            << "length " << n;
+    }
+    for (size_t n : {1499, 1514, 9001, 65535, 69999})
+    {
+        EXPECT_EQ(
+            m_pKernels->sum(data.data(), n), referenceSum(data.data(), n))
+            << "length " << n;
+    }
+}
+
+TEST_P(PedigreeChecksum, Unaligned)
+{
+    std::vector<uint8_t> data = randomBytes(2048);
+
+    for (size_t offset = 1; offset < 8; ++offset)
+    {
+        const uint8_t *p = data.data() + offset;
+        EXPECT_EQ(m_pKernels->sum(p, 1500), referenceSum(p, 1500))
+            << "offset " << offset;
+    }
+}
+
+TEST_P(PedigreeChecksum, AllOnes)
+{
+    // Worst case for carries.
+    std::vector<uint8_t> data(1 << 20, 0xFF);
+    EXPECT_EQ(m_pKernels->sum(data.data(), data.size()), 0xFFFF);
+}
+
+TEST_P(PedigreeChecksum, CopyAndSum)
+{
+    std::vector<uint8_t> src = randomBytes(4099);
+
+    for (size_t n : {0, 1, 2, 63, 64, 65, 1514, 4099})
+    {
+        std::vector<uint8_t> dest(n + 1, 0xAA);
+        EXPECT_EQ(
+            m_pKernels->copyAndSum(dest.data(), src.data(), n),
+            referenceSum(src.data(), n))
+            << "length " << n;
+        EXPECT_EQ(memcmp(dest.data(), src.data(), n), 0);
+        EXPECT_EQ(dest[n], 0xAA);
+    }
+}
+
+INSTANTIATE_TEST_CASE_P(
+    Variants, PedigreeChecksum,
+    ::testing::Values(ChecksumScalar, ChecksumSse2, ChecksumAvx2));
@@ -0,0 +1,191 @@
+/*
+ * Copyright (c) 2008-2014, Pedigree Developers
+ *
+ * Please see the CONTRIB file in the root of the source tree for a full
+ * list of contributors.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+#define PEDIGREE_EXTERNAL_SOURCE 1
+
+#include <gtest/gtest.h>
+
+#include "modules/system/vfs/FileAccessTrace.h"
+#include "pedigree/kernel/utilities/String.h"
+#include "pedigree/kernel/utilities/Vector.h"
+
+typedef Vector<FileAccessTrace::Entry> EntryList;
+
+static void roundTrip(FileAccessTrace &trace, EntryList &entries)
+{
+    String serialised;
+    trace.serialise(serialised);
+    FileAccessTrace::parse(
+        serialised.cstr(), serialised.length(), entries);
+}
+
+TEST(PedigreeFileAccessTrace, IgnoresReadsWhenNotTracing)
+{
+    FileAccessTrace trace;
+    trace.record(String("root»/a"), 0, 100);
+    EXPECT_EQ(trace.count(), 0);
+}
+
+TEST(PedigreeFileAccessTrace, RoundsToGranularity)
+{
+    FileAccessTrace trace;
+    trace.start();
+    trace.record(String("root»/a"), 100, 10);
+    trace.stop();
+
+    EntryList entries;
+    roundTrip(trace, entries);
+    ASSERT_EQ(entries.count(), 1);
+    EXPECT_STREQ(entries[0].path.cstr(), "root»/a");
+    EXPECT_EQ(entries[0].offset, 0);
+    EXPECT_EQ(entries[0].length, FileAccessTrace::TraceGranularity);
+}
+
+TEST(PedigreeFileAccessTrace, SequentialReadsMerge)
+{
+    FileAccessTrace trace;
+    trace.start();
+    for (uint64_t off = 0; off < 0x10000; off += 0x200)
+    {
+        trace.record(String("root»/a"), off, 0x200);
+    }
+    trace.stop();
+
+    EXPECT_EQ(trace.count(), 1);
+
+    EntryList entries;
+    roundTrip(trace, entries);
+    ASSERT_EQ(entries.count(), 1);
+    EXPECT_EQ(entries[0].offset, 0);
+    EXPECT_EQ(entries[0].length, 0x10000);
+}
+
+TEST(PedigreeFileAccessTrace, DisjointReadsStaySeparate)
+{
+    FileAccessTrace trace;
+    trace.start();
+    trace.record(String("root»/a"), 0, 0x1000);
+    trace.record(String("root»/a"), 0x100000, 0x1000);
+    trace.stop();
+
+    EntryList entries;
+    roundTrip(trace, entries);
+    ASSERT_EQ(entries.count(), 2);
+    EXPECT_EQ(entries[0].offset, 0);
+    EXPECT_EQ(entries[1].offset, 0x100000);
+}
+
+TEST(PedigreeFileAccessTrace, SerialiseSortsAndMerges)
+{
+    FileAccessTrace trace;
+    trace.start();
+    trace.record(String("root»/b"), 0x3000, 0x1000);
+    trace.record(String("root»/a"), 0, 1);
+    trace.record(String("root»/b"), 0, 0x2000);
+    trace.record(String("root»/b"), 0x8000, 0x1000);
+    // Overlaps the first /b read, but not the one just before it.
+    trace.record(String("root»/b"), 0x1000, 0x2800);
+    trace.stop();
+
+    EntryList entries;
+    roundTrip(trace, entries);
+    ASSERT_EQ(entries.count(), 3);
+    EXPECT_STREQ(entries[0].path.cstr(), "root»/a");
+    EXPECT_STREQ(entries[1].path.cstr(), "root»/b");
+    EXPECT_EQ(entries[1].offset, 0);
+    EXPECT_EQ(entries[1].length, 0x4000);
+    EXPECT_STREQ(entries[2].path.cstr(), "root»/b");
+    EXPECT_EQ(entries[2].offset, 0x8000);
+    EXPECT_EQ(entries[2].length, 0x1000);
+}
+
+TEST(PedigreeFileAccessTrace, StartDiscardsPreviousTrace)
+{
+    FileAccessTrace trace;
+    trace.start();
+    trace.record(String("root»/a"), 0, 1);
+    trace.stop();
+    trace.start();
+    trace.record(String("root»/b"), 0, 1);
+    trace.stop();
+
+    EntryList entries;
+    roundTrip(trace, entries);
+    ASSERT_EQ(entries.count(), 1);
+    EXPECT_STREQ(entries[0].path.cstr(), "root»/b");
+}
+
+TEST(PedigreeFileAccessTrace, ParseKeepsSpacesInPaths)
+{
+    const char *text = "0 4096 root»/a file\n";
+
+    EntryList entries;
+    FileAccessTrace::parse(text, strlen(text), entries);
+    ASSERT_EQ(entries.count(), 1);
+    EXPECT_STREQ(entries[0].path.cstr(), "root»/a file");
+}
+
+TEST(PedigreeFileAccessTrace, ParseSkipsBadLines)
+{
+    const char *text =
+        "# comment\n"
+        "\n"
+        "garbage\n"
+        "12\n"
+        "12 34\n"
+        "12 0 root»/zero-length\n"
+        "x 34 root»/bad-offset\n"
+        "4096 8192 root»/good\n"
+        "0 4096 root»/unterminated";
+
+    EntryList entries;
+    FileAccessTrace::parse(text, strlen(text), entries);
+    ASSERT_EQ(entries.count(), 2);
+    EXPECT_STREQ(entries[0].path.cstr(), "root»/good");
+    EXPECT_EQ(entries[0].offset, 4096);
+    EXPECT_EQ(entries[0].length, 8192);
+    EXPECT_STREQ(entries[1].path.cstr(), "root»/unterminated");
+}
+
+TEST(PedigreeFileAccessTrace, SortAndMergeManyEntries)
+{
+    EntryList entries;
+    for (size_t i = 0; i < 100; ++i)
+    {
+        // Interleave two files, each in reverse order.
+        FileAccessTrace::Entry entry;
+        entry.path.assign((i & 1) ? "root»/odd" : "root»/even");
+        entry.offset = (100 - i) * 0x1000;
+        entry.length = 0x2000;
+        entries.pushBack(entry);
+    }
+
+    FileAccessTrace::sortAndMerge(entries);
+
+    // Each file's extents start two pages apart and are two pages long, so
+    // they all merge.
+    ASSERT_EQ(entries.count(), 2);
+    EXPECT_STREQ(entries[0].path.cstr(), "root»/even");
+    EXPECT_EQ(entries[0].offset, 2 * 0x1000);
+    EXPECT_EQ(entries[0].length, 100 * 0x1000);
+    EXPECT_STREQ(entries[1].path.cstr(), "root»/odd");
+    EXPECT_EQ(entries[1].offset, 1 * 0x1000);
+    EXPECT_EQ(entries[1].length, 100 * 0x1000);
+}
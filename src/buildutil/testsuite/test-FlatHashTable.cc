@@ -0,0 +1,385 @@
+/*
+ * Copyright (c) 2008-2014, Pedigree Developers
+ *
+ * Please see the CONTRIB file in the root of the source tree for a full
+ * list of contributors.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+#define PEDIGREE_EXTERNAL_SOURCE 1
+
+#include <list>
+#include <random>
+#include <unordered_map>
+
+#include <gtest/gtest.h>
+
+#include "pedigree/kernel/utilities/FlatHashTable.h"
+#include "pedigree/kernel/utilities/String.h"
+#include "pedigree/kernel/utilities/StringView.h"
+
+template <int hashModulo = 0>
+class FlatHashableInteger
+{
+  public:
+    FlatHashableInteger() : x_(-1)
+    {
+    }
+
+    FlatHashableInteger(int x) : x_(x)
+    {
+    }
+
+    size_t hash() const
+    {
+        return hashModulo ? (x_ % hashModulo) : x_;
+    }
+
+    bool operator==(const FlatHashableInteger &other) const
+    {
+        return x_ == other.x_;
+    }
+
+    bool operator!=(const FlatHashableInteger &other) const
+    {
+        return x_ != other.x_;
+    }
+
+  private:
+    int x_;
+};
+
+typedef FlatHashableInteger<> Integer;
+typedef FlatHashableInteger<1> CollidingInteger;
+typedef FlatHashableInteger<10> ModuloTenInteger;
+
+TEST(PedigreeFlatHashTable, NoOpRemoval)
+{
+    FlatHashTable<Integer, int> hashtable(-1);
+
+    Integer key(0);
+    EXPECT_EQ(hashtable.lookup(key).error(), HashTableError::HashTableEmpty);
+    hashtable.remove(key);
+    EXPECT_EQ(hashtable.lookup(key).error(), HashTableError::HashTableEmpty);
+    EXPECT_EQ(hashtable.begin(), hashtable.end());
+}
+
+TEST(PedigreeFlatHashTable, RemoveInserted)
+{
+    FlatHashTable<Integer, int> hashtable;
+
+    Integer key(3);
+    EXPECT_TRUE(hashtable.insert(key, 5));
+    EXPECT_EQ(hashtable.lookup(key).value(), 5);
+
+    hashtable.remove(key);
+
+    EXPECT_EQ(hashtable.lookup(key).error(), HashTableError::HashTableEmpty);
+    EXPECT_FALSE(hashtable.contains(key));
+}
+
+TEST(PedigreeFlatHashTable, InsertedAlready)
+{
+    FlatHashTable<Integer, int> hashtable;
+
+    Integer key(0);
+    EXPECT_TRUE(hashtable.insert(key, 5));
+    EXPECT_FALSE(hashtable.insert(key, 6));
+    EXPECT_EQ(hashtable.lookup(key).value(), 5);
+    EXPECT_EQ(hashtable.count(), 1);
+}
+
+TEST(PedigreeFlatHashTable, Update)
+{
+    FlatHashTable<Integer, int> hashtable;
+
+    Integer key(0);
+    EXPECT_FALSE(hashtable.update(key, 6));
+    hashtable.insert(key, 5);
+    EXPECT_TRUE(hashtable.update(key, 6));
+    EXPECT_EQ(hashtable.lookup(key).value(), 6);
+}
+
+TEST(PedigreeFlatHashTable, CollidingHashes)
+{
+    FlatHashTable<CollidingInteger, int> hashtable;
+
+    // Every key shares a hash, so every probe walks the whole sequence.
+    for (int i = 0; i < 100; ++i)
+    {
+        EXPECT_TRUE(hashtable.insert(CollidingInteger(i), i + 1));
+    }
+
+    for (int i = 0; i < 100; ++i)
+    {
+        EXPECT_EQ(hashtable.lookup(CollidingInteger(i)).value(), i + 1);
+    }
+    EXPECT_EQ(
+        hashtable.lookup(CollidingInteger(100)).error(),
+        HashTableError::NotFound);
+}
+
+TEST(PedigreeFlatHashTable, RemoveChained)
+{
+    FlatHashTable<ModuloTenInteger, int> hashtable;
+
+    for (int i = 0; i < 50; ++i)
+    {
+        hashtable.insert(ModuloTenInteger(i), i);
+    }
+
+    for (int i = 0; i < 50; i += 3)
+    {
+        hashtable.remove(ModuloTenInteger(i));
+    }
+
+    for (int i = 0; i < 50; ++i)
+    {
+        auto result = hashtable.lookup(ModuloTenInteger(i));
+        if (i % 3)
+        {
+            EXPECT_EQ(result.value(), i);
+        }
+        else
+        {
+            EXPECT_EQ(result.error(), HashTableError::NotFound);
+        }
+    }
+}
+
+TEST(PedigreeFlatHashTable, ForwardIteration)
+{
+    FlatHashTable<Integer, int> hashtable(1234);
+
+    for (int i = 0; i < 100; ++i)
+    {
+        EXPECT_TRUE(hashtable.insert(Integer(i), i + 1));
+    }
+
+    std::list<int> results;
+    for (auto it : hashtable)
+    {
+        results.push_back(it);
+    }
+    results.sort();
+
+    std::list<int> expected;
+    for (int i = 0; i < 100; ++i)
+    {
+        expected.push_back(i + 1);
+    }
+
+    EXPECT_EQ(results, expected);
+}
+
+TEST(PedigreeFlatHashTable, IterateErase)
+{
+    FlatHashTable<Integer, int> hashtable(1234);
+
+    for (int i = 0; i < 64; ++i)
+    {
+        EXPECT_TRUE(hashtable.insert(Integer(i), i + 1));
+    }
+
+    // erase() returns the next entry, without restarting the iteration.
+    size_t visited = 0;
+    for (auto it = hashtable.begin(); it != hashtable.end(); ++visited)
+    {
+        if (((*it) % 2) == 0)
+        {
+            it = hashtable.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+    EXPECT_EQ(visited, 64);
+
+    std::list<int> results;
+    for (auto it = hashtable.begin(); it != hashtable.end(); ++it)
+    {
+        results.push_back(*it);
+        EXPECT_EQ(it.key(), Integer(*it - 1));
+    }
+    results.sort();
+
+    std::list<int> expected;
+    for (int i = 0; i < 64; i += 2)
+    {
+        expected.push_back(i + 1);
+    }
+
+    EXPECT_EQ(results, expected);
+}
+
+TEST(PedigreeFlatHashTable, GetNth)
+{
+    FlatHashTable<CollidingInteger, int> hashtable(1234);
+
+    for (int i = 0; i < 20; ++i)
+    {
+        EXPECT_TRUE(hashtable.insert(CollidingInteger(i), i));
+    }
+
+    EXPECT_EQ(hashtable.getNth(20).error(), HashTableError::IterationComplete);
+
+    std::list<int> results;
+    for (size_t i = 0; i < 20; ++i)
+    {
+        auto result = hashtable.getNth(i);
+        EXPECT_TRUE(result.hasValue());
+        results.push_back(result.value().second());
+    }
+    results.sort();
+
+    std::list<int> expected;
+    for (int i = 0; i < 20; ++i)
+    {
+        expected.push_back(i);
+    }
+
+    EXPECT_EQ(results, expected);
+}
+
+TEST(PedigreeFlatHashTable, CopyAndMove)
+{
+    FlatHashTable<CollidingInteger, int> hashtable(1234);
+
+    for (int i = 0; i < 8; ++i)
+    {
+        EXPECT_TRUE(hashtable.insert(CollidingInteger(i), i + 1));
+    }
+
+    FlatHashTable<CollidingInteger, int> copied;
+    copied.copyFrom(hashtable);
+
+    FlatHashTable<CollidingInteger, int> moved;
+    moved = pedigree_std::move(hashtable);
+    EXPECT_EQ(hashtable.count(), 0);
+
+    for (int i = 0; i < 8; ++i)
+    {
+        EXPECT_EQ(copied.lookup(CollidingInteger(i)).value(), i + 1);
+        EXPECT_EQ(moved.lookup(CollidingInteger(i)).value(), i + 1);
+    }
+}
+
+TEST(PedigreeFlatHashTable, SiblingKeys)
+{
+    String key("key");
+    HashedStringView keyView(key.view());
+
+    FlatHashTable<String, int, HashedStringView> hashtable(1234);
+
+    hashtable.insert(key, 1234);
+
+    auto resultA = hashtable.lookup(key);
+    EXPECT_TRUE(resultA.hasValue());
+    EXPECT_EQ(resultA.value(), 1234);
+
+    auto resultB = hashtable.lookup(keyView);
+    EXPECT_TRUE(resultB.hasValue());
+    EXPECT_EQ(resultB.value(), 1234);
+}
+
+TEST(PedigreeFlatHashTable, ReserveAvoidsGrowth)
+{
+    FlatHashTable<Integer, int> hashtable;
+    hashtable.reserve(1000);
+    size_t usage = hashtable.memoryUsage();
+    EXPECT_NE(usage, 0);
+
+    for (int i = 0; i < 1000; ++i)
+    {
+        hashtable.insert(Integer(i), i);
+    }
+    EXPECT_EQ(hashtable.memoryUsage(), usage);
+}
+
+TEST(PedigreeFlatHashTable, TombstonesReused)
+{
+    // Constant churn at a fixed size must not grow the table forever.
+    FlatHashTable<Integer, int> hashtable;
+    for (int i = 0; i < 100; ++i)
+    {
+        hashtable.insert(Integer(i), i);
+    }
+
+    // Tombstones may push a nearly-full table up a size once, but after that
+    // in-place rehashes reclaim them.
+    int i = 100;
+    for (; i < 1000; ++i)
+    {
+        hashtable.remove(Integer(i - 100));
+        hashtable.insert(Integer(i), i);
+    }
+    size_t usage = hashtable.memoryUsage();
+
+    for (; i < 100000; ++i)
+    {
+        hashtable.remove(Integer(i - 100));
+        hashtable.insert(Integer(i), i);
+    }
+
+    EXPECT_EQ(hashtable.count(), 100);
+    EXPECT_EQ(hashtable.memoryUsage(), usage);
+    for (int i = 99900; i < 100000; ++i)
+    {
+        EXPECT_EQ(hashtable.lookup(Integer(i)).value(), i);
+    }
+}
+
+TEST(PedigreeFlatHashTable, MatchesStdUnorderedMap)
+{
+    FlatHashTable<ModuloTenInteger, int> hashtable(-1);
+    std::unordered_map<int, int> reference;
+    std::mt19937 rng(1234);
+
+    for (int i = 0; i < 20000; ++i)
+    {
+        int key = rng() % 512;
+        switch (rng() % 3)
+        {
+            case 0:
+                EXPECT_EQ(
+                    hashtable.insert(ModuloTenInteger(key), i),
+                    reference.emplace(key, i).second);
+                break;
+            case 1:
+                hashtable.remove(ModuloTenInteger(key));
+                reference.erase(key);
+                break;
+            default:
+            {
+                auto result = hashtable.lookup(ModuloTenInteger(key));
+                auto it = reference.find(key);
+                ASSERT_EQ(result.hasValue(), it != reference.end()) << key;
+                if (result.hasValue())
+                {
+                    EXPECT_EQ(result.value(), it->second);
+                }
+            }
+        }
+        ASSERT_EQ(hashtable.count(), reference.size());
+    }
+
+    size_t iterated = 0;
+    for (auto it = hashtable.begin(); it != hashtable.end(); ++it)
+    {
+        ++iterated;
+    }
+    EXPECT_EQ(iterated, reference.size());
+}
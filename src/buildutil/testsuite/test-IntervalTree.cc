@@ -0,0 +1,202 @@
+/*
+ * Copyright (c) 2008-2014, Pedigree Developers
+ *
+ * Please see the CONTRIB file in the root of the source tree for a full
+ * list of contributors.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+#define PEDIGREE_EXTERNAL_SOURCE 1
+
+#include <gtest/gtest.h>
+
+#include <cstdlib>
+#include <vector>
+
+#include "pedigree/kernel/utilities/IntervalTree.h"
+
+TEST(PedigreeIntervalTree, Empty)
+{
+    IntervalTree<int> tree;
+    int value = 0;
+
+    EXPECT_EQ(tree.count(), 0U);
+    EXPECT_FALSE(tree.lookup(0, value));
+    EXPECT_FALSE(tree.remove(0, 1));
+}
+
+TEST(PedigreeIntervalTree, HalfOpen)
+{
+    IntervalTree<int> tree;
+    tree.insert(0x1000, 0x2000, 1);
+
+    int value = 0;
+    EXPECT_FALSE(tree.lookup(0xFFF, value));
+    EXPECT_TRUE(tree.lookup(0x1000, value));
+    EXPECT_EQ(value, 1);
+    EXPECT_TRUE(tree.lookup(0x1FFF, value));
+    EXPECT_FALSE(tree.lookup(0x2000, value));
+}
+
+TEST(PedigreeIntervalTree, ManyAdjacent)
+{
+    IntervalTree<int> tree;
+    for (int i = 0; i < 1000; ++i)
+    {
+        tree.insert(i * 0x1000, (i + 1) * 0x1000, i);
+    }
+
+    EXPECT_EQ(tree.count(), 1000U);
+    for (int i = 0; i < 1000; ++i)
+    {
+        int value = -1;
+        ASSERT_TRUE(tree.lookup(i * 0x1000 + 0x800, value));
+        EXPECT_EQ(value, i);
+    }
+}
+
+TEST(PedigreeIntervalTree, LongIntervalOnTheLeft)
+{
+    IntervalTree<int> tree;
+
+    // A big interval early on covers addresses well past later starts.
+    tree.insert(0, 0x100000, 1);
+    for (int i = 1; i < 64; ++i)
+    {
+        tree.insert(0x200000 + i * 0x1000, 0x200000 + i * 0x1000 + 0x100, 2);
+    }
+
+    int value = 0;
+    EXPECT_TRUE(tree.lookup(0xFFFFF, value));
+    EXPECT_EQ(value, 1);
+    EXPECT_FALSE(tree.lookup(0x100000, value));
+}
+
+TEST(PedigreeIntervalTree, SameStart)
+{
+    IntervalTree<int> tree;
+    for (int i = 0; i < 16; ++i)
+    {
+        tree.insert(0x1000, 0x2000, i);
+    }
+
+    for (int i = 15; i >= 0; --i)
+    {
+        EXPECT_TRUE(tree.remove(0x1000, i));
+        EXPECT_FALSE(tree.remove(0x1000, i));
+    }
+    EXPECT_EQ(tree.count(), 0U);
+}
+
+TEST(PedigreeIntervalTree, Overlapping)
+{
+    IntervalTree<int> tree;
+    tree.insert(0x3000, 0x4000, 3);
+    tree.insert(0x1000, 0x2000, 1);
+    tree.insert(0x2000, 0x3000, 2);
+    tree.insert(0x5000, 0x6000, 5);
+
+    Vector<int> results;
+    tree.overlapping(0x1800, 0x3001, results);
+
+    ASSERT_EQ(results.count(), 3U);
+    EXPECT_EQ(results[0], 1);
+    EXPECT_EQ(results[1], 2);
+    EXPECT_EQ(results[2], 3);
+
+    results.clear();
+    tree.overlapping(0x4000, 0x5000, results);
+    EXPECT_EQ(results.count(), 0U);
+
+    results.clear();
+    tree.values(results);
+    EXPECT_EQ(results.count(), 4U);
+}
+
+TEST(PedigreeIntervalTree, RandomisedAgainstList)
+{
+    struct Interval
+    {
+        uintptr_t start;
+        uintptr_t end;
+        int value;
+    };
+
+    IntervalTree<int> tree;
+    std::vector<Interval> reference;
+
+    srand(1234);
+    for (int i = 0; i < 5000; ++i)
+    {
+        if (reference.empty() || (rand() % 3))
+        {
+            uintptr_t start = (rand() % 4096) * 0x1000;
+            uintptr_t end = start + ((rand() % 16) + 1) * 0x1000;
+            tree.insert(start, end, i);
+            reference.push_back({start, end, i});
+        }
+        else
+        {
+            size_t n = rand() % reference.size();
+            ASSERT_TRUE(tree.remove(reference[n].start, reference[n].value));
+            reference.erase(reference.begin() + n);
+        }
+
+        uintptr_t address = (rand() % (4096 * 0x1000));
+        bool expected = false;
+        for (auto &it : reference)
+        {
+            if ((it.start <= address) && (address < it.end))
+            {
+                expected = true;
+                break;
+            }
+        }
+
+        int value = -1;
+        bool found = tree.lookup(address, value);
+        ASSERT_EQ(found, expected);
+        if (found)
+        {
+            // Whatever was found really does contain the address.
+            bool matched = false;
+            for (auto &it : reference)
+            {
+                if ((it.value == value) && (it.start <= address) &&
+                    (address < it.end))
+                {
+                    matched = true;
+                }
+            }
+            EXPECT_TRUE(matched);
+        }
+
+        uintptr_t rangeEnd = address + (rand() % 0x10000) + 1;
+        size_t expectedOverlaps = 0;
+        for (auto &it : reference)
+        {
+            if ((it.start < rangeEnd) && (address < it.end))
+            {
+                ++expectedOverlaps;
+            }
+        }
+
+        Vector<int> overlaps;
+        tree.overlapping(address, rangeEnd, overlaps);
+        ASSERT_EQ(overlaps.count(), expectedOverlaps);
+    }
+
+    EXPECT_EQ(tree.count(), reference.size());
+}
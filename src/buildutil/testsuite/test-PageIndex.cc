@@ -0,0 +1,271 @@
+/*
+ * Copyright (c) 2008-2014, Pedigree Developers
+ *
+ * Please see the CONTRIB file in the root of the source tree for a full
+ * list of contributors.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+#define PEDIGREE_EXTERNAL_SOURCE 1
+
+#include <gtest/gtest.h>
+
+#include <cstdlib>
+#include <map>
+
+#include "pedigree/kernel/utilities/PageIndex.h"
+
+TEST(PedigreePageIndex, Empty)
+{
+    PageIndex index;
+
+    EXPECT_EQ(index.count(), 0U);
+    EXPECT_EQ(index.lookup(0), 0U);
+    EXPECT_EQ(index.remove(0), 0U);
+    EXPECT_FALSE(index.setTag(0, PageIndex::Dirty));
+    EXPECT_FALSE(index.anyTagged(PageIndex::Dirty));
+    EXPECT_EQ(index.gangLookup(0, ~0UL, 16, nullptr, nullptr), 0U);
+}
+
+TEST(PedigreePageIndex, InsertLookup)
+{
+    PageIndex index;
+    index.insert(0, 0x1000);
+    index.insert(63, 0x2000);
+    index.insert(64, 0x3000);
+
+    EXPECT_EQ(index.count(), 3U);
+    EXPECT_EQ(index.lookup(0), 0x1000U);
+    EXPECT_EQ(index.lookup(63), 0x2000U);
+    EXPECT_EQ(index.lookup(64), 0x3000U);
+    EXPECT_EQ(index.lookup(1), 0U);
+    EXPECT_EQ(index.lookup(65), 0U);
+    EXPECT_EQ(index.lookup(4096), 0U);
+}
+
+TEST(PedigreePageIndex, Update)
+{
+    PageIndex index;
+    index.insert(5, 0x1000);
+    index.insert(5, 0x2000);
+
+    EXPECT_EQ(index.count(), 1U);
+    EXPECT_EQ(index.lookup(5), 0x2000U);
+}
+
+TEST(PedigreePageIndex, GrowKeepsEntries)
+{
+    PageIndex index;
+    index.insert(1, 0x1000);
+    index.setTag(1, PageIndex::Dirty);
+
+    // Forces several new levels above the original root.
+    index.insert(1UL << 40, 0x2000);
+
+    EXPECT_EQ(index.lookup(1), 0x1000U);
+    EXPECT_EQ(index.lookup(1UL << 40), 0x2000U);
+    EXPECT_TRUE(index.isTagged(1, PageIndex::Dirty));
+    EXPECT_FALSE(index.isTagged(1UL << 40, PageIndex::Dirty));
+}
+
+TEST(PedigreePageIndex, LargestIndex)
+{
+    PageIndex index;
+    index.insert(~0UL, 0x1000);
+    index.insert(0, 0x2000);
+
+    EXPECT_EQ(index.lookup(~0UL), 0x1000U);
+
+    size_t indices[4];
+    EXPECT_EQ(index.gangLookup(1, ~0UL, 4, indices, nullptr), 1U);
+    EXPECT_EQ(indices[0], ~0UL);
+
+    EXPECT_EQ(index.remove(~0UL), 0x1000U);
+    EXPECT_EQ(index.count(), 1U);
+}
+
+TEST(PedigreePageIndex, Remove)
+{
+    PageIndex index;
+    for (size_t i = 0; i < 1000; ++i)
+    {
+        index.insert(i * 7, i + 1);
+    }
+
+    for (size_t i = 0; i < 1000; i += 2)
+    {
+        EXPECT_EQ(index.remove(i * 7), i + 1);
+    }
+
+    EXPECT_EQ(index.count(), 500U);
+    for (size_t i = 0; i < 1000; ++i)
+    {
+        EXPECT_EQ(index.lookup(i * 7), (i % 2) ? i + 1 : 0);
+    }
+
+    for (size_t i = 1; i < 1000; i += 2)
+    {
+        index.remove(i * 7);
+    }
+
+    EXPECT_EQ(index.count(), 0U);
+    EXPECT_EQ(index.gangLookup(0, ~0UL, 16, nullptr, nullptr), 0U);
+}
+
+TEST(PedigreePageIndex, RemoveClearsTags)
+{
+    PageIndex index;
+    index.insert(10, 0x1000);
+    index.setTag(10, PageIndex::Pinned);
+    index.remove(10);
+    index.insert(10, 0x2000);
+
+    EXPECT_FALSE(index.isTagged(10, PageIndex::Pinned));
+    EXPECT_FALSE(index.anyTagged(PageIndex::Pinned));
+}
+
+TEST(PedigreePageIndex, Tags)
+{
+    PageIndex index;
+    index.insert(100, 0x1000);
+    index.insert(200, 0x2000);
+
+    EXPECT_TRUE(index.setTag(100, PageIndex::Dirty));
+    EXPECT_TRUE(index.setTag(200, PageIndex::Dirty));
+    EXPECT_TRUE(index.setTag(200, PageIndex::Writeback));
+
+    EXPECT_TRUE(index.isTagged(100, PageIndex::Dirty));
+    EXPECT_FALSE(index.isTagged(100, PageIndex::Writeback));
+    EXPECT_TRUE(index.anyTagged(PageIndex::Writeback));
+    EXPECT_FALSE(index.anyTagged(PageIndex::Pinned));
+
+    index.clearTag(100, PageIndex::Dirty);
+    EXPECT_FALSE(index.isTagged(100, PageIndex::Dirty));
+    EXPECT_TRUE(index.anyTagged(PageIndex::Dirty));
+
+    index.clearTag(200, PageIndex::Dirty);
+    EXPECT_FALSE(index.anyTagged(PageIndex::Dirty));
+    EXPECT_TRUE(index.isTagged(200, PageIndex::Writeback));
+}
+
+TEST(PedigreePageIndex, GangLookupRange)
+{
+    PageIndex index;
+    for (size_t i = 0; i < 100; ++i)
+    {
+        index.insert(i * 1000, i + 1);
+    }
+
+    size_t indices[8];
+    uintptr_t values[8];
+    size_t n = index.gangLookup(1500, 5500, 8, indices, values);
+    ASSERT_EQ(n, 4U);
+    for (size_t i = 0; i < n; ++i)
+    {
+        EXPECT_EQ(indices[i], (i + 2) * 1000);
+        EXPECT_EQ(values[i], i + 3);
+    }
+
+    // Limited by max, then resumed.
+    n = index.gangLookup(0, ~0UL, 8, indices, values);
+    ASSERT_EQ(n, 8U);
+    EXPECT_EQ(indices[7], 7000U);
+    n = index.gangLookup(indices[7] + 1, ~0UL, 8, indices, values);
+    ASSERT_EQ(n, 8U);
+    EXPECT_EQ(indices[0], 8000U);
+}
+
+TEST(PedigreePageIndex, GangLookupTagged)
+{
+    PageIndex index;
+    for (size_t i = 0; i < 10000; ++i)
+    {
+        index.insert(i, i + 1);
+        if ((i % 1000) == 999)
+        {
+            index.setTag(i, PageIndex::Dirty);
+        }
+    }
+
+    size_t indices[16];
+    uintptr_t values[16];
+    size_t n = index.gangLookupTagged(
+        0, ~0UL, PageIndex::Dirty, 16, indices, values);
+    ASSERT_EQ(n, 10U);
+    for (size_t i = 0; i < n; ++i)
+    {
+        EXPECT_EQ(indices[i], (i * 1000) + 999);
+        EXPECT_EQ(values[i], (i * 1000) + 1000);
+    }
+
+    n = index.gangLookupTagged(
+        2000, 4998, PageIndex::Dirty, 16, indices, nullptr);
+    ASSERT_EQ(n, 2U);
+    EXPECT_EQ(indices[0], 2999U);
+    EXPECT_EQ(indices[1], 3999U);
+}
+
+TEST(PedigreePageIndex, MatchesMap)
+{
+    PageIndex index;
+    std::map<size_t, uintptr_t> reference;
+
+    srand(1);
+    for (size_t i = 0; i < 20000; ++i)
+    {
+        size_t key = rand() % 100000;
+        if (rand() % 4)
+        {
+            index.insert(key, i + 1);
+            reference[key] = i + 1;
+        }
+        else
+        {
+            uintptr_t expected = 0;
+            auto it = reference.find(key);
+            if (it != reference.end())
+            {
+                expected = it->second;
+                reference.erase(it);
+            }
+            EXPECT_EQ(index.remove(key), expected);
+        }
+    }
+
+    EXPECT_EQ(index.count(), reference.size());
+
+    // Walk everything with gang lookups and compare against the map.
+    size_t indices[32];
+    uintptr_t values[32];
+    size_t next = 0;
+    auto it = reference.begin();
+    while (true)
+    {
+        size_t n = index.gangLookup(next, ~0UL, 32, indices, values);
+        for (size_t i = 0; i < n; ++i, ++it)
+        {
+            ASSERT_NE(it, reference.end());
+            EXPECT_EQ(indices[i], it->first);
+            EXPECT_EQ(values[i], it->second);
+        }
+
+        if (n < 32)
+        {
+            break;
+        }
+        next = indices[n - 1] + 1;
+    }
+    EXPECT_EQ(it, reference.end());
+}
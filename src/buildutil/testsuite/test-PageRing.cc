@@ -0,0 +1,219 @@
+/*
+ * Copyright (c) 2008-2014, Pedigree Developers
+ *
+ * Please see the CONTRIB file in the root of the source tree for a full
+ * list of contributors.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#define PEDIGREE_EXTERNAL_SOURCE 1
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <thread>
+
+#include "pedigree/kernel/utilities/PageRing.h"
+
+TEST(PedigreePageRing, InitialSettings)
+{
+    PageRing ring(4);
+
+    EXPECT_EQ(ring.getDataSize(), 0U);
+    EXPECT_EQ(ring.getSize(), 4 * PageRing::PageSize);
+}
+
+TEST(PedigreePageRing, ReadEmpty)
+{
+    PageRing ring;
+
+    char buf[16];
+    EXPECT_EQ(ring.read(buf, 16, false), 0U);
+}
+
+TEST(PedigreePageRing, SmallWritesMerge)
+{
+    PageRing ring(1);
+
+    char buf[16];
+    memset(buf, 0xAB, 16);
+
+    // All of these fit in the single slot's page.
+    for (size_t i = 0; i < PageRing::PageSize / 16; ++i)
+    {
+        ASSERT_EQ(ring.write(buf, 16, false), 16U);
+    }
+
+    EXPECT_EQ(ring.write(buf, 16, false), 0U);
+    EXPECT_EQ(ring.getDataSize(), PageRing::PageSize);
+}
+
+TEST(PedigreePageRing, FillAndRead)
+{
+    PageRing ring(8);
+
+    const size_t size = 8 * PageRing::PageSize;
+    std::unique_ptr<uint8_t[]> in(new uint8_t[size]);
+    std::unique_ptr<uint8_t[]> out(new uint8_t[size]);
+    for (size_t i = 0; i < size; ++i)
+    {
+        in[i] = i % 251;
+    }
+
+    EXPECT_EQ(ring.write(in.get(), size, false), size);
+    EXPECT_EQ(ring.write(in.get(), 1, false), 0U);
+    EXPECT_EQ(ring.read(out.get(), size, false), size);
+    EXPECT_EQ(memcmp(in.get(), out.get(), size), 0);
+}
+
+TEST(PedigreePageRing, SpliceMovesPages)
+{
+    PageRing source(4), dest(4);
+
+    char buf[6000], out[6000];
+    for (size_t i = 0; i < sizeof buf; ++i)
+    {
+        buf[i] = i % 127;
+    }
+
+    ASSERT_EQ(source.write(buf, sizeof buf, false), sizeof buf);
+
+    // Splitting a page shares it between the two rings.
+    EXPECT_EQ(source.splice(dest, 5000, false), 5000U);
+    EXPECT_EQ(source.getDataSize(), 1000U);
+    EXPECT_EQ(dest.getDataSize(), 5000U);
+
+    EXPECT_EQ(source.splice(dest, 5000, false), 1000U);
+    EXPECT_EQ(source.getDataSize(), 0U);
+
+    EXPECT_EQ(dest.read(out, sizeof out, false), sizeof out);
+    EXPECT_EQ(memcmp(buf, out, sizeof buf), 0);
+}
+
+TEST(PedigreePageRing, SharedPageIsNotMerged)
+{
+    PageRing source(4), dest(4);
+
+    char a[16], b[16], out[32];
+    memset(a, 'a', 16);
+    memset(b, 'b', 16);
+
+    ASSERT_EQ(source.write(a, 16, false), 16U);
+    ASSERT_EQ(source.splice(dest, 8, false), 8U);
+
+    // The source still holds the second half of the page dest now refers to.
+    ASSERT_EQ(dest.write(b, 16, false), 16U);
+
+    EXPECT_EQ(source.read(out, 32, false), 8U);
+    EXPECT_EQ(memcmp(out, a, 8), 0);
+    EXPECT_EQ(dest.read(out, 32, false), 24U);
+    EXPECT_EQ(memcmp(out, a, 8), 0);
+    EXPECT_EQ(memcmp(out + 8, b, 16), 0);
+}
+
+TEST(PedigreePageRing, TeeLeavesSource)
+{
+    PageRing source(4), dest(4);
+
+    char buf[100], out[100];
+    memset(buf, 0x5A, sizeof buf);
+
+    ASSERT_EQ(source.write(buf, sizeof buf, false), sizeof buf);
+    EXPECT_EQ(source.tee(dest, sizeof buf, false), sizeof buf);
+    EXPECT_EQ(source.getDataSize(), sizeof buf);
+
+    EXPECT_EQ(dest.read(out, sizeof out, false), sizeof out);
+    EXPECT_EQ(memcmp(buf, out, sizeof buf), 0);
+    EXPECT_EQ(source.read(out, sizeof out, false), sizeof out);
+    EXPECT_EQ(memcmp(buf, out, sizeof buf), 0);
+}
+
+TEST(PedigreePageRing, SpliceToFullRing)
+{
+    PageRing source(4), dest(1);
+
+    char buf[PageRing::PageSize];
+    memset(buf, 0, sizeof buf);
+
+    ASSERT_EQ(dest.write(buf, sizeof buf, false), sizeof buf);
+    ASSERT_EQ(source.write(buf, sizeof buf, false), sizeof buf);
+    EXPECT_EQ(source.splice(dest, sizeof buf, false), 0U);
+    EXPECT_EQ(source.getDataSize(), sizeof buf);
+}
+
+TEST(PedigreePageRing, ShortDrain)
+{
+    PageRing ring;
+
+    char buf[64];
+    memset(buf, 0, sizeof buf);
+    ASSERT_EQ(ring.write(buf, sizeof buf, false), sizeof buf);
+
+    // A callback that only takes part of what it was offered ends the drain.
+    auto half = [](void *, uint8_t *, size_t length) -> size_t {
+        return length / 2;
+    };
+    EXPECT_EQ(ring.drain(sizeof buf, half, nullptr, false), 32U);
+    EXPECT_EQ(ring.getDataSize(), 32U);
+}
+
+TEST(PedigreePageRing, DisabledReadsEndBlockingWrite)
+{
+    PageRing ring(1);
+
+    char buf[PageRing::PageSize * 2];
+    memset(buf, 0, sizeof buf);
+
+    std::thread reader([&ring]() { ring.disableReads(); });
+    reader.join();
+
+    // Would block forever waiting for space if nothing could read.
+    EXPECT_EQ(ring.write(buf, sizeof buf, true), PageRing::PageSize);
+}
+
+TEST(PedigreePageRing, Pipeline)
+{
+    PageRing ring(4);
+
+    const size_t size = 1 << 20;
+    std::unique_ptr<uint8_t[]> in(new uint8_t[size]);
+    std::unique_ptr<uint8_t[]> out(new uint8_t[size]);
+    for (size_t i = 0; i < size; ++i)
+    {
+        in[i] = i % 253;
+    }
+
+    std::thread writer([&]() {
+        EXPECT_EQ(ring.write(in.get(), size, true), size);
+        ring.disableWrites();
+    });
+
+    size_t offset = 0;
+    while (offset < size)
+    {
+        size_t n = ring.read(out.get() + offset, 3000, true);
+        if (!n)
+        {
+            break;
+        }
+        offset += n;
+    }
+
+    writer.join();
+
+    EXPECT_EQ(offset, size);
+    EXPECT_EQ(memcmp(in.get(), out.get(), size), 0);
+}
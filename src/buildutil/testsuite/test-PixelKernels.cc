@@ -0,0 +1,222 @@
+/*
+ * Copyright (c) 2008-2014, Pedigree Developers
+ *
+ * Please see the CONTRIB file in the root of the source tree for a full
+ * list of contributors.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#define PEDIGREE_EXTERNAL_SOURCE 1
+
+#include <gtest/gtest.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "pedigree/kernel/graphics/PixelKernels.h"
+
+using namespace Graphics;
+
+// Odd so that every kernel has to handle a scalar tail.
+static const size_t kPixels = 1031;
+
+static std::vector<uint8_t> randomBytes(size_t n)
+{
+    std::vector<uint8_t> result(n);
+    for (auto &b : result)
+    {
+        b = rand() & 0xFF;
+    }
+    return result;
+}
+
+class PedigreePixelKernels : public ::testing::TestWithParam<KernelVariant>
+{
+  protected:
+    void SetUp() override
+    {
+        // Variants the CPU can't run just compare the scalar kernels with
+        // themselves.
+        m_pKernels = pixelKernels(GetParam());
+        if (!m_pKernels)
+        {
+            m_pKernels = &m_Scalar;
+        }
+    }
+
+    const PixelKernels *m_pKernels;
+    const PixelKernels &m_Scalar = *pixelKernels(KernelScalar);
+};
+
+TEST(PedigreePixelKernelsScalar, Rgb565RoundTrip)
+{
+    const PixelKernels &k = *pixelKernels(KernelScalar);
+
+    uint32_t argb[3] = {0xFFFFFFFF, 0x00FF0000, 0x12345678};
+    uint16_t rgb565[3];
+    k.argb8888ToRgb565(rgb565, argb, 3);
+    EXPECT_EQ(rgb565[0], 0xFFFF);
+    EXPECT_EQ(rgb565[1], 0xF800);
+    EXPECT_EQ(rgb565[2], 0x32AF);
+
+    uint32_t back[3];
+    k.rgb565ToArgb8888(back, rgb565, 3);
+    EXPECT_EQ(back[0], 0xFFFFFFFFU);
+    EXPECT_EQ(back[1], 0xFFFF0000U);
+}
+
+TEST(PedigreePixelKernelsScalar, Rgb888Conversions)
+{
+    const PixelKernels &k = *pixelKernels(KernelScalar);
+
+    uint8_t rgb888[6] = {0x56, 0x34, 0x12, 0xCC, 0xBB, 0xAA};
+    uint32_t argb[2];
+    k.rgb888ToArgb8888(argb, rgb888, 2);
+    EXPECT_EQ(argb[0], 0xFF123456U);
+    EXPECT_EQ(argb[1], 0xFFAABBCCU);
+
+    uint8_t out[6];
+    k.argb8888ToRgb888(out, argb, 2);
+    EXPECT_EQ(memcmp(out, rgb888, 6), 0);
+}
+
+TEST(PedigreePixelKernelsScalar, BlendEndpoints)
+{
+    const PixelKernels &k = *pixelKernels(KernelScalar);
+
+    uint32_t dest[3] = {0xFF000000, 0xFF000000, 0xFF000000};
+    uint32_t src[3] = {0x00FFFFFF, 0xFFFFFFFF, 0x80FFFFFF};
+    k.blendArgb8888(dest, src, 3);
+    EXPECT_EQ(dest[0], 0xFF000000U);
+    EXPECT_EQ(dest[1], 0xFFFFFFFFU);
+    EXPECT_EQ(dest[2], 0xFF808080U);
+}
+
+TEST_P(PedigreePixelKernels, CopyMatchesScalar)
+{
+    std::vector<uint8_t> src = randomBytes(kPixels * 4);
+    std::vector<uint8_t> dest(src.size());
+
+    m_pKernels->copy(dest.data(), src.data(), src.size());
+    EXPECT_EQ(dest, src);
+}
+
+TEST_P(PedigreePixelKernels, FillMatchesScalar)
+{
+    std::vector<uint16_t> a16(kPixels), b16(kPixels);
+    std::vector<uint32_t> a32(kPixels), b32(kPixels);
+
+    m_pKernels->fill16(a16.data(), 0xBEEF, kPixels);
+    m_Scalar.fill16(b16.data(), 0xBEEF, kPixels);
+    m_pKernels->fill32(a32.data(), 0xDEADBEEF, kPixels);
+    m_Scalar.fill32(b32.data(), 0xDEADBEEF, kPixels);
+
+    EXPECT_EQ(a16, b16);
+    EXPECT_EQ(a32, b32);
+}
+
+TEST_P(PedigreePixelKernels, Rgb565MatchesScalar)
+{
+    std::vector<uint8_t> bytes = randomBytes(kPixels * 4);
+    const uint32_t *argb = reinterpret_cast<const uint32_t *>(bytes.data());
+    const uint16_t *rgb565 = reinterpret_cast<const uint16_t *>(bytes.data());
+
+    std::vector<uint16_t> a16(kPixels), b16(kPixels);
+    m_pKernels->argb8888ToRgb565(a16.data(), argb, kPixels);
+    m_Scalar.argb8888ToRgb565(b16.data(), argb, kPixels);
+    EXPECT_EQ(a16, b16);
+
+    std::vector<uint32_t> a32(kPixels), b32(kPixels);
+    m_pKernels->rgb565ToArgb8888(a32.data(), rgb565, kPixels);
+    m_Scalar.rgb565ToArgb8888(b32.data(), rgb565, kPixels);
+    EXPECT_EQ(a32, b32);
+}
+
+TEST_P(PedigreePixelKernels, Rgb888MatchesScalar)
+{
+    std::vector<uint8_t> bytes = randomBytes(kPixels * 4);
+    const uint32_t *argb = reinterpret_cast<const uint32_t *>(bytes.data());
+
+    std::vector<uint32_t> a32(kPixels), b32(kPixels);
+    m_pKernels->rgb888ToArgb8888(a32.data(), bytes.data(), kPixels);
+    m_Scalar.rgb888ToArgb8888(b32.data(), bytes.data(), kPixels);
+    EXPECT_EQ(a32, b32);
+
+    std::vector<uint8_t> a24(kPixels * 3), b24(kPixels * 3);
+    m_pKernels->argb8888ToRgb888(a24.data(), argb, kPixels);
+    m_Scalar.argb8888ToRgb888(b24.data(), argb, kPixels);
+    EXPECT_EQ(a24, b24);
+}
+
+TEST_P(PedigreePixelKernels, BlendMatchesScalar)
+{
+    std::vector<uint8_t> srcBytes = randomBytes(kPixels * 4);
+    std::vector<uint8_t> destBytes = randomBytes(kPixels * 4);
+    const uint32_t *src = reinterpret_cast<const uint32_t *>(srcBytes.data());
+    const uint32_t *dest =
+        reinterpret_cast<const uint32_t *>(destBytes.data());
+
+    std::vector<uint32_t> a(dest, dest + kPixels), b(dest, dest + kPixels);
+    m_pKernels->blendArgb8888(a.data(), src, kPixels);
+    m_Scalar.blendArgb8888(b.data(), src, kPixels);
+    EXPECT_EQ(a, b);
+}
+
+INSTANTIATE_TEST_CASE_P(
+    AllVariants, PedigreePixelKernels,
+    ::testing::Values(KernelScalar, KernelSse2, KernelAvx2));
+
+TEST(PedigreePixelKernelsRect, ConvertRectHonoursPitch)
+{
+    // 3x2 pixels of ARGB with a 4-pixel source pitch.
+    uint32_t src[8] = {0xFFFF0000, 0xFF00FF00, 0xFF0000FF, 0xDEADBEEF,
+                       0xFFFFFFFF, 0xFF000000, 0xFFFF0000, 0xDEADBEEF};
+    uint16_t dest[8];
+    memset(dest, 0xAB, sizeof(dest));
+
+    EXPECT_TRUE(convertRect(
+        dest, 8, Bits16_Rgb565, src, 16, Bits32_Argb, 3, 2));
+    EXPECT_EQ(dest[0], 0xF800);
+    EXPECT_EQ(dest[1], 0x07E0);
+    EXPECT_EQ(dest[2], 0x001F);
+    EXPECT_EQ(dest[3], 0xABAB);
+    EXPECT_EQ(dest[4], 0xFFFF);
+    EXPECT_EQ(dest[5], 0x0000);
+    EXPECT_EQ(dest[6], 0xF800);
+    EXPECT_EQ(dest[7], 0xABAB);
+}
+
+TEST(PedigreePixelKernelsRect, UnsupportedConversion)
+{
+    EXPECT_FALSE(canConvertPixels(Bits8_Idx, Bits32_Argb));
+    EXPECT_FALSE(canConvertPixels(Bits16_Rgb565, Bits24_Rgb));
+    EXPECT_TRUE(canConvertPixels(Bits24_Rgb, Bits32_Rgb));
+}
+
+TEST(PedigreePixelKernelsRect, FillRect)
+{
+    uint32_t buf[12];
+    memset(buf, 0, sizeof(buf));
+
+    // 2x2 fill inside a 4-pixel pitch at (1, 1).
+    EXPECT_TRUE(fillRect(&buf[5], 16, 4, 0x11223344, 2, 2));
+    for (size_t i = 0; i < 12; ++i)
+    {
+        bool inside = (i == 5) || (i == 6) || (i == 9) || (i == 10);
+        EXPECT_EQ(buf[i], inside ? 0x11223344U : 0U);
+    }
+
+    EXPECT_FALSE(fillRect(buf, 12, 3, 0, 4, 1));
+}
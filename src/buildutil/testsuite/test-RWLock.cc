@@ -0,0 +1,135 @@
+/*
+ * Copyright (c) 2008-2014, Pedigree Developers
+ *
+ * Please see the CONTRIB file in the root of the source tree for a full
+ * list of contributors.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#define PEDIGREE_EXTERNAL_SOURCE 1
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "pedigree/kernel/process/RWLock.h"
+
+TEST(PedigreeRWLock, ManyReaders)
+{
+    RWLock lock;
+
+    EXPECT_TRUE(lock.acquireRead());
+    EXPECT_TRUE(lock.tryAcquireRead());
+    EXPECT_EQ(lock.getReaders(), 2);
+    EXPECT_FALSE(lock.tryAcquireWrite());
+
+    lock.releaseRead();
+    lock.releaseRead();
+    EXPECT_EQ(lock.getReaders(), 0);
+}
+
+TEST(PedigreeRWLock, WriterExcludesEveryone)
+{
+    RWLock lock;
+
+    EXPECT_TRUE(lock.acquireWrite());
+    EXPECT_TRUE(lock.isWriteLocked());
+    EXPECT_FALSE(lock.tryAcquireRead());
+    EXPECT_FALSE(lock.tryAcquireWrite());
+
+    lock.releaseWrite();
+    EXPECT_FALSE(lock.isWriteLocked());
+    EXPECT_TRUE(lock.tryAcquireRead());
+    lock.releaseRead();
+}
+
+TEST(PedigreeRWLock, WaitingWriterHoldsBackReaders)
+{
+    RWLock lock;
+    std::atomic<bool> written(false);
+
+    lock.acquireRead();
+    std::thread writer([&lock, &written]() {
+        lock.acquireWrite();
+        written = true;
+        lock.releaseWrite();
+    });
+
+    // Wait for the writer to make itself known.
+    while (lock.tryAcquireRead())
+    {
+        lock.releaseRead();
+        std::this_thread::yield();
+    }
+    EXPECT_FALSE(written);
+
+    lock.releaseRead();
+    writer.join();
+    EXPECT_TRUE(written);
+
+    // With the writer gone, readers are welcome again.
+    EXPECT_TRUE(lock.tryAcquireRead());
+    lock.releaseRead();
+}
+
+TEST(PedigreeRWLock, Contended)
+{
+    RWLock lock;
+    size_t a = 0, b = 0;
+    std::atomic<size_t> torn(0);
+
+    const size_t nReaders = 6;
+    const size_t nWriters = 2;
+    const size_t nIterations = 10000;
+
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < nWriters; ++i)
+    {
+        threads.emplace_back([&]() {
+            for (size_t j = 0; j < nIterations; ++j)
+            {
+                lock.acquireWrite();
+                ++a;
+                ++b;
+                lock.releaseWrite();
+            }
+        });
+    }
+    for (size_t i = 0; i < nReaders; ++i)
+    {
+        threads.emplace_back([&]() {
+            for (size_t j = 0; j < nIterations; ++j)
+            {
+                ReadLockGuard guard(lock);
+                if (a != b)
+                {
+                    ++torn;
+                }
+            }
+        });
+    }
+
+    for (auto &t : threads)
+    {
+        t.join();
+    }
+
+    EXPECT_EQ(torn, 0);
+    EXPECT_EQ(a, nWriters * nIterations);
+    EXPECT_EQ(b, nWriters * nIterations);
+    EXPECT_EQ(lock.getReaders(), 0);
+    EXPECT_FALSE(lock.isWriteLocked());
+}
@@ -0,0 +1,214 @@
+/*
+ * Copyright (c) 2008-2014, Pedigree Developers
+ *
+ * Please see the CONTRIB file in the root of the source tree for a full
+ * list of contributors.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+#define PEDIGREE_EXTERNAL_SOURCE 1
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <thread>
+
+#include "pedigree/kernel/utilities/SpscRing.h"
+
+TEST(PedigreeSpscRing, InitialSettings)
+{
+    SpscRing ring;
+
+    EXPECT_EQ(ring.getDataSize(), 0U);
+    EXPECT_EQ(ring.getSize(), SpscRing::DefaultSize);
+    EXPECT_TRUE(ring.canWrite(false));
+    EXPECT_FALSE(ring.canRead(false));
+}
+
+TEST(PedigreeSpscRing, SizeRoundsUp)
+{
+    SpscRing small(1);
+    SpscRing odd(SpscRing::MinimumSize * 3);
+
+    EXPECT_EQ(small.getSize(), SpscRing::MinimumSize);
+    EXPECT_EQ(odd.getSize(), SpscRing::MinimumSize * 4);
+}
+
+TEST(PedigreeSpscRing, ReadEmpty)
+{
+    SpscRing ring;
+
+    char buf[16];
+    EXPECT_EQ(ring.read(buf, 16, false), 0U);
+}
+
+TEST(PedigreeSpscRing, ShortNonBlockingWrite)
+{
+    SpscRing ring(SpscRing::MinimumSize);
+
+    const size_t size = SpscRing::MinimumSize + 100;
+    std::unique_ptr<uint8_t[]> in(new uint8_t[size]());
+
+    EXPECT_EQ(ring.write(in.get(), size, false), SpscRing::MinimumSize);
+    EXPECT_EQ(ring.getDataSize(), SpscRing::MinimumSize);
+    EXPECT_FALSE(ring.canWrite(false));
+    EXPECT_TRUE(ring.canRead(false));
+}
+
+TEST(PedigreeSpscRing, Wraparound)
+{
+    SpscRing ring(SpscRing::MinimumSize);
+
+    const size_t size = SpscRing::MinimumSize;
+    std::unique_ptr<uint8_t[]> in(new uint8_t[size]);
+    std::unique_ptr<uint8_t[]> out(new uint8_t[size]);
+    for (size_t i = 0; i < size; ++i)
+    {
+        in[i] = i % 251;
+    }
+
+    // Move the indices to just before the end of the storage, then write
+    // across it.
+    ASSERT_EQ(ring.write(in.get(), size - 10, false), size - 10);
+    ASSERT_EQ(ring.read(out.get(), size - 10, false), size - 10);
+
+    EXPECT_EQ(ring.write(in.get(), size, false), size);
+    EXPECT_EQ(ring.read(out.get(), size, false), size);
+    EXPECT_EQ(memcmp(in.get(), out.get(), size), 0);
+}
+
+TEST(PedigreeSpscRing, ShortRead)
+{
+    SpscRing ring;
+
+    char buf[64];
+    memset(buf, 0xAB, 32);
+
+    ASSERT_EQ(ring.write(buf, 32, false), 32U);
+
+    // Blocking reads return whatever is there rather than waiting for more.
+    EXPECT_EQ(ring.read(buf, 64, true), 32U);
+}
+
+TEST(PedigreeSpscRing, Wipe)
+{
+    SpscRing ring;
+
+    char buf[32];
+    memset(buf, 0, 32);
+
+    ASSERT_EQ(ring.write(buf, 32, false), 32U);
+    ring.wipe();
+
+    EXPECT_EQ(ring.getDataSize(), 0U);
+    EXPECT_EQ(ring.read(buf, 32, false), 0U);
+}
+
+TEST(PedigreeSpscRing, DisabledWritesStillDrain)
+{
+    SpscRing ring;
+
+    char buf[32];
+    memset(buf, 0, 32);
+
+    ASSERT_EQ(ring.write(buf, 32, false), 32U);
+    ring.disableWrites();
+
+    EXPECT_EQ(ring.write(buf, 32, false), 0U);
+    EXPECT_EQ(ring.read(buf, 32, true), 32U);
+
+    // Would block forever if nothing could ever write again.
+    EXPECT_EQ(ring.read(buf, 32, true), 0U);
+    EXPECT_FALSE(ring.canRead(true));
+}
+
+TEST(PedigreeSpscRing, DisabledReadsEndBlockingWrite)
+{
+    SpscRing ring(SpscRing::MinimumSize);
+
+    char buf[SpscRing::MinimumSize * 2];
+    memset(buf, 0, sizeof buf);
+
+    std::thread writer([&]() {
+        EXPECT_EQ(ring.write(buf, sizeof buf, true), SpscRing::MinimumSize);
+    });
+
+    // Wait for the writer to fill the ring, then give up on reading.
+    while (ring.getDataSize() < SpscRing::MinimumSize)
+    {
+        std::this_thread::yield();
+    }
+    ring.disableReads();
+
+    writer.join();
+}
+
+TEST(PedigreeSpscRing, Pipeline)
+{
+    SpscRing ring(SpscRing::MinimumSize);
+
+    const size_t size = 1 << 22;
+    std::unique_ptr<uint8_t[]> in(new uint8_t[size]);
+    std::unique_ptr<uint8_t[]> out(new uint8_t[size]);
+    for (size_t i = 0; i < size; ++i)
+    {
+        in[i] = i % 253;
+    }
+
+    std::thread writer([&]() {
+        // Odd-sized writes so the ring wraps at many different offsets.
+        size_t offset = 0;
+        while (offset < size)
+        {
+            size_t n = size - offset < 1000 ? size - offset : 1000;
+            ASSERT_EQ(ring.write(in.get() + offset, n, true), n);
+            offset += n;
+        }
+        ring.disableWrites();
+    });
+
+    size_t offset = 0;
+    while (offset < size)
+    {
+        size_t n = ring.read(out.get() + offset, 3000, true);
+        if (!n)
+        {
+            break;
+        }
+        offset += n;
+    }
+
+    writer.join();
+
+    EXPECT_EQ(offset, size);
+    EXPECT_EQ(memcmp(in.get(), out.get(), size), 0);
+}
+
+TEST(PedigreeSpscRing, BlockingCanRead)
+{
+    SpscRing ring;
+
+    std::thread writer([&ring]() {
+        uint8_t c = 1;
+        ring.write(&c, 1, true);
+    });
+
+    EXPECT_TRUE(ring.canRead(true));
+    writer.join();
+
+    EXPECT_EQ(ring.getDataSize(), 1U);
+}
@@ -70,9 +70,9 @@ TEST(PedigreeString, Length)
 
 TEST(PedigreeString, Size)
 {
-    // 64-byte static strings
+    // Short strings are stored inline.
     String s("hello");
-    EXPECT_EQ(s.size(), (size_t) 64);
+    EXPECT_EQ(s.size(), String::InlineSize);
 
     // Dynamic strings are >64 bytes.
     String s2(bigstring());
@@ -350,7 +350,7 @@ TEST(PedigreeString, AssignBigEmpty)
     EXPECT_EQ(s.size(), (size_t) 1025);
     EXPECT_EQ(s, "a");
     s.downsize();
-    EXPECT_EQ(s.size(), (size_t) 64);
+    EXPECT_EQ(s.size(), String::InlineSize);
 }
 
 TEST(PedigreeString, AssignAnother)
@@ -368,7 +368,7 @@ TEST(PedigreeString, ReduceReserve)
     s.reserve(1024);
     EXPECT_EQ(s.size(), (size_t) 1024);
     s.downsize();
-    EXPECT_EQ(s.size(), (size_t) 64);
+    EXPECT_EQ(s.size(), String::InlineSize);
 }
 
 TEST(PedigreeString, ReserveBoundary)
@@ -717,3 +717,78 @@ TEST(PedigreeString, ConstAssign)
     EXPECT_EQ(s1.length(), (size_t) 11);
     EXPECT_STREQ(s1.cstr(), "hello world");
 }
+
+TEST(PedigreeString, InlineBoundary)
+{
+    // Longest string that fits inline, then one byte more.
+    char buf[String::InlineSize + 1];
+    ByteSet(buf, 'x', sizeof(buf));
+    buf[String::InlineSize - 1] = 0;
+
+    String s(buf);
+    EXPECT_EQ(s.length(), String::InlineSize - 1);
+    EXPECT_EQ(s.size(), String::InlineSize);
+
+    s += "y";
+    EXPECT_EQ(s.length(), String::InlineSize);
+    EXPECT_GT(s.size(), String::InlineSize);
+    EXPECT_EQ(s.cstr()[String::InlineSize - 1], 'y');
+    EXPECT_EQ(s.cstr()[String::InlineSize], 0);
+}
+
+TEST(PedigreeString, InlineCopyAndMove)
+{
+    String s1("short");
+    String s2(s1);
+    EXPECT_EQ(s1, s2);
+    EXPECT_NE(s1.cstr(), s2.cstr());
+
+    String s3(pedigree_std::move(s2));
+    EXPECT_EQ(s3, "short");
+    EXPECT_EQ(s2.cstr(), nullptr);
+    EXPECT_EQ(s3.hash(), s1.hash());
+
+    // Short into long and long into short.
+    String big(BIGSTRING);
+    s3 = big;
+    EXPECT_EQ(s3, BIGSTRING);
+    big = s1;
+    EXPECT_EQ(big, "short");
+}
+
+TEST(PedigreeString, DownsizeMovesInline)
+{
+    String s(BIGSTRING);
+    s.rtrim(s.length() - 4);
+    EXPECT_GT(s.size(), String::InlineSize);
+    s.downsize();
+    EXPECT_EQ(s.size(), String::InlineSize);
+    EXPECT_EQ(s.length(), (size_t) 4);
+    EXPECT_EQ(StringView(s.cstr(), 4), StringView(BIGSTRING, 4));
+}
+
+TEST(PedigreeString, ConstantStringLength)
+{
+    auto s1 = MakeConstantString("null");
+    EXPECT_EQ(s1.length(), (size_t) 4);
+    EXPECT_EQ(s1, String("null"));
+}
+
+TEST(PedigreeString, VectorOfInlineStrings)
+{
+    // Vector growth copies elements; inline contents must follow them.
+    Vector<String> v;
+    char buf[16];
+    for (int i = 0; i < 100; ++i)
+    {
+        StringFormat(buf, "entry-%d", i);
+        v.pushBack(String(buf));
+    }
+
+    for (int i = 0; i < 100; ++i)
+    {
+        StringFormat(buf, "entry-%d", i);
+        EXPECT_EQ(v[i].size(), String::InlineSize);
+        EXPECT_EQ(v[i], buf);
+    }
+}
@@ -0,0 +1,289 @@
+/*
+ * Copyright (c) 2008-2014, Pedigree Developers
+ *
+ * Please see the CONTRIB file in the root of the source tree for a full
+ * list of contributors.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+#define PEDIGREE_EXTERNAL_SOURCE 1
+
+#include <elf.h>
+#include <fcntl.h>
+#include <gtest/gtest.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include "pedigree/kernel/linker/SymbolAddressIndex.h"
+
+TEST(PedigreeSymbolAddressIndex, Empty)
+{
+    SymbolAddressIndex index;
+    index.finalise();
+
+    EXPECT_EQ(index.count(), 0U);
+    EXPECT_EQ(index.lookup(0x1000), nullptr);
+}
+
+TEST(PedigreeSymbolAddressIndex, NotFinalised)
+{
+    SymbolAddressIndex index;
+    index.insert(0x1000, 0x100, "a");
+
+    EXPECT_EQ(index.lookup(0x1000), nullptr);
+
+    index.finalise();
+    EXPECT_STREQ(index.lookup(0x1000), "a");
+}
+
+TEST(PedigreeSymbolAddressIndex, Ranges)
+{
+    SymbolAddressIndex index;
+    index.insert(0x3000, 0x100, "c");
+    index.insert(0x1000, 0x100, "a");
+    index.insert(0x2000, 0x100, "b");
+    index.finalise();
+
+    uintptr_t start = 0;
+    EXPECT_STREQ(index.lookup(0x1000, &start), "a");
+    EXPECT_EQ(start, 0x1000U);
+    EXPECT_STREQ(index.lookup(0x10ff, &start), "a");
+    EXPECT_STREQ(index.lookup(0x2080, &start), "b");
+    EXPECT_EQ(start, 0x2000U);
+    EXPECT_STREQ(index.lookup(0x30ff), "c");
+
+    EXPECT_EQ(index.lookup(0xfff), nullptr);
+    EXPECT_EQ(index.lookup(0x1100), nullptr);
+    EXPECT_EQ(index.lookup(0x3100), nullptr);
+}
+
+TEST(PedigreeSymbolAddressIndex, Nested)
+{
+    SymbolAddressIndex index;
+    index.insert(0x1000, 0x1000, "outer");
+    index.insert(0x1100, 0x10, "inner");
+    index.insert(0x1200, 0x10, "inner2");
+    index.finalise();
+
+    EXPECT_STREQ(index.lookup(0x1000), "outer");
+    EXPECT_STREQ(index.lookup(0x1105), "inner");
+    // Past the end of 'inner' but still within 'outer'.
+    EXPECT_STREQ(index.lookup(0x1150), "outer");
+    EXPECT_STREQ(index.lookup(0x1300), "outer");
+    EXPECT_EQ(index.lookup(0x2000), nullptr);
+}
+
+TEST(PedigreeSymbolAddressIndex, Aliases)
+{
+    SymbolAddressIndex index;
+    index.insert(0x1000, 0x100, "first");
+    index.insert(0x1000, 0x100, "second");
+    index.insert(0x1000, 0x10, "short");
+    index.finalise();
+
+    EXPECT_STREQ(index.lookup(0x1000), "first");
+    EXPECT_STREQ(index.lookup(0x1050), "first");
+}
+
+TEST(PedigreeSymbolAddressIndex, Clear)
+{
+    SymbolAddressIndex index;
+    index.insert(0x1000, 0x100, "a");
+    index.finalise();
+    index.clear();
+
+    EXPECT_EQ(index.count(), 0U);
+    EXPECT_EQ(index.lookup(0x1000), nullptr);
+}
+
+namespace
+{
+struct ElfSymbol
+{
+    uintptr_t start;
+    uintptr_t end;
+    const char *name;
+};
+
+/// Reference lookup with the same tie-breaking rules as the index.
+const char *linearLookup(const std::vector<ElfSymbol> &symbols, uintptr_t addr)
+{
+    const ElfSymbol *pFound = nullptr;
+    for (auto &sym : symbols)
+    {
+        if (addr < sym.start || addr >= sym.end)
+        {
+            continue;
+        }
+
+        if (!pFound || sym.start > pFound->start)
+        {
+            pFound = &sym;
+        }
+    }
+
+    return pFound ? pFound->name : nullptr;
+}
+
+/// Maps a real ELF file (this test binary) and pulls out its .symtab using
+/// the same filtering as Elf::lookupSymbol.
+class RealElf
+{
+  public:
+    RealElf() : m_pBase(nullptr), m_Length(0)
+    {
+        int fd = open("/proc/self/exe", O_RDONLY);
+        if (fd < 0)
+        {
+            return;
+        }
+
+        struct stat st;
+        if (fstat(fd, &st) == 0)
+        {
+            m_Length = st.st_size;
+            void *p = mmap(nullptr, m_Length, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p != MAP_FAILED)
+            {
+                m_pBase = static_cast<const uint8_t *>(p);
+            }
+        }
+
+        close(fd);
+
+        if (m_pBase)
+        {
+            load();
+        }
+    }
+
+    ~RealElf()
+    {
+        if (m_pBase)
+        {
+            munmap(const_cast<uint8_t *>(m_pBase), m_Length);
+        }
+    }
+
+    std::vector<ElfSymbol> symbols;
+
+  private:
+    void load()
+    {
+        auto ehdr = reinterpret_cast<const Elf64_Ehdr *>(m_pBase);
+        if (ehdr->e_ident[EI_CLASS] != ELFCLASS64)
+        {
+            return;
+        }
+
+        auto shdrs = reinterpret_cast<const Elf64_Shdr *>(
+            m_pBase + ehdr->e_shoff);
+        for (size_t i = 0; i < ehdr->e_shnum; ++i)
+        {
+            if (shdrs[i].sh_type != SHT_SYMTAB)
+            {
+                continue;
+            }
+
+            auto syms = reinterpret_cast<const Elf64_Sym *>(
+                m_pBase + shdrs[i].sh_offset);
+            auto strtab = reinterpret_cast<const char *>(
+                m_pBase + shdrs[shdrs[i].sh_link].sh_offset);
+
+            size_t n = shdrs[i].sh_size / sizeof(Elf64_Sym);
+            for (size_t j = 0; j < n; ++j)
+            {
+                const Elf64_Sym &sym = syms[j];
+                if (ELF64_ST_TYPE(sym.st_info) != STT_FUNC &&
+                    ELF64_ST_TYPE(sym.st_info) != STT_NOTYPE)
+                {
+                    continue;
+                }
+
+                if (ELF64_ST_BIND(sym.st_info) != STB_GLOBAL)
+                {
+                    continue;
+                }
+
+                size_t size = sym.st_size ? sym.st_size : 0x100;
+                symbols.push_back(
+                    {sym.st_value, sym.st_value + size, strtab + sym.st_name});
+            }
+        }
+    }
+
+    const uint8_t *m_pBase;
+    size_t m_Length;
+};
+}  // namespace
+
+TEST(PedigreeSymbolAddressIndex, RealElfMatchesLinearScan)
+{
+    RealElf elf;
+    ASSERT_GT(elf.symbols.size(), 100U);
+
+    SymbolAddressIndex index;
+    for (auto &sym : elf.symbols)
+    {
+        index.insert(sym.start, sym.end - sym.start, sym.name);
+    }
+    index.finalise();
+
+    EXPECT_EQ(index.count(), elf.symbols.size());
+
+    for (auto &sym : elf.symbols)
+    {
+        uintptr_t mid = sym.start + ((sym.end - sym.start) / 2);
+        uintptr_t probes[] = {sym.start, mid, sym.end - 1, sym.end};
+        for (auto addr : probes)
+        {
+            const char *expected = linearLookup(elf.symbols, addr);
+            const char *actual = index.lookup(addr);
+
+            EXPECT_EQ(actual, expected) << "addr " << std::hex << addr;
+        }
+    }
+}
+
+TEST(PedigreeSymbolAddressIndex, RealElfFindsThisFunction)
+{
+    RealElf elf;
+
+    SymbolAddressIndex index;
+    for (auto &sym : elf.symbols)
+    {
+        index.insert(sym.start, sym.end - sym.start, sym.name);
+    }
+    index.finalise();
+
+    // main() comes from gtest_main and is global in any test binary.
+    uintptr_t mainAddr = 0;
+    for (auto &sym : elf.symbols)
+    {
+        if (std::string(sym.name) == "main")
+        {
+            mainAddr = sym.start;
+        }
+    }
+    ASSERT_NE(mainAddr, 0U);
+
+    uintptr_t start = 0;
+    EXPECT_STREQ(index.lookup(mainAddr + 1, &start), "main");
+    EXPECT_EQ(start, mainAddr);
+}
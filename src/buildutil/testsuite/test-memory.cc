@@ -22,6 +22,7 @@
 #include <string.h>
 
 #include <gtest/gtest.h>
+#include <vector>
 
 #include "pedigree/kernel/utilities/utility.h"
 
@@ -99,3 +100,149 @@ TEST(PedigreeMemoryLibrary, MemoryCompareHalfDiffers)
 
     EXPECT_NE(MemoryCompare(buf1, buf2, 32), 0);
 }
+
+/// Runs the given check once for every memory variant the CPU supports.
+template <class F>
+static void forEachVariant(F check)
+{
+    for (int v = 0; v < MemoryVariantCount; ++v)
+    {
+        if (!MemoryVariantSupported(v))
+        {
+            continue;
+        }
+
+        int old = MemorySelectVariant(v);
+        SCOPED_TRACE(MemoryVariantName(v));
+        check();
+        MemorySelectVariant(old);
+    }
+}
+
+// Sizes either side of every size class boundary.
+static const size_t g_Sizes[] = {0,   1,    2,    3,    4,    7,    8,   9,
+                                 15,  16,   17,   31,   32,   33,   63,  64,
+                                 65,  255,  256,  257,  1023, 1024, 1025,
+                                 2047, 2048, 2049, 8191, 65537};
+
+TEST(PedigreeMemoryLibrary, VariantsCopy)
+{
+    forEachVariant([]() {
+        std::vector<unsigned char> src(65537 + 16), dest(65537 + 16);
+        for (size_t i = 0; i < src.size(); ++i)
+        {
+            src[i] = i * 7;
+        }
+
+        for (size_t n : g_Sizes)
+        {
+            for (size_t align = 0; align < 8; align += 3)
+            {
+                memset(dest.data(), 0xEE, dest.size());
+                ForwardMemoryCopy(dest.data() + align, src.data() + 1, n);
+
+                EXPECT_EQ(memcmp(dest.data() + align, src.data() + 1, n), 0)
+                    << "n=" << n << " align=" << align;
+                EXPECT_EQ(dest[align + n], 0xEE) << "n=" << n;
+                if (align)
+                {
+                    EXPECT_EQ(dest[align - 1], 0xEE) << "n=" << n;
+                }
+            }
+        }
+    });
+}
+
+TEST(PedigreeMemoryLibrary, VariantsOverlappingCopy)
+{
+    forEachVariant([]() {
+        for (size_t n : g_Sizes)
+        {
+            for (size_t shift : {1, 8, 13, 40})
+            {
+                std::vector<unsigned char> buf(n + shift), expected(n + shift);
+                for (size_t i = 0; i < buf.size(); ++i)
+                {
+                    buf[i] = i * 13;
+                }
+
+                // Forwards (destination before source).
+                expected = buf;
+                memmove(expected.data(), expected.data() + shift, n);
+                std::vector<unsigned char> actual = buf;
+                MemoryCopy(actual.data(), actual.data() + shift, n);
+                EXPECT_EQ(actual, expected) << "n=" << n << " shift=" << shift;
+
+                // Backwards (destination after source).
+                expected = buf;
+                memmove(expected.data() + shift, expected.data(), n);
+                actual = buf;
+                MemoryCopy(actual.data() + shift, actual.data(), n);
+                EXPECT_EQ(actual, expected) << "n=" << n << " shift=" << shift;
+            }
+        }
+    });
+}
+
+TEST(PedigreeMemoryLibrary, VariantsSet)
+{
+    forEachVariant([]() {
+        std::vector<unsigned char> buf(65537 + 16);
+        for (size_t n : g_Sizes)
+        {
+            memset(buf.data(), 0xEE, buf.size());
+            ByteSet(buf.data() + 3, 0x5A, n);
+
+            for (size_t i = 0; i < n; ++i)
+            {
+                if (buf[i + 3] != 0x5A)
+                {
+                    ADD_FAILURE() << "n=" << n << " i=" << i;
+                    break;
+                }
+            }
+            EXPECT_EQ(buf[2], 0xEE) << "n=" << n;
+            EXPECT_EQ(buf[n + 3], 0xEE) << "n=" << n;
+        }
+    });
+}
+
+TEST(PedigreeMemoryLibrary, MemoryCompareOrdering)
+{
+    // Sign must follow the first differing byte, compared unsigned, wherever
+    // it falls relative to a word boundary.
+    for (size_t n : {1, 7, 8, 9, 16, 31, 64})
+    {
+        for (size_t at = 0; at < n; ++at)
+        {
+            std::vector<unsigned char> a(n, 0x10), b(n, 0x10);
+            a[at] = 0x01;
+            b[at] = 0xF0;
+            if (at + 1 < n)
+            {
+                a[at + 1] = 0xFF;
+            }
+
+            EXPECT_LT(MemoryCompare(a.data(), b.data(), n), 0) << n << at;
+            EXPECT_GT(MemoryCompare(b.data(), a.data(), n), 0) << n << at;
+        }
+    }
+}
+
+TEST(PedigreeMemoryLibrary, VariantsLargeCopy)
+{
+    // Large enough to take the non-temporal path.
+    const size_t n = (5 << 20) + 3;
+    std::vector<unsigned char> src(n + 1), dest(n + 1, 0xEE);
+    for (size_t i = 0; i < n; ++i)
+    {
+        src[i] = i * 11;
+    }
+
+    forEachVariant([&]() {
+        ForwardMemoryCopy(dest.data(), src.data() + 1, n - 1);
+        EXPECT_EQ(memcmp(dest.data(), src.data() + 1, n - 1), 0);
+        EXPECT_EQ(dest[n], 0xEE);
+        ByteSet(dest.data(), 0, n - 1);
+    });
+}
@@ -17,39 +17,62 @@
  * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
+
 #include "DiskImage.h"
-#include "pedigree/kernel/BootstrapInfo.h"
 #include "pedigree/kernel/Log.h"
+#include "pedigree/kernel/machine/hosted/HostDiskImage.h"
+#include "pedigree/kernel/utilities/utility.h"
 
-extern BootstrapStruct_t *g_pBootstrapInfo;
+DiskImage::DiskImage()
+    : Disk(), RequestQueue(MakeConstantString("DiskImage")), m_pBase(0),
+      m_nSize(0), m_BlockSize(HostDiskImage::DefaultBlockSize),
+      m_bReadOnly(false), m_Cache()
+{
+    m_Cache.setCallback(cacheCallback, this);
+}
 
-bool DiskImage::initialise()
+DiskImage::~DiskImage()
 {
-    if (g_pBootstrapInfo->getModuleCount() < 3)
+    destroy();
+}
+
+bool DiskImage::initialiseImage()
+{
+    if (!HostDiskImage::isAvailable())
     {
-        NOTICE("not enough modules to create a DiskImage");
+        NOTICE("no disk image was given to the hosted kernel");
         return false;
     }
 
-    uintptr_t baseAddress = g_pBootstrapInfo->getModuleArray()[2].base;
-    uintptr_t endAddress = g_pBootstrapInfo->getModuleArray()[2].end;
+    m_pBase = reinterpret_cast<uint8_t *>(HostDiskImage::getMapping());
+    m_nSize = HostDiskImage::getSize();
+    m_BlockSize = HostDiskImage::getBlockSize();
+    m_bReadOnly = HostDiskImage::isReadOnly();
+
+    NOTICE(
+        "DiskImage: " << m_nSize << " bytes, " << m_BlockSize
+                      << " byte blocks, "
+                      << (m_pBase ? "mapped" : "not mapped")
+                      << (m_bReadOnly ? ", read-only" : ""));
 
-    m_pBase = reinterpret_cast<void *>(baseAddress);
-    m_nSize = endAddress - baseAddress;
+    // Start the RequestQueue
+    initialise();
     return true;
 }
 
 uintptr_t DiskImage::read(uint64_t location)
 {
-    if ((location > m_nSize) || !m_pBase)
+    if (location >= m_nSize)
     {
         ERROR("DiskImage::read() - location " << location << " > " << m_nSize);
-        ERROR("  -> or " << m_pBase << " is null");
-        return ~0;
+        return 0;
     }
 
-    uint64_t offset = location % getBlockSize();
-    location &= ~(getBlockSize() - 1);
+    // Blocks are always copied into the Cache, even when the image is
+    // mapped: the host's mapping isn't known to the hosted address space, so
+    // it can't give mmap() a physical page for the block.
+    uint64_t offset = location % m_BlockSize;
+    location -= offset;
 
     uintptr_t buffer = m_Cache.lookup(location);
     if (buffer)
@@ -57,14 +80,58 @@ uintptr_t DiskImage::read(uint64_t location)
         return buffer + offset;
     }
 
-    buffer = m_Cache.insert(location, getBlockSize());
-    MemoryCopy(
-        reinterpret_cast<void *>(buffer), adjust_pointer(m_pBase, location),
-        getBlockSize());
+    if (!addRequest(0, ReadBlock, location))
+    {
+        return 0;
+    }
 
-    m_Cache.markNoLongerEditing(location);
+    // Start on the next block while the caller works on this one.
+    if ((location + m_BlockSize) < m_nSize)
+    {
+        addAsyncRequest(1, ReadBlock, location + m_BlockSize);
+    }
 
-    return buffer + offset;
+    buffer = m_Cache.lookup(location);
+    return buffer ? buffer + offset : 0;
+}
+
+void DiskImage::write(uint64_t location)
+{
+#if !CRIPPLE_HDD
+    if (m_bReadOnly || (location >= m_nSize))
+    {
+        return;
+    }
+
+    // Only gets the data to the host; getting it onto the host's storage is
+    // left to flush(), so block-at-a-time writers don't fsync every block.
+    location &= ~static_cast<uint64_t>(m_BlockSize - 1);
+    for (size_t i = 0; i < m_BlockSize; i += 0x1000)
+    {
+        m_Cache.sync(location + i, true);
+    }
+#endif
+}
+
+void DiskImage::flush(uint64_t location)
+{
+#if !CRIPPLE_HDD
+    if (m_bReadOnly || (location >= m_nSize))
+    {
+        return;
+    }
+
+    location &= ~static_cast<uint64_t>(m_BlockSize - 1);
+    for (size_t i = 0; i < m_BlockSize; i += 0x1000)
+    {
+        m_Cache.sync(location + i, false);
+    }
+
+    if (!HostDiskImage::sync(location, m_BlockSize))
+    {
+        WARNING("DiskImage::flush() - sync failed at " << location);
+    }
+#endif
 }
 
 size_t DiskImage::getSize() const
@@ -74,10 +141,117 @@ size_t DiskImage::getSize() const
 
 void DiskImage::pin(uint64_t location)
 {
-    m_Cache.pin(location);
+    m_Cache.pin(location & ~static_cast<uint64_t>(m_BlockSize - 1));
 }
 
 void DiskImage::unpin(uint64_t location)
 {
-    m_Cache.release(location);
+    m_Cache.release(location & ~static_cast<uint64_t>(m_BlockSize - 1));
+}
+
+uint64_t DiskImage::executeRequest(
+    uint64_t p1, uint64_t p2, uint64_t p3, uint64_t p4, uint64_t p5,
+    uint64_t p6, uint64_t p7, uint64_t p8)
+{
+    if (p1 == ReadBlock)
+        return doRead(p2);
+    else
+        return 0;
+}
+
+void DiskImage::cacheCallback(
+    CacheConstants::CallbackCause cause, uintptr_t loc, uintptr_t page,
+    void *meta)
+{
+    DiskImage *pDisk = reinterpret_cast<DiskImage *>(meta);
+
+    switch (cause)
+    {
+        case CacheConstants::WriteBack:
+        {
+            size_t length = 0x1000;
+            if ((loc + length) > pDisk->m_nSize)
+            {
+                length = pDisk->m_nSize - loc;
+            }
+
+            if (pDisk->m_pBase)
+            {
+                // A read-only image has a private mapping, so this is also
+                // fine there; it just never reaches the file.
+                MemoryCopy(
+                    pDisk->m_pBase + loc, reinterpret_cast<void *>(page),
+                    length);
+            }
+            else if (
+                !pDisk->m_bReadOnly &&
+                (HostDiskImage::write(
+                     loc, reinterpret_cast<void *>(page), length) != length))
+            {
+                WARNING("DiskImage: short write at " << loc);
+            }
+            break;
+        }
+        case CacheConstants::Eviction:
+            // no-op for DiskImage
+            break;
+        default:
+            WARNING("DiskImage: unknown cache callback -- could indicate "
+                    "potential future I/O issues.");
+            break;
+    }
+}
+
+uint64_t DiskImage::doRead(uint64_t location)
+{
+    // Read-ahead may have already brought this block in.
+    uintptr_t buffer = m_Cache.lookup(location);
+    if (buffer)
+    {
+        m_Cache.release(location);
+        return 1;
+    }
+
+    buffer = m_Cache.insert(location, m_BlockSize);
+    if (!buffer)
+    {
+        ERROR("DiskImage::doRead - no buffer");
+        return 0;
+    }
+
+    size_t length = m_BlockSize;
+    if ((location + length) > m_nSize)
+    {
+        length = m_nSize - location;
+    }
+
+    void *p = reinterpret_cast<void *>(buffer);
+    size_t n = length;
+    if (m_pBase)
+    {
+        MemoryCopy(p, m_pBase + location, length);
+    }
+    else
+    {
+        n = HostDiskImage::read(location, p, length);
+    }
+    if (n < m_BlockSize)
+    {
+        // Short read (or the end of the image) - don't expose stale memory.
+        ByteSet(adjust_pointer(p, n), 0, m_BlockSize - n);
+    }
+
+    m_Cache.markNoLongerEditing(location, m_BlockSize);
+
+    if (n < length)
+    {
+        ERROR("DiskImage::doRead - short read at " << location);
+        for (size_t i = 0; i < m_BlockSize; i += 0x1000)
+        {
+            m_Cache.evict(location + i);
+        }
+        return 0;
+    }
+
+    return 1;
 }
@@ -17,52 +17,83 @@
  * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
+
 #ifndef DISKIMAGE_H
 #define DISKIMAGE_H
 
 #include "pedigree/kernel/machine/Disk.h"
+#include "pedigree/kernel/processor/types.h"
 #include "pedigree/kernel/utilities/Cache.h"
+#include "pedigree/kernel/utilities/RequestQueue.h"
+#include "pedigree/kernel/utilities/String.h"
 
-/** Loads a disk image as a usable disk device. */
-class DiskImage : public Disk
+/**
+ * Exposes the hosted kernel's disk image (see HostDiskImage) as a disk.
+ *
+ * Blocks are read into a Cache, so that they have physical pages that can be
+ * mapped into address spaces, and are written back by the Cache. Both copy
+ * through the host's mapping of the image if it has one, and fall back to
+ * pread and pwrite otherwise. Data only reaches the host's storage on
+ * flush().
+ */
+class DiskImage : public Disk, public RequestQueue
 {
   public:
-    DiskImage() : Disk(), m_pBase(0), m_nSize(0), m_Cache()
-    {
-    }
-
-    virtual ~DiskImage()
-    {
-    }
+    DiskImage();
+    virtual ~DiskImage();
 
-    bool initialise();
+    /** Attaches to the host's disk image, returning false if there is none. */
+    bool initialiseImage();
 
     virtual void getName(String &str)
     {
-        str = "Hosted disk image";
+        str.assign("Hosted disk image", 18);
     }
 
     virtual void dump(String &str)
     {
-        str = "Hosted disk image";
+        str.assign("Hosted disk image", 18);
     }
 
     virtual uintptr_t read(uint64_t location);
 
+    virtual void write(uint64_t location);
+
+    virtual void flush(uint64_t location);
+
     virtual size_t getSize() const;
 
     virtual size_t getBlockSize() const
     {
-        return 0x10000;
+        return m_BlockSize;
     }
 
     virtual void pin(uint64_t location);
 
     virtual void unpin(uint64_t location);
 
+  protected:
+    virtual uint64_t executeRequest(
+        uint64_t p1, uint64_t p2, uint64_t p3, uint64_t p4, uint64_t p5,
+        uint64_t p6, uint64_t p7, uint64_t p8);
+
   private:
-    void *m_pBase;
-    size_t m_nSize;
+    enum RequestType
+    {
+        ReadBlock = 0
+    };
+
+    static void cacheCallback(
+        CacheConstants::CallbackCause cause, uintptr_t loc, uintptr_t page,
+        void *meta);
+
+    /** Reads the block at \p location into the cache, if not present. */
+    uint64_t doRead(uint64_t location);
+
+    uint8_t *m_pBase;
+    uint64_t m_nSize;
+    size_t m_BlockSize;
+    bool m_bReadOnly;
 
     Cache m_Cache;
 };
@@ -23,7 +23,7 @@
 bool entry()
 {
     DiskImage *pDiskImage = new DiskImage();
-    if (!pDiskImage->initialise())
+    if (!pDiskImage->initialiseImage())
     {
         delete pDiskImage;
 
@@ -519,7 +519,8 @@ uintptr_t PosixSyscallManager::syscall(SyscallState &state)
             return posix_futex(
                 reinterpret_cast<int *>(p1), static_cast<int>(p2),
                 static_cast<int>(p3),
-                reinterpret_cast<const struct timespec *>(p4));
+                reinterpret_cast<const struct timespec *>(p4),
+                reinterpret_cast<int *>(p5), static_cast<int>(p6));
         case POSIX_UNAME:
             return posix_uname(reinterpret_cast<struct utsname *>(p1));
         case POSIX_ARCH_PRCTL:
@@ -680,6 +681,15 @@ uintptr_t PosixSyscallManager::syscall(SyscallState &state)
                 reinterpret_cast<const void *>(p2));
         case POSIX_PRCTL:
             return posix_prctl(p1, p2, p3, p4, p5);
+        case POSIX_SPLICE:
+            return posix_splice(
+                p1, reinterpret_cast<off_t *>(p2), p3,
+                reinterpret_cast<off_t *>(p4), p5, p6);
+        case POSIX_TEE:
+            return posix_tee(p1, p2, p3, p4);
+        case POSIX_VMSPLICE:
+            return posix_vmsplice(
+                p1, reinterpret_cast<const struct iovec *>(p2), p3, p4);
 
         default:
             ERROR(
@@ -24,7 +24,14 @@
 #include "pedigree/kernel/BootstrapInfo.h"
 #include "pedigree/kernel/LockGuard.h"
 #include "pedigree/kernel/Version.h"
+#include "pedigree/kernel/debugger/SamplingProfiler.h"
 #include "pedigree/kernel/machine/Device.h"
+#include "pedigree/kernel/process/MemoryPressureManager.h"
+#include "pedigree/kernel/process/PerProcessorScheduler.h"
+#include "pedigree/kernel/process/Process.h"
+#include "pedigree/kernel/process/Scheduler.h"
+#include "pedigree/kernel/process/Thread.h"
+#include "pedigree/kernel/processor/PhysicalMemoryManager.h"
 #include "pedigree/kernel/processor/Processor.h"
 #include "pedigree/kernel/time/Time.h"
 
@@ -322,6 +329,599 @@ String UptimeFile::generateString()
     return f;
 }
 
+ProfileFile::ProfileFile(size_t inode, Filesystem *pParentFS, File *pParent)
+    : File(String("profile"), 0, 0, 0, inode, pParentFS, 0, pParent),
+      m_pSnapshot(0), m_SnapshotSize(0), m_Lock(false)
+{
+    setPermissionsOnly(FILE_UR | FILE_UW);
+    setUidOnly(0);
+    setGidOnly(0);
+}
+
+ProfileFile::~ProfileFile()
+{
+    delete[] m_pSnapshot;
+}
+
+void ProfileFile::refresh()
+{
+    delete[] m_pSnapshot;
+
+    // writeStream only writes whole records, so samples arriving between
+    // these two calls are simply left for the next read.
+    size_t size = SamplingProfiler::instance().streamSize();
+    m_pSnapshot = new uint8_t[size];
+    m_SnapshotSize =
+        SamplingProfiler::instance().writeStream(m_pSnapshot, size);
+}
+
+uint64_t ProfileFile::readBytewise(
+    uint64_t location, uint64_t size, uintptr_t buffer, bool bCanBlock)
+{
+    LockGuard<Mutex> guard(m_Lock);
+
+    // Reading from the start takes a new snapshot, so a sequential read of
+    // the whole file sees one consistent set of samples.
+    if (!location || !m_pSnapshot)
+    {
+        refresh();
+    }
+
+    if (location >= m_SnapshotSize)
+    {
+        return 0;  // EOF
+    }
+    else if ((location + size) > m_SnapshotSize)
+    {
+        size = m_SnapshotSize - location;
+    }
+
+    MemoryCopy(
+        reinterpret_cast<void *>(buffer), m_pSnapshot + location, size);
+
+    return size;
+}
+
+uint64_t ProfileFile::writeBytewise(
+    uint64_t location, uint64_t size, uintptr_t buffer, bool bCanBlock)
+{
+    // The write buffer need not be NUL-terminated, so bound the scan.
+    String command(reinterpret_cast<const char *>(buffer), size, true);
+    command.rstrip();
+
+    SamplingProfiler &profiler = SamplingProfiler::instance();
+    if (command == "stop")
+    {
+        profiler.stop();
+    }
+    else if (command == "clear")
+    {
+        profiler.clear();
+    }
+    else if (command.startswith("start"))
+    {
+        size_t interval = 1;
+        if (command.length() > 5)
+        {
+            char *end = 0;
+            interval =
+                StringToUnsignedLong(command.cstr() + 5, &end, 10);
+        }
+
+        if (!profiler.start(interval))
+        {
+            return 0;
+        }
+
+        NOTICE(
+            "profiler: sampling every " << Dec << interval << Hex
+                                        << " scheduler tick(s)");
+    }
+    else
+    {
+        return 0;
+    }
+
+    return size;
+}
+
+size_t ProfileFile::getSize()
+{
+    return SamplingProfiler::instance().streamSize();
+}
+
+/** Times in /proc/stat and /proc/<pid>/stat are in units of USER_HZ. */
+static const Time::Timestamp ClockTicksPerSecond = 100;
+
+static uint64_t toClockTicks(Time::Timestamp t)
+{
+    return t / (Time::Multiplier::Second / ClockTicksPerSecond);
+}
+
+/** Copies the requested part of a generated file into a read buffer. */
+static uint64_t readGenerated(
+    const String &f, uint64_t location, uint64_t size, uintptr_t buffer)
+{
+    if (location >= f.length())
+    {
+        // "EOF"
+        return 0;
+    }
+
+    if ((location + size) > f.length())
+    {
+        size = f.length() - location;
+    }
+
+    char *destination = reinterpret_cast<char *>(buffer);
+    MemoryCopy(destination, f.cstr() + location, size);
+
+    return size;
+}
+
+/** Finds a process by ID, or null if it no longer exists. */
+static Process *findProcess(size_t pid)
+{
+    for (size_t i = 0; i < Scheduler::instance().getNumProcesses(); ++i)
+    {
+        Process *pProcess = Scheduler::instance().getProcess(i);
+        if (pProcess && pProcess->getId() == pid)
+        {
+            return pProcess;
+        }
+    }
+
+    return 0;
+}
+
+/** Appends a /proc/stat "cpu" line. */
+static void formatCpuTimes(
+    String &f, const String &name, Time::Timestamp user, Time::Timestamp busy,
+    Time::Timestamp idle)
+{
+    // Interrupt and syscall time is not split out, so it all counts as
+    // system time.
+    Time::Timestamp system = busy > user ? busy - user : 0;
+
+    String line;
+    line.Format(
+        "%s %lu 0 %lu %lu 0 0 0 0 0 0\n", static_cast<const char *>(name),
+        toClockTicks(user), toClockTicks(system), toClockTicks(idle));
+    f += line;
+}
+
+VmstatFile::VmstatFile(size_t inode, Filesystem *pParentFS, File *pParent)
+    : File(String("vmstat"), 0, 0, 0, inode, pParentFS, 0, pParent)
+{
+    setPermissionsOnly(FILE_UR | FILE_GR | FILE_OR);
+    setUidOnly(0);
+    setGidOnly(0);
+}
+
+VmstatFile::~VmstatFile() = default;
+
+uint64_t VmstatFile::readBytewise(
+    uint64_t location, uint64_t size, uintptr_t buffer, bool bCanBlock)
+{
+    return readGenerated(generateString(), location, size, buffer);
+}
+
+uint64_t VmstatFile::writeBytewise(
+    uint64_t location, uint64_t size, uintptr_t buffer, bool bCanBlock)
+{
+    return 0;
+}
+
+size_t VmstatFile::getSize()
+{
+    String f = generateString();
+    return f.length();
+}
+
+String VmstatFile::generateString()
+{
+    const MemoryPressureManager::Statistics &stats =
+        MemoryPressureManager::instance().getStatistics();
+
+    String f;
+    String line;
+
+    line.Format(
+        "nr_free_pages %lu\nnr_min_free_pages %lu\nnr_low_free_pages %lu\n",
+        PhysicalMemoryManager::instance().freePageCount(),
+        MemoryPressureManager::getMinWatermark(),
+        MemoryPressureManager::getLowWatermark());
+    f += line;
+    line.Format(
+        "nr_high_free_pages %lu\npageoutrun %lu\npgsteal_kswapd %lu\n",
+        MemoryPressureManager::getHighWatermark(), stats.backgroundRuns,
+        stats.backgroundPages);
+    f += line;
+    line.Format(
+        "pgsteal_direct %lu\nallocstall %lu\nallocstall_failed %lu\n",
+        stats.directPages, stats.directReclaims, stats.directFailures);
+    f += line;
+    line.Format("allocstall_time_ns %lu\n", stats.stallTime);
+    f += line;
+
+    return f;
+}
+
+static const char *g_SchedulerStatisticsNames[] = {
+    "stat", "schedstat", "interrupts", "sched_debug"};
+
+SchedulerStatisticsFile::SchedulerStatisticsFile(
+    Type type, size_t inode, Filesystem *pParentFS, File *pParent)
+    : File(
+          String(g_SchedulerStatisticsNames[type]), 0, 0, 0, inode, pParentFS,
+          0, pParent),
+      m_Type(type)
+{
+    setPermissionsOnly(FILE_UR | FILE_GR | FILE_OR);
+    setUidOnly(0);
+    setGidOnly(0);
+}
+
+SchedulerStatisticsFile::~SchedulerStatisticsFile() = default;
+
+uint64_t SchedulerStatisticsFile::readBytewise(
+    uint64_t location, uint64_t size, uintptr_t buffer, bool bCanBlock)
+{
+    return readGenerated(generateString(), location, size, buffer);
+}
+
+uint64_t SchedulerStatisticsFile::writeBytewise(
+    uint64_t location, uint64_t size, uintptr_t buffer, bool bCanBlock)
+{
+    return 0;
+}
+
+size_t SchedulerStatisticsFile::getSize()
+{
+    String f = generateString();
+    return f.length();
+}
+
+String SchedulerStatisticsFile::generateString()
+{
+    Scheduler &scheduler = Scheduler::instance();
+    size_t nCpus = scheduler.getNumProcessorSchedulers();
+
+    String f;
+    String line;
+    String name;
+
+    switch (m_Type)
+    {
+        case Stat:
+        {
+            Time::Timestamp user = 0, busy = 0, idle = 0;
+            uint64_t switches = 0;
+            for (size_t i = 0; i < nCpus; ++i)
+            {
+                const CpuStatistics &stats =
+                    scheduler.getProcessorScheduler(i)->getStatistics();
+                user += stats.userTime;
+                busy += stats.busyTime;
+                idle += stats.idleTime;
+                switches += stats.contextSwitches;
+            }
+
+            formatCpuTimes(f, String("cpu "), user, busy, idle);
+            for (size_t i = 0; i < nCpus; ++i)
+            {
+                const CpuStatistics &stats =
+                    scheduler.getProcessorScheduler(i)->getStatistics();
+                name.Format("cpu%lu", i);
+                formatCpuTimes(
+                    f, name, stats.userTime, stats.busyTime, stats.idleTime);
+            }
+
+            // Per-vector counts, preceded by their total.
+            uint64_t perVector[CpuStatistics::InterruptVectors];
+            uint64_t totalInterrupts = 0;
+            for (size_t v = 0; v < CpuStatistics::InterruptVectors; ++v)
+            {
+                perVector[v] = 0;
+                for (size_t i = 0; i < nCpus; ++i)
+                {
+                    perVector[v] += scheduler.getProcessorScheduler(i)
+                                        ->getStatistics()
+                                        .interrupts[v];
+                }
+                totalInterrupts += perVector[v];
+            }
+
+            line.Format("intr %lu", totalInterrupts);
+            f += line;
+            for (size_t v = 0; v < CpuStatistics::InterruptVectors; ++v)
+            {
+                line.Format(" %lu", perVector[v]);
+                f += line;
+            }
+
+            // Threads that are running or waiting to run.
+            size_t nRunning = 0;
+            for (size_t i = 0; i < scheduler.getNumProcesses(); ++i)
+            {
+                Process *pProcess = scheduler.getProcess(i);
+                if (!pProcess)
+                {
+                    continue;
+                }
+
+                for (size_t j = 0; j < pProcess->getNumThreads(); ++j)
+                {
+                    Thread::Status status =
+                        pProcess->getThread(j)->getStatus();
+                    if (status == Thread::Running || status == Thread::Ready)
+                    {
+                        ++nRunning;
+                    }
+                }
+            }
+
+            Time::Timestamp bootTime =
+                Time::getTimeNanoseconds() - Time::getTicks();
+            line.Format(
+                "\nctxt %lu\nbtime %lu\nprocs_running %lu\nprocs_blocked 0\n",
+                switches, bootTime / Time::Multiplier::Second, nRunning);
+            f += line;
+            break;
+        }
+
+        case Schedstat:
+            f += "version 15\n";
+            line.Format("timestamp %lu\n", toClockTicks(Time::getTicks()));
+            f += line;
+            for (size_t i = 0; i < nCpus; ++i)
+            {
+                const CpuStatistics &stats =
+                    scheduler.getProcessorScheduler(i)->getStatistics();
+                // Wakeup and yield counts are not tracked.
+                line.Format(
+                    "cpu%lu 0 0 %lu %lu 0 0 %lu %lu %lu\n", i,
+                    stats.scheduleCalls, stats.idleSchedules, stats.busyTime,
+                    stats.runDelay, stats.contextSwitches);
+                f += line;
+            }
+            break;
+
+        case Interrupts:
+            f += "    ";
+            for (size_t i = 0; i < nCpus; ++i)
+            {
+                name.Format("CPU%lu", i);
+                line.Format(" %10s", static_cast<const char *>(name));
+                f += line;
+            }
+            f += "\n";
+
+            for (size_t v = 0; v < CpuStatistics::InterruptVectors; ++v)
+            {
+                bool bAny = false;
+                for (size_t i = 0; i < nCpus && !bAny; ++i)
+                {
+                    bAny = scheduler.getProcessorScheduler(i)
+                               ->getStatistics()
+                               .interrupts[v] != 0;
+                }
+                if (!bAny)
+                {
+                    continue;
+                }
+
+                line.Format("%3lu:", v);
+                f += line;
+                for (size_t i = 0; i < nCpus; ++i)
+                {
+                    line.Format(
+                        " %10lu", scheduler.getProcessorScheduler(i)
+                                      ->getStatistics()
+                                      .interrupts[v]);
+                    f += line;
+                }
+                f += "\n";
+            }
+            break;
+
+        case SchedDebug:
+            f += "Sched Debug Version: v0.11, pedigree\n";
+            for (size_t i = 0; i < nCpus; ++i)
+            {
+                PerProcessorScheduler *pScheduler =
+                    scheduler.getProcessorScheduler(i);
+                const CpuStatistics &stats = pScheduler->getStatistics();
+
+                line.Format(
+                    "\ncpu#%lu\n  .nr_running : %lu\n  .nr_switches : %lu\n",
+                    i, pScheduler->getReadyCount(), stats.contextSwitches);
+                f += line;
+                line.Format(
+                    "  .nr_syscalls : %lu\n  .sched_count : %lu\n"
+                    "  .sched_goidle : %lu\n",
+                    stats.syscalls, stats.scheduleCalls, stats.idleSchedules);
+                f += line;
+                line.Format(
+                    "  .busy_time : %lu\n  .idle_time : %lu\n"
+                    "  .run_delay : %lu\n",
+                    stats.busyTime, stats.idleTime, stats.runDelay);
+                f += line;
+            }
+            break;
+    }
+
+    return f;
+}
+
+static const char *g_ProcessStatisticsNames[] = {"stat", "schedstat", "status"};
+
+ProcessStatisticsFile::ProcessStatisticsFile(
+    Type type, size_t pid, size_t inode, Filesystem *pParentFS, File *pParent)
+    : File(
+          String(g_ProcessStatisticsNames[type]), 0, 0, 0, inode, pParentFS, 0,
+          pParent),
+      m_Type(type), m_Pid(pid)
+{
+    setPermissionsOnly(FILE_UR | FILE_GR | FILE_OR);
+    setUidOnly(0);
+    setGidOnly(0);
+}
+
+ProcessStatisticsFile::~ProcessStatisticsFile() = default;
+
+uint64_t ProcessStatisticsFile::readBytewise(
+    uint64_t location, uint64_t size, uintptr_t buffer, bool bCanBlock)
+{
+    return readGenerated(generateString(), location, size, buffer);
+}
+
+uint64_t ProcessStatisticsFile::writeBytewise(
+    uint64_t location, uint64_t size, uintptr_t buffer, bool bCanBlock)
+{
+    return 0;
+}
+
+size_t ProcessStatisticsFile::getSize()
+{
+    String f = generateString();
+    return f.length();
+}
+
+String ProcessStatisticsFile::generateString()
+{
+    String f;
+
+    Process *pProcess = findProcess(m_Pid);
+    if (!pProcess)
+    {
+        return f;
+    }
+
+    // Sum up the thread counters, and pick a state for the whole process.
+    ThreadStatistics totals;
+    size_t nThreads = pProcess->getNumThreads();
+    size_t cpu = 0;
+    char state = 'S';
+    for (size_t i = 0; i < nThreads; ++i)
+    {
+        Thread *pThread = pProcess->getThread(i);
+        const ThreadStatistics &stats = pThread->getStatistics();
+        totals.runTime += stats.runTime;
+        totals.waitTime += stats.waitTime;
+        totals.voluntarySwitches += stats.voluntarySwitches;
+        totals.involuntarySwitches += stats.involuntarySwitches;
+        totals.timeslices += stats.timeslices;
+
+        Thread::Status status = pThread->getStatus();
+        if (status == Thread::Running || status == Thread::Ready)
+        {
+            state = 'R';
+        }
+        else if (status == Thread::Suspended && state != 'R')
+        {
+            state = 'T';
+        }
+
+        if (!i)
+        {
+            cpu = pThread->getCpuId();
+        }
+    }
+    if (pProcess->getState() >= Process::Terminating)
+    {
+        state = 'Z';
+    }
+
+    // Like Linux, the name is the basename of the executable.
+    const char *comm = static_cast<const char *>(pProcess->description());
+    for (const char *p = comm; *p; ++p)
+    {
+        if (*p == '/' && p[1])
+        {
+            comm = p + 1;
+        }
+    }
+    char name[16];
+    StringCopyN(name, comm, sizeof(name) - 1);
+    name[sizeof(name) - 1] = 0;
+
+    size_t ppid = pProcess->getParent() ? pProcess->getParent()->getId() : 0;
+    size_t pageSize = PhysicalMemoryManager::getPageSize();
+
+    String line;
+    switch (m_Type)
+    {
+        case Stat:
+        {
+            ssize_t pgrp = m_Pid, session = m_Pid;
+            if (pProcess->getType() == Process::Posix)
+            {
+                PosixProcess *pPosix = static_cast<PosixProcess *>(pProcess);
+                if (pPosix->getProcessGroup())
+                {
+                    pgrp = pPosix->getProcessGroup()->processGroupId;
+                }
+                if (pPosix->getSession() && pPosix->getSession()->Leader)
+                {
+                    session = pPosix->getSession()->Leader->getId();
+                }
+            }
+
+            Time::Timestamp bootTime =
+                Time::getTimeNanoseconds() - Time::getTicks();
+            Time::Timestamp startTime = pProcess->getStartTime();
+            startTime = startTime > bootTime ? startTime - bootTime : 0;
+
+            line.Format(
+                "%lu (%s) %c %lu %ld %ld 0 -1 0 0 0 0 0 ", m_Pid, name, state,
+                ppid, pgrp, session);
+            f += line;
+            line.Format(
+                "%lu %lu 0 0 20 0 %lu 0 %lu %lu %ld ",
+                toClockTicks(pProcess->getUserTime()),
+                toClockTicks(pProcess->getKernelTime()), nThreads,
+                toClockTicks(startTime),
+                pProcess->getVirtualPageCount() * pageSize,
+                pProcess->getPhysicalPageCount());
+            f += line;
+            f += "0 0 0 0 0 0 0 0 0 0 0 0 0 17 ";
+            line.Format(
+                "%lu 0 0 0 0 0 0 0 0 0 0 0 0 %d\n", cpu,
+                pProcess->getExitStatus());
+            f += line;
+            break;
+        }
+
+        case Schedstat:
+            line.Format(
+                "%lu %lu %lu\n", totals.runTime, totals.waitTime,
+                totals.timeslices);
+            f += line;
+            break;
+
+        case Status:
+            line.Format(
+                "Name:\t%s\nState:\t%c\nTgid:\t%lu\nPid:\t%lu\nPPid:\t%lu\n",
+                name, state, m_Pid, m_Pid, ppid);
+            f += line;
+            line.Format(
+                "VmSize:\t%8lu kB\nVmRSS:\t%8lu kB\nThreads:\t%lu\n",
+                (pProcess->getVirtualPageCount() * pageSize) / 1024,
+                (pProcess->getPhysicalPageCount() * pageSize) / 1024,
+                nThreads);
+            f += line;
+            line.Format(
+                "voluntary_ctxt_switches:\t%lu\n"
+                "nonvoluntary_ctxt_switches:\t%lu\n",
+                totals.voluntarySwitches, totals.involuntarySwitches);
+            f += line;
+            break;
+    }
+
+    return f;
+}
+
 ConstantFile::ConstantFile(
     String name, const char *value, size_t size, size_t inode,
     Filesystem *pParentFS, File *pParent)
@@ -418,6 +1018,23 @@ bool ProcFs::initialise(Disk *pDisk)
     UptimeFile *uptime = new UptimeFile(getNextInode(), this, m_pRoot);
     m_pRoot->addEntry(uptime->getName(), uptime);
 
+    ProfileFile *profile = new ProfileFile(getNextInode(), this, m_pRoot);
+    m_pRoot->addEntry(profile->getName(), profile);
+
+    VmstatFile *vmstat = new VmstatFile(getNextInode(), this, m_pRoot);
+    m_pRoot->addEntry(vmstat->getName(), vmstat);
+
+    SchedulerStatisticsFile::Type statisticsTypes[] = {
+        SchedulerStatisticsFile::Stat, SchedulerStatisticsFile::Schedstat,
+        SchedulerStatisticsFile::Interrupts,
+        SchedulerStatisticsFile::SchedDebug};
+    for (auto type : statisticsTypes)
+    {
+        SchedulerStatisticsFile *pStatistics =
+            new SchedulerStatisticsFile(type, getNextInode(), this, m_pRoot);
+        m_pRoot->addEntry(pStatistics->getName(), pStatistics);
+    }
+
     static String fs("\text2\nnodev\tproc\nnodev\ttmpfs\n");
     ConstantFile *pFilesystems = new ConstantFile(
         String("filesystems"), fs.cstr(), fs.length(), getNextInode(), this, m_pRoot);
@@ -582,7 +1199,17 @@ void ProcFs::addProcess(PosixProcess *proc)
     m_pProcessDirectories.insert(pid, procDir);
     m_pRoot->addEntry(procDir->getName(), procDir);
 
-    /// \todo add some info to the directory...
+    ProcessStatisticsFile::Type statisticsTypes[] = {
+        ProcessStatisticsFile::Stat, ProcessStatisticsFile::Schedstat,
+        ProcessStatisticsFile::Status};
+    for (auto type : statisticsTypes)
+    {
+        ProcessStatisticsFile *pStatistics =
+            new ProcessStatisticsFile(type, pid, getNextInode(), this, procDir);
+        procDir->addEntry(pStatistics->getName(), pStatistics);
+    }
+
+    /// \todo add some more info to the directory...
 }
 
 void ProcFs::removeProcess(PosixProcess *proc)
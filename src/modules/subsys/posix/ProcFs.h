@@ -138,6 +138,139 @@ class UptimeFile : public File
     }
 };
 
+/** Exports the kernel's SamplingProfiler. Reading yields an instrumentation
+ * stream for the host 'instrument' tool; writing "start [interval]", "stop"
+ * or "clear" controls the profiler. */
+class ProfileFile : public File
+{
+  public:
+    ProfileFile(size_t inode, Filesystem *pParentFS, File *pParent);
+    ~ProfileFile();
+
+    virtual uint64_t readBytewise(
+        uint64_t location, uint64_t size, uintptr_t buffer,
+        bool bCanBlock = true);
+    virtual uint64_t writeBytewise(
+        uint64_t location, uint64_t size, uintptr_t buffer,
+        bool bCanBlock = true);
+
+    virtual size_t getSize();
+
+  private:
+    /** Takes a fresh copy of the profiler's samples. */
+    void refresh();
+
+    uint8_t *m_pSnapshot;
+    size_t m_SnapshotSize;
+    Mutex m_Lock;
+
+    virtual bool isBytewise() const
+    {
+        return true;
+    }
+};
+
+/** Virtual memory statistics, including reclaim activity, in the format of
+ * Linux's /proc/vmstat. */
+class VmstatFile : public File
+{
+  public:
+    VmstatFile(size_t inode, Filesystem *pParentFS, File *pParent);
+    ~VmstatFile();
+
+    virtual uint64_t readBytewise(
+        uint64_t location, uint64_t size, uintptr_t buffer,
+        bool bCanBlock = true);
+    virtual uint64_t writeBytewise(
+        uint64_t location, uint64_t size, uintptr_t buffer,
+        bool bCanBlock = true);
+
+    virtual size_t getSize();
+
+  private:
+    String generateString();
+
+    virtual bool isBytewise() const
+    {
+        return true;
+    }
+};
+
+/** System-wide scheduler and interrupt statistics, regenerated on each read
+ * in the Linux format of the same name. */
+class SchedulerStatisticsFile : public File
+{
+  public:
+    enum Type
+    {
+        Stat,        ///< /proc/stat
+        Schedstat,   ///< /proc/schedstat
+        Interrupts,  ///< /proc/interrupts
+        SchedDebug,  ///< /proc/sched_debug, for run queue lengths
+    };
+
+    SchedulerStatisticsFile(
+        Type type, size_t inode, Filesystem *pParentFS, File *pParent);
+    ~SchedulerStatisticsFile();
+
+    virtual uint64_t readBytewise(
+        uint64_t location, uint64_t size, uintptr_t buffer,
+        bool bCanBlock = true);
+    virtual uint64_t writeBytewise(
+        uint64_t location, uint64_t size, uintptr_t buffer,
+        bool bCanBlock = true);
+
+    virtual size_t getSize();
+
+  private:
+    String generateString();
+
+    Type m_Type;
+
+    virtual bool isBytewise() const
+    {
+        return true;
+    }
+};
+
+/** Scheduler statistics for one process, found in its /proc/<pid>
+ * directory. Thread counters are summed over the process' threads. */
+class ProcessStatisticsFile : public File
+{
+  public:
+    enum Type
+    {
+        Stat,       ///< /proc/<pid>/stat
+        Schedstat,  ///< /proc/<pid>/schedstat
+        Status,     ///< /proc/<pid>/status
+    };
+
+    ProcessStatisticsFile(
+        Type type, size_t pid, size_t inode, Filesystem *pParentFS,
+        File *pParent);
+    ~ProcessStatisticsFile();
+
+    virtual uint64_t readBytewise(
+        uint64_t location, uint64_t size, uintptr_t buffer,
+        bool bCanBlock = true);
+    virtual uint64_t writeBytewise(
+        uint64_t location, uint64_t size, uintptr_t buffer,
+        bool bCanBlock = true);
+
+    virtual size_t getSize();
+
+  private:
+    String generateString();
+
+    Type m_Type;
+    size_t m_Pid;
+
+    virtual bool isBytewise() const
+    {
+        return true;
+    }
+};
+
 class ConstantFile : public File
 {
   public:
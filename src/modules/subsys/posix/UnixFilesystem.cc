@@ -28,6 +28,8 @@
 
 String UnixFilesystem::m_VolumeLabel("unix");
 
+ObjectPool<UnixSocket::PendingDatagram, 64> UnixSocket::m_DatagramPool;
+
 UnixSocket::UnixSocket(
     const String &name, Filesystem *pFs, File *pParent, UnixSocket *other,
     SocketType type)
@@ -68,6 +70,19 @@ UnixSocket::~UnixSocket()
             m_pOther->m_State = Inactive;
         }
     }
+    else
+    {
+        // clean up any datagrams nobody received
+        while (m_Datagrams.dataReady())
+        {
+            DatagramBuffer::ReadResult result = m_Datagrams.read();
+            if (result.hasError())
+            {
+                break;
+            }
+            releaseDatagram(result.value());
+        }
+    }
 
     // remove name on disk that points to us
     if (getName().length() > 0)
@@ -166,17 +181,15 @@ uint64_t UnixSocket::recvfrom(
         // TODO: set an error
         return 0;
     }
-    struct buf *b = result.value();
+    PendingDatagram *b = result.value();
     if (size > b->len)
         size = b->len;
     MemoryCopy(reinterpret_cast<void *>(buffer), b->pBuffer, size);
-    if (b->remotePath)
+    if (b->remotePathLen)
     {
         from.assign(b->remotePath, b->remotePathLen);
-        delete[] b->remotePath;
     }
-    delete[] b->pBuffer;
-    delete b;
+    releaseDatagram(b);
 
     return size;
 }
@@ -210,24 +223,41 @@ uint64_t UnixSocket::writeBytewise(
         return 0;
     }
 
-    struct buf *b = new struct buf;
-    b->pBuffer = new char[size];
+    PendingDatagram *b = m_DatagramPool.allocate();
+    b->pBuffer = b->inlineBuffer;
+    if (size > UNIX_DGRAM_INLINE_SIZE)
+    {
+        b->pBuffer = new uint8_t[size];
+    }
     MemoryCopy(b->pBuffer, reinterpret_cast<void *>(buffer), size);
     b->len = size;
-    b->remotePath = 0;
+    b->remotePathLen = 0;
     if (location)
     {
-        b->remotePath = new char[255];
-        StringCopyN(b->remotePath, reinterpret_cast<char *>(location), 255);
+        StringCopyN(
+            b->remotePath, reinterpret_cast<char *>(location), MAX_UNIX_PATH);
+        b->remotePath[MAX_UNIX_PATH - 1] = 0;
         b->remotePathLen = StringLength(b->remotePath);
     }
     m_Datagrams.write(b);
 
     dataChanged();
 
+    // Wake up anything polling this socket.
+    m_Stream.notifyMonitors();
+
     return size;
 }
 
+void UnixSocket::releaseDatagram(PendingDatagram *pDatagram)
+{
+    if (pDatagram->pBuffer != pDatagram->inlineBuffer)
+    {
+        delete[] pDatagram->pBuffer;
+    }
+    m_DatagramPool.deallocate(pDatagram);
+}
+
 bool UnixSocket::bind(UnixSocket *other, bool block)
 {
     if (other->m_pOther)
@@ -24,8 +24,9 @@
 #include "modules/system/vfs/File.h"
 #include "modules/system/vfs/Filesystem.h"
 
-#include "pedigree/kernel/utilities/Buffer.h"
+#include "pedigree/kernel/utilities/ObjectPool.h"
 #include "pedigree/kernel/utilities/RingBuffer.h"
+#include "pedigree/kernel/utilities/SpscRing.h"
 
 #include <sys/socket.h>
 
@@ -33,6 +34,13 @@ class Mutex;
 
 #define MAX_UNIX_DGRAM_BACKLOG 65536
 #define MAX_UNIX_STREAM_QUEUE 65536
+#define MAX_UNIX_PATH 255
+
+// Datagrams up to this size are stored without a separate allocation.
+#define UNIX_DGRAM_INLINE_SIZE 512
+
+// Largest datagram that can be sent in one go.
+#define MAX_UNIX_DGRAM_SIZE 65536
 
 /**
  * UnixFilesystem: UNIX sockets.
@@ -209,7 +217,7 @@ class UnixSocket : public File
     }
 
   private:
-    typedef Buffer<uint8_t, true> UnixSocketStream;
+    typedef SpscRing UnixSocketStream;
 
     void setCreds();
 
@@ -218,14 +226,18 @@ class UnixSocket : public File
         return true;
     }
 
-    struct buf
+    struct PendingDatagram
     {
-        char *pBuffer;
-        uint64_t len;
-        char *remotePath;  // Path of the socket that dumped data here, if any.
-        size_t remotePathLen;
+        uint8_t *pBuffer;  // Either inlineBuffer or a heap allocation.
+        size_t len;
+        char remotePath[MAX_UNIX_PATH];  // Socket that dumped data here.
+        size_t remotePathLen;            // Zero if there was no sender.
+        uint8_t inlineBuffer[UNIX_DGRAM_INLINE_SIZE];
     };
 
+    // Returns a datagram (and its buffer, if any) to the pool.
+    static void releaseDatagram(PendingDatagram *pDatagram);
+
     SocketType m_Type;
     SocketState m_State;
 
@@ -234,15 +246,18 @@ class UnixSocket : public File
     // Note: "servers" own the actual UNIX socket address, while clients get a
     // virtual address to track their existence (or are bound to a specific
     // name themselves).
-    typedef RingBuffer<struct buf *> DatagramBuffer;
+    typedef RingBuffer<PendingDatagram *> DatagramBuffer;
     DatagramBuffer m_Datagrams;
 
+    // Datagrams are recycled rather than going back to the heap each time.
+    static ObjectPool<PendingDatagram, 64> m_DatagramPool;
+
     // For stream sockets.
 
     // Other side of the connection (for stream sockets).
     UnixSocket *m_pOther;
 
-    // Data stream.
+    // Data stream. Also holds the poll()/select() waiters for all types.
     UnixSocketStream m_Stream;
 
     // List of sockets pending accept() on this socket.
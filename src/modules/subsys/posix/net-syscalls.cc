@@ -85,6 +85,26 @@ static bool isSaneSocket(FileDescriptor *f, bool is_create = false)
     return true;
 }
 
+/// Adds up the buffers making up a single datagram, failing with EMSGSIZE if
+/// the total is more than any datagram can carry.
+static bool datagramLength(const struct msghdr *msghdr, size_t &total)
+{
+    total = 0;
+    for (size_t i = 0; i < static_cast<size_t>(msghdr->msg_iovlen); ++i)
+    {
+        size_t len = msghdr->msg_iov[i].iov_len;
+        if (len > (MAX_UNIX_DGRAM_SIZE - total))
+        {
+            SYSCALL_ERROR(MessageTooLong);
+            return false;
+        }
+
+        total += len;
+    }
+
+    return true;
+}
+
 static err_t sockaddrToIpaddr(
     const struct sockaddr_storage *saddr, uint16_t &port, ip_addr_t *result,
     bool isbind = true)
@@ -1657,23 +1677,57 @@ ssize_t UnixSocketSyscalls::sendto_msg(const struct msghdr *msghdr)
 
     N_NOTICE(" -> transmitting!");
 
-    uint64_t numWritten = 0;
-    for (size_t i = 0; i < static_cast<size_t>(msghdr->msg_iovlen); ++i)
+    uintptr_t localPath =
+        reinterpret_cast<uintptr_t>(static_cast<const char *>(m_LocalPath));
+    size_t iovlen = msghdr->msg_iovlen;
+
+    size_t total = 0;
+    if ((getType() != SOCK_STREAM) && !datagramLength(msghdr, total))
     {
-        void *buffer = msghdr->msg_iov[i].iov_base;
-        size_t bufferlen = msghdr->msg_iov[i].iov_len;
+        N_NOTICE(" -> datagram is too long");
+        return -1;
+    }
 
-        uint64_t thisWrite = remote->write(
-            reinterpret_cast<uintptr_t>(static_cast<const char *>(m_LocalPath)),
-            bufferlen, reinterpret_cast<uintptr_t>(buffer), isBlocking());
+    uint64_t numWritten = 0;
+    if (getType() != SOCK_STREAM && iovlen > 1)
+    {
+        // Each message is exactly one datagram, so gather it up first.
 
-        if (!thisWrite)
+        uint8_t *gathered = new uint8_t[total];
+        size_t offset = 0;
+        for (size_t i = 0; i < iovlen; ++i)
         {
-            // eof or some other similar condition
-            break;
+            MemoryCopy(
+                &gathered[offset], msghdr->msg_iov[i].iov_base,
+                msghdr->msg_iov[i].iov_len);
+            offset += msghdr->msg_iov[i].iov_len;
         }
 
-        numWritten += thisWrite;
+        numWritten = remote->write(
+            localPath, total, reinterpret_cast<uintptr_t>(gathered),
+            isBlocking());
+
+        delete[] gathered;
+    }
+    else
+    {
+        // Single buffers (the usual case) go straight into the socket.
+        for (size_t i = 0; i < iovlen; ++i)
+        {
+            void *buffer = msghdr->msg_iov[i].iov_base;
+            size_t bufferlen = msghdr->msg_iov[i].iov_len;
+
+            uint64_t thisWrite = remote->write(
+                localPath, bufferlen, reinterpret_cast<uintptr_t>(buffer),
+                isBlocking());
+
+            numWritten += thisWrite;
+            if (thisWrite < bufferlen)
+            {
+                // eof, or the socket is full and we can't block
+                break;
+            }
+        }
     }
     if (!numWritten)
     {
@@ -1693,22 +1747,69 @@ ssize_t UnixSocketSyscalls::sendto_msg(const struct msghdr *msghdr)
 ssize_t UnixSocketSyscalls::recvfrom_msg(struct msghdr *msghdr)
 {
     String remote;
+    size_t iovlen = msghdr->msg_iovlen;
+
     uint64_t numRead = 0;
-    for (size_t i = 0; i < static_cast<size_t>(msghdr->msg_iovlen); ++i)
+    if (getType() != SOCK_STREAM && iovlen > 1)
     {
-        void *buffer = msghdr->msg_iov[i].iov_base;
-        size_t bufferlen = msghdr->msg_iov[i].iov_len;
+        // Receive the whole datagram at once and scatter it afterwards. No
+        // datagram is larger than a send can make it, so neither is the
+        // buffer.
+        size_t total = 0;
+        for (size_t i = 0; i < iovlen; ++i)
+        {
+            size_t len = msghdr->msg_iov[i].iov_len;
+            if (len >= (MAX_UNIX_DGRAM_SIZE - total))
+            {
+                total = MAX_UNIX_DGRAM_SIZE;
+                break;
+            }
 
-        uint64_t thisRead = m_Socket->recvfrom(
-            bufferlen, reinterpret_cast<uintptr_t>(buffer), isBlocking(),
+            total += len;
+        }
+
+        uint8_t *gathered = new uint8_t[total];
+        numRead = m_Socket->recvfrom(
+            total, reinterpret_cast<uintptr_t>(gathered), isBlocking(),
             remote);
-        if (!thisRead)
+
+        size_t offset = 0;
+        for (size_t i = 0; i < iovlen && offset < numRead; ++i)
         {
-            // eof or some other similar condition
-            break;
+            size_t len = msghdr->msg_iov[i].iov_len;
+            if (len > (numRead - offset))
+            {
+                len = numRead - offset;
+            }
+
+            MemoryCopy(msghdr->msg_iov[i].iov_base, &gathered[offset], len);
+            offset += len;
         }
 
-        numRead += thisRead;
+        delete[] gathered;
+    }
+    else
+    {
+        // Only wait for the first buffer; the rest just take whatever else
+        // has already arrived.
+        bool block = isBlocking();
+        for (size_t i = 0; i < iovlen; ++i)
+        {
+            void *buffer = msghdr->msg_iov[i].iov_base;
+            size_t bufferlen = msghdr->msg_iov[i].iov_len;
+
+            uint64_t thisRead = m_Socket->recvfrom(
+                bufferlen, reinterpret_cast<uintptr_t>(buffer), block, remote);
+
+            numRead += thisRead;
+            if (thisRead < bufferlen)
+            {
+                // eof, or nothing more to read right now
+                break;
+            }
+
+            block = false;
+        }
     }
 
     if (numRead && msghdr->msg_name)
@@ -1716,7 +1817,15 @@ ssize_t UnixSocketSyscalls::recvfrom_msg(struct msghdr *msghdr)
         struct sockaddr_un *un =
             reinterpret_cast<struct sockaddr_un *>(msghdr->msg_name);
         un->sun_family = AF_UNIX;
-        StringCopy(un->sun_path, remote.cstr());
+        // An unnamed sender has an empty (null) path.
+        if (remote.length())
+        {
+            StringCopy(un->sun_path, remote.cstr());
+        }
+        else
+        {
+            un->sun_path[0] = 0;
+        }
         msghdr->msg_namelen = sizeof(sa_family_t) + remote.length();
     }
 
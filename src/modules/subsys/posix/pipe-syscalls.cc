@@ -33,10 +33,151 @@
 #include "pedigree/kernel/process/Process.h"
 #include "pedigree/kernel/processor/Processor.h"
 
+#include "net-syscalls.h"
+
 #include <fcntl.h>
+#include <limits.h>
+#include <sys/uio.h>
+
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
 
 typedef Tree<size_t, FileDescriptor *> FdMap;
 
+/// The end of a splice that isn't a pipe: a file at an offset, or a socket.
+struct SpliceEndpoint
+{
+    SpliceEndpoint(FileDescriptor *fd, off_t *off, bool canBlock)
+        : pFd(fd), offset(off ? *off : fd->offset), bCanBlock(canBlock),
+          bReceived(false), error(0)
+    {
+    }
+
+    FileDescriptor *pFd;
+    uint64_t offset;
+    bool bCanBlock;
+    /// Sockets are read at most once per splice so we don't block waiting
+    /// for more data once we've got some.
+    bool bReceived;
+    /// Error returned by the socket, if any.
+    ssize_t error;
+};
+
+static size_t fileToPage(void *param, uint8_t *data, size_t length)
+{
+    SpliceEndpoint *pEndpoint = reinterpret_cast<SpliceEndpoint *>(param);
+    uint64_t n = pEndpoint->pFd->file->read(
+        pEndpoint->offset, length, reinterpret_cast<uintptr_t>(data),
+        pEndpoint->bCanBlock);
+    pEndpoint->offset += n;
+    return n;
+}
+
+static size_t pageToFile(void *param, uint8_t *data, size_t length)
+{
+    SpliceEndpoint *pEndpoint = reinterpret_cast<SpliceEndpoint *>(param);
+    uint64_t n = pEndpoint->pFd->file->write(
+        pEndpoint->offset, length, reinterpret_cast<uintptr_t>(data),
+        pEndpoint->bCanBlock);
+    pEndpoint->offset += n;
+    return n;
+}
+
+static size_t socketToPage(void *param, uint8_t *data, size_t length)
+{
+    SpliceEndpoint *pEndpoint = reinterpret_cast<SpliceEndpoint *>(param);
+    if (pEndpoint->bReceived)
+    {
+        return 0;
+    }
+    pEndpoint->bReceived = true;
+
+    ssize_t n = pEndpoint->pFd->networkImpl->recvfrom(
+        data, length, 0, nullptr, nullptr);
+    if (n < 0)
+    {
+        pEndpoint->error = n;
+        return 0;
+    }
+
+    return n;
+}
+
+static size_t pageToSocket(void *param, uint8_t *data, size_t length)
+{
+    SpliceEndpoint *pEndpoint = reinterpret_cast<SpliceEndpoint *>(param);
+    ssize_t n =
+        pEndpoint->pFd->networkImpl->sendto(data, length, 0, nullptr, 0);
+    if (n < 0)
+    {
+        pEndpoint->error = n;
+        return 0;
+    }
+
+    return n;
+}
+
+static FileDescriptor *lookupDescriptor(int fd)
+{
+    Process *pProcess =
+        Processor::information().getCurrentThread()->getParent();
+    PosixSubsystem *pSubsystem =
+        static_cast<PosixSubsystem *>(pProcess->getSubsystem());
+    if (!pSubsystem)
+    {
+        ERROR("No subsystem for the process!");
+        return 0;
+    }
+
+    return pSubsystem->getFileDescriptor(fd);
+}
+
+static bool isPipeDescriptor(FileDescriptor *pFd)
+{
+    return !pFd->networkImpl && (pFd->file->isPipe() || pFd->file->isFifo());
+}
+
+static bool isReadable(FileDescriptor *pFd)
+{
+    return !(pFd->flflags & O_WRONLY);
+}
+
+static bool isWritable(FileDescriptor *pFd)
+{
+    return (pFd->flflags & (O_WRONLY | O_RDWR)) != 0;
+}
+
+static bool isNonBlocking(FileDescriptor *pFd)
+{
+    return (pFd->flflags & O_NONBLOCK) == O_NONBLOCK;
+}
+
+/// Works out what a splice or tee that moved nothing should return.
+static ssize_t nothingMoved(Pipe *pSource, Pipe *pDest, bool bCanBlock)
+{
+    if (pDest && !pDest->getReaderCount())
+    {
+        F_NOTICE("  -> destination pipe has no readers");
+        Thread *pThread = Processor::information().getCurrentThread();
+        Subsystem *pSubsystem = pThread->getParent()->getSubsystem();
+        SYSCALL_ERROR(BrokenPipe);
+        pSubsystem->threadException(pThread, Subsystem::Pipe);
+        return -1;
+    }
+
+    // An empty pipe with no writers is EOF. Anything else only comes back
+    // empty handed if we weren't allowed to wait.
+    if (!bCanBlock && !(pSource && !pSource->getWriterCount()))
+    {
+        F_NOTICE("  -> would block");
+        SYSCALL_ERROR(NoMoreProcesses);
+        return -1;
+    }
+
+    return 0;
+}
+
 int posix_pipe(int filedes[2])
 {
     if (!PosixSubsystem::checkAddress(
@@ -79,3 +220,264 @@ int posix_pipe(int filedes[2])
 
     return 0;
 }
+
+ssize_t posix_splice(
+    int fd_in, off_t *off_in, int fd_out, off_t *off_out, size_t len,
+    unsigned int flags)
+{
+    F_NOTICE(
+        "splice(" << fd_in << ", " << fd_out << ", " << len << ", " << flags
+                  << ")");
+
+    FileDescriptor *pIn = lookupDescriptor(fd_in);
+    FileDescriptor *pOut = lookupDescriptor(fd_out);
+    if (!pIn || !pOut || !isReadable(pIn) || !isWritable(pOut))
+    {
+        SYSCALL_ERROR(BadFileDescriptor);
+        return -1;
+    }
+
+    bool bInPipe = isPipeDescriptor(pIn);
+    bool bOutPipe = isPipeDescriptor(pOut);
+    bool bInDirectory = !pIn->networkImpl && pIn->file->isDirectory();
+    bool bOutDirectory = !pOut->networkImpl && pOut->file->isDirectory();
+    if (!(bInPipe || bOutPipe) || bInDirectory || bOutDirectory)
+    {
+        F_NOTICE("  -> need a pipe and a file or socket");
+        SYSCALL_ERROR(InvalidArgument);
+        return -1;
+    }
+
+    // Pipes and sockets have no offset to speak of.
+    if ((off_in && (bInPipe || pIn->networkImpl)) ||
+        (off_out && (bOutPipe || pOut->networkImpl)))
+    {
+        SYSCALL_ERROR(IllegalSeek);
+        return -1;
+    }
+
+    if ((off_in && !PosixSubsystem::checkAddress(
+                       reinterpret_cast<uintptr_t>(off_in), sizeof(off_t),
+                       PosixSubsystem::SafeWrite)) ||
+        (off_out && !PosixSubsystem::checkAddress(
+                        reinterpret_cast<uintptr_t>(off_out), sizeof(off_t),
+                        PosixSubsystem::SafeWrite)))
+    {
+        F_NOTICE("  -> invalid address");
+        SYSCALL_ERROR(InvalidArgument);
+        return -1;
+    }
+
+    if (!len)
+    {
+        return 0;
+    }
+
+    bool bCanBlock = !(flags & SPLICE_F_NONBLOCK) && !isNonBlocking(pIn) &&
+                     !isNonBlocking(pOut);
+
+    Pipe *pSource = bInPipe ? Pipe::fromFile(pIn->file) : 0;
+    Pipe *pDest = bOutPipe ? Pipe::fromFile(pOut->file) : 0;
+
+    ssize_t result = 0;
+    if (pSource && pDest)
+    {
+        if (pSource == pDest)
+        {
+            SYSCALL_ERROR(InvalidArgument);
+            return -1;
+        }
+
+        result = pSource->splice(pDest, len, bCanBlock);
+    }
+    else if (pDest)
+    {
+        SpliceEndpoint endpoint(pIn, off_in, bCanBlock);
+        result = pDest->fill(
+            pIn->networkImpl ? socketToPage : fileToPage, &endpoint, len,
+            bCanBlock);
+        if (!result && endpoint.error)
+        {
+            return endpoint.error;
+        }
+
+        if (off_in)
+        {
+            *off_in = endpoint.offset;
+        }
+        else if (!pIn->networkImpl)
+        {
+            pIn->offset = endpoint.offset;
+        }
+
+        // A file at EOF fills nothing even though the pipe had room.
+        if (!result && pDest->select(true, 0))
+        {
+            return 0;
+        }
+    }
+    else
+    {
+        SpliceEndpoint endpoint(pOut, off_out, bCanBlock);
+        result = pSource->drain(
+            pOut->networkImpl ? pageToSocket : pageToFile, &endpoint, len,
+            bCanBlock);
+        if (!result && endpoint.error)
+        {
+            return endpoint.error;
+        }
+
+        if (off_out)
+        {
+            *off_out = endpoint.offset;
+        }
+        else if (!pOut->networkImpl)
+        {
+            pOut->offset = endpoint.offset;
+        }
+    }
+
+    F_NOTICE("  -> splice moved " << result);
+
+    if (!result)
+    {
+        return nothingMoved(pSource, pDest, bCanBlock);
+    }
+
+    return result;
+}
+
+ssize_t posix_tee(int fd_in, int fd_out, size_t len, unsigned int flags)
+{
+    F_NOTICE(
+        "tee(" << fd_in << ", " << fd_out << ", " << len << ", " << flags
+               << ")");
+
+    FileDescriptor *pIn = lookupDescriptor(fd_in);
+    FileDescriptor *pOut = lookupDescriptor(fd_out);
+    if (!pIn || !pOut || !isReadable(pIn) || !isWritable(pOut))
+    {
+        SYSCALL_ERROR(BadFileDescriptor);
+        return -1;
+    }
+
+    if (!isPipeDescriptor(pIn) || !isPipeDescriptor(pOut) ||
+        pIn->file == pOut->file)
+    {
+        F_NOTICE("  -> tee needs two different pipes");
+        SYSCALL_ERROR(InvalidArgument);
+        return -1;
+    }
+
+    if (!len)
+    {
+        return 0;
+    }
+
+    bool bCanBlock = !(flags & SPLICE_F_NONBLOCK) && !isNonBlocking(pIn) &&
+                     !isNonBlocking(pOut);
+
+    Pipe *pSource = Pipe::fromFile(pIn->file);
+    Pipe *pDest = Pipe::fromFile(pOut->file);
+
+    ssize_t result = pSource->tee(pDest, len, bCanBlock);
+
+    F_NOTICE("  -> tee duplicated " << result);
+
+    if (!result)
+    {
+        return nothingMoved(pSource, pDest, bCanBlock);
+    }
+
+    return result;
+}
+
+ssize_t posix_vmsplice(
+    int fd, const struct iovec *iov, size_t nr_segs, unsigned int flags)
+{
+    F_NOTICE(
+        "vmsplice(" << fd << ", <iov>, " << nr_segs << ", " << flags << ")");
+
+    // Also keeps the size of the iovec array below from overflowing.
+    if (nr_segs > IOV_MAX)
+    {
+        F_NOTICE("  -> too many segments");
+        SYSCALL_ERROR(InvalidArgument);
+        return -1;
+    }
+
+    if (!PosixSubsystem::checkAddress(
+            reinterpret_cast<uintptr_t>(iov), sizeof(struct iovec) * nr_segs,
+            PosixSubsystem::SafeRead))
+    {
+        F_NOTICE("  -> invalid address");
+        SYSCALL_ERROR(InvalidArgument);
+        return -1;
+    }
+
+    FileDescriptor *pFd = lookupDescriptor(fd);
+    if (!pFd)
+    {
+        SYSCALL_ERROR(BadFileDescriptor);
+        return -1;
+    }
+
+    if (!isPipeDescriptor(pFd))
+    {
+        SYSCALL_ERROR(InvalidArgument);
+        return -1;
+    }
+
+    // The direction is implied by which end of the pipe we were handed.
+    bool bWriting = isWritable(pFd);
+    bool bCanBlock = !(flags & SPLICE_F_NONBLOCK) && !isNonBlocking(pFd);
+    Pipe *pPipe = Pipe::fromFile(pFd->file);
+
+    ssize_t result = 0;
+    for (size_t i = 0; i < nr_segs; ++i)
+    {
+        uintptr_t base = reinterpret_cast<uintptr_t>(iov[i].iov_base);
+        size_t length = iov[i].iov_len;
+        if (!length)
+        {
+            continue;
+        }
+
+        if (!PosixSubsystem::checkAddress(
+                base, length,
+                bWriting ? PosixSubsystem::SafeRead
+                         : PosixSubsystem::SafeWrite))
+        {
+            F_NOTICE("  -> invalid address in iov[" << i << "]");
+            if (result)
+            {
+                break;
+            }
+            SYSCALL_ERROR(InvalidArgument);
+            return -1;
+        }
+
+        // User pages are copied into (or out of) the pipe's pages directly,
+        // with no intermediate buffer.
+        uint64_t n = bWriting ? pPipe->write(0, length, base, bCanBlock)
+                              : pPipe->read(0, length, base, bCanBlock);
+        result += n;
+        if (n < length)
+        {
+            break;
+        }
+
+        // Only the first segment may wait.
+        bCanBlock = false;
+    }
+
+    F_NOTICE("  -> vmsplice moved " << result);
+
+    if (!result)
+    {
+        return nothingMoved(
+            bWriting ? 0 : pPipe, bWriting ? pPipe : 0, bCanBlock);
+    }
+
+    return result;
+}
@@ -20,6 +20,24 @@
 #ifndef PIPE_SYSCALLS_H
 #define PIPE_SYSCALLS_H
 
+#include <sys/types.h>
+
+struct iovec;
+
+#ifndef SPLICE_F_MOVE
+#define SPLICE_F_MOVE 1
+#define SPLICE_F_NONBLOCK 2
+#define SPLICE_F_MORE 4
+#define SPLICE_F_GIFT 8
+#endif
+
 int posix_pipe(int filedes[2]);
 
+ssize_t posix_splice(
+    int fd_in, off_t *off_in, int fd_out, off_t *off_out, size_t len,
+    unsigned int flags);
+ssize_t posix_tee(int fd_in, int fd_out, size_t len, unsigned int flags);
+ssize_t posix_vmsplice(
+    int fd, const struct iovec *iov, size_t nr_segs, unsigned int flags);
+
 #endif
@@ -22,7 +22,9 @@
 #include "pedigree/kernel/process/PerProcessorScheduler.h"
 #include "pedigree/kernel/process/Process.h"
 #include "pedigree/kernel/process/Scheduler.h"
+#include "pedigree/kernel/processor/PhysicalMemoryManager.h"
 #include "pedigree/kernel/syscallError.h"
+#include "pedigree/kernel/time/Time.h"
 #include "pedigree/kernel/utilities/List.h"
 #include "pedigree/kernel/utilities/Tree.h"
 #include <pthread-syscalls.h>
@@ -38,18 +40,471 @@
 #define FUTEX_UNLOCK_PI 7
 #define FUTEX_TRYLOCK_PI 8
 #define FUTEX_WAIT_BITSET 9
+#define FUTEX_WAKE_BITSET 10
 #define FUTEX_PRIVATE 128
 #define FUTEX_CLOCK_REALTIME 256
 
+#define FUTEX_BITSET_MATCH_ANY 0xFFFFFFFFU
+
+// FUTEX_WAKE_OP operations and comparisons.
+#define FUTEX_OP_SET 0
+#define FUTEX_OP_ADD 1
+#define FUTEX_OP_OR 2
+#define FUTEX_OP_ANDN 3
+#define FUTEX_OP_XOR 4
+#define FUTEX_OP_OPARG_SHIFT 8
+
+#define FUTEX_OP_CMP_EQ 0
+#define FUTEX_OP_CMP_NE 1
+#define FUTEX_OP_CMP_LT 2
+#define FUTEX_OP_CMP_LE 3
+#define FUTEX_OP_CMP_GT 4
+#define FUTEX_OP_CMP_GE 5
+
+/// Number of hash buckets in the futex table.
+#define FUTEX_HASH_BUCKETS 256
+
 extern "C" {
 extern void pthread_stub();
 extern char pthread_stub_end;
 }
 
-static Tree<int *, List<Thread *> *> g_futexes;
+/**
+ * Identifies a futex. Private futexes are keyed by address space and virtual
+ * address; shared futexes by physical address (with a null address space) so
+ * that every process mapping the page finds the same waiters.
+ */
+struct FutexKey
+{
+    FutexKey() : space(0), address(0)
+    {
+    }
+
+    bool operator==(const FutexKey &other) const
+    {
+        return space == other.space && address == other.address;
+    }
+
+    uintptr_t space;
+    uintptr_t address;
+};
+
+/** A thread blocked on a futex. Lives on the waiting thread's stack. */
+struct FutexWaiter
+{
+    FutexWaiter() : key(), bitset(FUTEX_BITSET_MATCH_ANY), woken(false), sem(0)
+    {
+    }
+
+    /// Changed by requeue operations (with both bucket locks held).
+    FutexKey key;
+    uint32_t bitset;
+    /// Set by the waker, with the bucket lock held, before releasing sem.
+    bool woken;
+    Semaphore sem;
+};
+
+struct FutexBucket
+{
+    /// Not interruptible - this only ever protects short critical sections.
+    FutexBucket() : lock(1, false), waiters()
+    {
+    }
+
+    Semaphore lock;
+    List<FutexWaiter *> waiters;
+};
+
+static FutexBucket g_FutexBuckets[FUTEX_HASH_BUCKETS];
+
+static FutexBucket &futexBucket(const FutexKey &key)
+{
+    uintptr_t h = (key.address >> 2) ^ (key.space >> 6);
+    h *= 0x9E3779B1U;
+    return g_FutexBuckets[(h >> 8) % FUTEX_HASH_BUCKETS];
+}
+
+/** Validates a futex word and works out its key. */
+static bool futexKey(int *uaddr, bool bPrivate, FutexKey &key)
+{
+    uintptr_t addr = reinterpret_cast<uintptr_t>(uaddr);
+    if (addr & (sizeof(int) - 1))
+    {
+        SYSCALL_ERROR(InvalidArgument);
+        return false;
+    }
+
+    if (!PosixSubsystem::checkAddress(
+            addr, sizeof(int), PosixSubsystem::SafeRead))
+    {
+        SYSCALL_ERROR(BadAddress);
+        return false;
+    }
+
+    VirtualAddressSpace &va = Processor::information().getVirtualAddressSpace();
+    key.space = reinterpret_cast<uintptr_t>(&va);
+    key.address = addr;
+
+    if (!bPrivate)
+    {
+        // Make sure the page is actually there before asking where it is.
+        volatile int touch = *uaddr;
+        (void) touch;
+
+        void *page = reinterpret_cast<void *>(
+            addr & ~(PhysicalMemoryManager::getPageSize() - 1));
+        if (va.isMapped(page))
+        {
+            physical_uintptr_t phys = 0;
+            size_t flags = 0;
+            va.getMapping(page, phys, flags);
+
+            key.space = 0;
+            key.address =
+                phys + (addr & (PhysicalMemoryManager::getPageSize() - 1));
+        }
+    }
+
+    return true;
+}
+
+/** Locks two buckets in a consistent order so requeues can't deadlock. */
+static void lockBuckets(FutexBucket &a, FutexBucket &b)
+{
+    if (&a == &b)
+    {
+        a.lock.acquire();
+    }
+    else if (&a < &b)
+    {
+        a.lock.acquire();
+        b.lock.acquire();
+    }
+    else
+    {
+        b.lock.acquire();
+        a.lock.acquire();
+    }
+}
+
+static void unlockBuckets(FutexBucket &a, FutexBucket &b)
+{
+    a.lock.release();
+    if (&a != &b)
+    {
+        b.lock.release();
+    }
+}
+
+/** Wakes up to \p n waiters on \p key. The bucket must be locked. */
+static int futexWakeLocked(
+    FutexBucket &bucket, const FutexKey &key, int n, uint32_t bitset)
+{
+    int woken = 0;
+    for (List<FutexWaiter *>::Iterator it = bucket.waiters.begin();
+         it != bucket.waiters.end() && woken < n;)
+    {
+        FutexWaiter *pWaiter = *it;
+        if (!(pWaiter->key == key) || !(pWaiter->bitset & bitset))
+        {
+            ++it;
+            continue;
+        }
+
+        it = bucket.waiters.erase(it);
+        pWaiter->woken = true;
+        pWaiter->sem.release();
+        ++woken;
+    }
+
+    return woken;
+}
+
+/**
+ * Blocks until woken, or until \p timeout nanoseconds pass (Time::Infinity
+ * for no timeout), as long as *uaddr still holds \p val.
+ */
+static int futexWait(
+    int *uaddr, const FutexKey &key, int val, uint32_t bitset,
+    Time::Timestamp timeout)
+{
+    FutexWaiter waiter;
+    waiter.key = key;
+    waiter.bitset = bitset;
+
+    // The value check happens under the bucket lock, and wakers take the same
+    // lock after changing the value, so a wakeup can't be missed.
+    FutexBucket &bucket = futexBucket(key);
+    bucket.lock.acquire();
+    if (*uaddr != val)
+    {
+        bucket.lock.release();
+        PT_NOTICE(" -> value changed");
+        SYSCALL_ERROR(NoMoreProcesses);  // EAGAIN
+        return -1;
+    }
+    else if (!timeout)
+    {
+        bucket.lock.release();
+        SYSCALL_ERROR(TimedOut);
+        return -1;
+    }
+
+    bucket.waiters.pushBack(&waiter);
+    bucket.lock.release();
+
+    size_t timeoutSecs = 0, timeoutUsecs = 0;
+    if (timeout != Time::Infinity)
+    {
+        timeoutSecs = timeout / Time::Multiplier::Second;
+        timeoutUsecs = (timeout % Time::Multiplier::Second) /
+                       Time::Multiplier::Microsecond;
+        if (!(timeoutSecs || timeoutUsecs))
+        {
+            // Zero means forever to the semaphore.
+            timeoutUsecs = 1;
+        }
+    }
+
+    PT_NOTICE(" -> waiting...");
+    Semaphore::SemaphoreResult result =
+        waiter.sem.acquireWithResult(1, timeoutSecs, timeoutUsecs);
+    PT_NOTICE(" -> waiting complete!");
+
+    // Requeues can move us to another bucket, so find (and lock) the one
+    // we're on now before looking at our state.
+    FutexBucket *pBucket;
+    while (true)
+    {
+        pBucket = &futexBucket(waiter.key);
+        pBucket->lock.acquire();
+        if (pBucket == &futexBucket(waiter.key))
+        {
+            break;
+        }
+        pBucket->lock.release();
+    }
+
+    bool bWoken = waiter.woken;
+    if (!bWoken)
+    {
+        for (List<FutexWaiter *>::Iterator it = pBucket->waiters.begin();
+             it != pBucket->waiters.end(); ++it)
+        {
+            if (*it == &waiter)
+            {
+                pBucket->waiters.erase(it);
+                break;
+            }
+        }
+    }
+    pBucket->lock.release();
+
+    if (bWoken)
+    {
+        return 0;
+    }
+
+    if (result.hasError() && result.error() == Semaphore::TimedOut)
+    {
+        SYSCALL_ERROR(TimedOut);
+    }
+    else
+    {
+        SYSCALL_ERROR(Interrupted);
+    }
+    return -1;
+}
+
+static int futexWake(const FutexKey &key, int n, uint32_t bitset)
+{
+    FutexBucket &bucket = futexBucket(key);
+    bucket.lock.acquire();
+    int woken = futexWakeLocked(bucket, key, n, bitset);
+    bucket.lock.release();
+
+    PT_NOTICE(" -> woke " << Dec << woken << " threads.");
+    return woken;
+}
+
+/**
+ * Wakes up to \p nWake waiters on \p key and moves up to \p nRequeue of the
+ * rest to \p key2, so they can be woken one at a time later rather than all
+ * racing for the same lock. If \p pCompare is given, nothing happens unless
+ * it still holds \p compareVal.
+ */
+static int futexRequeue(
+    const FutexKey &key, const FutexKey &key2, int nWake, int nRequeue,
+    int *pCompare, int compareVal)
+{
+    FutexBucket &bucket = futexBucket(key);
+    FutexBucket &bucket2 = futexBucket(key2);
+    lockBuckets(bucket, bucket2);
+
+    if (pCompare && (*pCompare != compareVal))
+    {
+        unlockBuckets(bucket, bucket2);
+        SYSCALL_ERROR(NoMoreProcesses);  // EAGAIN
+        return -1;
+    }
+
+    int woken =
+        futexWakeLocked(bucket, key, nWake, FUTEX_BITSET_MATCH_ANY);
+
+    int requeued = 0;
+    if (!(key == key2))
+    {
+        for (List<FutexWaiter *>::Iterator it = bucket.waiters.begin();
+             it != bucket.waiters.end() && requeued < nRequeue;)
+        {
+            FutexWaiter *pWaiter = *it;
+            if (!(pWaiter->key == key))
+            {
+                ++it;
+                continue;
+            }
+
+            pWaiter->key = key2;
+            if (&bucket != &bucket2)
+            {
+                it = bucket.waiters.erase(it);
+                bucket2.waiters.pushBack(pWaiter);
+            }
+            else
+            {
+                ++it;
+            }
+            ++requeued;
+        }
+    }
+
+    unlockBuckets(bucket, bucket2);
+
+    PT_NOTICE(" -> woke " << Dec << woken << ", requeued " << requeued);
+    return woken + requeued;
+}
+
+/**
+ * Atomically applies an operation to *uaddr2, then wakes waiters on \p key
+ * and, if the old value of *uaddr2 passed the encoded comparison, waiters on
+ * \p key2 too.
+ */
+static int futexWakeOp(
+    const FutexKey &key, const FutexKey &key2, int *uaddr2, int nWake,
+    int nWake2, int encoded)
+{
+    int op = (encoded >> 28) & 0xF;
+    int cmp = (encoded >> 24) & 0xF;
+    // Both arguments are sign-extended 12-bit values.
+    int oparg = (encoded << 8) >> 20;
+    int cmparg = (encoded << 20) >> 20;
+
+    if (op & FUTEX_OP_OPARG_SHIFT)
+    {
+        op &= ~FUTEX_OP_OPARG_SHIFT;
+        if (oparg < 0 || oparg > 31)
+        {
+            SYSCALL_ERROR(InvalidArgument);
+            return -1;
+        }
+        oparg = 1 << oparg;
+    }
+
+    if (op > FUTEX_OP_XOR || cmp > FUTEX_OP_CMP_GE)
+    {
+        SYSCALL_ERROR(Unimplemented);
+        return -1;
+    }
+
+    FutexBucket &bucket = futexBucket(key);
+    FutexBucket &bucket2 = futexBucket(key2);
+    lockBuckets(bucket, bucket2);
+
+    int oldval, newval;
+    do
+    {
+        oldval = *uaddr2;
+        switch (op)
+        {
+            case FUTEX_OP_SET:
+                newval = oparg;
+                break;
+            case FUTEX_OP_ADD:
+                newval = oldval + oparg;
+                break;
+            case FUTEX_OP_OR:
+                newval = oldval | oparg;
+                break;
+            case FUTEX_OP_ANDN:
+                newval = oldval & ~oparg;
+                break;
+            default:
+                newval = oldval ^ oparg;
+                break;
+        }
+    } while (!__sync_bool_compare_and_swap(uaddr2, oldval, newval));
+
+    int woken = futexWakeLocked(bucket, key, nWake, FUTEX_BITSET_MATCH_ANY);
+
+    bool bWake2 = false;
+    switch (cmp)
+    {
+        case FUTEX_OP_CMP_EQ:
+            bWake2 = oldval == cmparg;
+            break;
+        case FUTEX_OP_CMP_NE:
+            bWake2 = oldval != cmparg;
+            break;
+        case FUTEX_OP_CMP_LT:
+            bWake2 = oldval < cmparg;
+            break;
+        case FUTEX_OP_CMP_LE:
+            bWake2 = oldval <= cmparg;
+            break;
+        case FUTEX_OP_CMP_GT:
+            bWake2 = oldval > cmparg;
+            break;
+        default:
+            bWake2 = oldval >= cmparg;
+            break;
+    }
+
+    if (bWake2)
+    {
+        woken += futexWakeLocked(bucket2, key2, nWake2, FUTEX_BITSET_MATCH_ANY);
+    }
+
+    unlockBuckets(bucket, bucket2);
+
+    PT_NOTICE(" -> woke " << Dec << woken << " threads.");
+    return woken;
+}
+
+/** Converts a user timespec to nanoseconds, or returns false if invalid. */
+static bool futexTimeout(const struct timespec *timeout, Time::Timestamp &ns)
+{
+    if (!PosixSubsystem::checkAddress(
+            reinterpret_cast<uintptr_t>(timeout), sizeof(struct timespec),
+            PosixSubsystem::SafeRead))
+    {
+        SYSCALL_ERROR(BadAddress);
+        return false;
+    }
+
+    if (timeout->tv_sec < 0 || timeout->tv_nsec < 0 ||
+        timeout->tv_nsec >= static_cast<long>(Time::Multiplier::Second))
+    {
+        SYSCALL_ERROR(InvalidArgument);
+        return false;
+    }
+
+    ns = (timeout->tv_sec * Time::Multiplier::Second) + timeout->tv_nsec;
+    return true;
+}
 
 int posix_futex(
-    int *uaddr, int futex_op, int val, const struct timespec *timeout)
+    int *uaddr, int futex_op, int val, const struct timespec *timeout,
+    int *uaddr2, int val3)
 {
     Thread *pThread = Processor::information().getCurrentThread();
     Process *pProcess = pThread->getParent();
@@ -63,84 +518,110 @@ int posix_futex(
 
     PT_NOTICE(
         "futex(" << Hex << uaddr << ", " << futex_op << ", " << val << ", "
-                 << timeout << ")");
+                 << timeout << ", " << uaddr2 << ", " << val3 << ")");
+
+    bool bPrivate = futex_op & FUTEX_PRIVATE;
+
+    // All clocks are the same clock for now (see clock_gettime).
+    futex_op &= ~(FUTEX_PRIVATE | FUTEX_CLOCK_REALTIME);
 
-    if (!(futex_op & FUTEX_PRIVATE))
+    FutexKey key;
+    if (!futexKey(uaddr, bPrivate, key))
     {
-        PT_NOTICE(" -> warning: public futexes are not yet supported");
+        return -1;
     }
 
-    if (futex_op & FUTEX_CLOCK_REALTIME)
+    // For requeue and wake-op, the timeout argument is a second count.
+    int val2 = static_cast<int>(reinterpret_cast<uintptr_t>(timeout));
+
+    FutexKey key2;
+    if (futex_op == FUTEX_REQUEUE || futex_op == FUTEX_CMP_REQUEUE ||
+        futex_op == FUTEX_WAKE_OP)
     {
-        PT_NOTICE(" -> warning: clock choice (monotonic vs realtime) is not "
-                  "yet supported");
-        futex_op &= ~FUTEX_CLOCK_REALTIME;
+        if (!futexKey(uaddr2, bPrivate, key2))
+        {
+            return -1;
+        }
     }
 
-    futex_op &= ~FUTEX_PRIVATE;
-
     int r = 0;
-    int supported = 0;
 
     switch (futex_op)
     {
         case FUTEX_WAIT:
+        case FUTEX_WAIT_BITSET:
         {
             PT_NOTICE(" -> FUTEX_WAIT");
 
-            /// \todo this is not atomic at all
-            if (*uaddr != val)
+            uint32_t bitset = FUTEX_BITSET_MATCH_ANY;
+            if (futex_op == FUTEX_WAIT_BITSET)
             {
-                PT_NOTICE(" -> value changed");
-                SYSCALL_ERROR(NoMoreProcesses);  // EAGAIN
-                r = -1;
+                bitset = static_cast<uint32_t>(val3);
+                if (!bitset)
+                {
+                    SYSCALL_ERROR(InvalidArgument);
+                    r = -1;
+                    break;
+                }
             }
-            else
-            {
-                bool newLock = false;
 
-                List<Thread *> *threads = g_futexes.lookup(uaddr);
-                if (!threads)
+            Time::Timestamp ns = Time::Infinity;
+            if (timeout)
+            {
+                if (!futexTimeout(timeout, ns))
                 {
-                    threads = new List<Thread *>;
-                    threads->pushBack(pThread);
-                    g_futexes.insert(uaddr, threads);
+                    r = -1;
+                    break;
                 }
 
-                // good to go for sleeping
-                /// \todo timeout
-                PT_NOTICE(" -> waiting...");
-                Processor::information().getScheduler().sleep();
-                PT_NOTICE(" -> waiting complete!");
+                // FUTEX_WAIT_BITSET takes an absolute timeout.
+                if (futex_op == FUTEX_WAIT_BITSET)
+                {
+                    Time::Timestamp now = Time::getTimeNanoseconds();
+                    ns = (ns > now) ? (ns - now) : 0;
+                }
             }
+
+            r = futexWait(uaddr, key, val, bitset, ns);
             break;
         }
 
         case FUTEX_WAKE:
+        case FUTEX_WAKE_BITSET:
         {
             PT_NOTICE(" -> FUTEX_WAKE");
 
-            List<Thread *> *threads = g_futexes.lookup(uaddr);
-            if (threads)
+            uint32_t bitset = FUTEX_BITSET_MATCH_ANY;
+            if (futex_op == FUTEX_WAKE_BITSET)
             {
-                int woken = 0;
-                for (int i = 0; i < val && threads->count() > 0; ++i)
+                bitset = static_cast<uint32_t>(val3);
+                if (!bitset)
                 {
-                    Thread *pWakeThread = threads->popFront();
-                    PT_NOTICE(" -> waking " << pWakeThread);
-                    pWakeThread->getLock().acquire();
-                    pWakeThread->setStatus(Thread::Ready);
-                    pWakeThread->getLock().release();
-                    PT_NOTICE(" -> woken!");
-                    ++woken;
+                    SYSCALL_ERROR(InvalidArgument);
+                    r = -1;
+                    break;
                 }
-
-                PT_NOTICE(" -> woke " << Dec << woken << " threads.");
-                r = woken;
             }
+
+            r = futexWake(key, val, bitset);
             break;
         }
 
+        case FUTEX_REQUEUE:
+            PT_NOTICE(" -> FUTEX_REQUEUE");
+            r = futexRequeue(key, key2, val, val2, 0, 0);
+            break;
+
+        case FUTEX_CMP_REQUEUE:
+            PT_NOTICE(" -> FUTEX_CMP_REQUEUE");
+            r = futexRequeue(key, key2, val, val2, uaddr, val3);
+            break;
+
+        case FUTEX_WAKE_OP:
+            PT_NOTICE(" -> FUTEX_WAKE_OP");
+            r = futexWakeOp(key, key2, uaddr2, val, val2, val3);
+            break;
+
         default:
             PT_NOTICE(" -> unsupported futex operation");
             SYSCALL_ERROR(Unimplemented);
@@ -43,7 +43,8 @@ int posix_pedigree_thread_trigger(void *waiter);
 void posix_pedigree_destroy_waiter(void *waiter);
 
 int posix_futex(
-    int *uaddr, int futex_op, int val, const struct timespec *timeout);
+    int *uaddr, int futex_op, int val, const struct timespec *timeout,
+    int *uaddr2, int val3);
 
 pid_t posix_gettid();
 
@@ -279,5 +279,8 @@
 #define POSIX_CAPGET 267
 #define POSIX_CAPSET 268
 #define POSIX_PRCTL 269
+#define POSIX_SPLICE 270
+#define POSIX_TEE 271
+#define POSIX_VMSPLICE 272
 
 #endif
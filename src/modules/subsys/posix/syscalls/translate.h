@@ -60,6 +60,11 @@ inline long posix_translate_syscall(long which)
         TRANSLATION_ENTRY(SYS_writev, POSIX_WRITEV)
         TRANSLATION_ENTRY(SYS_access, POSIX_ACCESS)
         TRANSLATION_ENTRY(SYS_pipe, POSIX_PIPE)
+#ifdef SYS_splice
+        TRANSLATION_ENTRY(SYS_splice, POSIX_SPLICE)
+        TRANSLATION_ENTRY(SYS_tee, POSIX_TEE)
+        TRANSLATION_ENTRY(SYS_vmsplice, POSIX_VMSPLICE)
+#endif
 #ifdef SYS_select
         TRANSLATION_ENTRY(SYS_select, POSIX_SELECT)
 #endif
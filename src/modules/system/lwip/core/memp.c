@@ -317,7 +317,11 @@ do_memp_malloc_pool_fn(const struct memp_desc *desc, const char* file, const int
   SYS_ARCH_DECL_PROTECT(old_level);
 
 #if MEMP_MEM_MALLOC
+#ifdef MEMP_MEM_POOL_MALLOC
+  memp = (struct memp *)MEMP_MEM_POOL_MALLOC(desc, MEMP_SIZE + MEMP_ALIGN_SIZE(desc->size));
+#else
   memp = (struct memp *)mem_malloc(MEMP_SIZE + MEMP_ALIGN_SIZE(desc->size));
+#endif
   SYS_ARCH_PROTECT(old_level);
 #else /* MEMP_MEM_MALLOC */
   SYS_ARCH_PROTECT(old_level);
@@ -446,9 +450,13 @@ do_memp_free_pool(const struct memp_desc* desc, void *mem)
 #endif
 
 #if MEMP_MEM_MALLOC
-  LWIP_UNUSED_ARG(desc);
   SYS_ARCH_UNPROTECT(old_level);
+#ifdef MEMP_MEM_POOL_FREE
+  MEMP_MEM_POOL_FREE(desc, memp);
+#else
+  LWIP_UNUSED_ARG(desc);
   mem_free(memp);
+#endif
 #else /* MEMP_MEM_MALLOC */
   memp->next = *desc->tab;
   *desc->tab = memp;
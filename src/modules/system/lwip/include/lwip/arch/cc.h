@@ -58,8 +58,6 @@ typedef int sys_prot_t;
 
 #define SZT_F "zu"
 
-#define LWIP_CHKSUM_ALGORITHM 2
-
 #if UTILITY_LINUX
 #include <stdio.h>
 
@@ -0,0 +1,41 @@
+/*
+ * Copyright (c) 2008-2014, Pedigree Developers
+ *
+ * Please see the CONTRIB file in the root of the source tree for a full
+ * list of contributors.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+#ifndef LWIP_ARCH_CHKSUM_H
+#define LWIP_ARCH_CHKSUM_H
+
+#include <pedigree/kernel/processor/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** LWIP_CHKSUM: the folded but uninverted ones' complement sum of a buffer,
+ *  using the kernel's checksum kernels. */
+uint16_t pedigree_chksum(const void *dataptr, int len);
+
+/** LWIP_CHKSUM_COPY: copies \p len bytes and returns their sum, as above. */
+uint16_t pedigree_chksum_copy(void *dst, const void *src, uint16_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // LWIP_ARCH_CHKSUM_H
@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2008-2014, Pedigree Developers
+ *
+ * Please see the CONTRIB file in the root of the source tree for a full
+ * list of contributors.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+#ifndef LWIP_ARCH_POOLS_H
+#define LWIP_ARCH_POOLS_H
+
+#include <pedigree/kernel/processor/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct memp_desc;
+
+/** Usage of the pool backing one lwIP memp type. */
+struct pedigree_memp_stats
+{
+    /** lwIP's name for the memp type. */
+    const char *name;
+    /** Bytes handed out per object (lwIP's element size). */
+    size_t objectSize;
+    /** Objects currently allocated. */
+    size_t inUse;
+    /** Largest number of objects allocated at once. */
+    size_t highWater;
+    /** Allocations served from the kernel heap because the pool was empty
+     *  or could not be refilled from the current context. */
+    size_t heapFallbacks;
+    /** Allocations that failed outright. */
+    size_t failures;
+};
+
+/** Creates the pools. Must be called before lwIP is initialised. */
+void pedigree_memp_init(void);
+
+/** Allocates an object for the given memp type. */
+void *pedigree_memp_malloc(const struct memp_desc *desc, size_t size);
+
+/** Frees an object from pedigree_memp_malloc. */
+void pedigree_memp_free(const struct memp_desc *desc, void *mem);
+
+/** Fills \p stats for the n'th memp type; returns zero once n is past the
+ *  last type. */
+int pedigree_memp_stats(size_t n, struct pedigree_memp_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // LWIP_ARCH_POOLS_H
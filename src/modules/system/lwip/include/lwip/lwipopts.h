@@ -29,6 +29,28 @@
 #define MEM_LIBC_MALLOC 1
 #define MEMP_MEM_MALLOC 1
 
+#if !UTILITY_LINUX
+// Fixed-size lwIP objects (pbufs, PCBs, segments, messages) come from a pool
+// per memp type rather than the general heap; see pools.cc.
+#include <lwip/arch/pools.h>
+#define MEMP_MEM_POOL_MALLOC(desc, size) pedigree_memp_malloc(desc, size)
+#define MEMP_MEM_POOL_FREE(desc, mem) pedigree_memp_free(desc, mem)
+#endif
+
+// Checksums use the kernel's checksum kernels, and data copied into TCP
+// segments is summed as it is copied rather than in a second pass.
+#include <lwip/arch/chksum.h>
+#define LWIP_CHKSUM pedigree_chksum
+#define LWIP_CHECKSUM_ON_COPY 1
+#define LWIP_CHKSUM_COPY(dst, src, len) pedigree_chksum_copy(dst, src, len)
+
+// Lets devices that offload checksums switch off the software ones.
+#define LWIP_CHECKSUM_CTRL_PER_NETIF 1
+
+// Large enough for a full Ethernet frame with a VLAN tag, so received
+// frames always land in a single pbuf with the payload inline.
+#define PBUF_POOL_BUFSIZE 1536
+
 /// \todo should be architecture specific
 #define MEM_ALIGNMENT 8
 
@@ -44,7 +66,8 @@
 #define LWIP_PROVIDE_ERRNO 1
 
 // We can safely do this rather than use an mbox as packets are pushed into
-// a RequestQueue, not directly pushed from an IRQ context.
+// a per-interface receive ring and handed to lwIP by the network stack's
+// poll thread, not directly pushed from an IRQ context.
 #define LWIP_TCPIP_CORE_LOCKING_INPUT 0
 
 #define LWIP_RANDOMIZE_INITIAL_LOCAL_PORTS 1
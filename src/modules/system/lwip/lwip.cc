@@ -21,6 +21,7 @@
 
 #include "pedigree/kernel/process/Mutex.h"
 
+#include "modules/system/lwip/include/lwip/arch/pools.h"
 #include "modules/system/lwip/include/lwip/init.h"
 #include "modules/system/lwip/include/lwip/tcpip.h"
 
@@ -38,6 +39,9 @@ static bool entry()
 {
     tcpipInitPending.acquire();
 
+    // lwIP starts allocating as soon as it is initialised.
+    pedigree_memp_init();
+
     // make sure the multi threaded lwIP implementation is ready to go
     /// \todo check if tcpip_init fails somehow
     tcpip_init(tcpipInitComplete, nullptr);
@@ -0,0 +1,404 @@
+/*
+ * Copyright (c) 2008-2014, Pedigree Developers
+ *
+ * Please see the CONTRIB file in the root of the source tree for a full
+ * list of contributors.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+#include <pedigree/kernel/Atomic.h>
+#include <pedigree/kernel/LockGuard.h>
+#include <pedigree/kernel/Log.h>
+#include <pedigree/kernel/Spinlock.h>
+#include <pedigree/kernel/processor/PhysicalMemoryManager.h>
+#include <pedigree/kernel/processor/Processor.h>
+#include <pedigree/kernel/utilities/MemoryPool.h>
+
+#include <lwip/arch/pools.h>
+#include <lwip/memp.h>
+#include <lwip/priv/memp_priv.h>
+
+/// Objects each CPU keeps for itself before touching the shared pool.
+static const size_t CpuCacheSize = 32;
+
+/// Objects moved at once between a CPU cache and the shared pool.
+static const size_t CacheBatch = CpuCacheSize / 2;
+
+/// Objects each pool reserves address space for. Pages are only mapped as
+/// they are used, and the heap takes over if a pool runs dry.
+static const size_t ObjectsPerPool = 1024;
+
+/**
+ * Backing store for one lwIP memp type.
+ *
+ * Objects come from a MemoryPool of their own, fronted by a small cache per
+ * CPU so the common case is a couple of loads and stores with interrupts
+ * disabled. The MemoryPool takes a Mutex, so it is only touched from thread
+ * context; allocations from interrupt handlers (drivers allocating receive
+ * pbufs) that miss the cache fall back to the kernel heap, and frees that
+ * overflow the cache go to a deferred list picked up later.
+ */
+class MempPool
+{
+  public:
+    MempPool(const struct memp_desc *desc, size_t objectSize);
+    ~MempPool();
+
+    void *allocate();
+    void free(void *mem);
+
+    const struct memp_desc *getDescriptor() const
+    {
+        return m_pDesc;
+    }
+
+    void getStatistics(struct pedigree_memp_stats &stats) const;
+
+  private:
+    struct CpuCache
+    {
+        void *objects[CpuCacheSize];
+        size_t count;
+    };
+
+    /// Gets an object from the deferred list or the MemoryPool.
+    void *allocateShared(bool bThreadContext);
+
+    /// Gives an object back to the MemoryPool (or the heap, if it came from
+    /// there). Thread context only.
+    void release(void *mem);
+
+    /// Moves objects freed in interrupt context back to the MemoryPool.
+    void releaseDeferred();
+
+    void accountAllocation();
+
+    const struct memp_desc *m_pDesc;
+    size_t m_ObjectSize;
+
+    MemoryPool m_Pool;
+
+    CpuCache *m_pCaches;
+    size_t m_nCaches;
+
+    /// Singly linked through the objects themselves.
+    void *m_pDeferred;
+    Spinlock m_DeferredLock;
+
+    Atomic<size_t> m_InUse;
+    Atomic<size_t> m_HighWater;
+    Atomic<size_t> m_HeapFallbacks;
+    Atomic<size_t> m_Failures;
+};
+
+static MempPool *g_Pools[MEMP_MAX];
+
+MempPool::MempPool(const struct memp_desc *desc, size_t objectSize)
+    : m_pDesc(desc), m_ObjectSize(objectSize), m_Pool(desc->desc),
+      m_pCaches(0), m_nCaches(Processor::getCount()), m_pDeferred(0),
+      m_DeferredLock(false), m_InUse(0), m_HighWater(0), m_HeapFallbacks(0),
+      m_Failures(0)
+{
+    m_pCaches = new CpuCache[m_nCaches];
+    for (size_t i = 0; i < m_nCaches; ++i)
+    {
+        m_pCaches[i].count = 0;
+    }
+
+    // MemoryPool rounds buffers up to a power of two.
+    size_t bufferSize = 1;
+    while (bufferSize < objectSize)
+    {
+        bufferSize <<= 1;
+    }
+
+    size_t pageSize = PhysicalMemoryManager::getPageSize();
+    size_t nPages = ((bufferSize * ObjectsPerPool) + pageSize - 1) / pageSize;
+    if (!m_Pool.initialise(nPages, objectSize))
+    {
+        WARNING(
+            "lwIP: no pool for " << desc->desc << ", using the kernel heap");
+    }
+}
+
+MempPool::~MempPool()
+{
+    releaseDeferred();
+    for (size_t i = 0; i < m_nCaches; ++i)
+    {
+        while (m_pCaches[i].count)
+        {
+            release(m_pCaches[i].objects[--m_pCaches[i].count]);
+        }
+    }
+
+    delete[] m_pCaches;
+}
+
+void *MempPool::allocate()
+{
+    bool bInterrupts = Processor::getInterrupts();
+    Processor::setInterrupts(false);
+
+    void *mem = 0;
+    size_t cpu = Processor::id();
+    if (LIKELY(cpu < m_nCaches) && m_pCaches[cpu].count)
+    {
+        CpuCache &cache = m_pCaches[cpu];
+        mem = cache.objects[--cache.count];
+    }
+
+    Processor::setInterrupts(bInterrupts);
+
+    if (!mem)
+    {
+        mem = allocateShared(bInterrupts);
+    }
+
+    if (!mem)
+    {
+        m_HeapFallbacks += 1;
+        mem = new uint8_t[m_ObjectSize];
+    }
+
+    if (mem)
+    {
+        accountAllocation();
+    }
+    else
+    {
+        m_Failures += 1;
+    }
+
+    return mem;
+}
+
+void MempPool::free(void *mem)
+{
+    m_InUse -= 1;
+
+    bool bInterrupts = Processor::getInterrupts();
+    Processor::setInterrupts(false);
+
+    size_t cpu = Processor::id();
+    if (LIKELY(cpu < m_nCaches))
+    {
+        CpuCache &cache = m_pCaches[cpu];
+        if (cache.count < CpuCacheSize)
+        {
+            cache.objects[cache.count++] = mem;
+            Processor::setInterrupts(bInterrupts);
+            return;
+        }
+    }
+
+    if (!bInterrupts)
+    {
+        // Can't take the MemoryPool's lock from here.
+        m_DeferredLock.acquire();
+        *reinterpret_cast<void **>(mem) = m_pDeferred;
+        m_pDeferred = mem;
+        m_DeferredLock.release();
+
+        Processor::setInterrupts(bInterrupts);
+        return;
+    }
+
+    // Cache is full: hand back half of it along with this object, so the
+    // next few frees don't come straight back here.
+    void *batch[CacheBatch];
+    size_t n = 0;
+    if (LIKELY(cpu < m_nCaches))
+    {
+        CpuCache &cache = m_pCaches[cpu];
+        while (n < CacheBatch && cache.count)
+        {
+            batch[n++] = cache.objects[--cache.count];
+        }
+    }
+
+    Processor::setInterrupts(bInterrupts);
+
+    release(mem);
+    for (size_t i = 0; i < n; ++i)
+    {
+        release(batch[i]);
+    }
+}
+
+void *MempPool::allocateShared(bool bThreadContext)
+{
+    m_DeferredLock.acquire();
+    void *mem = m_pDeferred;
+    if (mem)
+    {
+        m_pDeferred = *reinterpret_cast<void **>(mem);
+    }
+    m_DeferredLock.release();
+
+    if (mem || !bThreadContext || !m_Pool.initialised())
+    {
+        return mem;
+    }
+
+    mem = reinterpret_cast<void *>(m_Pool.allocateNow());
+    if (!mem)
+    {
+        return 0;
+    }
+
+    // Refill this CPU's cache while we're here, so the next allocations
+    // don't need the MemoryPool lock.
+    void *batch[CacheBatch];
+    size_t n = 0;
+    while (n < CacheBatch)
+    {
+        batch[n] = reinterpret_cast<void *>(m_Pool.allocateNow());
+        if (!batch[n])
+        {
+            break;
+        }
+        ++n;
+    }
+
+    Processor::setInterrupts(false);
+
+    // We may have moved CPUs while refilling, which doesn't matter.
+    size_t cpu = Processor::id();
+    if (LIKELY(cpu < m_nCaches))
+    {
+        CpuCache &cache = m_pCaches[cpu];
+        while (n && cache.count < CpuCacheSize)
+        {
+            cache.objects[cache.count++] = batch[--n];
+        }
+    }
+
+    Processor::setInterrupts(true);
+
+    while (n)
+    {
+        release(batch[--n]);
+    }
+
+    return mem;
+}
+
+void MempPool::release(void *mem)
+{
+    uintptr_t buffer = reinterpret_cast<uintptr_t>(mem);
+    if (m_Pool.contains(buffer))
+    {
+        m_Pool.free(buffer);
+    }
+    else
+    {
+        delete[] reinterpret_cast<uint8_t *>(mem);
+    }
+}
+
+void MempPool::releaseDeferred()
+{
+    m_DeferredLock.acquire();
+    void *mem = m_pDeferred;
+    m_pDeferred = 0;
+    m_DeferredLock.release();
+
+    while (mem)
+    {
+        void *next = *reinterpret_cast<void **>(mem);
+        release(mem);
+        mem = next;
+    }
+}
+
+void MempPool::accountAllocation()
+{
+    size_t inUse = (m_InUse += 1);
+    size_t highWater = m_HighWater;
+    while (inUse > highWater && !m_HighWater.compareAndSwap(highWater, inUse))
+    {
+        highWater = m_HighWater;
+    }
+}
+
+void MempPool::getStatistics(struct pedigree_memp_stats &stats) const
+{
+    stats.name = m_pDesc->desc;
+    stats.objectSize = m_ObjectSize;
+    stats.inUse = m_InUse;
+    stats.highWater = m_HighWater;
+    stats.heapFallbacks = m_HeapFallbacks;
+    stats.failures = m_Failures;
+}
+
+static MempPool *findPool(const struct memp_desc *desc)
+{
+    // Only a couple of dozen types, all in one array - cheaper than a tree.
+    for (size_t i = 0; i < MEMP_MAX; ++i)
+    {
+        if (memp_pools[i] == desc)
+        {
+            return g_Pools[i];
+        }
+    }
+
+    return 0;
+}
+
+void pedigree_memp_init()
+{
+    for (size_t i = 0; i < MEMP_MAX; ++i)
+    {
+        const struct memp_desc *desc = memp_pools[i];
+        size_t objectSize = MEMP_SIZE + MEMP_ALIGN_SIZE(desc->size);
+        g_Pools[i] = new MempPool(desc, objectSize);
+    }
+}
+
+void *pedigree_memp_malloc(const struct memp_desc *desc, size_t size)
+{
+    MempPool *pool = findPool(desc);
+    if (!pool)
+    {
+        // Private pools declared with LWIP_MEMPOOL_DECLARE.
+        return mem_malloc(size);
+    }
+
+    return pool->allocate();
+}
+
+void pedigree_memp_free(const struct memp_desc *desc, void *mem)
+{
+    MempPool *pool = findPool(desc);
+    if (!pool)
+    {
+        mem_free(mem);
+        return;
+    }
+
+    pool->free(mem);
+}
+
+int pedigree_memp_stats(size_t n, struct pedigree_memp_stats *stats)
+{
+    if (n >= MEMP_MAX || !g_Pools[n])
+    {
+        return 0;
+    }
+
+    g_Pools[n]->getStatistics(*stats);
+    return 1;
+}
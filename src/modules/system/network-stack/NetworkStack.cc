@@ -22,6 +22,7 @@
 #include "modules/Module.h"
 #include "pedigree/kernel/LockGuard.h"
 #include "pedigree/kernel/Log.h"
+#include "pedigree/kernel/process/Thread.h"
 #include "pedigree/kernel/processor/Processor.h"
 
 #include "modules/system/lwip/include/lwip/etharp.h"
@@ -106,20 +107,48 @@ static err_t netifInit(struct netif *netif)
     netif->output = etharp_output;
     netif->output_ip6 = ethip6_output;
 
+    // Skip software checksums the card already takes care of.
+    uint32_t offload = pDevice->getChecksumOffload();
+    uint16_t checksums = NETIF_CHECKSUM_ENABLE_ALL;
+    if (offload & Network::OffloadIpv4Transmit)
+        checksums &= ~NETIF_CHECKSUM_GEN_IP;
+    if (offload & Network::OffloadTcpTransmit)
+        checksums &= ~NETIF_CHECKSUM_GEN_TCP;
+    if (offload & Network::OffloadUdpTransmit)
+        checksums &= ~NETIF_CHECKSUM_GEN_UDP;
+    if (offload & Network::OffloadIpv4Receive)
+        checksums &= ~NETIF_CHECKSUM_CHECK_IP;
+    if (offload & Network::OffloadTcpReceive)
+        checksums &= ~NETIF_CHECKSUM_CHECK_TCP;
+    if (offload & Network::OffloadUdpReceive)
+        checksums &= ~NETIF_CHECKSUM_CHECK_UDP;
+    NETIF_SET_CHECKSUM_CTRL(netif, checksums);
+
     netif_set_status_callback(netif, netifStatusUpdate);
     netif_set_link_callback(netif, netifLinkUpdate);
 
     return ERR_OK;
 }
 
+NetworkStack::ReceiveRing::ReceiveRing(Network *card, struct netif *netif)
+    : pCard(card), iface(netif), lock(false), packets(), head(0), tail(0),
+      count(0), scheduled(false), pNextPoll(nullptr), stats()
+{
+}
+
 NetworkStack::NetworkStack()
-    : RequestQueue(MakeConstantString("Network Stack")), m_pLoopback(0), m_Children(),
-      m_MemPool("network-pool")
+    : m_pLoopback(0), m_Children(), m_MemPool("network-pool")
 #if UTILITY_LINUX
       ,
       m_Lock(false)
 #endif
       ,
+      m_Interfaces(), m_ReceiveRings(), m_ReceiveRingsLock(false),
+      m_pPollHead(nullptr),
+      m_pPollTail(nullptr), m_PollLock(false),
+#if THREADS
+      m_pPollThread(nullptr), m_PollWakeup(0, false), m_bPollActive(true),
+#endif
       m_NextInterfaceNumber(0)
 {
     if (stack)
@@ -129,7 +158,12 @@ NetworkStack::NetworkStack()
 
     stack = this;
 
-    initialise();
+#if THREADS
+    m_pPollThread = new Thread(
+        Processor::information().getCurrentThread()->getParent(),
+        &pollTrampoline, reinterpret_cast<void *>(this));
+    m_pPollThread->setName("Network Stack poll thread");
+#endif
 
 #if X86_COMMON || HOSTED
     // Lots of RAM to burn! Try 16 MB, then 8 MB, then 4 MB, then give up
@@ -151,28 +185,21 @@ NetworkStack::NetworkStack()
 
 NetworkStack::~NetworkStack()
 {
-    destroy();
-
-    stack = 0;
-}
-
-uint64_t NetworkStack::executeRequest(
-    uint64_t p1, uint64_t p2, uint64_t p3, uint64_t p4, uint64_t p5,
-    uint64_t p6, uint64_t p7, uint64_t p8)
-{
-    // OK, we are now processing the packet.
-    // We hold a lock that allows us to handle concurrency (not an issue with
-    // a true RequestQueue, but is an issue on other environments).
-#if THREADS || UTILITY_LINUX
-    LockGuard<Mutex> guard(m_Lock);
+#if THREADS
+    m_bPollActive = false;
+    m_PollWakeup.release();
+    m_pPollThread->join();
 #endif
 
-    struct pbuf *p = reinterpret_cast<struct pbuf *>(p1);
-    struct netif *iface = reinterpret_cast<struct netif *>(p2);
-
-    iface->input(p, iface);
+    for (Tree<Network *, ReceiveRing *>::Iterator it = m_ReceiveRings.begin();
+         it != m_ReceiveRings.end(); ++it)
+    {
+        ReceiveRing *pRing = it.value();
+        discard(pRing);
+        delete pRing;
+    }
 
-    return 0;
+    stack = 0;
 }
 
 void NetworkStack::receive(
@@ -187,21 +214,12 @@ void NetworkStack::receive(
         return;  // Drop the packet.
     }
 
-    struct netif *iface = getInterface(pCard);
-    if (!iface)
-    {
-        ERROR("Network Stack: no lwIP interface for received packet");
-        pCard->droppedPacket();
-        return;
-    }
-
     struct pbuf *p = pbuf_alloc(PBUF_RAW, nBytes, PBUF_POOL);
     if (p != 0)
     {
         struct pbuf *buf = p;
         while (buf != nullptr)
         {
-            size_t copyLength = buf->len;
             MemoryCopy(
                 buf->payload, reinterpret_cast<void *>(packet), buf->len);
 
@@ -219,10 +237,229 @@ void NetworkStack::receive(
         return;
     }
 
-    uint64_t result = addRequest(
-        0, reinterpret_cast<uint64_t>(p), reinterpret_cast<uintptr_t>(iface));
+    m_ReceiveRingsLock.acquire();
+
+    ReceiveRing *pRing = m_ReceiveRings.lookup(pCard);
+    bool bQueued = pRing && enqueue(pRing, p);
+
+    m_ReceiveRingsLock.release();
+
+    if (!pRing)
+    {
+        ERROR("Network Stack: no lwIP interface for received packet");
+    }
+
+    if (!bQueued)
+    {
+        // Either the card has gone away or the stack is not keeping up;
+        // dropping here is cheaper than making the driver wait, and TCP will
+        // back off in response.
+        pbuf_free(p);
+        pCard->droppedPacket();
+        return;
+    }
+
+#if !THREADS
+    // No poll thread, so deliver the packet right away.
+    poll();
+#endif
+}
+
+bool NetworkStack::getReceiveStatistics(
+    Network *pCard, ReceiveStatistics &stats)
+{
+    m_ReceiveRingsLock.acquire();
+
+    ReceiveRing *pRing = m_ReceiveRings.lookup(pCard);
+    if (pRing)
+    {
+        pRing->lock.acquire();
+        stats = pRing->stats;
+        pRing->lock.release();
+    }
+
+    m_ReceiveRingsLock.release();
+
+    return pRing != nullptr;
+}
+
+bool NetworkStack::enqueue(ReceiveRing *pRing, struct pbuf *p)
+{
+    pRing->lock.acquire();
+
+    if (pRing->count >= ReceiveRingSize)
+    {
+        ++pRing->stats.ringFull;
+        pRing->lock.release();
+        return false;
+    }
+
+    pRing->packets[pRing->tail] = p;
+    pRing->tail = (pRing->tail + 1) % ReceiveRingSize;
+    ++pRing->count;
+    ++pRing->stats.queued;
+
+    // Only the first packet after the ring goes idle needs to wake the poll
+    // thread; everything after that is picked up by the same batch.
+    bool needsPoll = !pRing->scheduled;
+    if (needsPoll)
+    {
+        pRing->scheduled = true;
+        ++pRing->stats.wakeups;
+    }
+
+    pRing->lock.release();
+
+    if (needsPoll)
+    {
+        schedulePoll(pRing);
+#if THREADS
+        m_PollWakeup.release();
+#endif
+    }
+
+    return true;
+}
+
+bool NetworkStack::drain(ReceiveRing *pRing, size_t budget)
+{
+    struct pbuf *batch[ReceiveBudget];
+    if (budget > ReceiveBudget)
+    {
+        budget = ReceiveBudget;
+    }
+
+    pRing->lock.acquire();
+
+    size_t n = pRing->count < budget ? pRing->count : budget;
+    for (size_t i = 0; i < n; ++i)
+    {
+        batch[i] = pRing->packets[pRing->head];
+        pRing->head = (pRing->head + 1) % ReceiveRingSize;
+    }
+    pRing->count -= n;
+
+    if (n)
+    {
+        ++pRing->stats.batches;
+        if (n > pRing->stats.largestBatch)
+        {
+            pRing->stats.largestBatch = n;
+        }
+    }
+
+    // An empty ring drops off the poll list; the next packet to arrive will
+    // schedule it again.
+    bool remaining = pRing->count != 0;
+    if (!remaining)
+    {
+        pRing->scheduled = false;
+    }
+
+    pRing->lock.release();
+
+    struct netif *iface = pRing->iface;
+    for (size_t i = 0; i < n; ++i)
+    {
+        // On failure lwIP leaves the pbuf for us to free.
+        if (iface->input(batch[i], iface) != ERR_OK)
+        {
+            pbuf_free(batch[i]);
+            pRing->pCard->droppedPacket();
+        }
+    }
+
+    return remaining;
+}
+
+void NetworkStack::discard(ReceiveRing *pRing)
+{
+    pRing->lock.acquire();
+    while (pRing->count)
+    {
+        pbuf_free(pRing->packets[pRing->head]);
+        pRing->head = (pRing->head + 1) % ReceiveRingSize;
+        --pRing->count;
+    }
+    pRing->lock.release();
 }
 
+void NetworkStack::schedulePoll(ReceiveRing *pRing)
+{
+    m_PollLock.acquire();
+    pRing->pNextPoll = nullptr;
+    if (m_pPollTail)
+    {
+        m_pPollTail->pNextPoll = pRing;
+    }
+    else
+    {
+        m_pPollHead = pRing;
+    }
+    m_pPollTail = pRing;
+    m_PollLock.release();
+}
+
+NetworkStack::ReceiveRing *NetworkStack::nextPoll()
+{
+    m_PollLock.acquire();
+    ReceiveRing *pRing = m_pPollHead;
+    if (pRing)
+    {
+        m_pPollHead = pRing->pNextPoll;
+        if (!m_pPollHead)
+        {
+            m_pPollTail = nullptr;
+        }
+        pRing->pNextPoll = nullptr;
+    }
+    m_PollLock.release();
+
+    return pRing;
+}
+
+void NetworkStack::poll()
+{
+    // Holding the stack lock for the whole pass keeps rings from being torn
+    // down underneath us by deRegisterDevice.
+#if THREADS || UTILITY_LINUX
+    LockGuard<Mutex> guard(m_Lock);
+#endif
+
+    ReceiveRing *pRing = nullptr;
+    while ((pRing = nextPoll()) != nullptr)
+    {
+        // Rings that still have packets after their budget go to the back of
+        // the list, so every interface gets a turn.
+        if (drain(pRing, ReceiveBudget))
+        {
+            schedulePoll(pRing);
+        }
+    }
+}
+
+#if THREADS
+int NetworkStack::pollTrampoline(void *p)
+{
+    reinterpret_cast<NetworkStack *>(p)->pollThread();
+    return 0;
+}
+
+void NetworkStack::pollThread()
+{
+    while (true)
+    {
+        m_PollWakeup.acquire();
+        if (!m_bPollActive)
+        {
+            break;
+        }
+
+        poll();
+    }
+}
+#endif
+
 void NetworkStack::registerDevice(Network *pDevice)
 {
 #if THREADS || UTILITY_LINUX
@@ -257,6 +494,11 @@ void NetworkStack::registerDevice(Network *pDevice)
     iface = netif_add(iface, &ipaddr, &netmask, &gateway, pDevice, netifInit, tcpip_input);
 
     m_Interfaces.insert(pDevice, iface);
+
+    ReceiveRing *pRing = new ReceiveRing(pDevice, iface);
+    m_ReceiveRingsLock.acquire();
+    m_ReceiveRings.insert(pDevice, pRing);
+    m_ReceiveRingsLock.release();
 }
 
 Network *NetworkStack::getDevice(size_t n)
@@ -271,6 +513,10 @@ size_t NetworkStack::getNumDevices()
 
 void NetworkStack::deRegisterDevice(Network *pDevice)
 {
+#if THREADS || UTILITY_LINUX
+    LockGuard<Mutex> guard(m_Lock);
+#endif
+
     int i = 0;
     for (Vector<Network *>::Iterator it = m_Children.begin();
          it != m_Children.end(); it++, i++)
@@ -280,6 +526,45 @@ void NetworkStack::deRegisterDevice(Network *pDevice)
             break;
         }
 
+    // Once the ring is out of the tree, no receive() can still be using it.
+    m_ReceiveRingsLock.acquire();
+    ReceiveRing *pRing = m_ReceiveRings.lookup(pDevice);
+    m_ReceiveRings.remove(pDevice);
+    m_ReceiveRingsLock.release();
+
+    if (pRing != nullptr)
+    {
+        // Take the ring off the poll list before it goes away.
+        m_PollLock.acquire();
+        ReceiveRing *pPrev = nullptr;
+        for (ReceiveRing *pCurr = m_pPollHead; pCurr;
+             pPrev = pCurr, pCurr = pCurr->pNextPoll)
+        {
+            if (pCurr != pRing)
+            {
+                continue;
+            }
+
+            if (pPrev)
+            {
+                pPrev->pNextPoll = pCurr->pNextPoll;
+            }
+            else
+            {
+                m_pPollHead = pCurr->pNextPoll;
+            }
+            if (m_pPollTail == pCurr)
+            {
+                m_pPollTail = pPrev;
+            }
+            break;
+        }
+        m_PollLock.release();
+
+        discard(pRing);
+        delete pRing;
+    }
+
     struct netif *iface = m_Interfaces.lookup(pDevice);
     m_Interfaces.remove(pDevice);
 
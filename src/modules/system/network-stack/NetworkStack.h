@@ -20,24 +20,35 @@
 #ifndef MACHINE_NETWORK_STACK_H
 #define MACHINE_NETWORK_STACK_H
 
+#include "pedigree/kernel/Atomic.h"
+#include "pedigree/kernel/Spinlock.h"
 #include "pedigree/kernel/compiler.h"
 #include "pedigree/kernel/machine/Network.h"
+#include "pedigree/kernel/process/Mutex.h"
+#include "pedigree/kernel/process/Semaphore.h"
 #include "pedigree/kernel/processor/types.h"
 #include "pedigree/kernel/utilities/MemoryPool.h"
-#include "pedigree/kernel/utilities/RequestQueue.h"
 #include "pedigree/kernel/utilities/String.h"
 #include "pedigree/kernel/utilities/Tree.h"
 #include "pedigree/kernel/utilities/Vector.h"
 
-// lwIP network interface type
+// lwIP network interface and packet buffer types
 struct netif;
+struct pbuf;
+
+class Thread;
 
 /**
  * The Pedigree network stack
  * This function is the base for receiving packets, and provides functionality
  * for keeping track of network devices in the system.
+ *
+ * Received packets are queued on a per-interface ring without blocking the
+ * driver, and a poll thread drains the rings into lwIP in batches. While an
+ * interface is already scheduled for polling, further packets only join its
+ * ring, so a burst of frames costs one wakeup rather than one per frame.
  */
-class EXPORTED_PUBLIC NetworkStack : public RequestQueue
+class EXPORTED_PUBLIC NetworkStack
 {
   public:
     NetworkStack();
@@ -49,10 +60,37 @@ class EXPORTED_PUBLIC NetworkStack : public RequestQueue
         return *stack;
     }
 
-    /** Called when a packet arrives */
+    /** Number of packets each interface can have waiting for the stack. */
+    static const size_t ReceiveRingSize = 256;
+
+    /** Number of packets processed from one interface before moving on to
+     *  the next, so one busy card cannot starve the others. */
+    static const size_t ReceiveBudget = 64;
+
+    /** Receive path counters for one interface. */
+    struct ReceiveStatistics
+    {
+        /// Packets queued for the stack.
+        size_t queued = 0;
+        /// Packets dropped because the receive ring was full.
+        size_t ringFull = 0;
+        /// Number of times the interface was scheduled for polling.
+        size_t wakeups = 0;
+        /// Number of batches drained from the ring.
+        size_t batches = 0;
+        /// Largest batch drained in one go.
+        size_t largestBatch = 0;
+    };
+
+    /** Called when a packet arrives. Never blocks, so drivers may call this
+     *  from their interrupt handlers. */
     void
     receive(size_t nBytes, uintptr_t packet, Network *pCard, uint32_t offset);
 
+    /** Gets the receive counters for the given card. Returns false if the
+     *  card is not registered with the stack. */
+    bool getReceiveStatistics(Network *pCard, ReceiveStatistics &stats);
+
     /** Registers a given network device with the stack */
     void registerDevice(Network *pDevice);
 
@@ -131,9 +169,52 @@ class EXPORTED_PUBLIC NetworkStack : public RequestQueue
   private:
     static NetworkStack *stack;
 
-    virtual uint64_t executeRequest(
-        uint64_t p1, uint64_t p2, uint64_t p3, uint64_t p4, uint64_t p5,
-        uint64_t p6, uint64_t p7, uint64_t p8);
+    /** Packets waiting to be passed to lwIP for one interface. */
+    struct ReceiveRing
+    {
+        ReceiveRing(Network *card, struct netif *netif);
+
+        Network *pCard;
+        struct netif *iface;
+
+        /// Held only to add or remove packets; never held across lwIP calls.
+        Spinlock lock;
+        struct pbuf *packets[ReceiveRingSize];
+        size_t head;
+        size_t tail;
+        size_t count;
+
+        /// Whether the ring is on the poll list (or being drained).
+        bool scheduled;
+        /// Next ring on the poll list.
+        ReceiveRing *pNextPoll;
+
+        ReceiveStatistics stats;
+    };
+
+    /** Pushes a packet to the ring, scheduling it for polling if needed. */
+    bool enqueue(ReceiveRing *pRing, struct pbuf *p);
+
+    /** Passes up to \p budget packets from the ring to lwIP. Returns true if
+     *  packets remain on the ring afterwards. */
+    bool drain(ReceiveRing *pRing, size_t budget);
+
+    /** Frees every packet left on the ring. */
+    void discard(ReceiveRing *pRing);
+
+    /** Adds a ring to the tail of the poll list. */
+    void schedulePoll(ReceiveRing *pRing);
+
+    /** Takes the ring at the head of the poll list, or null if empty. */
+    ReceiveRing *nextPoll();
+
+    /** Drains every ring on the poll list. */
+    void poll();
+
+#if THREADS
+    static int pollTrampoline(void *p);
+    void pollThread();
+#endif
 
     /** Loopback device */
     Network *m_pLoopback;
@@ -151,6 +232,26 @@ class EXPORTED_PUBLIC NetworkStack : public RequestQueue
     /** lwIP interfaces for each of our cards. */
     Tree<Network *, struct netif *> m_Interfaces;
 
+    /** Receive rings for each of our cards. */
+    Tree<Network *, ReceiveRing *> m_ReceiveRings;
+
+    /** Protects m_ReceiveRings. receive() holds it while it uses a ring, so
+     *  deRegisterDevice can't free the ring underneath it. */
+    Spinlock m_ReceiveRingsLock;
+
+    /** Rings with packets waiting for the poll thread, in arrival order.
+     *  Linked through the rings themselves so receive never allocates. */
+    ReceiveRing *m_pPollHead;
+    ReceiveRing *m_pPollTail;
+    Spinlock m_PollLock;
+
+#if THREADS
+    /** Poll thread, woken once per ring newly added to the poll list. */
+    Thread *m_pPollThread;
+    Semaphore m_PollWakeup;
+    Atomic<bool> m_bPollActive;
+#endif
+
     /** Next interface number to assign. */
     size_t m_NextInterfaceNumber;
 };
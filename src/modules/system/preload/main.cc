@@ -19,74 +19,189 @@
 
 #include "modules/Module.h"
 #include "modules/system/vfs/File.h"
+#include "modules/system/vfs/FileAccessTrace.h"
 #include "modules/system/vfs/VFS.h"
 #include "pedigree/kernel/Log.h"
-#include "pedigree/kernel/process/Semaphore.h"
+#include "pedigree/kernel/process/Thread.h"
+#include "pedigree/kernel/processor/Processor.h"
+#include "pedigree/kernel/processor/ProcessorInformation.h"
 #include "pedigree/kernel/processor/types.h"
+#include "pedigree/kernel/time/Time.h"
 #include "pedigree/kernel/utilities/String.h"
+#include "pedigree/kernel/utilities/Vector.h"
 
-static const char *g_FilesToPreload[] = {
-    "root»/applications/init",        "root»/applications/ttyterm",
-    "root»/applications/winman",      "root»/applications/tui",
-    "root»/applications/TUI",         "root»/applications/login",
-    "root»/libraries/libload.so",     "root»/libraries/libc.so",
-    "root»/libraries/libm.so",        "root»/libraries/libstdc++.so",
-    "root»/libraries/libpedigree.so", "root»/libraries/libpedigree-c.so",
-    "root»/libraries/libpthread.so",  0};
+/**
+ * Boot-time file cache preloading.
+ *
+ * If there's no boot trace on the root filesystem, this boot is traced: every
+ * file read for the first TRACE_SECONDS (enough to get through to a login
+ * prompt) is recorded and the trace is saved. Otherwise, the saved trace is
+ * replayed in the background, reading each traced extent into the file cache
+ * in path and offset order so that init and login find their files cached.
+ *
+ * Delete the trace to record a new one.
+ */
+
+#define TRACE_PATH "root»/system/boot-trace"
+#define TRACE_SECONDS 60
+
+/// Largest single read issued while replaying a trace.
+#define REPLAY_CHUNK 0x40000
+
+static Thread *g_pPreloadThread = nullptr;
+static volatile bool g_bStopping = false;
+
+static int traceThread(void *)
+{
+    // Sleep in one-second steps so unloading doesn't wait out the window.
+    for (size_t i = 0; i < TRACE_SECONDS && !g_bStopping; ++i)
+    {
+        Time::delay(Time::Multiplier::Second);
+    }
+
+    FileAccessTrace &trace = FileAccessTrace::instance();
+    trace.stop();
+
+    if (g_bStopping)
+    {
+        // Don't save a partial trace.
+        return 0;
+    }
+
+    if (trace.save(String(TRACE_PATH)))
+    {
+        NOTICE(
+            "PRELOAD: saved " << trace.count() << " extents to "
+                              << TRACE_PATH);
+    }
 
-static Semaphore g_Preloads(0);
+    return 0;
+}
 
-static int preloadThread(void *p)
+static int replayThread(void *p)
 {
-    const char *s = reinterpret_cast<const char *>(p);
+    Vector<FileAccessTrace::Entry> *pEntries =
+        reinterpret_cast<Vector<FileAccessTrace::Entry> *>(p);
+
+    Time::Timestamp start = Time::getTicks();
 
-    NOTICE("PRELOAD: " << s);
+    // The saved trace is already in order, but it's cheap to make sure.
+    FileAccessTrace::sortAndMerge(*pEntries);
 
-    File *pFile = VFS::instance().find(String(s));
-    if (pFile)
+    File *pFile = nullptr;
+    const String *pPath = nullptr;
+    size_t nFiles = 0;
+    uint64_t nBytes = 0;
+    for (auto &entry : *pEntries)
     {
-        NOTICE("PRELOAD: preloading " << s << "...");
-        size_t sz = 0;
-        while (sz < pFile->getSize())
+        if (g_bStopping)
+        {
+            break;
+        }
+
+        if (!pPath || !(*pPath == entry.path))
+        {
+            pPath = &entry.path;
+            pFile = VFS::instance().find(entry.path);
+            if (pFile && pFile->isDirectory())
+            {
+                pFile = nullptr;
+            }
+
+            if (pFile)
+            {
+                ++nFiles;
+            }
+        }
+
+        if (!pFile)
+        {
+            continue;
+        }
+
+        // Files may have shrunk since the trace was taken.
+        uint64_t offset = entry.offset;
+        uint64_t end = entry.offset + entry.length;
+        if (end > pFile->getSize())
         {
-            pFile->read(sz, 0x1000, 0);
-            sz += 0x1000;
+            end = pFile->getSize();
+        }
+
+        // A null buffer only brings the blocks into the cache.
+        while (offset < end && !g_bStopping)
+        {
+            uint64_t length = end - offset;
+            if (length > REPLAY_CHUNK)
+            {
+                length = REPLAY_CHUNK;
+            }
+
+            uint64_t nRead = pFile->read(offset, length, 0);
+            if (!nRead)
+            {
+                break;
+            }
+
+            offset += nRead;
+            nBytes += nRead;
         }
     }
 
-    NOTICE("PRELOAD: preload " << s << " has completed.");
-    g_Preloads.release();
+    NOTICE(
+        "PRELOAD: read " << Dec << (nBytes / 1024) << "K from " << nFiles
+                         << " files in "
+                         << ((Time::getTicks() - start) /
+                             Time::Multiplier::Millisecond)
+                         << "ms");
 
+    delete pEntries;
     return 0;
 }
 
 static bool init()
 {
-    /// \todo figure out why this causes numerous problems with ext2
-    return false;
-    /*
-        size_t n = 0;
-        const char *s = g_FilesToPreload[n++];
-        do
-        {
-            NOTICE("PRELOAD: Queue " << s);
-            Thread *pThread = new Thread(
-                Processor::information().getCurrentThread()->getParent(),
-                preloadThread, const_cast<char *>(s));
-            pThread->detach();
-            s = g_FilesToPreload[n++];
-        } while (s);
-
-        g_Preloads.acquire(n - 1);
-        NOTICE("PRELOAD: preloaded " << n << " files.");
-
-        // Trick: return false, which unloads this module (its purpose is
-       complete.) return false;
-    */
+    Vector<FileAccessTrace::Entry> *pEntries =
+        new Vector<FileAccessTrace::Entry>();
+
+    Process *pParent = Processor::information().getCurrentThread()->getParent();
+    if (FileAccessTrace::load(String(TRACE_PATH), *pEntries))
+    {
+        NOTICE(
+            "PRELOAD: replaying " << pEntries->count() << " extents from "
+                                  << TRACE_PATH);
+
+        // One thread, reading in order: the disk sees sorted, mostly
+        // sequential requests rather than several streams seeking against
+        // each other.
+        g_pPreloadThread = new Thread(pParent, replayThread, pEntries);
+        g_pPreloadThread->setName("boot trace replay");
+    }
+    else
+    {
+        delete pEntries;
+
+        NOTICE(
+            "PRELOAD: no boot trace, tracing for " << Dec << TRACE_SECONDS
+                                                   << " seconds");
+        FileAccessTrace::instance().start();
+
+        g_pPreloadThread = new Thread(pParent, traceThread, nullptr);
+        g_pPreloadThread->setName("boot trace recorder");
+    }
+
+    return true;
 }
 
 static void destroy()
 {
+    g_bStopping = true;
+    if (g_pPreloadThread)
+    {
+        g_pPreloadThread->join();
+        g_pPreloadThread = nullptr;
+    }
+
+    FileAccessTrace::instance().stop();
 }
 
 MODULE_INFO("File Cache Preload", &init, &destroy, "vfs");
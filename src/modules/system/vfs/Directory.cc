@@ -26,7 +26,8 @@
 #include "pedigree/kernel/utilities/StringView.h"
 #include "pedigree/kernel/utilities/Vector.h"
 
-template class HashTable<String, Directory::DirectoryEntry *, HashedStringView>;
+template class FlatHashTable<
+    String, Directory::DirectoryEntry *, HashedStringView>;
 
 Directory::Directory() : File(), m_Cache(nullptr), m_bCachePopulated(false)
 {
@@ -25,7 +25,7 @@
 #include "pedigree/kernel/compiler.h"
 #include "pedigree/kernel/processor/types.h"
 #include "pedigree/kernel/time/Time.h"
-#include "pedigree/kernel/utilities/HashTable.h"
+#include "pedigree/kernel/utilities/FlatHashTable.h"
 #include "pedigree/kernel/utilities/LazyEvaluate.h"
 #include "pedigree/kernel/utilities/Pointers.h"
 #include "pedigree/kernel/utilities/String.h"
@@ -167,7 +167,8 @@ class EXPORTED_PUBLIC Directory : public File
         DirectoryEntry;
 
   private:
-    typedef HashTable<String, DirectoryEntry *, HashedStringView> DirectoryEntryCache;
+    typedef FlatHashTable<String, DirectoryEntry *, HashedStringView>
+        DirectoryEntryCache;
 
     /** Directory contents cache. */
     DirectoryEntryCache m_Cache;
@@ -207,6 +208,7 @@ class EXPORTED_PUBLIC Directory : public File
     virtual File *convertToFile(const DirectoryEntryMetadata &meta);
 };
 
-extern template class HashTable<String, Directory::DirectoryEntry *, HashedStringView>;
+extern template class FlatHashTable<
+    String, Directory::DirectoryEntry *, HashedStringView>;
 
 #endif
@@ -18,6 +18,7 @@
  */
 
 #include "File.h"
+#include "FileAccessTrace.h"
 #include "Filesystem.h"
 #include "pedigree/kernel/LockGuard.h"
 #include "pedigree/kernel/Log.h"
@@ -34,6 +35,9 @@
 #include "pedigree/kernel/utilities/assert.h"
 #include "pedigree/kernel/utilities/utility.h"
 
+/** Number of blocks looked up at once by read() and sync(). */
+static const size_t CacheBatchSize = 16;
+
 void File::writeCallback(
     CacheConstants::CallbackCause cause, uintptr_t loc, uintptr_t page,
     void *meta)
@@ -69,8 +73,8 @@ File::File()
     : m_Name(), m_AccessedTime(0), m_ModifiedTime(0), m_CreationTime(0),
       m_Inode(0), m_pFilesystem(0), m_Size(0), m_pParent(0), m_nWriters(0),
       m_nReaders(0), m_Uid(0), m_Gid(0), m_Permissions(0),
-      m_DataCache(FILE_BAD_BLOCK), m_bDirect(false),
-      m_FillCache(), m_Lock(), m_MonitorTargets()
+      m_DataCache(), m_bDirect(false), m_FillCache(), m_Lock(),
+      m_MonitorTargets()
 {
 }
 
@@ -81,21 +85,14 @@ File::File(
     : m_Name(name), m_AccessedTime(accessedTime), m_ModifiedTime(modifiedTime),
       m_CreationTime(creationTime), m_Inode(inode), m_pFilesystem(pFs),
       m_Size(size), m_pParent(pParent), m_nWriters(0), m_nReaders(0), m_Uid(0),
-      m_Gid(0), m_Permissions(0), m_DataCache(FILE_BAD_BLOCK), m_bDirect(false),
+      m_Gid(0), m_Permissions(0), m_DataCache(), m_bDirect(false),
       m_FillCache(), m_Lock(), m_MonitorTargets()
 {
-    size_t maxBlock = size / getBlockSize();
-    if (size % getBlockSize())
-    {
-        ++maxBlock;
-    }
-
-    // Prefill the block cache with bad pages to avoid continuous resizes.
-    setCachedPage(maxBlock, FILE_BAD_BLOCK);
 }
 
 File::~File()
 {
+    FileAccessTrace::instance().forget(this);
 }
 
 uint64_t
@@ -125,9 +122,23 @@ File::read(uint64_t location, uint64_t size, uintptr_t buffer, bool bCanBlock)
         }
     }
 
+    if (UNLIKELY(FileAccessTrace::instance().isTracing()))
+    {
+        FileAccessTrace::instance().record(this, location, size);
+    }
+
     const size_t blockSize =
         useFillCache() ? PhysicalMemoryManager::getPageSize() : getBlockSize();
 
+    // Cached blocks are found a batch at a time rather than taking the lock
+    // for every block of a large read.
+    const bool batched = !useFillCache() && !m_bDirect;
+    size_t cachedIndices[CacheBatchSize];
+    uintptr_t cachedBlocks[CacheBatchSize];
+    size_t nCached = 0;
+    size_t nextCached = 0;
+    size_t batchEnd = 0;
+
     size_t n = 0;
     while (size)
     {
@@ -142,7 +153,43 @@ File::read(uint64_t location, uint64_t size, uintptr_t buffer, bool bCanBlock)
         if (sz > (m_Size - location))
             sz = m_Size - location;
 
-        uintptr_t buff = readIntoCache(block);
+        uintptr_t buff = FILE_BAD_BLOCK;
+        if (batched)
+        {
+            if (block >= batchEnd)
+            {
+                size_t lastBlock = (location + size - 1) / blockSize;
+
+                LockGuard<Mutex> guard(m_Lock);
+                nCached = m_DataCache.gangLookup(
+                    block, lastBlock, CacheBatchSize, cachedIndices,
+                    cachedBlocks);
+                nextCached = 0;
+                batchEnd = (nCached == CacheBatchSize)
+                               ? cachedIndices[nCached - 1] + 1
+                               : lastBlock + 1;
+            }
+
+            while (nextCached < nCached && cachedIndices[nextCached] < block)
+            {
+                ++nextCached;
+            }
+
+            if (nextCached < nCached && cachedIndices[nextCached] == block)
+            {
+                buff = cachedBlocks[nextCached];
+            }
+        }
+
+        if (buff == FILE_BAD_BLOCK)
+        {
+            buff = readIntoCache(block);
+
+            // The rest of the batch may be stale by the time the read is
+            // done, so look it up again.
+            batchEnd = 0;
+        }
+
         if (buff == FILE_BAD_BLOCK)
         {
             ERROR(
@@ -293,6 +340,10 @@ physical_uintptr_t File::getPhysicalPage(size_t offset)
         else
         {
             pinBlock(offset);
+
+            // The page can now be written without going through write().
+            LockGuard<Mutex> guard(m_Lock);
+            m_DataCache.setTag(offset / blockSize, PageIndex::Dirty);
         }
 
         return phys;
@@ -339,20 +390,29 @@ void File::sync()
 {
     LockGuard<Mutex> guard(m_Lock);
 
+    // write() writes blocks back as it goes, so only blocks that have been
+    // handed out for mapping can have changed since. They stay tagged as
+    // the mapping may still be live.
     const size_t blockSize = getBlockSize();
-    for (size_t i = 0; i < m_DataCache.count(); ++i)
-    {
-        auto result = m_DataCache.getNth(i);
-        if (result.hasError())
+    size_t indices[CacheBatchSize];
+    uintptr_t buffers[CacheBatchSize];
+    size_t next = 0;
+    while (true)
+    {
+        size_t n = m_DataCache.gangLookupTagged(
+            next, ~static_cast<size_t>(0), PageIndex::Dirty, CacheBatchSize,
+            indices, buffers);
+        for (size_t i = 0; i < n; ++i)
         {
-            break;
+            writeBlock(indices[i] * blockSize, buffers[i]);
         }
 
-        uintptr_t buffer = result.value().second();
-        if (buffer != FILE_BAD_BLOCK)
+        if (n < CacheBatchSize)
         {
-            writeBlock(i * blockSize, buffer);
+            break;
         }
+
+        next = indices[n - 1] + 1;
     }
 }
 
@@ -761,16 +821,8 @@ uintptr_t File::getCachedPage(size_t block, bool locked)
 {
     LockGuard<Mutex> guard(m_Lock, locked);
 
-    DataCacheKey key(block);
-    auto result = m_DataCache.lookup(key);
-    if (result.hasValue())
-    {
-        return result.value();
-    }
-    else
-    {
-        return FILE_BAD_BLOCK;
-    }
+    uintptr_t value = m_DataCache.lookup(block);
+    return value ? value : FILE_BAD_BLOCK;
 }
 
 void File::setCachedPage(size_t block, uintptr_t value, bool locked)
@@ -779,21 +831,13 @@ void File::setCachedPage(size_t block, uintptr_t value, bool locked)
 
     assert(value);
 
-    DataCacheKey key(block);
-    if (m_DataCache.contains(key))
+    if (value == FILE_BAD_BLOCK)
     {
-        if (value == FILE_BAD_BLOCK)
-        {
-            m_DataCache.remove(key);
-        }
-        else
-        {
-            m_DataCache.update(key, value);
-        }
+        m_DataCache.remove(block);
     }
     else
     {
-        m_DataCache.insert(key, value);
+        m_DataCache.insert(block, value);
     }
 }
 
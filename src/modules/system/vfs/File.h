@@ -26,8 +26,8 @@
 #include "pedigree/kernel/time/Time.h"
 #include "pedigree/kernel/utilities/Cache.h"
 #include "pedigree/kernel/utilities/CacheConstants.h"
-#include "pedigree/kernel/utilities/HashTable.h"
 #include "pedigree/kernel/utilities/List.h"
+#include "pedigree/kernel/utilities/PageIndex.h"
 #include "pedigree/kernel/utilities/StaticString.h"
 #include "pedigree/kernel/utilities/String.h"
 #include "pedigree/kernel/utilities/new"
@@ -343,30 +343,12 @@ class EXPORTED_PUBLIC File
     size_t m_Gid;
     uint32_t m_Permissions;
 
-    class DataCacheKey
-    {
-      public:
-        DataCacheKey() = default;
-        DataCacheKey(size_t block) : m_Block(block)
-        {
-        }
-        ~DataCacheKey() = default;
-
-        size_t hash() const
-        {
-            return m_Block;
-        }
-
-        bool operator==(const DataCacheKey &other) const
-        {
-            return m_Block == other.m_Block;
-        }
-
-      private:
-        size_t m_Block = ~static_cast<size_t>(0);
-    };
-
-    HashTable<DataCacheKey, uintptr_t> m_DataCache;
+    /**
+     * Blocks returned by readBlock, indexed by block number. Blocks handed
+     * out by getPhysicalPage are tagged Dirty, as they may be written through
+     * a mapping without us knowing.
+     */
+    PageIndex m_DataCache;
 
     bool m_bDirect;
 
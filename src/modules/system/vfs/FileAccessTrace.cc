@@ -0,0 +1,400 @@
+/*
+ * Copyright (c) 2008-2014, Pedigree Developers
+ *
+ * Please see the CONTRIB file in the root of the source tree for a full
+ * list of contributors.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+#include "FileAccessTrace.h"
+#include "File.h"
+#include "VFS.h"
+#include "pedigree/kernel/LockGuard.h"
+#include "pedigree/kernel/Log.h"
+#include "pedigree/kernel/utilities/StaticString.h"
+#include "pedigree/kernel/utilities/utility.h"
+
+FileAccessTrace FileAccessTrace::m_Instance;
+
+const uint64_t FileAccessTrace::TraceGranularity = 0x1000;
+
+FileAccessTrace::FileAccessTrace()
+    : m_Records(), m_RecordsByPath(), m_RecordsByFile(), m_nExtents(0),
+      m_bTracing(false), m_Lock(false)
+{
+}
+
+FileAccessTrace::~FileAccessTrace()
+{
+    clearRecords();
+}
+
+FileAccessTrace &FileAccessTrace::instance()
+{
+    return m_Instance;
+}
+
+void FileAccessTrace::start()
+{
+    LockGuard<Mutex> guard(m_Lock);
+
+    clearRecords();
+    m_bTracing = true;
+}
+
+void FileAccessTrace::stop()
+{
+    LockGuard<Mutex> guard(m_Lock);
+
+    m_bTracing = false;
+}
+
+void FileAccessTrace::record(File *pFile, uint64_t location, uint64_t size)
+{
+    // Files with no filesystem (e.g. pipes) can't be found again later.
+    if (!m_bTracing || !size || !pFile->getFilesystem())
+    {
+        return;
+    }
+
+    LockGuard<Mutex> guard(m_Lock);
+    if (!m_bTracing)
+    {
+        return;
+    }
+
+    FileRecord *pRecord = m_RecordsByFile.lookup(pFile);
+    if (!pRecord)
+    {
+        pRecord = getRecord(pFile->getFullPath());
+        m_RecordsByFile.insert(pFile, pRecord);
+    }
+
+    addExtent(pRecord, location, size);
+}
+
+void FileAccessTrace::record(
+    const String &path, uint64_t location, uint64_t size)
+{
+    if (!m_bTracing || !size)
+    {
+        return;
+    }
+
+    LockGuard<Mutex> guard(m_Lock);
+    if (!m_bTracing)
+    {
+        return;
+    }
+
+    addExtent(getRecord(path), location, size);
+}
+
+void FileAccessTrace::forget(File *pFile)
+{
+    // Nothing is added to m_RecordsByFile unless tracing, and start() empties
+    // it, so a File destroyed while not tracing can't be in it next time.
+    if (!m_bTracing)
+    {
+        return;
+    }
+
+    LockGuard<Mutex> guard(m_Lock);
+    m_RecordsByFile.remove(pFile);
+}
+
+size_t FileAccessTrace::count() const
+{
+    return m_nExtents;
+}
+
+void FileAccessTrace::serialise(String &result)
+{
+    Vector<Entry> entries;
+
+    m_Lock.acquire();
+    for (auto pRecord : m_Records)
+    {
+        for (auto &extent : pRecord->extents)
+        {
+            Entry entry;
+            entry.path = pRecord->path;
+            entry.offset = extent.offset;
+            entry.length = extent.length;
+            entries.pushBack(entry);
+        }
+    }
+    m_Lock.release();
+
+    sortAndMerge(entries);
+
+    result.clear();
+    for (auto &entry : entries)
+    {
+        HugeStaticString line;
+        line += entry.offset;
+        line += " ";
+        line += entry.length;
+        line += " ";
+        line += entry.path.cstr();
+        line += "\n";
+
+        result += static_cast<const char *>(line);
+    }
+}
+
+void FileAccessTrace::sortAndMerge(Vector<Entry> &entries)
+{
+    size_t n = entries.count();
+
+    Vector<Entry *> order;
+    for (auto &entry : entries)
+    {
+        order.pushBack(&entry);
+    }
+
+    // Bottom-up merge sort by path, then offset.
+    Vector<Entry *> scratch(order);
+    for (size_t width = 1; width < n; width *= 2)
+    {
+        for (size_t lo = 0; lo < n; lo += 2 * width)
+        {
+            size_t mid = min(lo + width, n);
+            size_t hi = min(lo + (2 * width), n);
+            size_t i = lo, j = mid, k = lo;
+            while (i < mid && j < hi)
+            {
+                scratch[k++] =
+                    entryBefore(order[j], order[i]) ? order[j++] : order[i++];
+            }
+            while (i < mid)
+            {
+                scratch[k++] = order[i++];
+            }
+            while (j < hi)
+            {
+                scratch[k++] = order[j++];
+            }
+        }
+
+        for (size_t i = 0; i < n; ++i)
+        {
+            order[i] = scratch[i];
+        }
+    }
+
+    // Merge overlapping and adjacent extents of the same file.
+    Vector<Entry> result;
+    for (auto pEntry : order)
+    {
+        if (result.count())
+        {
+            Entry &last = result[result.count() - 1];
+            uint64_t lastEnd = last.offset + last.length;
+            if (pEntry->offset <= lastEnd && last.path == pEntry->path)
+            {
+                uint64_t end = pEntry->offset + pEntry->length;
+                if (end > lastEnd)
+                {
+                    last.length = end - last.offset;
+                }
+                continue;
+            }
+        }
+
+        result.pushBack(*pEntry);
+    }
+
+    entries = result;
+}
+
+bool FileAccessTrace::entryBefore(const Entry *a, const Entry *b)
+{
+    int cmp = StringCompare(a->path.cstr(), b->path.cstr());
+    if (cmp)
+    {
+        return cmp < 0;
+    }
+
+    return a->offset < b->offset;
+}
+
+void FileAccessTrace::parse(
+    const char *buffer, size_t length, Vector<Entry> &result)
+{
+    size_t pos = 0;
+    while (pos < length)
+    {
+        size_t end = pos;
+        while (end < length && buffer[end] != '\n')
+        {
+            ++end;
+        }
+
+        // Copy out the line so it's terminated for StringToUnsignedLong.
+        String line(&buffer[pos], end - pos);
+        pos = end + 1;
+
+        const char *s = line.cstr();
+        if (!line.length() || s[0] == '#')
+        {
+            continue;
+        }
+
+        char *next = nullptr;
+        uint64_t offset = StringToUnsignedLong(s, &next, 10);
+        if (next == s || *next != ' ')
+        {
+            continue;
+        }
+
+        s = next + 1;
+        uint64_t size = StringToUnsignedLong(s, &next, 10);
+        if (next == s || *next != ' ' || !next[1] || !size)
+        {
+            continue;
+        }
+
+        Entry entry;
+        entry.path.assign(next + 1);
+        entry.offset = offset;
+        entry.length = size;
+        result.pushBack(entry);
+    }
+}
+
+bool FileAccessTrace::save(const String &path)
+{
+    String contents;
+    serialise(contents);
+
+    File *pFile = VFS::instance().find(path);
+    if (!pFile)
+    {
+        if (!VFS::instance().createFile(path, 0644))
+        {
+            ERROR("FileAccessTrace: couldn't create " << path);
+            return false;
+        }
+
+        pFile = VFS::instance().find(path);
+    }
+
+    if (!pFile || pFile->isDirectory())
+    {
+        ERROR("FileAccessTrace: " << path << " is not a file");
+        return false;
+    }
+
+    pFile->truncate();
+
+    size_t length = contents.length();
+    if (length &&
+        pFile->write(
+            0, length,
+            reinterpret_cast<uintptr_t>(contents.cstr())) != length)
+    {
+        ERROR("FileAccessTrace: short write to " << path);
+        return false;
+    }
+
+    return true;
+}
+
+bool FileAccessTrace::load(const String &path, Vector<Entry> &result)
+{
+    File *pFile = VFS::instance().find(path);
+    if (!pFile || pFile->isDirectory())
+    {
+        return false;
+    }
+
+    size_t length = pFile->getSize();
+    if (!length)
+    {
+        return true;
+    }
+
+    char *buffer = new char[length];
+    size_t nRead =
+        pFile->read(0, length, reinterpret_cast<uintptr_t>(buffer));
+    parse(buffer, nRead, result);
+    delete[] buffer;
+
+    return true;
+}
+
+FileAccessTrace::FileRecord *FileAccessTrace::getRecord(const String &path)
+{
+    auto result = m_RecordsByPath.lookup(path);
+    if (result.hasValue())
+    {
+        return result.value();
+    }
+
+    FileRecord *pRecord = new FileRecord;
+    pRecord->path = path;
+    m_Records.pushBack(pRecord);
+    m_RecordsByPath.insert(path, pRecord);
+    return pRecord;
+}
+
+void FileAccessTrace::addExtent(
+    FileRecord *pRecord, uint64_t location, uint64_t size)
+{
+    uint64_t start = location & ~(TraceGranularity - 1);
+    uint64_t end =
+        (location + size + TraceGranularity - 1) & ~(TraceGranularity - 1);
+
+    // Most reads continue (or repeat) the previous one, so only the last
+    // extent is merged with here. serialise() does the full merge.
+    if (pRecord->extents.count())
+    {
+        Extent &last = pRecord->extents[pRecord->extents.count() - 1];
+        uint64_t lastEnd = last.offset + last.length;
+        if (start <= lastEnd && end >= last.offset)
+        {
+            if (start < last.offset)
+            {
+                last.offset = start;
+            }
+            if (end > lastEnd)
+            {
+                lastEnd = end;
+            }
+            last.length = lastEnd - last.offset;
+            return;
+        }
+    }
+
+    Extent extent;
+    extent.offset = start;
+    extent.length = end - start;
+    pRecord->extents.pushBack(extent);
+    ++m_nExtents;
+}
+
+void FileAccessTrace::clearRecords()
+{
+    for (auto pRecord : m_Records)
+    {
+        delete pRecord;
+    }
+
+    m_Records.clear();
+    m_RecordsByPath.clear();
+    m_RecordsByFile.clear();
+    m_nExtents = 0;
+}
@@ -0,0 +1,153 @@
+/*
+ * Copyright (c) 2008-2014, Pedigree Developers
+ *
+ * Please see the CONTRIB file in the root of the source tree for a full
+ * list of contributors.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+#ifndef VFS_FILEACCESSTRACE_H
+#define VFS_FILEACCESSTRACE_H
+
+#include "pedigree/kernel/compiler.h"
+#include "pedigree/kernel/process/Mutex.h"
+#include "pedigree/kernel/processor/types.h"
+#include "pedigree/kernel/utilities/FlatHashTable.h"
+#include "pedigree/kernel/utilities/String.h"
+#include "pedigree/kernel/utilities/StringView.h"
+#include "pedigree/kernel/utilities/Tree.h"
+#include "pedigree/kernel/utilities/Vector.h"
+
+class File;
+
+/**
+ * Records which parts of which files are read, so that a later boot can
+ * read them ahead of time (see the preload module).
+ *
+ * While tracing, File::read() reports every cached read here, and
+ * MemoryMappedFile reports every page fault on a mapped file. Reads are
+ * rounded out to TraceGranularity and merged with the previous extent of
+ * the same file where they touch, so sequential reads collapse into one
+ * extent as they happen.
+ *
+ * The trace is saved as plain text, one "offset length path" line per
+ * extent, sorted by path and then by offset so that a replay reads each
+ * file front to back, once.
+ */
+class EXPORTED_PUBLIC FileAccessTrace
+{
+  public:
+    /** One extent from a saved trace. */
+    struct Entry
+    {
+        String path;
+        uint64_t offset;
+        uint64_t length;
+    };
+
+    /** Reads are rounded out to this many bytes before being recorded. */
+    static const uint64_t TraceGranularity;
+
+    FileAccessTrace();
+    ~FileAccessTrace();
+
+    static FileAccessTrace &instance();
+
+    /** Discards any existing trace and starts recording. */
+    void start();
+    /** Stops recording. The trace is kept until the next start(). */
+    void stop();
+
+    bool isTracing() const
+    {
+        return m_bTracing;
+    }
+
+    /** Records a read of the given file. Ignored unless tracing. */
+    void record(File *pFile, uint64_t location, uint64_t size);
+    /** Records a read of the file at the given path. Ignored unless
+     *  tracing. */
+    void record(const String &path, uint64_t location, uint64_t size);
+
+    /** Called when a File is destroyed, so a later File at the same address
+     *  isn't taken for it. Anything already recorded for it is kept. */
+    void forget(File *pFile);
+
+    /** Number of extents recorded so far (before final merging). */
+    size_t count() const;
+
+    /** Serialises the trace, sorting and merging each file's extents. */
+    void serialise(String &result);
+
+    /** Sorts entries by path and then offset, and merges overlapping or
+     *  adjacent extents of the same file. */
+    static void sortAndMerge(Vector<Entry> &entries);
+
+    /** Parses a serialised trace, appending to \p result. Blank lines,
+     *  comments (starting with '#') and malformed lines are skipped. */
+    static void
+    parse(const char *buffer, size_t length, Vector<Entry> &result);
+
+    /** Saves the trace to the given path, replacing any existing file. */
+    bool save(const String &path);
+
+    /** Loads a trace from the given path, appending to \p result. */
+    static bool load(const String &path, Vector<Entry> &result);
+
+  private:
+    FileAccessTrace(const FileAccessTrace &);
+    FileAccessTrace &operator=(const FileAccessTrace &);
+
+    struct Extent
+    {
+        uint64_t offset;
+        uint64_t length;
+    };
+
+    struct FileRecord
+    {
+        String path;
+        Vector<Extent> extents;
+    };
+
+    /** Finds or creates the record for a path. Must hold m_Lock. */
+    FileRecord *getRecord(const String &path);
+    /** Adds an extent to a record. Must hold m_Lock. */
+    void addExtent(FileRecord *pRecord, uint64_t location, uint64_t size);
+
+    /** Frees all records. Must hold m_Lock. */
+    void clearRecords();
+
+    /** Ordering for sortAndMerge(). */
+    static bool entryBefore(const Entry *a, const Entry *b);
+
+    static FileAccessTrace m_Instance;
+
+    /** Records, in order of first access. */
+    Vector<FileRecord *> m_Records;
+    /** Records by path. */
+    FlatHashTable<String, FileRecord *, HashedStringView> m_RecordsByPath;
+    /** Records by File object, so paths are only resolved once per file.
+     *  Entries are removed by forget() when their File goes away. */
+    Tree<File *, FileRecord *> m_RecordsByFile;
+    /** Number of extents across all records. */
+    size_t m_nExtents;
+
+    volatile bool m_bTracing;
+
+    Mutex m_Lock;
+};
+
+#endif
@@ -19,6 +19,7 @@
 
 #include "MemoryMappedFile.h"
 #include "File.h"
+#include "FileAccessTrace.h"
 #include "pedigree/kernel/LockGuard.h"
 #include "pedigree/kernel/Log.h"
 #include "pedigree/kernel/Spinlock.h"
@@ -39,6 +40,9 @@ MemoryMapManager MemoryMapManager::m_Instance;
 
 physical_uintptr_t AnonymousMemoryMap::m_Zero = 0;
 
+const size_t MemoryMappedFile::MappingLeafSize;
+size_t MemoryMappedFile::m_FaultAroundPages = 16;
+
 // #define DEBUG_MMOBJECTS
 
 MemoryMappedObject::~MemoryMappedObject()
@@ -346,7 +350,8 @@ MemoryMappedFile::MemoryMappedFile(
     uintptr_t address, size_t length, size_t offset, File *backing,
     bool bCopyOnWrite, MemoryMappedObject::Permissions perms)
     : MemoryMappedObject(address, bCopyOnWrite, length, perms),
-      m_pBacking(backing), m_Offset(offset), m_Mappings(), m_Lock(false)
+      m_pBacking(backing), m_Offset(offset), m_Mappings(),
+      m_MappingBase(address), m_MappingCount(0), m_Lock(false)
 {
     assert(m_pBacking);
 }
@@ -354,23 +359,31 @@ MemoryMappedFile::MemoryMappedFile(
 MemoryMappedFile::~MemoryMappedFile()
 {
     unmap();
+    clearMappings();
 }
 
 MemoryMappedObject *MemoryMappedFile::clone()
 {
     LockGuard<Spinlock> guard(m_Lock);
 
+    size_t pageSz = PhysicalMemoryManager::getPageSize();
+
     MemoryMappedFile *pResult = new MemoryMappedFile(
         m_Address, m_Length, m_Offset, m_pBacking, m_bCopyOnWrite,
         m_Permissions);
-    pResult->m_Mappings = m_Mappings;
 
-    for (auto it = m_Mappings.begin(); it != m_Mappings.end(); ++it)
+    uintptr_t addr = m_Address;
+    physical_uintptr_t p = 0;
+    while (nextMapping(addr, p))
     {
+        pResult->trackMapping(addr, p);
+
         // Bump reference count on backing file page if needed.
-        size_t fileOffset = (it.key() - m_Address) + m_Offset;
-        if (it.value() == ~0UL)
+        size_t fileOffset = (addr - m_Address) + m_Offset;
+        if (p == ~0UL)
             m_pBacking->getPhysicalPage(fileOffset);
+
+        addr += pageSz;
     }
 
     return pResult;
@@ -412,8 +425,10 @@ MemoryMappedObject *MemoryMappedFile::split(uintptr_t at)
     for (uintptr_t virt = at; virt < oldEnd; virt += pageSz)
     {
         physical_uintptr_t old = getMapping(virt);
-        untrackMapping(virt);
+        if (!old)
+            continue;
 
+        untrackMapping(virt);
         pResult->trackMapping(virt, old);
     }
 
@@ -485,6 +500,7 @@ void MemoryMappedFile::setPermissions(MemoryMappedObject::Permissions perms)
     LockGuard<Spinlock> guard(m_Lock);
 
     VirtualAddressSpace &va = Processor::information().getVirtualAddressSpace();
+    size_t pageSz = PhysicalMemoryManager::getPageSize();
 
     if (perms == MemoryMappedObject::None)
     {
@@ -493,9 +509,11 @@ void MemoryMappedFile::setPermissions(MemoryMappedObject::Permissions perms)
     else
     {
         // Adjust any existing mappings in this object.
-        for (auto it = m_Mappings.begin(); it != m_Mappings.end(); ++it)
+        uintptr_t addr = m_Address;
+        physical_uintptr_t phys = 0;
+        for (; nextMapping(addr, phys); addr += pageSz)
         {
-            void *v = reinterpret_cast<void *>(it.key());
+            void *v = reinterpret_cast<void *>(addr);
             if (va.isMapped(v))
             {
                 physical_uintptr_t p;
@@ -682,6 +700,16 @@ void MemoryMappedFile::unmap()
 
 bool MemoryMappedFile::trap(uintptr_t address, bool bWrite)
 {
+    // Faults on pages that are already cached never reach File::read(), so
+    // tell the trace about them here, before taking the (spin)lock.
+    if (UNLIKELY(FileAccessTrace::instance().isTracing()))
+    {
+        size_t pageSz = PhysicalMemoryManager::getPageSize();
+        size_t pageOffset = (address & ~(pageSz - 1)) - m_Address;
+        FileAccessTrace::instance().record(
+            m_pBacking, m_Offset + pageOffset, pageSz);
+    }
+
     LockGuard<Spinlock> guard(m_Lock);
 
 #ifdef DEBUG_MMOBJECTS
@@ -755,6 +783,11 @@ bool MemoryMappedFile::trap(uintptr_t address, bool bWrite)
         }
 
         trackMapping(address, ~0);
+
+        if (!bWrite)
+        {
+            faultAround(address, flags | extraFlags);
+        }
     }
     else
     {
@@ -887,6 +920,12 @@ bool MemoryMappedFile::compact()
     return bReleased;
 }
 
+size_t MemoryMappedFile::reclaimablePages()
+{
+    LockGuard<Spinlock> guard(m_Lock);
+    return getMappingCount();
+}
+
 void MemoryMappedFile::unmapUnlocked()
 {
 #ifdef DEBUG_MMOBJECTS
@@ -894,13 +933,16 @@ void MemoryMappedFile::unmapUnlocked()
 #endif
 
     VirtualAddressSpace &va = Processor::information().getVirtualAddressSpace();
+    size_t pageSz = PhysicalMemoryManager::getPageSize();
 
     if (!getMappingCount())
         return;
 
-    for (auto it = m_Mappings.begin(); it != m_Mappings.end(); ++it)
+    uintptr_t addr = m_Address;
+    physical_uintptr_t p = 0;
+    for (; nextMapping(addr, p); addr += pageSz)
     {
-        void *v = reinterpret_cast<void *>(it.key());
+        void *v = reinterpret_cast<void *>(addr);
         if (!va.isMapped(v))
             break;  // Already unmapped...
 
@@ -909,10 +951,9 @@ void MemoryMappedFile::unmapUnlocked()
         va.getMapping(v, phys, flags);
         va.unmap(v);
 
-        physical_uintptr_t p = it.value();
         if (p == ~0UL)
         {
-            size_t fileOffset = (it.key() - m_Address) + m_Offset;
+            size_t fileOffset = (addr - m_Address) + m_Offset;
             m_pBacking->returnPhysicalPage(fileOffset);
 
             // Only sync back to the backing store if the page was actually
@@ -928,32 +969,202 @@ void MemoryMappedFile::unmapUnlocked()
     clearMappings();
 }
 
+void MemoryMappedFile::setFaultAroundPages(size_t nPages)
+{
+    size_t window = 1;
+    while ((window << 1) <= nPages)
+        window <<= 1;
+
+    m_FaultAroundPages = window;
+}
+
+size_t MemoryMappedFile::getFaultAroundPages()
+{
+    return m_FaultAroundPages;
+}
+
+void MemoryMappedFile::faultAround(uintptr_t address, size_t flags)
+{
+    if (m_FaultAroundPages <= 1)
+        return;
+
+    VirtualAddressSpace &va = Processor::information().getVirtualAddressSpace();
+    size_t pageSz = PhysicalMemoryManager::getPageSize();
+
+    size_t windowSz = m_FaultAroundPages * pageSz;
+    uintptr_t start = address & ~(windowSz - 1);
+    uintptr_t end = start + windowSz;
+
+    // A copy-on-write mapping has to copy a partial last page (to zero the
+    // tail), so that page is left to trap as usual.
+    uintptr_t objEnd = m_Address + m_Length;
+    if (m_bCopyOnWrite)
+        objEnd &= ~(pageSz - 1);
+    else
+        objEnd = (objEnd + pageSz - 1) & ~(pageSz - 1);
+
+    if (start < m_Address)
+        start = m_Address;
+    if (end > objEnd)
+        end = objEnd;
+
+    size_t nMapped = 0;
+    for (uintptr_t virt = start; virt < end; virt += pageSz)
+    {
+        if (virt == address || getMapping(virt))
+            continue;
+
+        void *v = reinterpret_cast<void *>(virt);
+        if (va.isMapped(v))
+            continue;
+
+        // Only pages that are already cached - never wait on I/O here.
+        size_t fileOffset = (virt - m_Address) + m_Offset;
+        physical_uintptr_t phys = m_pBacking->getPhysicalPage(fileOffset);
+        if (phys == ~0UL)
+            continue;
+
+        if (!va.map(phys, v, flags))
+        {
+            m_pBacking->returnPhysicalPage(fileOffset);
+            break;
+        }
+
+        trackMapping(virt, ~0UL);
+        ++nMapped;
+    }
+
+#ifdef DEBUG_MMOBJECTS
+    DEBUG_LOG(" -> fault-around mapped " << nMapped << " extra pages");
+#else
+    (void) nMapped;
+#endif
+}
+
 void MemoryMappedFile::trackMapping(uintptr_t addr, physical_uintptr_t phys)
 {
-    m_Mappings.insert(addr, phys);
+    if (!phys)
+    {
+        untrackMapping(addr);
+        return;
+    }
+
+    size_t page = (addr - m_MappingBase) / PhysicalMemoryManager::getPageSize();
+    size_t dir = page / MappingLeafSize;
+
+    while (m_Mappings.count() <= dir)
+        m_Mappings.pushBack(0);
+
+    physical_uintptr_t *leaf = m_Mappings[dir];
+    if (!leaf)
+    {
+        leaf = new physical_uintptr_t[MappingLeafSize];
+        ByteSet(leaf, 0, sizeof(physical_uintptr_t) * MappingLeafSize);
+        m_Mappings[dir] = leaf;
+    }
+
+    physical_uintptr_t &entry = leaf[page % MappingLeafSize];
+    if (!entry)
+        ++m_MappingCount;
+    entry = phys;
 }
 
 void MemoryMappedFile::untrackMapping(uintptr_t addr)
 {
-    m_Mappings.remove(addr);
+    size_t page = (addr - m_MappingBase) / PhysicalMemoryManager::getPageSize();
+    size_t dir = page / MappingLeafSize;
+    if (dir >= m_Mappings.count() || !m_Mappings[dir])
+        return;
+
+    physical_uintptr_t &entry = m_Mappings[dir][page % MappingLeafSize];
+    if (entry)
+        --m_MappingCount;
+    entry = 0;
 }
 
 physical_uintptr_t MemoryMappedFile::getMapping(uintptr_t addr)
 {
-    return m_Mappings.lookup(addr);
+    size_t page = (addr - m_MappingBase) / PhysicalMemoryManager::getPageSize();
+    size_t dir = page / MappingLeafSize;
+    if (dir >= m_Mappings.count() || !m_Mappings[dir])
+        return 0;
+
+    return m_Mappings[dir][page % MappingLeafSize];
 }
 
 size_t MemoryMappedFile::getMappingCount()
 {
-    return m_Mappings.count();
+    return m_MappingCount;
 }
 
 void MemoryMappedFile::clearMappings()
 {
+    for (size_t i = 0; i < m_Mappings.count(); ++i)
+    {
+        delete[] m_Mappings[i];
+    }
+
     m_Mappings.clear();
+    m_MappingCount = 0;
+
+    // Nothing is indexed any more, so the table can start afresh at the
+    // current start of the object.
+    m_MappingBase = m_Address;
 }
 
-MemoryMapManager::MemoryMapManager() : m_MmObjectLists(), m_Lock()
+bool MemoryMappedFile::nextMapping(uintptr_t &addr, physical_uintptr_t &phys)
+{
+    size_t pageSz = PhysicalMemoryManager::getPageSize();
+    uintptr_t end = m_Address + m_Length;
+
+    if (addr < m_Address)
+        addr = m_Address;
+
+    while (addr < end)
+    {
+        size_t page = (addr - m_MappingBase) / pageSz;
+        size_t dir = page / MappingLeafSize;
+        if (dir >= m_Mappings.count())
+            return false;
+
+        physical_uintptr_t *leaf = m_Mappings[dir];
+        if (!leaf)
+        {
+            // Skip the rest of this leaf in one go.
+            addr = m_MappingBase + ((dir + 1) * MappingLeafSize * pageSz);
+            continue;
+        }
+
+        physical_uintptr_t p = leaf[page % MappingLeafSize];
+        if (p)
+        {
+            phys = p;
+            return true;
+        }
+
+        addr += pageSz;
+    }
+
+    return false;
+}
+
+void MemoryMapManager::MmObjectTree::add(MemoryMappedObject *pObject)
+{
+    // Traps are matched against page-aligned addresses, so an object that
+    // ends midway through a page still covers the rest of it.
+    size_t pageSz = PhysicalMemoryManager::getPageSize();
+    uintptr_t end = pObject->address() + pObject->length();
+    end = (end + pageSz - 1) & ~(pageSz - 1);
+
+    objects.insert(pObject->address(), end, pObject);
+}
+
+bool MemoryMapManager::MmObjectTree::remove(MemoryMappedObject *pObject)
+{
+    return objects.remove(pObject->address(), pObject);
+}
+
+MemoryMapManager::MemoryMapManager() : m_MmObjectTrees(), m_Lock()
 {
     PageFaultHandler::instance().registerHandler(this);
     MemoryPressureManager::instance().registerHandler(
@@ -965,6 +1176,21 @@ MemoryMapManager::~MemoryMapManager()
     MemoryPressureManager::instance().removeHandler(this);
 }
 
+MemoryMapManager::MmObjectTree *
+MemoryMapManager::getObjects(VirtualAddressSpace *va, bool bCreate)
+{
+    LockGuard<Spinlock> guard(m_Lock);
+
+    MmObjectTree *pTree = m_MmObjectTrees.lookup(va);
+    if (!pTree && bCreate)
+    {
+        pTree = new MmObjectTree();
+        m_MmObjectTrees.insert(va, pTree);
+    }
+
+    return pTree;
+}
+
 MemoryMappedObject *MemoryMapManager::mapFile(
     File *pFile, uintptr_t &address, size_t length,
     MemoryMappedObject::Permissions perms, size_t offset, bool bCopyOnWrite)
@@ -995,18 +1221,10 @@ MemoryMappedObject *MemoryMapManager::mapFile(
     MemoryMappedFile *pMappedFile = new MemoryMappedFile(
         address, actualLength, offset, pFile, bCopyOnWrite, perms);
 
+    MmObjectTree *pTree = getObjects(&va, true);
     {
-        // This operation must appear atomic.
-        LockGuard<Spinlock> guard(m_Lock);
-
-        MmObjectList *pMmObjectList = m_MmObjectLists.lookup(&va);
-        if (!pMmObjectList)
-        {
-            pMmObjectList = new MmObjectList();
-            m_MmObjectLists.insert(&va, pMmObjectList);
-        }
-
-        pMmObjectList->pushBack(pMappedFile);
+        LockGuard<RWLock> guard(pTree->lock);
+        pTree->add(pMappedFile);
     }
 
     // Success.
@@ -1038,18 +1256,10 @@ MemoryMappedObject *MemoryMapManager::mapAnon(
 #endif
     AnonymousMemoryMap *pMap = new AnonymousMemoryMap(address, length, perms);
 
+    MmObjectTree *pTree = getObjects(&va, true);
     {
-        // This operation must appear atomic.
-        LockGuard<Spinlock> guard(m_Lock);
-
-        MmObjectList *pMmObjectList = m_MmObjectLists.lookup(&va);
-        if (!pMmObjectList)
-        {
-            pMmObjectList = new MmObjectList();
-            m_MmObjectLists.insert(&va, pMmObjectList);
-        }
-
-        pMmObjectList->pushBack(pMap);
+        LockGuard<RWLock> guard(pTree->lock);
+        pTree->add(pMap);
     }
 
     // Success.
@@ -1058,28 +1268,23 @@ MemoryMappedObject *MemoryMapManager::mapAnon(
 
 void MemoryMapManager::clone(Process *pProcess)
 {
-    LockGuard<Spinlock> guard(m_Lock);
-
     VirtualAddressSpace &va = Processor::information().getVirtualAddressSpace();
     VirtualAddressSpace *pOtherVa = pProcess->getAddressSpace();
 
-    MmObjectList *pMmObjectList = m_MmObjectLists.lookup(&va);
-    if (!pMmObjectList)
+    MmObjectTree *pTree = getObjects(&va);
+    if (!pTree)
         return;
 
-    MmObjectList *pMmObjectList2 = m_MmObjectLists.lookup(pOtherVa);
-    if (!pMmObjectList2)
-    {
-        pMmObjectList2 = new MmObjectList();
-        m_MmObjectLists.insert(pOtherVa, pMmObjectList2);
-    }
+    MmObjectTree *pTree2 = getObjects(pOtherVa, true);
+
+    ReadLockGuard guard(pTree->lock);
+    LockGuard<RWLock> guard2(pTree2->lock);
 
-    for (List<MemoryMappedObject *>::Iterator it = pMmObjectList->begin();
-         it != pMmObjectList->end(); it++)
+    Vector<MemoryMappedObject *> objects;
+    pTree->objects.values(objects);
+    for (auto pObject : objects)
     {
-        MemoryMappedObject *obj = *it;
-        MemoryMappedObject *pNewObject = obj->clone();
-        pMmObjectList2->pushBack(pNewObject);
+        pTree2->add(pObject->clone());
     }
 }
 
@@ -1102,24 +1307,20 @@ size_t MemoryMapManager::remove(uintptr_t base, size_t length)
 
     uintptr_t removeEnd = base + length;
 
-    m_Lock.acquire();
-
-    MmObjectList *pMmObjectList = m_MmObjectLists.lookup(&va);
-    if (!pMmObjectList)
+    MmObjectTree *pTree = getObjects(&va);
+    if (!pTree)
     {
-        m_Lock.release();
         return 0;
     }
 
-    for (List<MemoryMappedObject *>::Iterator it = pMmObjectList->begin();
-         it != pMmObjectList->end();)
-    {
-        MemoryMappedObject *pObject = *it;
+    LockGuard<RWLock> guard(pTree->lock);
 
-        // Whether or not  it = x.erase() was called - because we should not
-        // increment an iterator if so.
-        bool bErased = false;
+    // Only objects overlapping the range can be affected.
+    Vector<MemoryMappedObject *> objects;
+    pTree->objects.overlapping(base, removeEnd, objects);
 
+    for (auto pObject : objects)
+    {
         uintptr_t objEnd = pObject->address() + pObject->length();
 
 #ifdef DEBUG_MMOBJECTS
@@ -1135,15 +1336,12 @@ size_t MemoryMapManager::remove(uintptr_t base, size_t length)
             objAlignEnd &= ~(pageSz - 1);
         }
 
-        // Avoid?
-        if (pObject->address() == removeEnd)
-        {
-            ++it;
-            continue;
-        }
+        // Every case below changes the object's extent, so it has to come
+        // out of the index first. Survivors are put back afterwards.
+        pTree->remove(pObject);
 
         // Direct removal?
-        else if (pObject->address() == base)
+        if (pObject->address() == base)
         {
 #ifdef DEBUG_MMOBJECTS
             NOTICE("MemoryMapManager::remove() - a direct removal");
@@ -1151,9 +1349,11 @@ size_t MemoryMapManager::remove(uintptr_t base, size_t length)
             bool bAll = pObject->remove(length);
             if (bAll)
             {
-                it = pMmObjectList->erase(it);
                 delete pObject;
-                bErased = true;
+            }
+            else
+            {
+                pTree->add(pObject);
             }
         }
 
@@ -1164,11 +1364,17 @@ size_t MemoryMapManager::remove(uintptr_t base, size_t length)
             NOTICE("MemoryMapManager::remove() - fully enclosed removal");
 #endif
             MemoryMappedObject *pNewObject = pObject->split(base);
+            pTree->add(pObject);
+
             bool bAll = pNewObject->remove(removeEnd - base);
-            if (!bAll)
+            if (bAll)
+            {
+                delete pNewObject;
+            }
+            else
             {
                 // Remainder not fully removed - add to housekeeping.
-                pMmObjectList->pushBack(pNewObject);
+                pTree->add(pNewObject);
             }
         }
 
@@ -1183,10 +1389,7 @@ size_t MemoryMapManager::remove(uintptr_t base, size_t length)
 #endif
             // Outright unmap.
             pObject->unmap();
-
-            it = pMmObjectList->erase(it);
             delete pObject;
-            bErased = true;
         }
 
         // End is within the object, start is before the object.
@@ -1200,12 +1403,9 @@ size_t MemoryMapManager::remove(uintptr_t base, size_t length)
             MemoryMappedObject *pNewObject = pObject->split(removeEnd);
 
             pObject->unmap();
-
-            it = pMmObjectList->erase(it);
             delete pObject;
-            bErased = true;
 
-            pMmObjectList->pushBack(pNewObject);
+            pTree->add(pNewObject);
         }
 
         // Start is within the object, end is past the end of the object.
@@ -1219,6 +1419,8 @@ size_t MemoryMapManager::remove(uintptr_t base, size_t length)
             MemoryMappedObject *pNewObject = pObject->split(base);
             pNewObject->unmap();
             delete pNewObject;
+
+            pTree->add(pObject);
         }
 
         // Nothing!
@@ -1227,20 +1429,13 @@ size_t MemoryMapManager::remove(uintptr_t base, size_t length)
 #ifdef DEBUG_MMOBJECTS
             NOTICE("MemoryMapManager::remove() - doing nothing!");
 #endif
-            ++it;
+            pTree->add(pObject);
             continue;
         }
 
-        if (!bErased)
-        {
-            ++it;
-        }
-
         ++nAffected;
     }
 
-    m_Lock.release();
-
     return nAffected;
 }
 
@@ -1265,20 +1460,19 @@ size_t MemoryMapManager::setPermissions(
 
     uintptr_t removeEnd = base + length;
 
-    m_Lock.acquire();
-
-    MmObjectList *pMmObjectList = m_MmObjectLists.lookup(&va);
-    if (!pMmObjectList)
+    MmObjectTree *pTree = getObjects(&va);
+    if (!pTree)
     {
-        m_Lock.release();
         return 0;
     }
 
-    for (List<MemoryMappedObject *>::Iterator it = pMmObjectList->begin();
-         it != pMmObjectList->end(); ++it)
-    {
-        MemoryMappedObject *pObject = *it;
+    LockGuard<RWLock> guard(pTree->lock);
 
+    Vector<MemoryMappedObject *> objects;
+    pTree->objects.overlapping(base, removeEnd, objects);
+
+    for (auto pObject : objects)
+    {
         uintptr_t objEnd = pObject->address() + pObject->length();
 
 #ifdef DEBUG_MMOBJECTS
@@ -1294,14 +1488,11 @@ size_t MemoryMapManager::setPermissions(
             objAlignEnd &= ~(pageSz - 1);
         }
 
-        // Avoid?
-        if (pObject->address() == removeEnd)
-        {
-            continue;
-        }
+        // Splits change the object's extent, so re-index it afterwards.
+        pTree->remove(pObject);
 
         // Direct?
-        else if (pObject->address() == base)
+        if (pObject->address() == base)
         {
 #ifdef DEBUG_MMOBJECTS
             NOTICE("MemoryMapManager::setPermissions() - a direct set");
@@ -1310,7 +1501,7 @@ size_t MemoryMapManager::setPermissions(
             {
                 // Split needed.
                 MemoryMappedObject *pNewObject = pObject->split(base + length);
-                pMmObjectList->pushBack(pNewObject);
+                pTree->add(pNewObject);
             }
 
             pObject->setPermissions(perms);
@@ -1327,11 +1518,11 @@ size_t MemoryMapManager::setPermissions(
             if (removeEnd < objAlignEnd)
             {
                 MemoryMappedObject *pTailObject = pNewObject->split(removeEnd);
-                pMmObjectList->pushBack(pTailObject);
+                pTree->add(pTailObject);
             }
 
             pNewObject->setPermissions(perms);
-            pMmObjectList->pushBack(pNewObject);
+            pTree->add(pNewObject);
         }
 
         // Object in the middle of the parameters (neither begin or end inside)
@@ -1359,7 +1550,7 @@ size_t MemoryMapManager::setPermissions(
             MemoryMappedObject *pNewObject = pObject->split(removeEnd);
 
             pObject->setPermissions(perms);
-            pMmObjectList->pushBack(pNewObject);
+            pTree->add(pNewObject);
         }
 
         // Start is within the object, end is past the end of the object.
@@ -1373,7 +1564,7 @@ size_t MemoryMapManager::setPermissions(
 #endif
             MemoryMappedObject *pNewObject = pObject->split(base);
             pNewObject->setPermissions(perms);
-            pMmObjectList->pushBack(pNewObject);
+            pTree->add(pNewObject);
         }
 
         // Nothing!
@@ -1382,14 +1573,14 @@ size_t MemoryMapManager::setPermissions(
 #ifdef DEBUG_MMOBJECTS
             NOTICE("MemoryMapManager::setPermissions() - doing nothing!");
 #endif
+            pTree->add(pObject);
             continue;
         }
 
+        pTree->add(pObject);
         ++nAffected;
     }
 
-    m_Lock.release();
-
     return nAffected;
 }
 
@@ -1398,28 +1589,17 @@ bool MemoryMapManager::contains(uintptr_t base, size_t length)
     VirtualAddressSpace &va = Processor::information().getVirtualAddressSpace();
     size_t pageSz = PhysicalMemoryManager::getPageSize();
 
-    LockGuard<Spinlock> guard(m_Lock);
-
-    MmObjectList *pMmObjectList = m_MmObjectLists.lookup(&va);
-    if (!pMmObjectList)
+    MmObjectTree *pTree = getObjects(&va);
+    if (!pTree)
     {
         return false;
     }
 
-    for (uintptr_t address = base; address < (base + length); address += pageSz)
-    {
-        for (List<MemoryMappedObject *>::Iterator it = pMmObjectList->begin();
-             it != pMmObjectList->end(); it++)
-        {
-            MemoryMappedObject *pObject = *it;
-            if (pObject->matches(address & ~(pageSz - 1)))
-            {
-                return true;
-            }
-        }
-    }
+    ReadLockGuard guard(pTree->lock);
 
-    return false;
+    Vector<MemoryMappedObject *> objects;
+    pTree->objects.overlapping(base & ~(pageSz - 1), base + length, objects);
+    return objects.count() > 0;
 }
 
 void MemoryMapManager::op(
@@ -1428,39 +1608,34 @@ void MemoryMapManager::op(
     VirtualAddressSpace &va = Processor::information().getVirtualAddressSpace();
     size_t pageSz = PhysicalMemoryManager::getPageSize();
 
-    m_Lock.acquire();
-
-    MmObjectList *pMmObjectList = m_MmObjectLists.lookup(&va);
-    if (!pMmObjectList)
+    MmObjectTree *pTree = getObjects(&va);
+    if (!pTree)
     {
-        m_Lock.release();
         return;
     }
 
+    ReadLockGuard guard(pTree->lock);
+
     for (uintptr_t address = base; address < (base + length); address += pageSz)
     {
-        for (List<MemoryMappedObject *>::Iterator it = pMmObjectList->begin();
-             it != pMmObjectList->end(); it++)
+        MemoryMappedObject *pObject = 0;
+        if (!pTree->objects.lookup(address & ~(pageSz - 1), pObject))
         {
-            MemoryMappedObject *pObject = *it;
-            if (pObject->matches(address & ~(pageSz - 1)))
-            {
-                switch (what)
-                {
-                    case Sync:
-                        pObject->sync(address, async);
-                        break;
-                    case Invalidate:
-                        pObject->invalidate(address);
-                        break;
-                    default:
-                        WARNING("Bad 'what' in MemoryMapManager::op()");
-                }
-            }
+            continue;
         }
-    }
 
-    m_Lock.release();
+        switch (what)
+        {
+            case Sync:
+                pObject->sync(address, async);
+                break;
+            case Invalidate:
+                pObject->invalidate(address);
+                break;
+            default:
+                WARNING("Bad 'what' in MemoryMapManager::op()");
+        }
+    }
 }
 
 void MemoryMapManager::sync(uintptr_t base, size_t length, bool async)
@@ -1475,26 +1650,19 @@ void MemoryMapManager::invalidate(uintptr_t base, size_t length)
 
 void MemoryMapManager::unmap(MemoryMappedObject *pObj)
 {
-    LockGuard<Spinlock> guard(m_Lock);
-
     VirtualAddressSpace &va = Processor::information().getVirtualAddressSpace();
 
-    MmObjectList *pMmObjectList = m_MmObjectLists.lookup(&va);
-    if (!pMmObjectList)
+    MmObjectTree *pTree = getObjects(&va);
+    if (!pTree)
         return;
 
-    for (List<MemoryMappedObject *>::Iterator it = pMmObjectList->begin();
-         it != pMmObjectList->end(); ++it)
-    {
-        if ((*it) != pObj)
-            continue;
-
-        (*it)->unmap();
-        delete (*it);
+    LockGuard<RWLock> guard(pTree->lock);
 
-        pMmObjectList->erase(it);
+    if (!pTree->remove(pObj))
         return;
-    }
+
+    pObj->unmap();
+    delete pObj;
 }
 
 void MemoryMapManager::unmapAll()
@@ -1522,53 +1690,45 @@ bool MemoryMapManager::trap(
     VirtualAddressSpace &va = Processor::information().getVirtualAddressSpace();
     size_t pageSz = PhysicalMemoryManager::getPageSize();
 
-    m_Lock.acquire();
-#ifdef DEBUG_MMOBJECTS
-    NOTICE_NOLOCK("trap: got lock");
-#endif
-
-    MmObjectList *pMmObjectList = m_MmObjectLists.lookup(&va);
-    if (!pMmObjectList)
+    // Only the lookup of the address space is global; traps in different
+    // address spaces don't contend past this point.
+    MmObjectTree *pTree = getObjects(&va);
+    if (!pTree)
     {
-        m_Lock.release();
         return false;
     }
 
 #ifdef DEBUG_MMOBJECTS
     NOTICE_NOLOCK(
-        "trap: lookup complete " << reinterpret_cast<uintptr_t>(pMmObjectList));
+        "trap: lookup complete " << reinterpret_cast<uintptr_t>(pTree));
 #endif
 
-    for (List<MemoryMappedObject *>::Iterator it = pMmObjectList->begin();
-         it != pMmObjectList->end(); it++)
+    // Passing in a page-aligned address means we handle the case where
+    // a mapping ends midway through a page and a trap happens after this.
+    // Because we map in terms of pages, but store unaligned 'actual'
+    // lengths (for proper page zeroing etc), this is necessary.
+    MemoryMappedObject *pObject = 0;
+    bool bFound = false;
+    {
+        ReadLockGuard guard(pTree->lock);
+        bFound = pTree->objects.lookup(address & ~(pageSz - 1), pObject);
+    }
+
+    if (!bFound)
     {
-        MemoryMappedObject *pObject = *it;
 #ifdef DEBUG_MMOBJECTS
-        NOTICE_NOLOCK("mmobj=" << reinterpret_cast<uintptr_t>(pObject));
-        if (!pObject)
-        {
-            NOTICE_NOLOCK("bad mmobj, should create a real #PF and backtrace");
-            break;
-        }
+        ERROR(
+            "MemoryMapManager::trap() could not find an object for "
+            << address);
 #endif
-
-        // Passing in a page-aligned address means we handle the case where
-        // a mapping ends midway through a page and a trap happens after this.
-        // Because we map in terms of pages, but store unaligned 'actual'
-        // lengths (for proper page zeroing etc), this is necessary.
-        if (pObject->matches(address & ~(pageSz - 1)))
-        {
-            m_Lock.release();
-            return pObject->trap(address, bIsWrite);
-        }
+        return false;
     }
 
 #ifdef DEBUG_MMOBJECTS
-    ERROR("MemoryMapManager::trap() could not find an object for " << address);
+    NOTICE_NOLOCK("mmobj=" << reinterpret_cast<uintptr_t>(pObject));
 #endif
-    m_Lock.release();
 
-    return false;
+    return pObject->trap(address, bIsWrite);
 }
 
 bool MemoryMapManager::sanitiseAddress(uintptr_t &address, size_t length)
@@ -1603,28 +1763,44 @@ bool MemoryMapManager::sanitiseAddress(uintptr_t &address, size_t length)
     return true;
 }
 
+
 bool MemoryMapManager::compact()
 {
+    // Address spaces can't be torn down while we hold the lock, but we can't
+    // wait for it: getObjects() may be allocating under it on this CPU.
+    if (m_Lock.acquired())
+        return false;
+    LockGuard<Spinlock> guard(m_Lock);
+
     // Track current address space as we need to switch into each known address
     // space in order to compact them.
     VirtualAddressSpace &currva =
         Processor::information().getVirtualAddressSpace();
 
     bool bCompact = false;
-    for (Tree<VirtualAddressSpace *, MmObjectList *>::Iterator it =
-             m_MmObjectLists.begin();
-         it != m_MmObjectLists.end(); ++it)
+    for (Tree<VirtualAddressSpace *, MmObjectTree *>::Iterator it =
+             m_MmObjectTrees.begin();
+         it != m_MmObjectTrees.end(); ++it)
     {
+        MmObjectTree *pTree = it.value();
+
+        // Don't wait on an address space that's busy changing its mappings.
+        if (!pTree->lock.tryAcquireRead())
+            continue;
+
         Processor::switchAddressSpace(*it.key());
 
-        for (MmObjectList::Iterator it2 = it.value()->begin();
-             it2 != it.value()->end(); ++it2)
+        Vector<MemoryMappedObject *> objects;
+        pTree->objects.values(objects);
+        for (auto pObject : objects)
         {
-            bCompact = (*it2)->compact();
+            bCompact = pObject->compact();
             if (bCompact)
                 break;
         }
 
+        pTree->lock.releaseRead();
+
         if (bCompact)
             break;
     }
@@ -1640,6 +1816,83 @@ bool MemoryMapManager::compact()
     return false;
 }
 
+size_t MemoryMapManager::reclaimablePages()
+{
+    // As in compact(), a busy lock means there's nothing we can safely count.
+    if (m_Lock.acquired())
+        return 0;
+    LockGuard<Spinlock> guard(m_Lock);
+
+    size_t total = 0;
+    for (Tree<VirtualAddressSpace *, MmObjectTree *>::Iterator it =
+             m_MmObjectTrees.begin();
+         it != m_MmObjectTrees.end(); ++it)
+    {
+        MmObjectTree *pTree = it.value();
+        if (!pTree->lock.tryAcquireRead())
+            continue;
+
+        Vector<MemoryMappedObject *> objects;
+        pTree->objects.values(objects);
+        for (auto pObject : objects)
+        {
+            total += pObject->reclaimablePages();
+        }
+
+        pTree->lock.releaseRead();
+    }
+
+    return total;
+}
+
+size_t MemoryMapManager::shrink(size_t nPages)
+{
+    // As in compact(), this also stops us switching into an address space
+    // that's in the middle of being destroyed.
+    if (m_Lock.acquired())
+        return 0;
+    LockGuard<Spinlock> guard(m_Lock);
+
+    VirtualAddressSpace &currva =
+        Processor::information().getVirtualAddressSpace();
+
+    // As with compact(), pages are only unpinned here; the Cache handler
+    // frees them afterwards.
+    size_t released = 0;
+    for (Tree<VirtualAddressSpace *, MmObjectTree *>::Iterator it =
+             m_MmObjectTrees.begin();
+         (it != m_MmObjectTrees.end()) && (released < nPages); ++it)
+    {
+        MmObjectTree *pTree = it.value();
+        if (!pTree->lock.tryAcquireRead())
+            continue;
+
+        Processor::switchAddressSpace(*it.key());
+
+        Vector<MemoryMappedObject *> objects;
+        pTree->objects.values(objects);
+        for (size_t i = 0; (i < objects.count()) && (released < nPages); ++i)
+        {
+            MemoryMappedObject *pObject = objects[i];
+
+            size_t before = pObject->reclaimablePages();
+            if (!before || !pObject->compact())
+            {
+                continue;
+            }
+
+            size_t after = pObject->reclaimablePages();
+            released += before > after ? before - after : 0;
+        }
+
+        pTree->lock.releaseRead();
+    }
+
+    Processor::switchAddressSpace(currva);
+
+    return released;
+}
+
 void MemoryMapManager::unmapAllUnlocked()
 {
     if (!m_Lock.acquired())
@@ -1650,21 +1903,23 @@ void MemoryMapManager::unmapAllUnlocked()
 
     VirtualAddressSpace &va = Processor::information().getVirtualAddressSpace();
 
-    MmObjectList *pMmObjectList = m_MmObjectLists.lookup(&va);
-    if (!pMmObjectList)
+    MmObjectTree *pTree = m_MmObjectTrees.lookup(&va);
+    if (!pTree)
         return;
 
-    for (List<MemoryMappedObject *>::Iterator it = pMmObjectList->begin();
-         it != pMmObjectList->end(); it = pMmObjectList->begin())
-    {
-        (*it)->unmap();
-        delete (*it);
+    // The address space is going away, so nothing else can be using its
+    // objects; once it's out of the cache nobody can find them either.
+    m_MmObjectTrees.remove(&va);
 
-        pMmObjectList->erase(it);
+    Vector<MemoryMappedObject *> objects;
+    pTree->objects.values(objects);
+    for (auto pObject : objects)
+    {
+        pObject->unmap();
+        delete pObject;
     }
 
-    delete pMmObjectList;
-    m_MmObjectLists.remove(&va);
+    delete pTree;
 }
 
 bool MemoryMapManager::acquireLock()
@@ -23,12 +23,15 @@
 #include "pedigree/kernel/Spinlock.h"
 #include "pedigree/kernel/compiler.h"
 #include "pedigree/kernel/process/MemoryPressureManager.h"
+#include "pedigree/kernel/process/RWLock.h"
 #include "pedigree/kernel/processor/PageFaultHandler.h"
 #include "pedigree/kernel/processor/state_forward.h"
 #include "pedigree/kernel/processor/types.h"
+#include "pedigree/kernel/utilities/IntervalTree.h"
 #include "pedigree/kernel/utilities/List.h"
 #include "pedigree/kernel/utilities/String.h"
 #include "pedigree/kernel/utilities/Tree.h"
+#include "pedigree/kernel/utilities/Vector.h"
 #include "pedigree/kernel/utilities/new"
 
 class File;
@@ -211,6 +214,16 @@ class MemoryMappedObject
         return false;
     }
 
+    /**
+     * Estimates how many pages compact() could release.
+     *
+     * Default implementation returns zero.
+     */
+    virtual size_t reclaimablePages()
+    {
+        return 0;
+    }
+
     /**
      * Determines if the given address is within this object's mapping.
      */
@@ -359,9 +372,31 @@ class MemoryMappedFile : public MemoryMappedObject
      */
     virtual bool compact();
 
+    /** Counts the pages currently mapped in from the backing file. */
+    virtual size_t reclaimablePages();
+
+    /**
+     * Sets the fault-around window, in pages.
+     *
+     * A read fault on a shared page also maps any other pages in the same
+     * aligned window that are already in the file's page cache, so a fresh
+     * binary doesn't take one trap per page it touches. The window is
+     * rounded down to a power of two; 1 disables fault-around.
+     */
+    static void setFaultAroundPages(size_t nPages);
+
+    /** Gets the current fault-around window, in pages. */
+    static size_t getFaultAroundPages();
+
   private:
     void unmapUnlocked();
 
+    /**
+     * Maps cached pages around a read fault at \p address (which has just
+     * been mapped). Pages not already in the page cache are left to trap.
+     */
+    void faultAround(uintptr_t address, size_t flags);
+
     /** Track a new mapping. */
     void trackMapping(uintptr_t, physical_uintptr_t);
 
@@ -377,14 +412,38 @@ class MemoryMappedFile : public MemoryMappedObject
     /** Clear all mappings. */
     void clearMappings();
 
+    /**
+     * Finds the first tracked mapping at or after \p addr within the
+     * object, updating \p addr and \p phys. Returns false if none remain.
+     */
+    bool nextMapping(uintptr_t &addr, physical_uintptr_t &phys);
+
     /** Backing file. */
     File *m_pBacking;
 
     /** Offset within the file that this mapping begins at. */
     size_t m_Offset;
 
-    /** List of existing mappings. */
-    Tree<uintptr_t, physical_uintptr_t> m_Mappings;
+    /**
+     * Existing mappings, as a two-level table indexed by page relative to
+     * m_MappingBase. Each leaf covers MappingLeafSize pages and is only
+     * allocated once one of its pages is mapped. An entry is zero if the
+     * page is not mapped, ~0 if it is the backing file's page, or the
+     * physical address of a private copy.
+     */
+    Vector<physical_uintptr_t *> m_Mappings;
+
+    /** Address that index zero of m_Mappings refers to. */
+    uintptr_t m_MappingBase;
+
+    /** Number of non-zero entries in m_Mappings. */
+    size_t m_MappingCount;
+
+    /** Pages per leaf in m_Mappings. */
+    static const size_t MappingLeafSize = 512;
+
+    /** Fault-around window, in pages. */
+    static size_t m_FaultAroundPages;
 
     /** Lock for anything to do with the memory mapped file. */
     Spinlock m_Lock;
@@ -488,6 +547,17 @@ class EXPORTED_PUBLIC MemoryMapManager : public MemoryTrapHandler,
      */
     virtual bool compact();
 
+    /**
+     * Total pages mapped in from files across all address spaces.
+     */
+    virtual size_t reclaimablePages();
+
+    /**
+     * Compacts mappings until roughly the given number of pages have been
+     * unpinned, for the Cache to then evict.
+     */
+    virtual size_t shrink(size_t nPages);
+
     virtual const String getMemoryPressureDescription()
     {
         return String("Unmap safe pages from memory mapped files.");
@@ -535,12 +605,37 @@ class EXPORTED_PUBLIC MemoryMapManager : public MemoryTrapHandler,
     /** Singleton instance. */
     static MemoryMapManager m_Instance;
 
-    typedef List<MemoryMappedObject *> MmObjectList;
+    /**
+     * The memory mapped objects of a single address space, indexed by the
+     * page-aligned range each one covers.
+     */
+    struct MmObjectTree
+    {
+        MmObjectTree() : objects(), lock()
+        {
+        }
+
+        /** Indexes an object by its current address and length. */
+        void add(MemoryMappedObject *pObject);
+
+        /** Removes an object from the index; must be done before changing
+         *  its address or length. */
+        bool remove(MemoryMappedObject *pObject);
+
+        IntervalTree<MemoryMappedObject *> objects;
+
+        /** Traps take this for reading, anything that changes the set of
+         *  objects (or their extents) takes it for writing. */
+        RWLock lock;
+    };
+
+    /** Finds the objects for an address space, optionally creating them. */
+    MmObjectTree *getObjects(VirtualAddressSpace *va, bool bCreate = false);
 
-    /** Cache of virtual address spaces -> MmObjectLists. */
-    Tree<VirtualAddressSpace *, MmObjectList *> m_MmObjectLists;
+    /** Cache of virtual address spaces -> MmObjectTrees. */
+    Tree<VirtualAddressSpace *, MmObjectTree *> m_MmObjectTrees;
 
-    /** Lock for the cache. */
+    /** Lock for the cache (but not the trees themselves). */
     Spinlock m_Lock;
 };
 
@@ -48,8 +48,7 @@ ZombiePipe::~ZombiePipe()
 }
 
 Pipe::Pipe()
-    : File(), m_bIsAnonymous(true), m_bIsEOF(false), m_Buffer(PIPE_BUF_MAX),
-      m_ReaderSem(0)
+    : File(), m_bIsAnonymous(true), m_bIsEOF(false), m_Ring(), m_ReaderSem(0)
 {
 #if VERBOSE_KERNEL
     NOTICE("Pipe: new anonymous pipe " << reinterpret_cast<uintptr_t>(this));
@@ -63,8 +62,7 @@ Pipe::Pipe(
     : File(
           name, accessedTime, modifiedTime, creationTime, inode, pFs, size,
           pParent),
-      m_bIsAnonymous(bIsAnonymous), m_bIsEOF(false), m_Buffer(PIPE_BUF_MAX),
-      m_ReaderSem(0)
+      m_bIsAnonymous(bIsAnonymous), m_bIsEOF(false), m_Ring(), m_ReaderSem(0)
 {
 #if VERBOSE_KERNEL
     NOTICE(
@@ -87,11 +85,11 @@ int Pipe::select(bool bWriting, int timeout)
 {
     if (bWriting)
     {
-        return m_Buffer.canWrite(timeout > 0) ? 1 : 0;
+        return m_Ring.canWrite(timeout > 0) ? 1 : 0;
     }
     else
     {
-        return m_Buffer.canRead(timeout > 0) ? 1 : 0;
+        return m_Ring.canRead(timeout > 0) ? 1 : 0;
     }
 }
 
@@ -104,8 +102,7 @@ uint64_t Pipe::readBytewise(
         bCanBlock = false;
     }
 
-    uint8_t *pBuf = reinterpret_cast<uint8_t *>(buffer);
-    return m_Buffer.read(pBuf, size, bCanBlock);
+    return m_Ring.read(reinterpret_cast<void *>(buffer), size, bCanBlock);
 }
 
 uint64_t Pipe::writeBytewise(
@@ -117,8 +114,8 @@ uint64_t Pipe::writeBytewise(
         return 0;
     }
 
-    uint8_t *pBuf = reinterpret_cast<uint8_t *>(buffer);
-    uint64_t result = m_Buffer.write(pBuf, size, bCanBlock);
+    uint64_t result =
+        m_Ring.write(reinterpret_cast<const void *>(buffer), size, bCanBlock);
     if (result)
     {
         dataChanged();
@@ -127,6 +124,78 @@ uint64_t Pipe::writeBytewise(
     return result;
 }
 
+uint64_t Pipe::splice(Pipe *pDest, uint64_t size, bool bCanBlock)
+{
+    if (m_nWriters == 0)
+    {
+        bCanBlock = false;
+    }
+
+    if (pDest->m_nReaders == 0)
+    {
+        return 0;
+    }
+
+    uint64_t result = m_Ring.splice(pDest->m_Ring, size, bCanBlock);
+    if (result)
+    {
+        pDest->dataChanged();
+    }
+
+    return result;
+}
+
+uint64_t Pipe::tee(Pipe *pDest, uint64_t size, bool bCanBlock)
+{
+    if (m_nWriters == 0)
+    {
+        bCanBlock = false;
+    }
+
+    if (pDest->m_nReaders == 0)
+    {
+        return 0;
+    }
+
+    uint64_t result = m_Ring.tee(pDest->m_Ring, size, bCanBlock);
+    if (result)
+    {
+        pDest->dataChanged();
+    }
+
+    return result;
+}
+
+uint64_t Pipe::fill(
+    PageRing::PageCallback callback, void *param, uint64_t size,
+    bool bCanBlock)
+{
+    if (m_nReaders == 0)
+    {
+        return 0;
+    }
+
+    uint64_t result = m_Ring.fill(size, callback, param, bCanBlock);
+    if (result)
+    {
+        dataChanged();
+    }
+
+    return result;
+}
+
+uint64_t Pipe::drain(
+    PageRing::PageCallback callback, void *param, uint64_t size,
+    bool bCanBlock)
+{
+    if (m_nWriters == 0)
+    {
+        bCanBlock = false;
+    }
+
+    return m_Ring.drain(size, callback, param, bCanBlock);
+}
+
 bool Pipe::isPipe() const
 {
     return getName().length() == 0 || m_bIsAnonymous;
@@ -142,17 +211,17 @@ void Pipe::increaseRefCount(bool bIsWriter)
     if (bIsWriter)
     {
         // Enable writes if they were previously disabled.
-        if (!m_Buffer.enableWrites())
+        if (!m_Ring.enableWrites())
         {
             // Writes were disabled previously (EOF), so wipe the pipe.
-            m_Buffer.wipe();
+            m_Ring.wipe();
         }
         m_nWriters++;
     }
     else
     {
         // A reader is now present so we can enable reads if they weren't.
-        m_Buffer.enableReads();
+        m_Ring.enableReads();
         m_nReaders++;
 
         m_ReaderSem.release();
@@ -184,7 +253,7 @@ void Pipe::decreaseRefCount(bool bIsWriter)
             {
                 // Wakes up readers waiting as they won't be able to be woken
                 // by new bytes being written anymore.
-                m_Buffer.disableWrites();
+                m_Ring.disableWrites();
                 bDataChanged = true;
             }
         }
@@ -195,7 +264,7 @@ void Pipe::decreaseRefCount(bool bIsWriter)
             {
                 // Wake up any writers that were waiting for space - no more
                 // readers (EOF condition, pipe other end has left).
-                m_Buffer.disableReads();
+                m_Ring.disableReads();
                 bDataChanged = true;
             }
         }
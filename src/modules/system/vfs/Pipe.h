@@ -26,11 +26,9 @@
 #include "pedigree/kernel/process/Semaphore.h"
 #include "pedigree/kernel/processor/types.h"
 #include "pedigree/kernel/time/Time.h"
-#include "pedigree/kernel/utilities/Buffer.h"
+#include "pedigree/kernel/utilities/PageRing.h"
 #include "pedigree/kernel/utilities/String.h"
 
-#define PIPE_BUF_MAX 2048
-
 /** A first-in-first-out buffer node. */
 class EXPORTED_PUBLIC Pipe : public File
 {
@@ -82,6 +80,25 @@ class EXPORTED_PUBLIC Pipe : public File
     /** FIFOs are not anonymous (have a name). */
     virtual bool isFifo() const;
 
+    /** Moves up to \p size bytes of pages from this pipe into \p pDest
+        without copying them. */
+    uint64_t splice(Pipe *pDest, uint64_t size, bool bCanBlock = true);
+
+    /** Shares up to \p size bytes of pages with \p pDest, leaving them in
+        this pipe as well. */
+    uint64_t tee(Pipe *pDest, uint64_t size, bool bCanBlock = true);
+
+    /** Lets \p callback write up to \p size bytes directly into the pipe's
+        pages (e.g. straight from a file or socket). */
+    uint64_t fill(
+        PageRing::PageCallback callback, void *param, uint64_t size,
+        bool bCanBlock = true);
+
+    /** Hands up to \p size bytes of the pipe's pages to \p callback. */
+    uint64_t drain(
+        PageRing::PageCallback callback, void *param, uint64_t size,
+        bool bCanBlock = true);
+
     virtual void increaseRefCount(bool bIsWriter);
 
     /** Override decreaseRefCount so we can tell when all writers have hung up
@@ -109,8 +126,8 @@ class EXPORTED_PUBLIC Pipe : public File
     /** Have we reached EOF? */
     volatile bool m_bIsEOF;
 
-    /** Internal pipe buffer. */
-    Buffer<uint8_t> m_Buffer;
+    /** Pages holding data written to the pipe but not yet read. */
+    PageRing m_Ring;
 
     /** Reader semaphore to allow blocking until a reader arrives. */
     Semaphore m_ReaderSem;
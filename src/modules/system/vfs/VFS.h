@@ -23,7 +23,7 @@
 #include "Filesystem.h"
 #include "pedigree/kernel/compiler.h"
 #include "pedigree/kernel/processor/types.h"
-#include "pedigree/kernel/utilities/HashTable.h"
+#include "pedigree/kernel/utilities/FlatHashTable.h"
 #include "pedigree/kernel/utilities/List.h"
 #include "pedigree/kernel/utilities/LruCache.h"
 #include "pedigree/kernel/utilities/String.h"
@@ -61,7 +61,7 @@ class EXPORTED_PUBLIC VFS
     typedef void (*MountCallback)();
 
     /** Type of the alias lookup table. */
-    typedef HashTable<String, Filesystem *, HashedStringView> AliasTable;
+    typedef FlatHashTable<String, Filesystem *, HashedStringView> AliasTable;
 
     /** Constructor */
     VFS();
@@ -22,10 +22,14 @@
 
 #include "pedigree/kernel/processor/MemoryRegion.h"
 #include "pedigree/kernel/processor/types.h"
+#include "pedigree/kernel/utilities/Vector.h"
 
 /**
  * This class provides functions for extracting an archive file as made by UNIX
  * Tar.
+ *
+ * The archive is indexed once, on construction, so that files can be looked
+ * up by position without walking the headers again.
  */
 class Archive
 {
@@ -65,12 +69,25 @@ class Archive
         char linkname[100];  // Linked-to file name.
     };
 
+    /** An indexed file: its header and its (already decoded) size. */
+    struct IndexEntry
+    {
+        ArchiveFile *header;
+        size_t size;
+    };
+
     ArchiveFile *getFirst();
-    ArchiveFile *getNext(ArchiveFile *pFile);
     ArchiveFile *get(size_t n);
 
+    /** Walks the archive headers once to build m_Index. */
+    void buildIndex();
+
     uint8_t *m_pBase;
+    size_t m_Size;
     MemoryRegion m_Region;
+
+    /** Files, in archive order. */
+    Vector<IndexEntry> m_Index;
 };
 
 #endif
@@ -0,0 +1,117 @@
+/*
+ * Copyright (c) 2008-2014, Pedigree Developers
+ *
+ * Please see the CONTRIB file in the root of the source tree for a full
+ * list of contributors.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef KERNEL_DEBUGGER_SAMPLINGPROFILER_H
+#define KERNEL_DEBUGGER_SAMPLINGPROFILER_H
+
+#include "pedigree/kernel/Atomic.h"
+#include "pedigree/kernel/Spinlock.h"
+#include "pedigree/kernel/compiler.h"
+#include "pedigree/kernel/processor/state_forward.h"
+#include "pedigree/kernel/processor/types.h"
+
+/** @addtogroup kerneldebugger
+ * @{ */
+
+/**
+ * Statistical profiler driven by each CPU's scheduler timer.
+ *
+ * While running, every Nth timer tick on each CPU records the interrupted
+ * PC, the current thread and a short call stack into a ring owned by that
+ * CPU. Nothing leaves the ring until it is read out (see snapshot), so the
+ * cost while running is one backtrace per sample and nothing at all while
+ * stopped. The records are SampleRecords, as understood by the host-side
+ * 'instrument' tool.
+ */
+class EXPORTED_PUBLIC SamplingProfiler
+{
+  public:
+    /// Size of each CPU's ring; older samples are overwritten.
+    static const size_t SamplesPerCpu = 4096;
+
+    SamplingProfiler();
+    ~SamplingProfiler();
+
+    static SamplingProfiler &instance()
+    {
+        return m_Instance;
+    }
+
+    /** Begins sampling every \p interval scheduler ticks, allocating the
+     *  per-CPU rings on first use. */
+    bool start(size_t interval = 1);
+
+    /** Stops sampling. Samples already taken are kept. */
+    void stop();
+
+    /** Discards all samples taken so far. */
+    void clear();
+
+    bool isRunning() const
+    {
+        return m_bRunning;
+    }
+
+    /** Called from the scheduler timer on each CPU. */
+    void sample(InterruptState &state);
+
+    /** Number of samples currently held across all CPUs. */
+    size_t count();
+
+    /** Size in bytes of the stream writeStream would produce right now. */
+    size_t streamSize();
+
+    /** Writes an instrumentation stream (a global flags byte, followed by
+     *  SampleRecords CPU by CPU, oldest first) into \p pBuffer. Only whole
+     *  records are written. Returns the number of bytes written. */
+    size_t writeStream(uint8_t *pBuffer, size_t length);
+
+    /** Samples lost because the ring was being read at the time. */
+    size_t getDropped() const
+    {
+        return m_Dropped;
+    }
+
+    size_t getInterval() const
+    {
+        return m_Interval;
+    }
+
+  private:
+    NOT_COPYABLE_OR_ASSIGNABLE(SamplingProfiler);
+
+    struct CpuRing;
+
+    static SamplingProfiler m_Instance;
+
+    /** Protects start/stop/clear against each other. */
+    Spinlock m_Lock;
+
+    CpuRing *m_pRings;
+    size_t m_nRings;
+
+    volatile bool m_bRunning;
+    size_t m_Interval;
+
+    Atomic<size_t> m_Dropped;
+};
+
+/** @} */
+
+#endif
@@ -60,6 +60,7 @@ enum PosixError
     Unimplemented = 38,          // ENOSYS
     NotEmpty = 39,               // ENOTEMPTY
     LoopExists = 40,             // ELOOP
+    MessageTooLong = 90,         // EMSGSIZE
     ProtocolNotAvailable = 92,   // ENOPROTOOPT
     OperationNotSupported = 95,  // ENOTSUP
     ConnectionAborted = 103,     // ECONNABORTED
@@ -0,0 +1,107 @@
+/*
+ * Copyright (c) 2008-2014, Pedigree Developers
+ *
+ * Please see the CONTRIB file in the root of the source tree for a full
+ * list of contributors.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef _GRAPHICS_PIXELKERNELS_H
+#define _GRAPHICS_PIXELKERNELS_H
+
+#include "pedigree/kernel/compiler.h"
+#include "pedigree/kernel/graphics/Graphics.h"
+#include "pedigree/kernel/processor/types.h"
+
+namespace Graphics
+{
+/** Instruction set used by a set of pixel kernels. */
+enum KernelVariant
+{
+    KernelScalar,
+    KernelSse2,
+    KernelAvx2,
+
+    KernelVariantCount
+};
+
+/** A set of row-oriented pixel kernels for one instruction set.
+ *
+ *  Every kernel operates on a single run of \p n pixels; the rect helpers
+ *  below walk rows and call into these. Kernels an instruction set cannot
+ *  accelerate point at the scalar implementation. */
+struct PixelKernels
+{
+    KernelVariant variant;
+    const char *name;
+
+    /// Copies \p n bytes. The source and destination must not overlap.
+    void (*copy)(void *dest, const void *src, size_t n);
+
+    /// Fills \p n 16-bit pixels with \p colour.
+    void (*fill16)(uint16_t *dest, uint16_t colour, size_t n);
+    /// Fills \p n 32-bit pixels with \p colour.
+    void (*fill32)(uint32_t *dest, uint32_t colour, size_t n);
+
+    /// Bits32_Argb -> Bits16_Rgb565 (alpha is discarded).
+    void (*argb8888ToRgb565)(uint16_t *dest, const uint32_t *src, size_t n);
+    /// Bits16_Rgb565 -> Bits32_Argb (alpha set to 0xFF).
+    void (*rgb565ToArgb8888)(uint32_t *dest, const uint16_t *src, size_t n);
+    /// Bits24_Rgb -> Bits32_Argb (alpha set to 0xFF).
+    void (*rgb888ToArgb8888)(uint32_t *dest, const uint8_t *src, size_t n);
+    /// Bits32_Argb -> Bits24_Rgb (alpha is discarded).
+    void (*argb8888ToRgb888)(uint8_t *dest, const uint32_t *src, size_t n);
+
+    /// Composites Bits32_Argb \p src over Bits32_Argb \p dest.
+    void (*blendArgb8888)(uint32_t *dest, const uint32_t *src, size_t n);
+};
+
+/** Returns the fastest set of kernels supported by the running CPU. The
+ *  choice is made once, on first use. */
+EXPORTED_PUBLIC const PixelKernels &pixelKernels();
+
+/** Returns the kernels for a specific variant, or null if the running CPU
+ *  (or the build) cannot run that variant. */
+EXPORTED_PUBLIC const PixelKernels *pixelKernels(KernelVariant variant);
+
+/** Whether a row converter exists for the given pair of formats. */
+EXPORTED_PUBLIC bool
+canConvertPixels(PixelFormat srcFormat, PixelFormat destFormat);
+
+/** Copies a rectangle of \p widthBytes by \p height between two surfaces
+ *  with the given pitches (bytes per line). */
+EXPORTED_PUBLIC void blitRect(
+    void *dest, size_t destPitch, const void *src, size_t srcPitch,
+    size_t widthBytes, size_t height);
+
+/** Fills a rectangle of \p width pixels by \p height with \p colour, which
+ *  must already be in the surface's pixel format. Returns false if the
+ *  pixel size is not handled (the caller should fall back). */
+EXPORTED_PUBLIC bool fillRect(
+    void *dest, size_t destPitch, size_t bytesPerPixel, uint32_t colour,
+    size_t width, size_t height);
+
+/** Converts a rectangle between two pixel formats. Returns false if the
+ *  pair of formats has no kernel (see canConvertPixels). */
+EXPORTED_PUBLIC bool convertRect(
+    void *dest, size_t destPitch, PixelFormat destFormat, const void *src,
+    size_t srcPitch, PixelFormat srcFormat, size_t width, size_t height);
+
+/** Composites a rectangle of Bits32_Argb pixels onto a 32-bit surface. */
+EXPORTED_PUBLIC void blendRect(
+    void *dest, size_t destPitch, const void *src, size_t srcPitch,
+    size_t width, size_t height);
+}  // namespace Graphics
+
+#endif
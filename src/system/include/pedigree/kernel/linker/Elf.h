@@ -27,6 +27,7 @@
 #include "pedigree/kernel/utilities/new"
 #endif
 
+#include "pedigree/kernel/linker/SymbolAddressIndex.h"
 #include "pedigree/kernel/linker/SymbolTable.h"
 #include "pedigree/kernel/utilities/List.h"
 
@@ -60,6 +61,7 @@
 #define SHT_INIT_ARRAY 0xe
 #define SHT_FINI_ARRAY 0xf
 #define SHT_PREINIT_ARRAY 0x10
+#define SHT_GNU_HASH 0x6ffffff6  // GNU-style symbol hash table
 
 // Section header flags - common to Elf32 and Elf64.
 #define SHF_WRITE 0x1
@@ -307,6 +309,10 @@ class EXPORTED_PUBLIC Elf
     /** Returns the start address of the symbol with name 'pName'. */
     uintptr_t lookupSymbol(const char *pName);
 
+    /** Builds the index used by lookupSymbol(addr) now, rather than on the
+     * first lookup (which may be in a context that can't allocate). */
+    void buildAddressIndex();
+
     /** Same as lookupSymbol, but acts on the dynamic symbol table instead of
      * the normal one. */
     uintptr_t lookupDynamicSymbolAddress(const char *str, uintptr_t loadBase);
@@ -467,6 +473,17 @@ typedef ElfSymbol_t Elf32Symbol_t;
         // chains follow
     };
 
+    struct ElfGnuHash_t
+    {
+        Elf_Word nbuckets;
+        Elf_Word symoffset;
+        Elf_Word bloom_size;
+        Elf_Word bloom_shift;
+        // bloom filter words (one native word each) follow
+        // buckets follow
+        // chains follow (for symbols from symoffset onwards)
+    };
+
     struct ElfDyn_t
     {
         Elf_Sxword tag;
@@ -528,6 +545,12 @@ typedef ElfSymbol_t Elf32Symbol_t;
     void rebaseDynamic();
 
   protected:
+    /** Builds m_AddressIndex from the given symbol table on first use.
+     * Returns false if the index can't be used for this table (yet), in
+     * which case lookups fall back to scanning the table. */
+    template <class T>
+    bool buildAddressIndex(T *symbolTable);
+
     ElfSymbol_t *m_pSymbolTable;
     size_t m_nSymbolTableSize;
     char *m_pStringTable;
@@ -563,6 +586,18 @@ typedef ElfSymbol_t Elf32Symbol_t;
     String m_Name;
     uintptr_t m_LoadBase;
 
+    /** Index for lookupSymbol(addr), built lazily from m_pAddressIndexTable.
+     */
+    SymbolAddressIndex m_AddressIndex;
+    const void *m_pAddressIndexTable;
+    enum AddressIndexState
+    {
+        AddressIndexNone,
+        AddressIndexBuilding,
+        AddressIndexReady
+    };
+    int m_AddressIndexState;
+
   private:
     /** The assignment operator
      *\note currently not implemented */
@@ -27,8 +27,13 @@
 #include "pedigree/kernel/process/Semaphore.h"
 #include "pedigree/kernel/processor/MemoryRegion.h"
 #include "pedigree/kernel/processor/types.h"
+#include "pedigree/kernel/time/Time.h"
+#include "pedigree/kernel/utilities/FlatHashTable.h"
+#include "pedigree/kernel/utilities/IntervalTree.h"
 #include "pedigree/kernel/utilities/MemoryAllocator.h"
 #include "pedigree/kernel/utilities/SharedPointer.h"
+#include "pedigree/kernel/utilities/String.h"
+#include "pedigree/kernel/utilities/StringView.h"
 #include "pedigree/kernel/utilities/Vector.h"
 #include "pedigree/kernel/utilities/utility.h"
 
@@ -43,7 +48,9 @@ class Module
   public:
     Module()
         : elf(nullptr), name(0), entry(0), exit(0), depends(0), depends_opt(0),
-          buffer(0), buflen(0), status(Unknown)
+          buffer(0), buflen(0), dependents(), optionalDependents(),
+          waitingOn(0), scheduled(false), dependencyFailed(false),
+          preloadTime(0), executeTime(0), status(Unknown)
     {
     }
 
@@ -63,6 +70,23 @@ class Module
     uintptr_t loadBase;
     size_t loadSize;
 
+    /** Modules that can't execute until this one is active. */
+    Vector<Module *> dependents;
+    /** Modules that optionally depend on this one, and so only wait for it
+     *  to finish executing (successfully or not). */
+    Vector<Module *> optionalDependents;
+    /** Number of dependencies that have yet to finish executing. */
+    size_t waitingOn;
+    /** Whether this module has been added to the dependency graph. */
+    bool scheduled;
+    /** Set if a mandatory dependency failed; the module will not execute. */
+    bool dependencyFailed;
+
+    /** Time taken to load and link the module, in nanoseconds. */
+    Time::Timestamp preloadTime;
+    /** Time taken to relocate and execute the module, in nanoseconds. */
+    Time::Timestamp executeTime;
+
     enum ModuleStatus
     {
         Unknown,
@@ -204,6 +228,21 @@ class EXPORTED_PUBLIC KernelElf : public Elf
     bool moduleDependenciesSatisfied(Module *module);
     bool executeModule(Module *module);
 
+    /** Finds a preloaded module by name, or returns null. */
+    Module *findModule(const char *name);
+
+    /** Resolves the dependencies of every newly-preloaded module into edges
+     *  of the dependency graph. Modules with nothing to wait for are queued
+     *  for execution. */
+    void buildDependencyGraph();
+
+    /** Executes queued modules until the queue is empty. */
+    void dispatchReadyModules();
+
+    /** Queues any modules that were only waiting on the given module, which
+     *  has just finished executing. Must be called with the modules lock. */
+    void releaseDependents(Module *module);
+
     /** Rebase a pointer for the given loaded module. */
     template <class T>
     static T *rebase(Module *module, T *ptr)
@@ -240,6 +279,18 @@ class EXPORTED_PUBLIC KernelElf : public Elf
 
     /** List of modules */
     Vector<Module *> m_Modules;
+    /** Modules by name, for dependency resolution. */
+    FlatHashTable<String, Module *, HashedStringView> m_ModuleNames;
+    /** Modules whose dependencies have all finished executing. */
+    Vector<Module *> m_ReadyModules;
+    /** Number of modules dispatched that have not yet finished. */
+    size_t m_nRunningModules;
+    /** Whether executing modules should update the boot progress. */
+    bool m_bSilentExecution;
+    /** When executeModules() was last called. */
+    Time::Timestamp m_ExecutionStart;
+    /** Loaded modules by address range, for globalLookupSymbol(addr). */
+    IntervalTree<Module *> m_ModuleRanges;
     /** Memory allocator for modules - where they can be loaded. */
     MemoryAllocator m_ModuleAllocator;
 
@@ -0,0 +1,86 @@
+/*
+ * Copyright (c) 2008-2014, Pedigree Developers
+ *
+ * Please see the CONTRIB file in the root of the source tree for a full
+ * list of contributors.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+#ifndef KERNEL_LINKER_SYMBOLADDRESSINDEX_H
+#define KERNEL_LINKER_SYMBOLADDRESSINDEX_H
+
+#include "pedigree/kernel/compiler.h"
+#include "pedigree/kernel/processor/types.h"
+#include "pedigree/kernel/utilities/Vector.h"
+
+/** \addtogroup kernellinker
+ * @{ */
+
+/** Sorted index of symbol address ranges, for reverse (address to name)
+ *  lookups in O(log n).
+ *
+ *  Symbols are added with insert() and the index is sorted by finalise();
+ *  lookups before then find nothing. Names are not copied, so they must
+ *  outlive the index (they normally point into an ELF string table).
+ *
+ *  Where ranges overlap, the symbol with the highest start address that
+ *  contains the address wins, and among symbols that start at the same
+ *  address, the one inserted first wins. */
+class EXPORTED_PUBLIC SymbolAddressIndex
+{
+  public:
+    SymbolAddressIndex();
+    ~SymbolAddressIndex();
+
+    /** Adds the symbol covering [start, start + size). */
+    void insert(uintptr_t start, size_t size, const char *name);
+
+    /** Sorts the index, making it ready for lookups. */
+    void finalise();
+
+    /** Finds the symbol containing \p addr, or returns null.
+     * \param[out] startAddr The start of the symbol found (optional). */
+    const char *lookup(uintptr_t addr, uintptr_t *startAddr = 0) const;
+
+    /** Number of symbols in the index. */
+    size_t count() const;
+
+    /** Removes all symbols from the index. */
+    void clear();
+
+  private:
+    NOT_COPYABLE_OR_ASSIGNABLE(SymbolAddressIndex);
+
+    struct Entry
+    {
+        uintptr_t start;
+        uintptr_t end;
+        /// Highest end of this entry and every entry before it.
+        uintptr_t maxEnd;
+        const char *name;
+        /// Insertion order, used to break ties between equal starts.
+        size_t order;
+    };
+
+    static bool before(const Entry &a, const Entry &b);
+    void siftDown(size_t root, size_t count);
+
+    Vector<Entry> m_Entries;
+    bool m_bFinalised;
+};
+
+/** @} */
+
+#endif
@@ -66,6 +66,21 @@ class EXPORTED_PUBLIC StationInfo
 class EXPORTED_PUBLIC Network : public Device
 {
   public:
+    /** Checksum work a device can do in hardware. Transmit flags mean the
+     *  device fills in the checksum, so the stack leaves it alone; receive
+     *  flags mean the device has already verified it (and drops bad
+     *  packets). TCP and UDP flags cover both IPv4 and IPv6. */
+    enum ChecksumOffload
+    {
+        OffloadNone = 0,
+        OffloadIpv4Transmit = 1 << 0,
+        OffloadTcpTransmit = 1 << 1,
+        OffloadUdpTransmit = 1 << 2,
+        OffloadIpv4Receive = 1 << 8,
+        OffloadTcpReceive = 1 << 9,
+        OffloadUdpReceive = 1 << 10,
+    };
+
     Network();
     Network(Network *pDev);
     virtual ~Network();
@@ -91,6 +106,10 @@ class EXPORTED_PUBLIC Network : public Device
     /** Is this device actually connected to a network? */
     virtual bool isConnected();
 
+    /** Which checksums the device handles itself, as ChecksumOffload flags.
+     *  Read once, when the device is registered with the network stack. */
+    virtual uint32_t getChecksumOffload();
+
     /** Converts an IPv4 address into an integer */
     EXPORTED_PUBLIC static uint32_t
     convertToIpv4(uint8_t a, uint8_t b, uint8_t c, uint8_t d);
@@ -0,0 +1,113 @@
+/*
+ * Copyright (c) 2008-2014, Pedigree Developers
+ *
+ * Please see the CONTRIB file in the root of the source tree for a full
+ * list of contributors.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+#ifndef KERNEL_MACHINE_HOSTED_HOSTDISKIMAGE_H
+#define KERNEL_MACHINE_HOSTED_HOSTDISKIMAGE_H
+
+#include "pedigree/kernel/compiler.h"
+#include "pedigree/kernel/processor/types.h"
+
+/** @addtogroup kernelmachinehosted
+ * @{ */
+
+/**
+ * The disk image passed on the hosted kernel's command line.
+ *
+ * Modules are built against Pedigree's own headers and so can't talk to the
+ * host directly. This wraps the host file so the hosted disk driver can use
+ * pread/pwrite and a shared mapping of the image without doing so. The driver
+ * keeps every block in its own Cache pages either way; the mapping is only
+ * a cheaper way to copy blocks in and out of them.
+ */
+class EXPORTED_PUBLIC HostDiskImage
+{
+  public:
+    /** Block size used when none is given on the command line. */
+    static const size_t DefaultBlockSize = 0x1000;
+
+    /**
+     * Opens the image at \p path. Called by the hosted bootstrap before the
+     * kernel starts, so this must not allocate or log - on failure, errno
+     * describes the problem.
+     *
+     * Images that can't be opened for writing are opened read-only, with a
+     * private mapping so writes still work but never reach the file.
+     * \param blockSize must be a power of two and at least a page, or zero
+     *        to use DefaultBlockSize.
+     */
+    static bool open(const char *path, size_t blockSize);
+
+    /** Unmaps and closes the image, if one is open. */
+    static void close();
+
+    static bool isAvailable()
+    {
+        return m_Fd >= 0;
+    }
+
+    static bool isReadOnly()
+    {
+        return m_bReadOnly;
+    }
+
+    static uint64_t getSize()
+    {
+        return m_Size;
+    }
+
+    static size_t getBlockSize()
+    {
+        return m_BlockSize;
+    }
+
+    /**
+     * Returns the mapping of the whole image, or null if the host couldn't
+     * map it (in which case read() and write() must be used instead). Its
+     * pages aren't known to the hosted address space, so copy out of it
+     * rather than handing out pointers into it.
+     */
+    static void *getMapping()
+    {
+        return m_pMapping;
+    }
+
+    /** Reads up to \p length bytes at \p location. Returns bytes read. */
+    static size_t read(uint64_t location, void *buffer, size_t length);
+
+    /** Writes up to \p length bytes at \p location. Returns bytes written. */
+    static size_t write(uint64_t location, const void *buffer, size_t length);
+
+    /**
+     * Waits for the given range to reach the host's storage. Dirty pages in
+     * the mapping are written out first.
+     */
+    static bool sync(uint64_t location, size_t length);
+
+  private:
+    static int m_Fd;
+    static void *m_pMapping;
+    static uint64_t m_Size;
+    static size_t m_BlockSize;
+    static bool m_bReadOnly;
+};
+
+/** @} */
+
+#endif
@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) 2008-2014, Pedigree Developers
+ *
+ * Please see the CONTRIB file in the root of the source tree for a full
+ * list of contributors.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef NETWORK_CHECKSUM_H
+#define NETWORK_CHECKSUM_H
+
+#include "pedigree/kernel/compiler.h"
+#include "pedigree/kernel/processor/types.h"
+
+/** Instruction set used by a set of checksum kernels. */
+enum ChecksumVariant
+{
+    ChecksumScalar,
+    ChecksumSse2,
+    ChecksumAvx2,
+
+    ChecksumVariantCount
+};
+
+/** Internet checksum (RFC 1071) kernels for one instruction set.
+ *
+ *  Both kernels return the ones' complement sum of the data folded to 16
+ *  bits but not inverted, with the data treated as 16-bit words in memory
+ *  order - the same contract as lwIP's LWIP_CHKSUM. Buffers need not be
+ *  aligned. */
+struct ChecksumKernels
+{
+    ChecksumVariant variant;
+    const char *name;
+
+    /// Sums \p n bytes.
+    uint16_t (*sum)(const void *buffer, size_t n);
+
+    /// Copies \p n bytes and sums them in the same pass. The source and
+    /// destination must not overlap.
+    uint16_t (*copyAndSum)(void *dest, const void *src, size_t n);
+};
+
+/** Returns the fastest checksum kernels supported by the running CPU. The
+ *  choice is made once, on first use. */
+EXPORTED_PUBLIC const ChecksumKernels &checksumKernels();
+
+/** Returns the kernels for a specific variant, or null if the running CPU
+ *  (or the build) cannot run that variant. */
+EXPORTED_PUBLIC const ChecksumKernels *checksumKernels(ChecksumVariant variant);
+
+/** Sums \p n bytes with the best kernels for a buffer of that size. Unlike
+ *  calling the kernels directly, this is safe anywhere in the kernel. */
+EXPORTED_PUBLIC uint16_t checksumSum(const void *buffer, size_t n);
+
+/** Copies and sums \p n bytes; see checksumSum. */
+EXPORTED_PUBLIC uint16_t
+checksumCopyAndSum(void *dest, const void *src, size_t n);
+
+#endif
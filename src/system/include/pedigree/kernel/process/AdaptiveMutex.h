@@ -0,0 +1,113 @@
+/*
+ * Copyright (c) 2008-2014, Pedigree Developers
+ *
+ * Please see the CONTRIB file in the root of the source tree for a full
+ * list of contributors.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef ADAPTIVE_MUTEX_H
+#define ADAPTIVE_MUTEX_H
+
+#include "pedigree/kernel/Atomic.h"
+#include "pedigree/kernel/compiler.h"
+#include "pedigree/kernel/processor/types.h"
+
+#ifndef STANDALONE_MUTEXES
+#include "pedigree/kernel/process/Semaphore.h"
+#endif
+
+/**
+ * Where a thread blocked on an adaptive lock goes to sleep once spinning has
+ * stopped being worthwhile. This is a counting wakeup channel: a wake() that
+ * arrives before the matching wait() is not lost.
+ */
+class EXPORTED_PUBLIC AdaptiveWaitQueue
+{
+  public:
+    AdaptiveWaitQueue();
+    ~AdaptiveWaitQueue();
+
+    /** Sleeps until a wakeup is available, then consumes it. */
+    void wait();
+
+    /** Makes \p n wakeups available. */
+    void wake(size_t n = 1);
+
+  private:
+    NOT_COPYABLE_OR_ASSIGNABLE(AdaptiveWaitQueue);
+
+#ifdef STANDALONE_MUTEXES
+    void *m_Private;
+#else
+    Semaphore m_Semaphore;
+#endif
+};
+
+/**
+ * A mutex that spins while its owner is running on another CPU, and only
+ * sleeps once the owner has been descheduled (or the spin budget runs out).
+ *
+ * Critical sections protected by a mutex are usually short, so a contending
+ * thread is far better off waiting a few hundred cycles for the owner to
+ * finish than paying for a trip through the scheduler. The owner is recorded
+ * in the lock word itself, so the uncontended paths are a single atomic
+ * operation each.
+ *
+ * This is not recursive, and must be released by the thread that acquired it.
+ */
+class EXPORTED_PUBLIC AdaptiveMutex
+{
+  public:
+    /** Maximum number of times to poll a lock before going to sleep, even if
+     *  the owner still appears to be running. */
+    static const size_t SpinLimit = 1000;
+
+    AdaptiveMutex(bool bLocked = false);
+    ~AdaptiveMutex();
+
+    /** Acquires the mutex, blocking if needed. Always returns true. */
+    bool acquire();
+
+    /** Acquires the mutex if it is free, without blocking. */
+    bool tryAcquire();
+
+    /** Releases the mutex, waking a sleeping waiter if there is one. */
+    void release();
+
+    /** Returns 1 if the mutex is free, 0 otherwise (matches Mutex). */
+    ssize_t getValue();
+
+    /** Opaque, non-zero identifier for the calling thread. */
+    static uintptr_t currentOwner();
+
+    /** Whether \p owner (from currentOwner) is running on another CPU, which
+     *  is the only case where spinning on a lock it holds can pay off. */
+    static bool ownerRunning(uintptr_t owner);
+
+    /** Hint to the CPU that we are in a spin-wait loop. */
+    static void relax();
+
+  private:
+    NOT_COPYABLE_OR_ASSIGNABLE(AdaptiveMutex);
+
+    /** Owning thread (from currentOwner), or zero if unlocked. */
+    Atomic<uintptr_t> m_Owner;
+    /** Number of threads that are (about to be) asleep in m_Queue. */
+    Atomic<size_t> m_Sleepers;
+
+    AdaptiveWaitQueue m_Queue;
+};
+
+#endif  // ADAPTIVE_MUTEX_H
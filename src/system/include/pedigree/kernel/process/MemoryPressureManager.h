@@ -20,12 +20,19 @@
 #ifndef MEMORY_PRESSURE_MANAGER_H
 #define MEMORY_PRESSURE_MANAGER_H
 
+#include "pedigree/kernel/Atomic.h"
 #include "pedigree/kernel/compiler.h"
 #include "pedigree/kernel/processor/types.h"
 #include "pedigree/kernel/utilities/List.h"
 #include "pedigree/kernel/utilities/String.h"
 #include "pedigree/kernel/utilities/new"
 
+#if THREADS
+#include "pedigree/kernel/process/Semaphore.h"
+#endif
+
+class Thread;
+
 /** Maximum memory pressure handler priority (one list per priority level). */
 #define MAX_MEMPRESSURE_PRIORITY 16
 
@@ -46,6 +53,21 @@ class EXPORTED_PUBLIC MemoryPressureHandler
      * \return true if pages were released, false otherwise.
      */
     virtual bool compact() = 0;
+
+    /**
+     * Estimates how many pages this handler could release right now. Used
+     * to spread background reclaim across handlers in proportion to their
+     * size. Handlers returning zero (the default) are only called upon by
+     * direct reclaim, via compact().
+     */
+    virtual size_t reclaimablePages();
+
+    /**
+     * Asks the handler to release up to the given number of pages.
+     * The default implementation performs a single compact().
+     * \return the number of pages released (or made releasable).
+     */
+    virtual size_t shrink(size_t nPages);
 };
 
 /**
@@ -72,29 +94,80 @@ class EXPORTED_PUBLIC MemoryPressureManager
         return m_Instance;
     }
 
-    static size_t getHighWatermark()
+    static size_t getMinWatermark()
     {
-        // Once the system has only this or less pages free, we begin
-        // doing compacts. We do not want to wait until the system is
-        // actually out of memory, as some compact mechanisms require
-        // allocating memory.
+        // Once the system has only this or less pages free, allocations
+        // stall and reclaim directly. We do not want to wait until the
+        // system is actually out of memory, as some compact mechanisms
+        // require allocating memory.
         return 16;
     }
 
     static size_t getLowWatermark()
     {
-        // Caches can begin voluntarily evicting cache pages at this mark.
-        // Should no action be taken, the system will take over forcefully
-        // at the high water mark.
+        // The reclaim thread (and caches, voluntarily) begin releasing pages
+        // at this mark, so that allocations rarely reach the min mark.
         return 32;
     }
 
+    static size_t getHighWatermark()
+    {
+        // The reclaim thread keeps going until this many pages are free.
+        return 64;
+    }
+
+    /** Reclaim activity counters. These are updated without locking and
+     *  so are approximate. */
+    struct Statistics
+    {
+        /// Number of times the reclaim thread ran below the low mark.
+        uint64_t backgroundRuns;
+        /// Pages released by the reclaim thread.
+        uint64_t backgroundPages;
+        /// Number of allocations that stalled to reclaim directly.
+        uint64_t directReclaims;
+        /// Pages released by direct reclaim.
+        uint64_t directPages;
+        /// Direct reclaims that did not release anything.
+        uint64_t directFailures;
+        /// Total time allocations spent stalled in direct reclaim (ns).
+        uint64_t stallTime;
+    };
+
+    /** Starts the background reclaim thread. */
+    void initialise();
+
     /**
-     * Attempt to alleviate memory pressure by requesting registered
-     * handlers release pages that can be safely released.
+     * Called after each page allocation with the number of free pages left.
+     * Wakes the reclaim thread once the low watermark is crossed.
+     */
+    void checkWatermarks(size_t freePages)
+    {
+        if (UNLIKELY(freePages < getLowWatermark()))
+        {
+            wakeReclaim();
+        }
+    }
+
+    /**
+     * Direct reclaim: attempt to alleviate memory pressure by requesting
+     * registered handlers release pages that can be safely released. The
+     * caller is stalled for the duration.
      */
     bool compact();
 
+    /**
+     * Shrinks handlers in proportion to their size until the given number
+     * of pages are free, or no handler can release any more.
+     * \return the number of pages released.
+     */
+    size_t reclaim(size_t targetFree);
+
+    const Statistics &getStatistics() const
+    {
+        return m_Statistics;
+    }
+
     /**
      * Register a new handler.
      */
@@ -106,9 +179,28 @@ class EXPORTED_PUBLIC MemoryPressureManager
     void removeHandler(MemoryPressureHandler *pHandler);
 
   private:
+    void wakeReclaim();
+
+#if THREADS
+    static int reclaimTrampoline(void *p);
+    void reclaimThread() NORETURN;
+#endif
+
     static MemoryPressureManager m_Instance;
 
     List<MemoryPressureHandler *> m_Handlers[MAX_MEMPRESSURE_PRIORITY];
+
+    Statistics m_Statistics;
+
+#if THREADS
+    Thread *m_pReclaimThread;
+
+    /** Released to wake the reclaim thread. */
+    Semaphore m_ReclaimWakeup;
+
+    /** Set while a wakeup is outstanding, to avoid repeated releases. */
+    Atomic<bool> m_bWakeupPending;
+#endif
 };
 
 #endif
@@ -24,6 +24,7 @@
 #include "pedigree/kernel/machine/TimerHandler.h"
 #include "pedigree/kernel/process/ConditionVariable.h"
 #include "pedigree/kernel/process/Mutex.h"
+#include "pedigree/kernel/process/SchedulerStatistics.h"
 #include "pedigree/kernel/process/Thread.h"
 #include "pedigree/kernel/processor/state_forward.h"
 #include "pedigree/kernel/processor/types.h"
@@ -98,6 +99,35 @@ class EXPORTED_PUBLIC PerProcessorScheduler : public TimerHandler
 
     void setIdle(Thread *pThread);
 
+    /** Scheduling and interrupt counters for this processor. */
+    const CpuStatistics &getStatistics() const
+    {
+        return m_Statistics;
+    }
+
+    /** Number of threads waiting in this processor's run queue. This is
+        read without locking and so is only a snapshot. */
+    size_t getReadyCount() const;
+
+    /** Counts an interrupt on this processor. Interrupts must be off. */
+    void accountInterrupt(size_t nVector)
+    {
+        if (LIKELY(nVector < CpuStatistics::InterruptVectors))
+            ++m_Statistics.interrupts[nVector];
+    }
+
+    /** Counts a system call on this processor. Interrupts must be off. */
+    void accountSyscall()
+    {
+        ++m_Statistics.syscalls;
+    }
+
+    /** Adds time spent in userspace on this processor. */
+    void accountUserTime(Time::Timestamp time)
+    {
+        m_Statistics.userTime += time;
+    }
+
   private:
     /** Copy-constructor
      *  \note Not implemented - singleton class. */
@@ -116,6 +146,10 @@ class EXPORTED_PUBLIC PerProcessorScheduler : public TimerHandler
 
     static void deleteThread(Thread *pThread);
 
+    /** Updates statistics for a switch from pFrom to pTo, where pFrom is
+        left in the given status. Called with interrupts disabled. */
+    void accountSwitch(Thread *pFrom, Thread *pTo, Thread::Status fromStatus);
+
     /** The current SchedulingAlgorithm */
     SchedulingAlgorithm *m_pSchedulingAlgorithm;
 
@@ -128,6 +162,8 @@ class EXPORTED_PUBLIC PerProcessorScheduler : public TimerHandler
 
     Thread *m_pIdleThread;
 
+    CpuStatistics m_Statistics;
+
 #if ARM_BEAGLE
     size_t m_TickCount;
 #endif
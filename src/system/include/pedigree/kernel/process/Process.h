@@ -330,8 +330,10 @@ class EXPORTED_PUBLIC Process
      * relevant time field to the current time.
      *
      * Use when scheduling.
+     *
+     * \return the time that was added.
      */
-    void trackTime(bool bUserspace)
+    Time::Timestamp trackTime(bool bUserspace)
     {
         Time::Timestamp now = Time::getTimeNanoseconds();
         if (bUserspace)
@@ -341,6 +343,7 @@ class EXPORTED_PUBLIC Process
             m_Metadata.userTime += diff;
 
             reportTimesUpdated(diff, 0);
+            return diff;
         }
         else
         {
@@ -349,6 +352,7 @@ class EXPORTED_PUBLIC Process
             m_Metadata.kernelTime += diff;
 
             reportTimesUpdated(0, diff);
+            return diff;
         }
     }
 
@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) 2008-2014, Pedigree Developers
+ *
+ * Please see the CONTRIB file in the root of the source tree for a full
+ * list of contributors.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef RWLOCK_H
+#define RWLOCK_H
+
+#include "pedigree/kernel/Atomic.h"
+#include "pedigree/kernel/compiler.h"
+#include "pedigree/kernel/process/AdaptiveMutex.h"
+#include "pedigree/kernel/processor/types.h"
+
+/**
+ * A reader-writer lock that prefers writers.
+ *
+ * Any number of readers may hold the lock at once, or a single writer. Once a
+ * writer is waiting, new readers are held back until it has been and gone, so
+ * a steady stream of readers cannot starve writers out. Waiters spin like an
+ * AdaptiveMutex does before they go to sleep.
+ */
+class EXPORTED_PUBLIC RWLock
+{
+  public:
+    RWLock();
+    ~RWLock();
+
+    /** Acquires the lock for reading, blocking if needed. */
+    bool acquireRead();
+    /** Acquires the lock for reading if that can be done without blocking. */
+    bool tryAcquireRead();
+    /** Releases a read hold on the lock. */
+    void releaseRead();
+
+    /** Acquires the lock for writing, blocking if needed. */
+    bool acquireWrite();
+    /** Acquires the lock for writing if it is entirely free. */
+    bool tryAcquireWrite();
+    /** Releases a write hold on the lock. */
+    void releaseWrite();
+
+    /** Number of readers currently holding the lock. */
+    size_t getReaders() const
+    {
+        return m_State >> ReaderShift;
+    }
+
+    /** Whether a writer currently holds the lock. */
+    bool isWriteLocked() const
+    {
+        return m_State & WriterHeld;
+    }
+
+    /** Lets a LockGuard take the lock for writing. */
+    bool acquire()
+    {
+        return acquireWrite();
+    }
+    void release()
+    {
+        releaseWrite();
+    }
+
+  private:
+    NOT_COPYABLE_OR_ASSIGNABLE(RWLock);
+
+    static const size_t WriterHeld = 1;
+    static const size_t ReaderShift = 1;
+    static const size_t ReaderUnit = 1 << ReaderShift;
+
+    /** Whether a blocked thread should keep spinning, given the state that
+     *  blocked it. */
+    bool worthSpinning(size_t state) const;
+
+    /** Reader count (shifted by ReaderShift) and the WriterHeld bit. */
+    Atomic<size_t> m_State;
+    /** Writing thread (from AdaptiveMutex::currentOwner), only a hint. */
+    Atomic<uintptr_t> m_Owner;
+    /** Writers that want the lock; while non-zero, readers stay out. */
+    Atomic<size_t> m_WritersWaiting;
+
+    Atomic<size_t> m_ReadSleepers;
+    Atomic<size_t> m_WriteSleepers;
+    AdaptiveWaitQueue m_ReadQueue;
+    AdaptiveWaitQueue m_WriteQueue;
+};
+
+/** RAII helper that holds an RWLock for reading. */
+class EXPORTED_PUBLIC ReadLockGuard
+{
+  public:
+    ReadLockGuard(RWLock &lock) : m_Lock(lock)
+    {
+        m_Lock.acquireRead();
+    }
+    ~ReadLockGuard()
+    {
+        m_Lock.releaseRead();
+    }
+
+  private:
+    ReadLockGuard() = delete;
+    NOT_COPYABLE_OR_ASSIGNABLE(ReadLockGuard);
+
+    RWLock &m_Lock;
+};
+
+#endif  // RWLOCK_H
@@ -44,6 +44,8 @@ class RoundRobin : public SchedulingAlgorithm
 
     virtual void threadStatusChanged(Thread *pThread);
 
+    virtual size_t getReadyCount() const;
+
   private:
     static bool isReady(Thread *pThread);
 
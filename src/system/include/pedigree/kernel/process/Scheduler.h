@@ -26,6 +26,7 @@
 #include "pedigree/kernel/processor/types.h"
 #include "pedigree/kernel/utilities/List.h"
 #include "pedigree/kernel/utilities/Tree.h"
+#include "pedigree/kernel/utilities/Vector.h"
 #include "pedigree/kernel/utilities/new"
 
 class Thread;
@@ -92,6 +93,21 @@ class EXPORTED_PUBLIC Scheduler
         return m_pBspScheduler;
     }
 
+    /** Returns the number of per-processor schedulers. */
+    size_t getNumProcessorSchedulers() const
+    {
+        return m_ProcessorSchedulers.count();
+    }
+
+    /** Returns the n'th per-processor scheduler. The bootstrap processor's
+     *  scheduler is always the first. */
+    PerProcessorScheduler *getProcessorScheduler(size_t n) const
+    {
+        if (n >= m_ProcessorSchedulers.count())
+            return 0;
+        return m_ProcessorSchedulers[n];
+    }
+
   private:
     Scheduler();
     NOT_COPYABLE_OR_ASSIGNABLE(Scheduler);
@@ -123,6 +139,9 @@ class EXPORTED_PUBLIC Scheduler
      */
     PerProcessorScheduler *m_pBspScheduler;
 
+    /** All per-processor schedulers, for enumeration purposes. */
+    Vector<PerProcessorScheduler *> m_ProcessorSchedulers;
+
     /** Main scheduler lock for modifying internal structures. */
     Spinlock m_SchedulerLock;
 };
@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2008-2014, Pedigree Developers
+ *
+ * Please see the CONTRIB file in the root of the source tree for a full
+ * list of contributors.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#ifndef KERNEL_PROCESS_SCHEDULERSTATISTICS_H
+#define KERNEL_PROCESS_SCHEDULERSTATISTICS_H
+
+#include "pedigree/kernel/Atomic.h"
+#include "pedigree/kernel/processor/types.h"
+#include "pedigree/kernel/time/Time.h"
+
+/** Scheduling and interrupt counters for a single processor.
+ *
+ *  Only the owning processor updates these, and always with interrupts
+ *  disabled, so no locking is done. Readers on other processors may see a
+ *  slightly stale or torn snapshot, which is good enough for reporting.
+ *  All times are in nanoseconds. */
+struct CpuStatistics
+{
+    static const size_t InterruptVectors = 256;
+
+    /// Time spent running userspace code.
+    Time::Timestamp userTime = 0;
+    /// Time spent running any thread other than the idle thread.
+    Time::Timestamp busyTime = 0;
+    /// Time spent running the idle thread.
+    Time::Timestamp idleTime = 0;
+    /// Total time threads spent ready to run on this processor but waiting.
+    Time::Timestamp runDelay = 0;
+
+    /// Number of switches to a different thread.
+    uint64_t contextSwitches = 0;
+    /// Number of calls to schedule(), including ones that did not switch.
+    uint64_t scheduleCalls = 0;
+    /// Number of calls to schedule() that fell back to the idle thread.
+    uint64_t idleSchedules = 0;
+    /// Number of system calls made.
+    uint64_t syscalls = 0;
+    /// Number of interrupts taken, by vector.
+    uint64_t interrupts[InterruptVectors] = {};
+
+    /// When the currently running thread was switched to.
+    Time::Timestamp lastSwitch = 0;
+};
+
+/** Scheduling counters for a single thread. Updated by the processor the
+ *  thread runs on as it switches threads, except for readySince, which is set
+ *  by whichever processor makes the thread ready. Times are in nanoseconds. */
+struct ThreadStatistics
+{
+    /// Time spent running.
+    Time::Timestamp runTime = 0;
+    /// Time spent ready to run but waiting for a processor.
+    Time::Timestamp waitTime = 0;
+    /// Switches away from the thread because it blocked or exited.
+    uint64_t voluntarySwitches = 0;
+    /// Switches away from the thread while it was still ready to run.
+    uint64_t involuntarySwitches = 0;
+    /// Number of times the thread has been switched to.
+    uint64_t timeslices = 0;
+
+    /// When the thread last became ready, or zero if it is not waiting.
+    Atomic<Time::Timestamp> readySince = 0;
+};
+
+#endif
@@ -20,6 +20,8 @@
 #ifndef SCHEDULING_ALGORITHM_H
 #define SCHEDULING_ALGORITHM_H
 
+#include "pedigree/kernel/processor/types.h"
+
 class Thread;
 
 #define MAX_PRIORITIES 8
@@ -50,6 +52,10 @@ class SchedulingAlgorithm
     /** Notifies us that the status of a thread has changed, and that we may
      * need to take action. */
     virtual void threadStatusChanged(Thread *pThread) = 0;
+
+    /** Returns the number of threads waiting to be scheduled. This may be
+     * called without synchronisation and need only be approximate. */
+    virtual size_t getReadyCount() const = 0;
 };
 
 #endif
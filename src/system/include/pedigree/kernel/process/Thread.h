@@ -23,6 +23,7 @@
 #include "pedigree/kernel/Spinlock.h"
 #include "pedigree/kernel/compiler.h"
 #include "pedigree/kernel/process/Event.h"
+#include "pedigree/kernel/process/SchedulerStatistics.h"
 #include "pedigree/kernel/process/SchedulingAlgorithm.h"
 #include "pedigree/kernel/processor/ProcessorInformation.h"
 #include "pedigree/kernel/processor/VirtualAddressSpace.h"
@@ -381,6 +382,12 @@ class EXPORTED_PUBLIC Thread
         return m_ProcId;
     }
 
+    /** Gets this thread's scheduling statistics. */
+    ThreadStatistics &getStatistics()
+    {
+        return m_Statistics;
+    }
+
     /** Sets this thread's CPU ID */
     inline void setCpuId(
 #if MULTIPROCESSOR
@@ -553,6 +560,9 @@ class EXPORTED_PUBLIC Thread
     /** Waiters on this thread. */
     Thread *m_pWaiter = nullptr;
 
+    /** Scheduling statistics, maintained by PerProcessorScheduler. */
+    ThreadStatistics m_Statistics;
+
     /** Lock for schedulers. */
     Spinlock m_Lock;
 
@@ -28,6 +28,7 @@
 
 template <class T> class Vector;
 
+class Thread;
 class VirtualAddressSpace;
 #if MULTIBOOT
 class BootstrapStruct_t;
@@ -301,6 +302,11 @@ class EXPORTED_PUBLIC ProcessorBase
     /** Get the number of CPUs currently available */
     static size_t getCount();
 
+    /** Is the given thread the current thread of a processor other than this
+     *  one? Only the pointer is compared, so the thread may already have been
+     *  freed. */
+    static bool isRunningElsewhere(const Thread *pThread);
+
     /** Set a new TLS area base address. */
     static void setTlsBase(uintptr_t newBase);
 
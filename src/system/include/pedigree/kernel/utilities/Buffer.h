@@ -48,8 +48,6 @@ class Thread;
 template <class T, bool allowShortOperation = false>
 class EXPORTED_PUBLIC Buffer
 {
-    friend class UnixSocket;  // to allow for calling notifyMonitors()
-
   public:
     Buffer(size_t bufferSize);
     ~Buffer();
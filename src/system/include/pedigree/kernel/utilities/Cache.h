@@ -24,6 +24,7 @@
 #include "pedigree/kernel/Spinlock.h"
 #include "pedigree/kernel/compiler.h"
 #include "pedigree/kernel/machine/TimerHandler.h"
+#include "pedigree/kernel/process/MemoryPressureManager.h"
 #include "pedigree/kernel/processor/state_forward.h"
 #include "pedigree/kernel/processor/types.h"
 #include "pedigree/kernel/utilities/BloomFilter.h"
@@ -55,6 +56,24 @@ class UnlikelyLock;
 // Forward declaration of Cache so CacheManager can be defined first
 class Cache;
 
+#if THREADS
+/** Trims caches on behalf of the MemoryPressureManager. */
+class CacheManagerPressureHandler : public MemoryPressureHandler
+{
+  public:
+    virtual const String getMemoryPressureDescription()
+    {
+        return String("Cache: evicting old pages");
+    }
+
+    virtual bool compact();
+
+    virtual size_t reclaimablePages();
+
+    virtual size_t shrink(size_t nPages);
+};
+#endif
+
 /** Provides a clean abstraction to a set of data caches. */
 class CacheManager :
 #if !STANDALONE_CACHE
@@ -88,14 +107,14 @@ class CacheManager :
 
     /**
      * Trim each cache we know about until 'count' pages have been evicted.
+     * \return the number of pages evicted.
      */
-    bool trimAll(size_t count = 1);
+    size_t trimAll(size_t count = 1);
 
-    virtual void timer(uint64_t delta, InterruptState &state);
+    /** Total number of pages held across all caches. */
+    size_t pageCount();
 
-#if THREADS
-    void trimThread();
-#endif
+    virtual void timer(uint64_t delta, InterruptState &state);
 
   private:
     /**
@@ -122,7 +141,8 @@ class CacheManager :
     List<Cache *> m_Caches;
 
 #if THREADS
-    Thread *m_pTrimThread;
+    /** Trims our caches when memory runs low. */
+    CacheManagerPressureHandler m_PressureHandler;
 #endif
 
     bool m_bActive;
@@ -272,6 +292,12 @@ class EXPORTED_PUBLIC Cache
      */
     size_t trim(size_t count = 1);
 
+    /** Number of pages currently in the cache. Read without locking. */
+    size_t count() const
+    {
+        return m_Pages.count();
+    }
+
     /**
      * Synchronises the given cache key back to a backing store, if a
      * callback has been assigned to the Cache.
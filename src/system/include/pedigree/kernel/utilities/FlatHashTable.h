@@ -0,0 +1,758 @@
+/*
+ * Copyright (c) 2008-2014, Pedigree Developers
+ *
+ * Please see the CONTRIB file in the root of the source tree for a full
+ * list of contributors.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+#ifndef KERNEL_UTILITIES_FLATHASHTABLE_H
+#define KERNEL_UTILITIES_FLATHASHTABLE_H
+
+#include "pedigree/kernel/compiler.h"
+#include "pedigree/kernel/processor/types.h"
+#include "pedigree/kernel/utilities/HashTable.h"
+#include "pedigree/kernel/utilities/Pair.h"
+#include "pedigree/kernel/utilities/Result.h"
+#include "pedigree/kernel/utilities/utility.h"
+
+/** @addtogroup kernelutilities
+ * @{ */
+
+/**
+ * Open-addressing hash table with a separate control byte array, in the style
+ * of a "Swiss table".
+ *
+ * Every slot has one control byte: empty, deleted (a tombstone), or - for a
+ * full slot - the low 7 bits of the key's (mixed) hash. Lookups probe a group
+ * of control bytes at a time and only compare keys whose 7-bit fragment
+ * matches, so a miss rarely touches the slot array at all. Removal leaves a
+ * tombstone instead of rehashing the table, and iterators stay valid across
+ * erase().
+ *
+ * Groups are probed as a single 64-bit word with plain integer operations.
+ * The kernel is built without SSE (vector state is not saved on entry), so
+ * this needs nothing beyond general-purpose registers.
+ *
+ * The API matches HashTable (including the HashTableError codes and the
+ * optional 'SiblingK' lookup type), so a user can switch by changing a
+ * typedef. As with HashTable, 'K' must provide hash() and equality against
+ * both 'K' and 'SiblingK'. The hash is mixed before use, so weak hashes
+ * (e.g. an integer returning itself) are fine.
+ */
+template <class K, class V, class SiblingK = K>
+class FlatHashTable
+{
+  private:
+    typedef FlatHashTable<K, V, SiblingK> SelfType;
+
+    /// Control byte for a slot that has never held a value.
+    static const uint8_t CtrlEmpty = 0x80;
+    /// Control byte for a slot whose value has been removed.
+    static const uint8_t CtrlDeleted = 0xFE;
+
+    /// Number of control bytes probed at once.
+    static const size_t GroupWidth = 8;
+
+    struct Slot
+    {
+        Slot() : key(), value()
+        {
+        }
+
+        K key;
+        V value;
+    };
+
+    typedef uint64_t unaligned_u64 __attribute__((aligned(1), may_alias));
+
+    /** A group of GroupWidth control bytes, loaded as one word. Each match
+     *  returns a mask with the high bit of every matching byte set. */
+    class Group
+    {
+      public:
+        explicit Group(const uint8_t *ctrl)
+            : m_Word(*reinterpret_cast<const unaligned_u64 *>(ctrl))
+        {
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+            m_Word = __builtin_bswap64(m_Word);
+#endif
+        }
+
+        /// Full slots with the given hash fragment. May report a false
+        /// positive in the byte following a true match; callers compare keys
+        /// anyway.
+        uint64_t match(uint8_t h2) const
+        {
+            uint64_t x = m_Word ^ (Lsbs * h2);
+            return (x - Lsbs) & ~x & Msbs;
+        }
+
+        uint64_t matchEmpty() const
+        {
+            return (m_Word & (~m_Word << 6)) & Msbs;
+        }
+
+        uint64_t matchEmptyOrDeleted() const
+        {
+            return (m_Word & (~m_Word << 7)) & Msbs;
+        }
+
+        uint64_t matchFull() const
+        {
+            return ~m_Word & Msbs;
+        }
+
+        /// Index of the first byte set in a non-zero mask.
+        static size_t first(uint64_t mask)
+        {
+            return __builtin_ctzll(mask) >> 3;
+        }
+
+        /// Number of bytes after the last byte set in a non-zero mask.
+        static size_t trailing(uint64_t mask)
+        {
+            return __builtin_clzll(mask) >> 3;
+        }
+
+      private:
+        static const uint64_t Lsbs = 0x0101010101010101ULL;
+        static const uint64_t Msbs = 0x8080808080808080ULL;
+
+        uint64_t m_Word;
+    };
+
+    /** Iterator over the values in the table. Holds the table and a slot
+     *  index, so no per-slot back-pointer is needed. */
+    template <class T, class Table>
+    class IteratorBase
+    {
+        template <class T2, class Table2>
+        friend class IteratorBase;
+        friend class FlatHashTable;
+
+      public:
+        IteratorBase() : m_pTable(nullptr), m_Index(0)
+        {
+        }
+
+        IteratorBase(Table *pTable, size_t index)
+            : m_pTable(pTable), m_Index(index)
+        {
+        }
+
+        /// Allows Iterator -> ConstIterator.
+        template <class T2, class Table2>
+        IteratorBase(const IteratorBase<T2, Table2> &other)
+            : m_pTable(other.m_pTable), m_Index(other.m_Index)
+        {
+        }
+
+        T &operator*() const
+        {
+            return m_pTable->m_Slots[m_Index].value;
+        }
+
+        /// Key of the current entry.
+        const K &key() const
+        {
+            return m_pTable->m_Slots[m_Index].key;
+        }
+
+        IteratorBase &operator++()
+        {
+            if (m_pTable)
+            {
+                m_Index = m_pTable->nextFull(m_Index + 1);
+            }
+            return *this;
+        }
+
+        IteratorBase &operator--()
+        {
+            if (m_pTable)
+            {
+                m_Index = m_pTable->previousFull(m_Index);
+            }
+            return *this;
+        }
+
+        bool operator==(const IteratorBase &other) const
+        {
+            return m_pTable == other.m_pTable && m_Index == other.m_Index;
+        }
+
+        bool operator!=(const IteratorBase &other) const
+        {
+            return !(*this == other);
+        }
+
+      private:
+        Table *m_pTable;
+        size_t m_Index;
+    };
+
+  public:
+    typedef IteratorBase<V, SelfType> Iterator;
+    typedef IteratorBase<const V, const SelfType> ConstIterator;
+
+    typedef Result<const V &, HashTableError::Error> LookupResult;
+    typedef Result<Pair<K, V>, HashTableError::Error> PairLookupResult;
+
+    FlatHashTable()
+        : m_Ctrl(nullptr), m_Slots(nullptr), m_Default(), m_nCapacity(0),
+          m_nMask(0), m_nItems(0), m_nGrowthLeft(0)
+    {
+    }
+
+    /**
+     * Constructor with custom default value.
+     */
+    FlatHashTable(const V &customDefault) : FlatHashTable()
+    {
+        m_Default = customDefault;
+    }
+
+    FlatHashTable(SelfType &&other) : FlatHashTable()
+    {
+        *this = pedigree_std::move(other);
+    }
+
+    ~FlatHashTable()
+    {
+        clear();
+    }
+
+    /**
+     * Clear the table, releasing all storage.
+     */
+    void clear()
+    {
+        delete[] m_Ctrl;
+        delete[] m_Slots;
+        m_Ctrl = nullptr;
+        m_Slots = nullptr;
+        m_nCapacity = 0;
+        m_nMask = 0;
+        m_nItems = 0;
+        m_nGrowthLeft = 0;
+    }
+
+    /**
+     * Check if the given key exists in the table.
+     */
+    bool contains(const K &k) const
+    {
+        return find(k) != m_nCapacity;
+    }
+
+    /**
+     * Look up the given key, returning its value or an error.
+     */
+    LookupResult lookup(const K &k) const
+    {
+        return doLookup<K>(k);
+    }
+
+    template <typename SK = SiblingK>
+    typename pedigree_std::enable_if<
+        !pedigree_std::is_same<K, SK>::value, LookupResult>::type
+    lookup(const SK &k) const
+    {
+        return doLookup<SK>(k);
+    }
+
+    /**
+     * Get the nth item in the table.
+     *
+     * As with HashTable, this provides indexed access for enumeration only;
+     * the order changes as the table grows.
+     */
+    PairLookupResult getNth(size_t n) const
+    {
+        if (n >= m_nItems)
+        {
+            return PairLookupResult::withError(
+                HashTableError::IterationComplete);
+        }
+
+        // The capacity is a multiple of the group width, so aligned groups
+        // never include the cloned control bytes.
+        for (size_t i = 0; i < m_nCapacity; i += GroupWidth)
+        {
+            uint64_t full = Group(m_Ctrl + i).matchFull();
+            for (; full; full &= full - 1)
+            {
+                if (!n--)
+                {
+                    const Slot &slot = m_Slots[i + Group::first(full)];
+                    Pair<K, V> result(slot.key, slot.value);
+                    return PairLookupResult::withValue(result);
+                }
+            }
+        }
+
+        return PairLookupResult::withError(HashTableError::IterationComplete);
+    }
+
+    /**
+     * Insert the given value with the given key. Returns false if the key is
+     * already present.
+     */
+    bool insert(const K &k, const V &v)
+    {
+        uint64_t hash = hashOf(k);
+        if (find(k, hash) != m_nCapacity)
+        {
+            return false;
+        }
+
+        size_t index = prepareInsert(hash);
+        m_Slots[index].key = k;
+        m_Slots[index].value = v;
+        return true;
+    }
+
+    /**
+     * Update the value at the given key.
+     */
+    bool update(const K &k, const V &v)
+    {
+        size_t index = find(k);
+        if (index == m_nCapacity)
+        {
+            return false;
+        }
+
+        m_Slots[index].value = v;
+        return true;
+    }
+
+    /**
+     * Remove the given key.
+     */
+    void remove(const K &k)
+    {
+        size_t index = find(k);
+        if (index != m_nCapacity)
+        {
+            eraseAt(index);
+        }
+    }
+
+    /**
+     * Reserve space for the given number of items without further growth.
+     */
+    void reserve(size_t numItems)
+    {
+        size_t capacity = GroupWidth;
+        while (maxLoad(capacity) < numItems)
+        {
+            capacity *= 2;
+        }
+
+        if (capacity > m_nCapacity)
+        {
+            resize(capacity);
+        }
+    }
+
+    size_t count() const
+    {
+        return m_nItems;
+    }
+
+    /**
+     * Bytes of heap used by the table (control bytes and slots).
+     */
+    size_t memoryUsage() const
+    {
+        if (!m_nCapacity)
+        {
+            return 0;
+        }
+        return (m_nCapacity + GroupWidth) + (m_nCapacity * sizeof(Slot));
+    }
+
+    Iterator begin()
+    {
+        return Iterator(this, nextFull(0));
+    }
+
+    ConstIterator begin() const
+    {
+        return ConstIterator(this, nextFull(0));
+    }
+
+    Iterator end()
+    {
+        return Iterator(this, m_nCapacity);
+    }
+
+    ConstIterator end() const
+    {
+        return ConstIterator(this, m_nCapacity);
+    }
+
+    /**
+     * Erase the value at the given iterator position, returning an iterator
+     * to the next value. Other iterators remain valid.
+     */
+    Iterator erase(Iterator &at)
+    {
+        if (at.m_pTable != this || at.m_Index >= m_nCapacity ||
+            !isFull(m_Ctrl[at.m_Index]))
+        {
+            return at;
+        }
+
+        eraseAt(at.m_Index);
+        return Iterator(this, nextFull(at.m_Index + 1));
+    }
+
+    /**
+     * \note As with HashTable, copies must be requested explicitly via
+     * copyFrom() so owners of pointer values decide how they're shared.
+     */
+    FlatHashTable(const SelfType &other) = delete;
+    SelfType &operator=(const SelfType &p) = delete;
+
+    /**
+     * Forceful opt-in to copy values from the other table into this one.
+     */
+    void copyFrom(const SelfType &other)
+    {
+        clear();
+
+        m_Default = other.m_Default;
+        if (!other.m_nCapacity)
+        {
+            return;
+        }
+
+        allocate(other.m_nCapacity);
+        MemoryCopy(m_Ctrl, other.m_Ctrl, m_nCapacity + GroupWidth);
+        for (size_t i = 0; i < m_nCapacity; ++i)
+        {
+            if (isFull(m_Ctrl[i]))
+            {
+                m_Slots[i] = other.m_Slots[i];
+            }
+        }
+        m_nItems = other.m_nItems;
+        m_nGrowthLeft = other.m_nGrowthLeft;
+    }
+
+    SelfType &operator=(SelfType &&p)
+    {
+        clear();
+
+        m_Ctrl = p.m_Ctrl;
+        m_Slots = p.m_Slots;
+        m_Default = pedigree_std::move(p.m_Default);
+        m_nCapacity = p.m_nCapacity;
+        m_nMask = p.m_nMask;
+        m_nItems = p.m_nItems;
+        m_nGrowthLeft = p.m_nGrowthLeft;
+
+        p.m_Ctrl = nullptr;
+        p.m_Slots = nullptr;
+        p.clear();
+
+        return *this;
+    }
+
+  private:
+    static bool isFull(uint8_t ctrl)
+    {
+        return (ctrl & 0x80) == 0;
+    }
+
+    /// Items a table of the given capacity holds before growing (7/8).
+    static size_t maxLoad(size_t capacity)
+    {
+        return capacity - (capacity / 8);
+    }
+
+    /// Mixes the key's hash so both the 7-bit fragment (the top bits) and
+    /// the probe start (the folded low bits) depend on every bit of it.
+    template <class HashK>
+    static uint64_t hashOf(const HashK &k)
+    {
+        uint64_t h = static_cast<uint32_t>(k.hash());
+        h *= 0x9E3779B97F4A7C15ULL;
+        return h ^ (h >> 32);
+    }
+
+    static uint8_t h2(uint64_t hash)
+    {
+        return hash >> 57;
+    }
+
+    size_t probeStart(uint64_t hash) const
+    {
+        return hash & m_nMask;
+    }
+
+    /// Sets a control byte, keeping the cloned bytes after the end (used by
+    /// groups that wrap around) in sync.
+    void setCtrl(size_t index, uint8_t ctrl)
+    {
+        m_Ctrl[index] = ctrl;
+        if (index < GroupWidth)
+        {
+            m_Ctrl[m_nCapacity + index] = ctrl;
+        }
+    }
+
+    template <class FindK>
+    size_t find(const FindK &k) const
+    {
+        return find(k, hashOf(k));
+    }
+
+    /// Returns the slot holding the key, or m_nCapacity if not present.
+    /// The probe visits every group (triangular steps over a power-of-two
+    /// capacity) and stops at the first group with an empty slot. The load
+    /// limit guarantees at least one empty slot, so the loop terminates.
+    template <class FindK>
+    size_t find(const FindK &k, uint64_t hash) const
+    {
+        if (!m_nItems)
+        {
+            return m_nCapacity;
+        }
+
+        size_t pos = probeStart(hash);
+        size_t step = GroupWidth;
+        uint8_t fragment = h2(hash);
+        while (true)
+        {
+            Group g(m_Ctrl + pos);
+            for (uint64_t m = g.match(fragment); m; m &= m - 1)
+            {
+                size_t index = (pos + Group::first(m)) & m_nMask;
+                if (LIKELY(m_Slots[index].key == k))
+                {
+                    return index;
+                }
+            }
+
+            if (LIKELY(g.matchEmpty()))
+            {
+                return m_nCapacity;
+            }
+
+            pos = (pos + step) & m_nMask;
+            step += GroupWidth;
+        }
+    }
+
+    /// First empty or deleted slot on the probe sequence for the hash.
+    size_t findFirstNonFull(uint64_t hash) const
+    {
+        size_t pos = probeStart(hash);
+        size_t step = GroupWidth;
+        while (true)
+        {
+            uint64_t m = Group(m_Ctrl + pos).matchEmptyOrDeleted();
+            if (m)
+            {
+                return (pos + Group::first(m)) & m_nMask;
+            }
+
+            pos = (pos + step) & m_nMask;
+            step += GroupWidth;
+        }
+    }
+
+    /// Claims a slot for a new key with the given hash, growing if needed.
+    size_t prepareInsert(uint64_t hash)
+    {
+        if (!m_nCapacity)
+        {
+            resize(GroupWidth);
+        }
+
+        size_t index = findFirstNonFull(hash);
+        if (!m_nGrowthLeft && m_Ctrl[index] != CtrlDeleted)
+        {
+            // Out of empty slots. If tombstones make up a good part of the
+            // table, rehashing in place is enough to reclaim them.
+            if (m_nItems <= maxLoad(m_nCapacity) / 2)
+            {
+                resize(m_nCapacity);
+            }
+            else
+            {
+                resize(m_nCapacity * 2);
+            }
+            index = findFirstNonFull(hash);
+        }
+
+        if (m_Ctrl[index] == CtrlEmpty)
+        {
+            --m_nGrowthLeft;
+        }
+        setCtrl(index, h2(hash));
+        ++m_nItems;
+        return index;
+    }
+
+    void eraseAt(size_t index)
+    {
+        --m_nItems;
+        m_Slots[index].key = K();
+        m_Slots[index].value = m_Default;
+
+        // If every group containing this slot also has an empty slot, no probe
+        // can have passed over it, and it can go straight back to empty.
+        uint64_t emptyBefore =
+            Group(m_Ctrl + ((index - GroupWidth) & m_nMask)).matchEmpty();
+        uint64_t emptyAfter = Group(m_Ctrl + index).matchEmpty();
+        if (emptyBefore && emptyAfter &&
+            (Group::first(emptyAfter) + Group::trailing(emptyBefore)) <
+                GroupWidth)
+        {
+            setCtrl(index, CtrlEmpty);
+            ++m_nGrowthLeft;
+        }
+        else
+        {
+            setCtrl(index, CtrlDeleted);
+        }
+    }
+
+    void allocate(size_t capacity)
+    {
+        m_nCapacity = capacity;
+        m_nMask = capacity - 1;
+        m_Ctrl = new uint8_t[capacity + GroupWidth];
+        ByteSet(m_Ctrl, CtrlEmpty, capacity + GroupWidth);
+        m_Slots = new Slot[capacity];
+        for (size_t i = 0; i < capacity; ++i)
+        {
+            m_Slots[i].value = m_Default;
+        }
+        m_nItems = 0;
+        m_nGrowthLeft = maxLoad(capacity);
+    }
+
+    /// Moves every item into fresh storage of the given capacity, dropping
+    /// tombstones on the way.
+    void resize(size_t capacity)
+    {
+        uint8_t *oldCtrl = m_Ctrl;
+        Slot *oldSlots = m_Slots;
+        size_t oldCapacity = m_nCapacity;
+
+        allocate(capacity);
+
+        for (size_t i = 0; i < oldCapacity; ++i)
+        {
+            if (!isFull(oldCtrl[i]))
+            {
+                continue;
+            }
+
+            uint64_t hash = hashOf(oldSlots[i].key);
+            size_t index = findFirstNonFull(hash);
+            setCtrl(index, h2(hash));
+            m_Slots[index].key = pedigree_std::move(oldSlots[i].key);
+            m_Slots[index].value = pedigree_std::move(oldSlots[i].value);
+            ++m_nItems;
+            --m_nGrowthLeft;
+        }
+
+        delete[] oldCtrl;
+        delete[] oldSlots;
+    }
+
+    /// First full slot at or after the given index, or m_nCapacity.
+    size_t nextFull(size_t index) const
+    {
+        // Tables are mostly full, so the next slot is the common case.
+        if (index < m_nCapacity && isFull(m_Ctrl[index]))
+        {
+            return index;
+        }
+
+        while (index < m_nCapacity)
+        {
+            uint64_t full = Group(m_Ctrl + index).matchFull();
+            size_t remaining = m_nCapacity - index;
+            if (remaining < GroupWidth)
+            {
+                // Don't look at the cloned bytes past the end.
+                full &= (1ULL << (remaining * 8)) - 1;
+            }
+
+            if (full)
+            {
+                return index + Group::first(full);
+            }
+
+            index += GroupWidth;
+        }
+
+        return m_nCapacity;
+    }
+
+    /// Last full slot before the given index; the index itself if none.
+    size_t previousFull(size_t index) const
+    {
+        for (size_t i = index; i > 0; --i)
+        {
+            if (isFull(m_Ctrl[i - 1]))
+            {
+                return i - 1;
+            }
+        }
+
+        return index;
+    }
+
+    template <class LookupK>
+    LookupResult doLookup(const LookupK &k) const
+    {
+        if (!m_nItems)
+        {
+            return LookupResult::withError(HashTableError::HashTableEmpty);
+        }
+
+        size_t index = find(k);
+        if (index == m_nCapacity)
+        {
+            return LookupResult::withError(HashTableError::NotFound);
+        }
+
+        return LookupResult::withValue(m_Slots[index].value);
+    }
+
+    /// Control bytes; m_nCapacity + GroupWidth of them, where the last
+    /// GroupWidth mirror the first so a group can be loaded at any index.
+    uint8_t *m_Ctrl;
+    Slot *m_Slots;
+    V m_Default;
+    size_t m_nCapacity;
+    size_t m_nMask;
+    size_t m_nItems;
+    /// Empty slots that may still be filled before the table must grow.
+    size_t m_nGrowthLeft;
+};
+
+/** @} */
+
+#endif
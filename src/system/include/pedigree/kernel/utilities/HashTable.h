@@ -417,6 +417,14 @@ class HashTable
         return m_nItems;
     }
 
+    /**
+     * Bytes of heap used by the bucket array.
+     */
+    size_t memoryUsage() const
+    {
+        return m_Buckets ? m_nBuckets * sizeof(bucket) : 0;
+    }
+
     Iterator begin()
     {
         return m_nItems ? Iterator(getFirstSetBucket()) : end();
@@ -0,0 +1,354 @@
+/*
+ * Copyright (c) 2008-2014, Pedigree Developers
+ *
+ * Please see the CONTRIB file in the root of the source tree for a full
+ * list of contributors.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+#ifndef KERNEL_UTILITIES_INTERVALTREE_H
+#define KERNEL_UTILITIES_INTERVALTREE_H
+
+#include "pedigree/kernel/compiler.h"
+#include "pedigree/kernel/processor/types.h"
+#include "pedigree/kernel/utilities/Vector.h"
+
+/** @addtogroup kernelutilities
+ * @{ */
+
+/**
+ * A set of half-open [start, end) intervals, each with a value.
+ *
+ * This is an AVL tree ordered by interval start, where every node also tracks
+ * the largest end in its subtree. That lets lookups and overlap queries skip
+ * whole subtrees, so finding the interval covering an address is O(log n)
+ * rather than a walk over every interval.
+ *
+ * Intervals may overlap and may share a start. An interval is identified by
+ * its start and value when it is removed.
+ *
+ * \note Not thread-safe; callers provide their own locking.
+ */
+template <class T>
+class IntervalTree
+{
+  public:
+    IntervalTree() : m_Root(0), m_Count(0)
+    {
+    }
+
+    ~IntervalTree()
+    {
+        clear();
+    }
+
+    /** Adds the interval [start, end) with the given value. */
+    void insert(uintptr_t start, uintptr_t end, const T &value)
+    {
+        m_Root = insertNode(m_Root, new Node(start, end, value));
+        ++m_Count;
+    }
+
+    /** Removes the interval beginning at \p start with the given value.
+     *  \return false if there was no such interval. */
+    bool remove(uintptr_t start, const T &value)
+    {
+        bool bRemoved = false;
+        m_Root = removeNode(m_Root, start, value, bRemoved);
+        if (bRemoved)
+        {
+            --m_Count;
+        }
+        return bRemoved;
+    }
+
+    /** Finds an interval containing \p address.
+     *  \return false if no interval contains the address. */
+    bool lookup(uintptr_t address, T &value) const
+    {
+        Node *n = m_Root;
+        while (n)
+        {
+            if ((n->start <= address) && (address < n->end))
+            {
+                value = n->value;
+                return true;
+            }
+
+            // If anything on the left reaches past the address, either it
+            // contains the address or nothing to our right can.
+            if (n->left && (n->left->maxEnd > address))
+            {
+                n = n->left;
+            }
+            else if (n->start > address)
+            {
+                // Everything to the right starts even later.
+                break;
+            }
+            else
+            {
+                n = n->right;
+            }
+        }
+
+        return false;
+    }
+
+    /** Adds the value of every interval overlapping [start, end) to
+     *  \p results, in order of interval start. */
+    void overlapping(uintptr_t start, uintptr_t end, Vector<T> &results) const
+    {
+        collect(m_Root, start, end, results);
+    }
+
+    /** Adds the value of every interval to \p results, in order of interval
+     *  start. */
+    void values(Vector<T> &results) const
+    {
+        collect(m_Root, 0, ~static_cast<uintptr_t>(0), results);
+    }
+
+    /** Number of intervals in the tree. */
+    size_t count() const
+    {
+        return m_Count;
+    }
+
+    /** Removes every interval. */
+    void clear()
+    {
+        destroy(m_Root);
+        m_Root = 0;
+        m_Count = 0;
+    }
+
+  private:
+    NOT_COPYABLE_OR_ASSIGNABLE(IntervalTree);
+
+    struct Node
+    {
+        Node(uintptr_t s, uintptr_t e, const T &v)
+            : start(s), end(e), maxEnd(e), height(1), value(v), left(0),
+              right(0)
+        {
+        }
+
+        uintptr_t start;
+        uintptr_t end;
+        /** Largest end of any interval in this subtree. */
+        uintptr_t maxEnd;
+        size_t height;
+        T value;
+        Node *left;
+        Node *right;
+    };
+
+    static size_t height(Node *n)
+    {
+        return n ? n->height : 0;
+    }
+
+    /** Recalculates the height and maxEnd of a node from its children. */
+    static void update(Node *n)
+    {
+        size_t lh = height(n->left), rh = height(n->right);
+        n->height = (lh > rh ? lh : rh) + 1;
+
+        n->maxEnd = n->end;
+        if (n->left && (n->left->maxEnd > n->maxEnd))
+        {
+            n->maxEnd = n->left->maxEnd;
+        }
+        if (n->right && (n->right->maxEnd > n->maxEnd))
+        {
+            n->maxEnd = n->right->maxEnd;
+        }
+    }
+
+    static Node *rotateLeft(Node *n)
+    {
+        Node *r = n->right;
+        n->right = r->left;
+        r->left = n;
+        update(n);
+        update(r);
+        return r;
+    }
+
+    static Node *rotateRight(Node *n)
+    {
+        Node *l = n->left;
+        n->left = l->right;
+        l->right = n;
+        update(n);
+        update(l);
+        return l;
+    }
+
+    /** Updates a node after one of its subtrees changed, rotating if it has
+     *  become unbalanced. Returns the new root of the subtree. */
+    static Node *rebalance(Node *n)
+    {
+        update(n);
+
+        size_t lh = height(n->left), rh = height(n->right);
+        if (lh > (rh + 1))
+        {
+            if (height(n->left->left) < height(n->left->right))
+            {
+                n->left = rotateLeft(n->left);
+            }
+            return rotateRight(n);
+        }
+        else if (rh > (lh + 1))
+        {
+            if (height(n->right->right) < height(n->right->left))
+            {
+                n->right = rotateRight(n->right);
+            }
+            return rotateLeft(n);
+        }
+
+        return n;
+    }
+
+    static Node *insertNode(Node *n, Node *newNode)
+    {
+        if (!n)
+        {
+            return newNode;
+        }
+
+        if (newNode->start < n->start)
+        {
+            n->left = insertNode(n->left, newNode);
+        }
+        else
+        {
+            n->right = insertNode(n->right, newNode);
+        }
+
+        return rebalance(n);
+    }
+
+    /** Unlinks the leftmost node of a subtree into \p min. */
+    static Node *removeMin(Node *n, Node *&min)
+    {
+        if (!n->left)
+        {
+            min = n;
+            return n->right;
+        }
+
+        n->left = removeMin(n->left, min);
+        return rebalance(n);
+    }
+
+    static Node *
+    removeNode(Node *n, uintptr_t start, const T &value, bool &bRemoved)
+    {
+        if (!n)
+        {
+            return 0;
+        }
+
+        if (start < n->start)
+        {
+            n->left = removeNode(n->left, start, value, bRemoved);
+        }
+        else if (start > n->start)
+        {
+            n->right = removeNode(n->right, start, value, bRemoved);
+        }
+        else if (!(n->value == value))
+        {
+            // Rotations can leave intervals with the same start on either
+            // side of this one.
+            n->left = removeNode(n->left, start, value, bRemoved);
+            if (!bRemoved)
+            {
+                n->right = removeNode(n->right, start, value, bRemoved);
+            }
+        }
+        else
+        {
+            bRemoved = true;
+
+            Node *replacement = 0;
+            if (!n->left)
+            {
+                replacement = n->right;
+            }
+            else if (!n->right)
+            {
+                replacement = n->left;
+            }
+            else
+            {
+                // Successor takes this node's place.
+                Node *right = removeMin(n->right, replacement);
+                replacement->left = n->left;
+                replacement->right = right;
+            }
+
+            delete n;
+            return replacement ? rebalance(replacement) : 0;
+        }
+
+        return rebalance(n);
+    }
+
+    static void
+    collect(Node *n, uintptr_t start, uintptr_t end, Vector<T> &results)
+    {
+        // Nothing in this subtree reaches the range.
+        if (!n || (n->maxEnd <= start))
+        {
+            return;
+        }
+
+        collect(n->left, start, end, results);
+
+        if (n->start < end)
+        {
+            if (n->end > start)
+            {
+                results.pushBack(n->value);
+            }
+
+            collect(n->right, start, end, results);
+        }
+    }
+
+    static void destroy(Node *n)
+    {
+        if (!n)
+        {
+            return;
+        }
+
+        destroy(n->left);
+        destroy(n->right);
+        delete n;
+    }
+
+    Node *m_Root;
+    size_t m_Count;
+};
+
+/** @} */
+
+#endif  // KERNEL_UTILITIES_INTERVALTREE_H
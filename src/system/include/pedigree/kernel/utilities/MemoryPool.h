@@ -48,6 +48,10 @@ class MemoryPoolPressureHandler : public MemoryPressureHandler
 
     virtual bool compact();
 
+    virtual size_t reclaimablePages();
+
+    virtual size_t shrink(size_t nPages);
+
   private:
     MemoryPool *m_Pool;
 };
@@ -87,13 +91,29 @@ class EXPORTED_PUBLIC MemoryPool
     /// Frees an allocated buffer, allowing it to be used elsewhere
     void free(uintptr_t buffer);
 
-    /// Trims the pool, freeing pages that are not otherwise in use.
-    bool trim();
+    /// Whether the given address lies within this pool's buffers.
+    bool contains(uintptr_t buffer) const;
+
+    /// Size of each buffer, after rounding.
+    size_t bufferSize() const
+    {
+        return m_BufferSize;
+    }
+
+    /// Trims the pool, freeing pages that are not otherwise in use. Does
+    /// nothing if another thread is using the pool.
+    /// @return The number of pages freed.
+    size_t trim();
+
+    /// Estimates the number of pages a trim() could free. Pages that have
+    /// already been trimmed are still counted until they are reused. Returns
+    /// zero if another thread is using the pool.
+    size_t unusedPages() const;
 
   private:
 #if THREADS
     ConditionVariable m_Condition;
-    Mutex m_Lock;
+    mutable Mutex m_Lock;
 #endif
 
     /// Size of each buffer in this pool
@@ -0,0 +1,160 @@
+/*
+ * Copyright (c) 2008-2014, Pedigree Developers
+ *
+ * Please see the CONTRIB file in the root of the source tree for a full
+ * list of contributors.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+#ifndef KERNEL_UTILITIES_PAGEINDEX_H
+#define KERNEL_UTILITIES_PAGEINDEX_H
+
+#include "pedigree/kernel/compiler.h"
+#include "pedigree/kernel/processor/types.h"
+
+/**
+ * A sparse map from page (or block) index to a cached page address.
+ *
+ * This is a radix tree with 64 slots per node. Every node keeps a bitmap of
+ * which slots are in use and, for each tag, a bitmap of which slots have that
+ * tag somewhere beneath them. Finding the next entry (or the next tagged
+ * entry) after a given index therefore skips empty or untagged subtrees a
+ * word at a time, which is what gang lookups for readahead and writeback
+ * rely on.
+ *
+ * Values must not be zero; zero is returned for indices with no entry.
+ * There is no locking - the owner must serialise access.
+ */
+class EXPORTED_PUBLIC PageIndex
+{
+  public:
+    /** Tags that can be attached to each entry. */
+    enum Tag
+    {
+        Dirty = 0,
+        Writeback,
+        Pinned,
+
+        TagCount
+    };
+
+    PageIndex();
+    ~PageIndex();
+
+    /** Returns the value at \p index, or zero if there is none. */
+    uintptr_t lookup(size_t index) const;
+
+    /**
+     * Sets the value at \p index. Tags on an existing entry are kept; new
+     * entries start with no tags set.
+     */
+    void insert(size_t index, uintptr_t value);
+
+    /** Removes the entry at \p index (and its tags), returning its value. */
+    uintptr_t remove(size_t index);
+
+    /** Removes every entry. */
+    void clear();
+
+    /** Number of entries in the index. */
+    size_t count() const
+    {
+        return m_Count;
+    }
+
+    /** Sets \p tag on the entry at \p index. Fails if there is no entry. */
+    bool setTag(size_t index, Tag tag);
+
+    /** Clears \p tag on the entry at \p index. */
+    void clearTag(size_t index, Tag tag);
+
+    /** Whether the entry at \p index has \p tag set. */
+    bool isTagged(size_t index, Tag tag) const;
+
+    /** Whether any entry at all has \p tag set. */
+    bool anyTagged(Tag tag) const;
+
+    /**
+     * Finds up to \p max entries with indices in [first, last], in order.
+     * \param indices receives the index of each entry found, may be null.
+     * \param values receives the value of each entry found, may be null.
+     * \return the number of entries found.
+     */
+    size_t gangLookup(
+        size_t first, size_t last, size_t max, size_t *indices,
+        uintptr_t *values) const;
+
+    /** As gangLookup(), but only finds entries with \p tag set. */
+    size_t gangLookupTagged(
+        size_t first, size_t last, Tag tag, size_t max, size_t *indices,
+        uintptr_t *values) const;
+
+  private:
+    NOT_COPYABLE_OR_ASSIGNABLE(PageIndex);
+
+    static const size_t NodeShift = 6;
+    static const size_t NodeSize = 1 << NodeShift;
+    static const size_t NodeMask = NodeSize - 1;
+    static const size_t IndexBits = sizeof(size_t) * 8;
+    /** Deep enough for any size_t index. */
+    static const size_t MaxDepth = (IndexBits + NodeShift - 1) / NodeShift;
+
+    struct Node
+    {
+        Node(size_t shift_);
+
+        /** Bit n is set if slots[n] is in use. */
+        uint64_t present;
+        /** Bit n of tags[t] is set if anything under slots[n] has tag t. */
+        uint64_t tags[TagCount];
+        /** How far to shift an index to get this node's slot number. */
+        size_t shift;
+        /** Child nodes, or values in leaves (shift == 0). */
+        uintptr_t slots[NodeSize];
+    };
+
+    /** Whether the subtree of a node with the given shift holds \p index. */
+    static bool covers(size_t shift, size_t index)
+    {
+        size_t span = shift + NodeShift;
+        return (span >= IndexBits) || !(index >> span);
+    }
+
+    /** Adds levels above the root until \p index fits in the tree. */
+    void grow(size_t index);
+
+    /** Finds the leaf that would hold \p index, or null. */
+    Node *findLeaf(size_t index) const;
+
+    /**
+     * Finds the first entry at or after \p index that is in use (\p tag is
+     * TagCount) or has \p tag set. Updates \p index to match and returns
+     * the leaf holding it, or null if there is no such entry.
+     */
+    Node *findNext(size_t &index, size_t tag) const;
+
+    /** Common implementation of gangLookup() and gangLookupTagged(). */
+    size_t gather(
+        size_t first, size_t last, size_t tag, size_t max, size_t *indices,
+        uintptr_t *values) const;
+
+    /** Frees \p node and everything beneath it. */
+    void destroy(Node *node);
+
+    Node *m_pRoot;
+    size_t m_Count;
+};
+
+#endif
@@ -0,0 +1,223 @@
+/*
+ * Copyright (c) 2008-2014, Pedigree Developers
+ *
+ * Please see the CONTRIB file in the root of the source tree for a full
+ * list of contributors.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef KERNEL_UTILITIES_PAGERING_H
+#define KERNEL_UTILITIES_PAGERING_H
+
+#include "pedigree/kernel/Atomic.h"
+#include "pedigree/kernel/compiler.h"
+#include "pedigree/kernel/process/ConditionVariable.h"
+#include "pedigree/kernel/process/Mutex.h"
+#include "pedigree/kernel/processor/types.h"
+#include "pedigree/kernel/utilities/ObjectPool.h"
+
+/**
+ * A bounded FIFO of reference-counted pages, suitable for pipes.
+ *
+ * Data lives in a fixed ring of slots, each of which refers to a range of
+ * bytes within a page. Small writes are merged into the last page when no
+ * other slot shares it. Pages can be moved (splice) or shared (tee) between
+ * two rings without copying their contents, and freed pages are recycled
+ * through a global free list rather than going back to the heap.
+ *
+ * Blocking behaviour matches Buffer: writes block until everything has been
+ * written, reads block until at least one byte is available, and disabling
+ * either end wakes up anyone waiting on the other.
+ */
+class EXPORTED_PUBLIC PageRing
+{
+  public:
+    /** Size of each page held in the ring. */
+    static const size_t PageSize = 4096;
+
+    /** Number of slots in a ring unless specified otherwise. */
+    static const size_t DefaultSlotCount = 16;
+
+    /**
+     * Moves up to \param length bytes between a page and some other storage.
+     * For fill() \param data is the page to write into, for drain() it is the
+     * page to read from. Returns the number of bytes handled; returning fewer
+     * than \param length ends the operation.
+     *
+     * \note Called with the ring lock held.
+     */
+    typedef size_t (*PageCallback)(void *param, uint8_t *data, size_t length);
+
+    PageRing(size_t slotCount = DefaultSlotCount);
+    ~PageRing();
+
+    /**
+     * Write \param count bytes from \param buffer, optionally blocking
+     * before writing if there is insufficient space.
+     */
+    size_t write(const void *buffer, size_t count, bool block = true);
+
+    /**
+     * Read \param count bytes into \param buffer, optionally blocking
+     * if no more bytes are available to be read yet.
+     */
+    size_t read(void *buffer, size_t count, bool block = true);
+
+    /**
+     * Fill the ring with up to \param count bytes produced by \param callback
+     * directly into its pages. Blocks like write().
+     */
+    size_t fill(
+        size_t count, PageCallback callback, void *param, bool block = true);
+
+    /**
+     * Consume up to \param count bytes by handing the ring's pages to
+     * \param callback. Blocks like read().
+     */
+    size_t drain(
+        size_t count, PageCallback callback, void *param, bool block = true);
+
+    /**
+     * Move up to \param count bytes of pages from this ring into \param dest
+     * without copying. Blocks until at least one byte has been moved.
+     */
+    size_t splice(PageRing &dest, size_t count, bool block = true);
+
+    /**
+     * Share up to \param count bytes of pages from this ring with \param dest
+     * without consuming them or copying. Blocks like splice().
+     */
+    size_t tee(PageRing &dest, size_t count, bool block = true);
+
+    /**
+     * Disable further writes to the ring.
+     * This will wake up all readers waiting on a writer.
+     */
+    void disableWrites();
+
+    /**
+     * Disable further reads from the ring.
+     * This will wake up all writers waiting on reader.
+     */
+    void disableReads();
+
+    /**
+     * Enable writes to the ring.
+     *
+     * \return the previous state of writes.
+     */
+    bool enableWrites();
+
+    /**
+     * Enable reads from the ring.
+     *
+     * \return the previous state of reads.
+     */
+    bool enableReads();
+
+    /**
+     * Get the number of bytes in the ring now.
+     */
+    size_t getDataSize();
+
+    /**
+     * Get the full size of the ring (potential storage).
+     */
+    size_t getSize() const;
+
+    /**
+     * Check if the ring can be written to.
+     * \note This does not guarantee the next write() will succeed.
+     */
+    bool canWrite(bool block);
+
+    /**
+     * Check if the ring can be read from.
+     */
+    bool canRead(bool block);
+
+    /**
+     * Wipes the ring, returning all of its pages.
+     */
+    void wipe();
+
+  private:
+    NOT_COPYABLE_OR_ASSIGNABLE(PageRing);
+
+    /** A page of data, shared by every slot that refers to it. */
+    struct Page
+    {
+        Page() : refs(0), data()
+        {
+        }
+
+        Atomic<size_t> refs;
+        uint8_t data[PageSize];
+    };
+
+    /** A range of bytes within a page. */
+    struct Slot
+    {
+        Page *page;
+        size_t offset;
+        size_t length;
+    };
+
+    /** Common implementation of splice() and tee(). */
+    size_t transfer(PageRing &dest, size_t count, bool block, bool consume);
+
+    /** Moves or shares pages into \p dest; both locks must be held. */
+    size_t transferLocked(PageRing &dest, size_t count, bool consume);
+
+    /** Waits until there is data to read. Returns false if there never
+     *  will be (or blocking failed). */
+    bool waitForData();
+
+    /** Waits until there is a free slot. Returns false if there never
+     *  will be (or blocking failed). */
+    bool waitForSpace();
+
+    /** Pushes a slot onto the tail; lock must be held and a slot free. */
+    void push(Page *page, size_t offset, size_t length);
+
+    /** Releases the head slot; lock must be held. */
+    void pop();
+
+    Slot &slot(size_t n)
+    {
+        return m_Slots[(m_Head + n) % m_SlotCount];
+    }
+
+    static Page *allocatePage();
+    static void releasePage(Page *page);
+
+    size_t m_SlotCount;
+    Slot *m_Slots;
+    size_t m_Head;
+    size_t m_Count;
+    size_t m_DataSize;
+
+    Mutex m_Lock;
+
+    ConditionVariable m_WriteCondition;
+    ConditionVariable m_ReadCondition;
+
+    bool m_bCanRead;
+    bool m_bCanWrite;
+
+    /** Pages kept around for reuse once every ring has let go (1 MiB). */
+    static ObjectPool<Page, 256> m_PagePool;
+};
+
+#endif
@@ -0,0 +1,219 @@
+/*
+ * Copyright (c) 2008-2014, Pedigree Developers
+ *
+ * Please see the CONTRIB file in the root of the source tree for a full
+ * list of contributors.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+#ifndef KERNEL_UTILITIES_SPSCRING_H
+#define KERNEL_UTILITIES_SPSCRING_H
+
+#include "pedigree/kernel/compiler.h"
+#include "pedigree/kernel/process/ConditionVariable.h"
+#include "pedigree/kernel/process/Mutex.h"
+#include "pedigree/kernel/processor/types.h"
+#include "pedigree/kernel/utilities/List.h"
+
+class Event;
+class Semaphore;
+class Thread;
+
+/**
+ * A byte ring for one producer and one consumer, suitable for stream sockets.
+ *
+ * The ring is a single power-of-two sized allocation indexed by two
+ * free-running counters: the producer only ever advances the head and the
+ * consumer only ever advances the tail, so a read and a write never contend
+ * on a lock. Producers (and consumers) are still serialised among themselves
+ * by a per-side lock, which is uncontended in the common one-writer,
+ * one-reader case. Sleeping only happens when the ring is full or empty, and
+ * the other side only takes the wait lock if someone is actually asleep.
+ *
+ * Storage is allocated on the first write, so rings that never carry any
+ * data (e.g. on listening sockets) cost nothing.
+ *
+ * Blocking behaviour matches Buffer: writes block until everything has been
+ * written, reads block until at least one byte is available, and disabling
+ * either end wakes up anyone waiting on the other.
+ */
+class EXPORTED_PUBLIC SpscRing
+{
+  public:
+    /** Minimum size of a ring, in bytes. */
+    static const size_t MinimumSize = 4096;
+
+    /** Size of a ring unless specified otherwise. */
+    static const size_t DefaultSize = 65536;
+
+    /** Creates a ring of at least \p size bytes (rounded up to a power of
+     *  two, and at least MinimumSize). */
+    SpscRing(size_t size = DefaultSize);
+    ~SpscRing();
+
+    /**
+     * Write \param count bytes from \param buffer, optionally blocking
+     * before writing if there is insufficient space.
+     */
+    size_t write(const void *buffer, size_t count, bool block = true);
+
+    /**
+     * Read \param count bytes into \param buffer, optionally blocking
+     * if no more bytes are available to be read yet.
+     */
+    size_t read(void *buffer, size_t count, bool block = true);
+
+    /**
+     * Disable further writes to the ring.
+     * This will wake up all readers waiting on a writer.
+     */
+    void disableWrites();
+
+    /**
+     * Disable further reads from the ring.
+     * This will wake up all writers waiting on reader.
+     */
+    void disableReads();
+
+    /**
+     * Enable writes to the ring.
+     *
+     * \return the previous state of writes.
+     */
+    bool enableWrites();
+
+    /**
+     * Enable reads from the ring.
+     *
+     * \return the previous state of reads.
+     */
+    bool enableReads();
+
+    /**
+     * Get the number of bytes in the ring now.
+     */
+    size_t getDataSize() const;
+
+    /**
+     * Get the full size of the ring (potential storage).
+     */
+    size_t getSize() const;
+
+    /**
+     * Check if the ring can be written to.
+     * \note This does not guarantee the next write() will succeed.
+     */
+    bool canWrite(bool block);
+
+    /**
+     * Check if the ring can be read from.
+     */
+    bool canRead(bool block);
+
+    /**
+     * Wipes the ring.
+     */
+    void wipe();
+
+    /**
+     * Add an event to be sent to the given thread upon a data change.
+     *
+     * \note An event does not guarantee the next operation will succeed.
+     */
+    void monitor(Thread *pThread, Event *pEvent);
+
+    /**
+     * Add a Semaphore to be signaled when data changes.
+     */
+    void monitor(Semaphore *pSemaphore);
+
+    /**
+     * Remove monitoring targets for the given Semaphore.
+     */
+    void cullMonitorTargets(Semaphore *pSemaphore);
+
+    /**
+     * Remove monitoring targets for the given Event.
+     */
+    void cullMonitorTargets(Event *pEvent);
+
+    /**
+     * Send events to (and then clear) all monitor targets. Cheap when there
+     * are none, so this can be called after every operation.
+     */
+    void notifyMonitors();
+
+  private:
+    NOT_COPYABLE_OR_ASSIGNABLE(SpscRing);
+
+    /** Waits until there is data to read. Returns false if there never
+     *  will be (or blocking failed). */
+    bool waitForData();
+
+    /** Waits until there is space to write. Returns false if there never
+     *  will be (or blocking failed). */
+    bool waitForSpace();
+
+    /** Wakes sleeping readers, if there are any. */
+    void wakeReaders();
+
+    /** Wakes sleeping writers, if there are any. */
+    void wakeWriters();
+
+    /** Wakes every sleeper, used when the state of either end changes. */
+    void wakeAll();
+
+    /** Contains information about a particular target to send events to. */
+    struct MonitorTarget
+    {
+        Thread *pThread;
+        Event *pEvent;
+        Semaphore *pSemaphore;
+    };
+
+    uint8_t *m_pData;
+    size_t m_Size;
+
+    /** Bytes ever written; only advanced by the producer. */
+    size_t m_Head;
+
+    /** Keeps the two counters on separate cache lines. */
+    uint8_t m_Padding[64 - sizeof(size_t)];
+
+    /** Bytes ever read; only advanced by the consumer. */
+    size_t m_Tail;
+
+    /** Serialises producers. */
+    Mutex m_WriteLock;
+
+    /** Serialises consumers. */
+    Mutex m_ReadLock;
+
+    /** Protects sleeping on (and waking) the conditions below. */
+    Mutex m_WaitLock;
+    ConditionVariable m_WriteCondition;
+    ConditionVariable m_ReadCondition;
+    size_t m_ReadersWaiting;
+    size_t m_WritersWaiting;
+
+    Mutex m_MonitorLock;
+    List<MonitorTarget *> m_MonitorTargets;
+    size_t m_nMonitorTargets;
+
+    bool m_bCanRead;
+    bool m_bCanWrite;
+};
+
+#endif  // KERNEL_UTILITIES_SPSCRING_H
@@ -45,10 +45,20 @@
 class Cord;
 
 /** String class for ASCII strings
- *\todo provide documentation */
+ *
+ * Strings shorter than InlineSize (including the terminator) are stored
+ * inside the object itself, so short path components, keys and log fragments
+ * never touch the heap. Longer strings use a heap buffer. A string with no
+ * contents and no buffer has a null cstr().
+ *
+ * String is deliberately not polymorphic: there is no vtable, and the hot
+ * accessors (cstr(), length(), hash()) are inline. */
 class EXPORTED_PUBLIC String
 {
   public:
+    /** Bytes of inline storage, including the null terminator. */
+    static const size_t InlineSize = 24;
+
     /** The default constructor does nothing */
     String();
     // The constructors marked explicit are slow, but sometimes the only way
@@ -61,7 +71,7 @@ class EXPORTED_PUBLIC String
     String(const String &x);
     explicit String(const StringView &x);
     String(String &&x);
-    virtual ~String();
+    ~String();
 
     String &operator=(String &&x);
     String &operator=(const Cord &x);
@@ -122,17 +132,27 @@ class EXPORTED_PUBLIC String
 
     size_t size() const
     {
-        return m_Size;
+        return m_bInline ? InlineSize : m_Heap.size;
     }
 
     /**
      * Variant of hash() that might compute the hash if needed, but won't
      * update the stored hash.
      */
-    uint32_t hash() const;
+    uint32_t hash() const
+    {
+        return LIKELY(m_Hash) ? m_Hash : computeHash();
+    }
 
     /** Variant of hash() that computes the hash if needed. */
-    uint32_t hash();
+    uint32_t hash()
+    {
+        if (UNLIKELY(!m_Hash))
+        {
+            computeHash();
+        }
+        return m_Hash;
+    }
 
     /** Given a character index, return the index of the next character,
        interpreting the string as UTF-8 encoded. */
@@ -198,7 +218,7 @@ class EXPORTED_PUBLIC String
      */
     void assign(const char *s, size_t len = 0, bool unsafe = false);
     void reserve(size_t size);
-    virtual void clear();
+    void clear();
 
     /** Resize the buffer to fit the actual string. */
     void downsize();
@@ -236,32 +256,44 @@ class EXPORTED_PUBLIC String
     uint32_t computeHash() const;
   private:
     /** Extract hash without recomputing it. */
-    uint32_t maybeHash() const;
+    uint32_t maybeHash() const
+    {
+        return m_Hash;
+    }
     /** Extract the correct string buffer for this string. */
-    virtual char *extract() const;
+    char *extract() const
+    {
+        return m_bInline ? const_cast<char *>(m_Inline) : m_Heap.data;
+    }
     /** Move another string into this one. */
     void move(String &&other);
-    /** Pointer to the zero-terminated ASCII string */
-    char *m_Data;
+
+    struct HeapBuffer
+    {
+        /** Pointer to the zero-terminated ASCII string, or null. */
+        char *data;
+        /** The size of the reserved space for the string */
+        size_t size;
+    };
+
+    union
+    {
+        /** Storage for strings that don't fit inline. */
+        HeapBuffer m_Heap;
+        /** Storage for short strings (when m_bInline is set). */
+        char m_Inline[InlineSize];
+    };
     /** The string's length */
     size_t m_Length;
-    /** The size of the reserved space for the string */
-    size_t m_Size;
     /** Hash of the string. */
     uint32_t m_Hash;
-    /** Is this string resizable? */
-    virtual bool resizable() const;
-    /** Is this string assignable? */
-    virtual bool assignable() const;
-
-  protected:
-    /** Internal setter for length. */
-    void setLength(size_t n);
-    /** Internal setter for size. */
-    void setSize(size_t n);
+    /** Whether the contents live in m_Inline rather than m_Heap. */
+    bool m_bInline;
 };
 
-/** Class for immmutable strings with values known at compile time.
+/** String initialised from a literal, with its hash computed up front.
+ *
+ * Short literals are stored inline, so these never allocate in practice.
  *
  * \todo make String hashes more expressive so we can do a compile-time hash
  * of these ConstantString objects and avoid the runtime computation.
@@ -269,33 +301,11 @@ class EXPORTED_PUBLIC String
 template <size_t N>
 class ConstantString : public String
 {
-    public:
-        ConstantString(const char str[N])
-        {
-            setLength(N);
-            setSize(N);
-            MemoryCopy(m_Data, str, N);
-            computeHash();
-        }
-
-        virtual void clear() override {}
-    private:
-        virtual char *extract() const override
-        {
-            return const_cast<char *>(m_Data);
-        }
-
-        virtual bool resizable() const override
-        {
-            return false;
-        }
-
-        virtual bool assignable() const override
-        {
-            return false;
-        }
-
-        char m_Data[N];
+  public:
+    ConstantString(const char (&str)[N]) : String(str, N - 1, true)
+    {
+        computeHash();
+    }
 };
 
 template <size_t N>
@@ -116,6 +116,23 @@ EXPORTED_PUBLIC void *MemoryCopy(void *s1, const void *s2, size_t n);
 EXPORTED_PUBLIC int
 MemoryCompare(const void *p1, const void *p2, size_t len) PURE;
 
+// Variants of the memory functions. They differ only in how large copies and
+// sets are done; the best one the CPU supports is picked on first use.
+enum MemoryVariant
+{
+    MemoryGeneric,  // rep movsq/stosq for large sizes
+    MemoryErms,     // rep movsb/stosb (Enhanced REP MOVSB/STOSB)
+    MemoryFsrm,     // rep movsb from smaller sizes (Fast Short REP MOVSB)
+
+    MemoryVariantCount
+};
+
+EXPORTED_PUBLIC const char *MemoryVariantName(int variant) PURE;
+EXPORTED_PUBLIC int MemoryVariantSupported(int variant);
+// Switches variant (for benchmarking). Returns the previous variant, or -1 if
+// the CPU does not support the requested one.
+EXPORTED_PUBLIC int MemorySelectVariant(int variant);
+
 // Misc utilities for paths etc
 EXPORTED_PUBLIC const char *
 SDirectoryName(const char *path, char *buf, size_t buflen) PURE;
@@ -26,7 +26,7 @@
 #include "pedigree/kernel/utilities/utility.h"
 
 Archive::Archive(uint8_t *pPhys, size_t sSize)
-    : m_pBase(pPhys), m_Region("Archive")
+    : m_pBase(pPhys), m_Size(sSize), m_Region("Archive"), m_Index()
 {
     EMIT_IF(!HOSTED)
     {
@@ -48,6 +48,8 @@ Archive::Archive(uint8_t *pPhys, size_t sSize)
             NOTICE("Archive: mapped to " << m_Region.virtualAddress());
         }
     }
+
+    buildIndex();
 }
 
 Archive::~Archive()
@@ -57,21 +59,12 @@ Archive::~Archive()
 
 size_t Archive::getNumFiles()
 {
-    size_t i = 0;
-    ArchiveFile *pFile = getFirst();
-    while (pFile != 0)
-    {
-        i++;
-        pFile = getNext(pFile);
-    }
-    return i;
+    return m_Index.count();
 }
 
 size_t Archive::getFileSize(size_t n)
 {
-    ArchiveFile *pFile = get(n);
-    NormalStaticString str(pFile->size);
-    return str.intValue(8);  // Octal
+    return m_Index[n].size;
 }
 
 char *Archive::getFileName(size_t n)
@@ -97,21 +90,41 @@ Archive::ArchiveFile *Archive::getFirst()
     }
 }
 
-Archive::ArchiveFile *Archive::getNext(ArchiveFile *pFile)
+Archive::ArchiveFile *Archive::get(size_t n)
 {
-    NormalStaticString str(pFile->size);
-    size_t size = str.intValue(8);  // Octal.
-    size_t nBlocks = (size + 511) / 512;
-    pFile = adjust_pointer(pFile, 512 * (nBlocks + 1));
-    if (pFile->name[0] == '\0')
-        return 0;
-    return pFile;
+    return m_Index[n].header;
 }
 
-Archive::ArchiveFile *Archive::get(size_t n)
+void Archive::buildIndex()
 {
     ArchiveFile *pFile = getFirst();
-    for (size_t i = 0; i < n; i++)
-        pFile = getNext(pFile);
-    return pFile;
+    if (!pFile)
+    {
+        return;
+    }
+
+    size_t offset = 0;
+    while ((offset + 512) <= m_Size && pFile->name[0] != '\0')
+    {
+        NormalStaticString str(pFile->size);
+        size_t size = str.intValue(8);  // Octal.
+        size_t nBlocks = (size + 511) / 512;
+
+        if ((offset + 512 + size) > m_Size)
+        {
+            ERROR(
+                "Archive: file '" << pFile->name
+                                  << "' runs past the end of the archive");
+            break;
+        }
+
+        IndexEntry entry;
+        entry.header = pFile;
+        entry.size = size;
+
+        m_Index.pushBack(entry);
+
+        offset += 512 * (nBlocks + 1);
+        pFile = adjust_pointer(pFile, 512 * (nBlocks + 1));
+    }
 }
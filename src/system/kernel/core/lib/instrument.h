@@ -25,6 +25,9 @@
 // Global flags are held within the first byte written to the instrumentation
 // stream, and control things like which data types to use.
 #define INSTRUMENT_GLOBAL_LITE (1 << 0)
+// The stream holds SampleRecords from the sampling profiler, rather than
+// function entry records.
+#define INSTRUMENT_GLOBAL_SAMPLES (1 << 1)
 
 // Record flags define how to interpret the specific records.
 #define INSTRUMENT_RECORD_ENTRY (1 << 0)
@@ -32,6 +35,14 @@
 
 #define INSTRUMENT_MAGIC 0x1090U
 
+// Sample flags.
+#define INSTRUMENT_SAMPLE_USER (1 << 0)
+
+#define INSTRUMENT_SAMPLE_MAGIC 0x5A3BU
+
+/// Most stack frames a single sample can carry (including the sampled PC).
+#define INSTRUMENT_SAMPLE_FRAMES 8
+
 /**
  * InstrumentationRecord is the full-size, full-featured instrumentation type.
  * It provides information about callers and allows for flexibility via flags.
@@ -76,4 +87,24 @@ typedef union
     typedef uintptr_t lite;
 } LiteInstrumentationRecord;
 
+/**
+ * SampleRecord is written by the sampling profiler for each timer tick that
+ * was sampled. Fields are fixed-size so the host tools can read the stream
+ * regardless of the architecture that produced it.
+ */
+typedef struct SampleRecord
+{
+    uint16_t magic;
+    uint8_t flags;
+    /// Number of valid entries in frames.
+    uint8_t depth;
+    uint32_t cpu;
+    uint32_t process;
+    uint32_t thread;
+    /// Nanoseconds since boot.
+    uint64_t timestamp;
+    /// frames[0] is the interrupted PC, followed by return addresses.
+    uint64_t frames[INSTRUMENT_SAMPLE_FRAMES];
+} SampleRecord;
+
 #endif  // KERNEL_INSTRUMENT_H
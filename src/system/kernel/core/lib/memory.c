@@ -29,15 +29,108 @@
 #include <string.h>
 #endif
 
-#define WITH_SSE 0
-#define SSE_THRESHOLD 1024
 #define STOSB_THRESHOLD 64
+#define NONTEMPORAL_THRESHOLD (4 << 20)
 
 #if HOSTED_X64
 #undef X64
 #define X64 1
 #endif
 
+/// Parameters for one memory routine variant. The small and medium size
+/// classes are the same for every variant; only where (and how) the large
+/// class takes over differs.
+struct memory_variant
+{
+    const char *name;
+
+    /// Copies and sets at least this large use string instructions.
+    size_t rep_threshold;
+
+    /// Use byte-granular rep movsb/stosb (fast with ERMS) rather than the
+    /// quadword forms plus a tail.
+    int rep_bytes;
+};
+
+static const struct memory_variant memory_variants[MemoryVariantCount] = {
+    {"generic", 2048, 0},
+    {"erms", 1024, 1},
+    {"fsrm", 256, 1},
+};
+
+#ifdef TARGET_IS_X86
+static void memory_cpuid(
+    uint32_t leaf, uint32_t *eax, uint32_t *ebx, uint32_t *ecx, uint32_t *edx)
+{
+    __asm__ __volatile__("cpuid"
+                         : "=a"(*eax), "=b"(*ebx), "=c"(*ecx), "=d"(*edx)
+                         : "a"(leaf), "c"(0));
+}
+#endif
+
+/// Bitmask of the variants the running CPU supports.
+static int memory_supported(void)
+{
+    int supported = 1 << MemoryGeneric;
+#ifdef TARGET_IS_X86
+    uint32_t eax, ebx, ecx, edx;
+    memory_cpuid(0, &eax, &ebx, &ecx, &edx);
+    if (eax >= 7)
+    {
+        memory_cpuid(7, &eax, &ebx, &ecx, &edx);
+        if (ebx & (1 << 9))
+            supported |= 1 << MemoryErms;
+        if ((ebx & (1 << 9)) && (edx & (1 << 4)))
+            supported |= 1 << MemoryFsrm;
+    }
+#endif
+    return supported;
+}
+
+// Racing here is harmless: every caller will pick the same variant.
+static const struct memory_variant *memory_current = 0;
+
+static const struct memory_variant *memory_variant(void)
+{
+    if (UNLIKELY(!memory_current))
+    {
+        int supported = memory_supported();
+        int best = MemoryGeneric;
+        for (int i = MemoryGeneric; i < MemoryVariantCount; ++i)
+        {
+            if (supported & (1 << i))
+                best = i;
+        }
+        memory_current = &memory_variants[best];
+    }
+
+    return memory_current;
+}
+
+const char *MemoryVariantName(int variant)
+{
+    if (variant < 0 || variant >= MemoryVariantCount)
+        return 0;
+    return memory_variants[variant].name;
+}
+
+int MemoryVariantSupported(int variant)
+{
+    if (variant < 0 || variant >= MemoryVariantCount)
+        return 0;
+    return (memory_supported() & (1 << variant)) ? 1 : 0;
+}
+
+int MemorySelectVariant(int variant)
+{
+    const struct memory_variant *old = memory_variant();
+    if (!MemoryVariantSupported(variant))
+        return -1;
+
+    memory_current = &memory_variants[variant];
+    return (int) (old - memory_variants);
+}
+
 #if UTILITY_LINUX_COVERAGE
 #undef _STRING_H
 #include <string.h>
@@ -64,106 +157,373 @@ EXPORT void *memmove(void *s1, const void *s2, size_t n);
 // asan provides a memcpy/memset/etc that we care about more than our custom
 // ones, in general.
 #if !HAS_ADDRESS_SANITIZER
+
+// The routines below only use general purpose registers: the kernel does not
+// save vector state on entry, and these run everywhere (including interrupt
+// handlers), so saving it here would cost more than vectors gain.
+
+typedef uint64_t unaligned_u64 __attribute__((aligned(1), may_alias));
+typedef uint32_t unaligned_u32 __attribute__((aligned(1), may_alias));
+typedef uint16_t unaligned_u16 __attribute__((aligned(1), may_alias));
+
+#define LOAD64(p) (*(const unaligned_u64 *) (p))
+#define STORE64(p, v) (*(unaligned_u64 *) (p) = (v))
+#define LOAD32(p) (*(const unaligned_u32 *) (p))
+#define STORE32(p, v) (*(unaligned_u32 *) (p) = (v))
+#define LOAD16(p) (*(const unaligned_u16 *) (p))
+#define STORE16(p, v) (*(unaligned_u16 *) (p) = (v))
+
+/// Copies up to 16 bytes with a pair of possibly-overlapping moves. All loads
+/// happen before any store, so this is safe for overlapping buffers.
+static ALWAYS_INLINE inline void
+copy_small(unsigned char *d, const unsigned char *s, size_t n)
+{
+    if (n >= 8)
+    {
+        uint64_t a = LOAD64(s), b = LOAD64(s + n - 8);
+        STORE64(d, a);
+        STORE64(d + n - 8, b);
+    }
+    else if (n >= 4)
+    {
+        uint32_t a = LOAD32(s), b = LOAD32(s + n - 4);
+        STORE32(d, a);
+        STORE32(d + n - 4, b);
+    }
+    else if (n >= 2)
+    {
+        uint16_t a = LOAD16(s), b = LOAD16(s + n - 2);
+        STORE16(d, a);
+        STORE16(d + n - 2, b);
+    }
+    else if (n)
+    {
+        *d = *s;
+    }
+}
+
+/// Copies more than 16 bytes forwards, 32 bytes per iteration. The last 16
+/// bytes are loaded up front and stored at the end, which covers the tail
+/// without a byte loop. Safe for overlap where d < s.
+static ALWAYS_INLINE inline void
+copy_forward(unsigned char *d, const unsigned char *s, size_t n)
+{
+    uint64_t t0 = LOAD64(s + n - 16), t1 = LOAD64(s + n - 8);
+    unsigned char *end = d + n;
+
+    while (n > 32)
+    {
+        uint64_t a = LOAD64(s), b = LOAD64(s + 8);
+        uint64_t c = LOAD64(s + 16), e = LOAD64(s + 24);
+        STORE64(d, a);
+        STORE64(d + 8, b);
+        STORE64(d + 16, c);
+        STORE64(d + 24, e);
+        d += 32;
+        s += 32;
+        n -= 32;
+    }
+
+    if (n > 16)
+    {
+        uint64_t a = LOAD64(s), b = LOAD64(s + 8);
+        STORE64(d, a);
+        STORE64(d + 8, b);
+    }
+
+    STORE64(end - 16, t0);
+    STORE64(end - 8, t1);
+}
+
+/// Mirror image of copy_forward, for overlap where d > s.
+static ALWAYS_INLINE inline void
+copy_backward(unsigned char *d, const unsigned char *s, size_t n)
+{
+    uint64_t h0 = LOAD64(s), h1 = LOAD64(s + 8);
+    unsigned char *start = d;
+
+    d += n;
+    s += n;
+    while (n > 32)
+    {
+        uint64_t a = LOAD64(s - 8), b = LOAD64(s - 16);
+        uint64_t c = LOAD64(s - 24), e = LOAD64(s - 32);
+        STORE64(d - 8, a);
+        STORE64(d - 16, b);
+        STORE64(d - 24, c);
+        STORE64(d - 32, e);
+        d -= 32;
+        s -= 32;
+        n -= 32;
+    }
+
+    if (n > 16)
+    {
+        uint64_t a = LOAD64(s - 8), b = LOAD64(s - 16);
+        STORE64(d - 8, a);
+        STORE64(d - 16, b);
+    }
+
+    STORE64(start, h0);
+    STORE64(start + 8, h1);
+}
+
+#if defined(TARGET_IS_X86) && defined(__x86_64__)
+/// Copies with non-temporal stores, for copies much larger than the cache
+/// that would otherwise evict everything else on their way through.
+static void copy_nontemporal(unsigned char *d, const unsigned char *s, size_t n)
+{
+    // Align the destination so every movnti is naturally aligned.
+    size_t head = (8 - ((uintptr_t) d & 7)) & 7;
+    copy_small(d, s, head);
+    d += head;
+    s += head;
+    n -= head;
+
+    while (n >= 32)
+    {
+        uint64_t a = LOAD64(s), b = LOAD64(s + 8);
+        uint64_t c = LOAD64(s + 16), e = LOAD64(s + 24);
+        __asm__ __volatile__("movnti %1, %0" : "=m"(*(uint64_t *) d) : "r"(a));
+        __asm__ __volatile__("movnti %1, %0"
+                             : "=m"(*(uint64_t *) (d + 8))
+                             : "r"(b));
+        __asm__ __volatile__("movnti %1, %0"
+                             : "=m"(*(uint64_t *) (d + 16))
+                             : "r"(c));
+        __asm__ __volatile__("movnti %1, %0"
+                             : "=m"(*(uint64_t *) (d + 24))
+                             : "r"(e));
+        d += 32;
+        s += 32;
+        n -= 32;
+    }
+
+    // Non-temporal stores are weakly ordered.
+    __asm__ __volatile__("sfence" ::: "memory");
+
+    if (n > 16)
+        copy_forward(d, s, n);
+    else
+        copy_small(d, s, n);
+}
+
+#define HAVE_NONTEMPORAL 1
+#else
+#define HAVE_NONTEMPORAL 0
+#endif
+
+/// Copies a large, non-overlapping (or d < s) buffer with string
+/// instructions.
+static void copy_rep(
+    const struct memory_variant *v, unsigned char *d, const unsigned char *s,
+    size_t n)
+{
+#ifdef TARGET_IS_X86
+    if (v->rep_bytes)
+    {
+        __asm__ __volatile__("rep movsb"
+                             : "+D"(d), "+S"(s), "+c"(n)
+                             :
+                             : "memory");
+        return;
+    }
+
+    size_t words = n / sizeof(unsigned long);
+#if BITS_64 || defined(__x86_64__)
+    __asm__ __volatile__("rep movsq"
+                         : "+D"(d), "+S"(s), "+c"(words)
+                         :
+                         : "memory");
+#else
+    __asm__ __volatile__("rep movsl"
+                         : "+D"(d), "+S"(s), "+c"(words)
+                         :
+                         : "memory");
+#endif
+    copy_small(d, s, n & (sizeof(unsigned long) - 1));
+#else
+    (void) v;
+    copy_forward(d, s, n);
+#endif
+}
+
 EXPORT int memcmp(const void *p1, const void *p2, size_t len)
 {
-    const char *a = (const char *) p1;
-    const char *b = (const char *) p2;
-    size_t i = 0;
-    int r = 0;
-    for (; i < len; i++)
+    const unsigned char *a = (const unsigned char *) p1;
+    const unsigned char *b = (const unsigned char *) p2;
+
+    // Compare a word at a time; on a mismatch, byte-swapping makes the
+    // first differing byte the most significant so the words order the
+    // same way the bytes do.
+    for (; len >= 8; len -= 8, a += 8, b += 8)
     {
-        if ((r = a[i] - b[i]) != 0)
-            break;
+        uint64_t x = LOAD64(a), y = LOAD64(b);
+        if (x != y)
+        {
+#if TARGET_IS_LITTLE_ENDIAN || defined(TARGET_IS_X86)
+            x = __builtin_bswap64(x);
+            y = __builtin_bswap64(y);
+#endif
+            return x < y ? -1 : 1;
+        }
     }
-    return r;
+
+    for (; len; --len, ++a, ++b)
+    {
+        if (*a != *b)
+            return *a < *b ? -1 : 1;
+    }
+
+    return 0;
 }
 
 EXPORT void *memset(void *buf, int c, size_t n)
 {
+    unsigned char *d = (unsigned char *) buf;
+    uint64_t v = 0x0101010101010101ULL * (unsigned char) c;
+
+    if (n <= 16)
+    {
+        if (n >= 8)
+        {
+            STORE64(d, v);
+            STORE64(d + n - 8, v);
+        }
+        else if (n >= 4)
+        {
+            STORE32(d, (uint32_t) v);
+            STORE32(d + n - 4, (uint32_t) v);
+        }
+        else if (n >= 2)
+        {
+            STORE16(d, (uint16_t) v);
+            STORE16(d + n - 2, (uint16_t) v);
+        }
+        else if (n)
+        {
+            *d = (unsigned char) c;
+        }
+        return buf;
+    }
+
 #ifdef TARGET_IS_X86
-    if (n >= STOSB_THRESHOLD)
+    const struct memory_variant *variant = memory_variant();
+    if (n >= variant->rep_threshold)
     {
-        int a, b;
-        __asm__ __volatile__("rep stosb"
-                             : "=&D"(a), "=&c"(b)
-                             : "0"(buf), "a"(c), "1"(n)
+        if (variant->rep_bytes)
+        {
+            __asm__ __volatile__("rep stosb"
+                                 : "+D"(d), "+c"(n)
+                                 : "a"(c)
+                                 : "memory");
+            return buf;
+        }
+
+        unsigned char *end = d + n;
+        size_t words = n / sizeof(unsigned long);
+#if BITS_64 || defined(__x86_64__)
+        __asm__ __volatile__("rep stosq"
+                             : "+D"(d), "+c"(words)
+                             : "a"(v)
+                             : "memory");
+#else
+        __asm__ __volatile__("rep stosl"
+                             : "+D"(d), "+c"(words)
+                             : "a"((uint32_t) v)
                              : "memory");
+#endif
+        // Tail is shorter than a word; finish with an overlapping store.
+        STORE64(end - 8, v);
         return buf;
     }
 #endif
-    unsigned char *tmp = (unsigned char *) buf;
-    while (n--)
+
+    unsigned char *end = d + n;
+    while (n > 32)
     {
-        *tmp++ = c;
+        STORE64(d, v);
+        STORE64(d + 8, v);
+        STORE64(d + 16, v);
+        STORE64(d + 24, v);
+        d += 32;
+        n -= 32;
     }
+    if (n > 16)
+    {
+        STORE64(d, v);
+        STORE64(d + 8, v);
+    }
+    STORE64(end - 16, v);
+    STORE64(end - 8, v);
+
     return buf;
 }
 
 EXPORT void *memcpy(void *restrict s1, const void *restrict s2, size_t n)
 {
-#ifdef TARGET_IS_X86
-    if (n >= STOSB_THRESHOLD)
+    unsigned char *d = (unsigned char *) s1;
+    const unsigned char *s = (const unsigned char *) s2;
+
+    if (n <= 16)
     {
-        int a, b, c;
-        __asm__ __volatile__("rep movsb"
-                             : "=&c"(a), "=&D"(b), "=&S"(c)
-                             : "1"(s1), "2"(s2), "0"(n)
-                             : "memory");
+        copy_small(d, s, n);
         return s1;
     }
+
+    const struct memory_variant *variant = memory_variant();
+    if (n < variant->rep_threshold)
+    {
+        copy_forward(d, s, n);
+    }
+#if HAVE_NONTEMPORAL
+    else if (n >= NONTEMPORAL_THRESHOLD)
+    {
+        copy_nontemporal(d, s, n);
+    }
 #endif
-    const unsigned char *restrict sp = (const unsigned char *restrict) s2;
-    unsigned char *restrict dp = (unsigned char *restrict) s1;
-    while (n--)
-        *dp++ = *sp++;
-    return s1;
-}
+    else
+    {
+        copy_rep(variant, d, s, n);
+    }
 
-#ifdef TARGET_IS_X86
-static inline void *memmove_x86(void *s1, const void *s2, size_t n)
-{
-    // Perform rep movsb in reverse.
-    const unsigned char *sp = (const unsigned char *) s2 + (n - 1);
-    unsigned char *dp = (unsigned char *) s1 + (n - 1);
-
-    int a, b, c;
-    __asm__ __volatile__("std; rep movsb; cld"
-                         : "=&c"(a), "=&D"(b), "=&S"(c)
-                         : "1"(dp), "2"(sp), "0"(n)
-                         : "memory");
     return s1;
 }
-#endif
 
 EXPORT void *memmove(void *s1, const void *s2, size_t n)
 {
     if (UNLIKELY(!n))
         return s1;
 
+    unsigned char *d = (unsigned char *) s1;
+    const unsigned char *s = (const unsigned char *) s2;
+
     const size_t orig_n = n;
-    if (LIKELY((s1 < s2) || !overlaps(s1, s2, n)))
+    if (n <= 16)
     {
-        // No overlap, or there's overlap but we can copy forwards.
-        memcpy(s1, s2, n);
+        // Loads all happen before stores, so direction doesn't matter.
+        copy_small(d, s, n);
     }
-    else
+    else if (LIKELY((s1 < s2) || !overlaps(s1, s2, n)))
     {
-#ifdef TARGET_IS_X86
-        if (n >= STOSB_THRESHOLD)
-        {
-            memmove_x86(s1, s2, n);
-        }
-        else
-        {
-#endif
-        // Writing bytes from s2 into s1 cannot be done forwards, use memmove.
-        const unsigned char *sp = (const unsigned char *) s2 + (n - 1);
-        unsigned char *dp = (unsigned char *) s1 + (n - 1);
-        for (; n != 0; n--)
-            *dp-- = *sp--;
-#ifdef TARGET_IS_X86
-        }
+        // No overlap, or there's overlap but we can copy forwards. The
+        // non-temporal path is only for buffers that don't overlap.
+        const struct memory_variant *variant = memory_variant();
+        if (n < variant->rep_threshold)
+            copy_forward(d, s, n);
+#if HAVE_NONTEMPORAL
+        else if (n >= NONTEMPORAL_THRESHOLD && !overlaps(s1, s2, n))
+            copy_nontemporal(d, s, n);
 #endif
+        else
+            copy_rep(variant, d, s, n);
+    }
+    else
+    {
+        // Writing bytes from s2 into s1 cannot be done forwards. Reverse
+        // string instructions are slow on most CPUs, so always use the word
+        // loop for this.
+        copy_backward(d, s, n);
     }
 
 #if EXCESSIVE_ADDITIONAL_CHECKS
@@ -172,6 +532,8 @@ EXPORT void *memmove(void *s1, const void *s2, size_t n)
     {
         assert(!memcmp(s1, s2, orig_n));
     }
+#else
+    (void) orig_n;
 #endif
 
     return s1;
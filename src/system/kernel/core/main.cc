@@ -455,6 +455,10 @@ void _cxx_main(BootstrapStruct_t &bsInf)
     MemoryPressureManager::instance().registerHandler(
         MemoryPressureManager::LowestPriority, &killer);
 
+    // Start reclaiming in the background before we get anywhere near the
+    // point where allocations have to stall.
+    MemoryPressureManager::instance().initialise();
+
     // Set up the global info block manager.
     TRACE("InfoBlockManager init");
     InfoBlockManager::instance().initialise();
@@ -0,0 +1,141 @@
+/*
+ * Copyright (c) 2008-2014, Pedigree Developers
+ *
+ * Please see the CONTRIB file in the root of the source tree for a full
+ * list of contributors.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "pedigree/kernel/process/AdaptiveMutex.h"
+
+#ifndef STANDALONE_MUTEXES
+#include "pedigree/kernel/processor/Processor.h"
+#include "pedigree/kernel/processor/ProcessorInformation.h"
+#endif
+
+AdaptiveMutex::AdaptiveMutex(bool bLocked)
+    : m_Owner(bLocked ? currentOwner() : 0), m_Sleepers(0), m_Queue()
+{
+}
+
+AdaptiveMutex::~AdaptiveMutex() = default;
+
+bool AdaptiveMutex::acquire()
+{
+    uintptr_t me = currentOwner();
+    if (m_Owner.compareAndSwap(0, me))
+    {
+        return true;
+    }
+
+    while (true)
+    {
+        // Spin for as long as the owner is making progress elsewhere - it is
+        // likely to release the lock before we could get to sleep.
+        for (size_t i = 0; i < SpinLimit; ++i)
+        {
+            uintptr_t owner = m_Owner;
+            if (!owner)
+            {
+                if (m_Owner.compareAndSwap(0, me))
+                {
+                    return true;
+                }
+                continue;
+            }
+
+            if (!ownerRunning(owner))
+            {
+                break;
+            }
+
+            relax();
+        }
+
+        // Announce ourselves before the last attempt, so a release() racing
+        // with us is guaranteed to see that it needs to wake someone.
+        m_Sleepers += 1;
+        if (m_Owner.compareAndSwap(0, me))
+        {
+            m_Sleepers -= 1;
+            return true;
+        }
+
+        m_Queue.wait();
+        m_Sleepers -= 1;
+    }
+}
+
+bool AdaptiveMutex::tryAcquire()
+{
+    return m_Owner.compareAndSwap(0, currentOwner());
+}
+
+void AdaptiveMutex::release()
+{
+    // Only the owner writes a non-zero lock word, so this cannot fail.
+    uintptr_t owner = m_Owner;
+    m_Owner.compareAndSwap(owner, 0);
+
+    // A waiter woken here may find the lock taken again, in which case it
+    // simply goes around once more.
+    if (m_Sleepers)
+    {
+        m_Queue.wake();
+    }
+}
+
+ssize_t AdaptiveMutex::getValue()
+{
+    return m_Owner ? 0 : 1;
+}
+
+// The standalone (hosted utility) versions of these live in buildutil/shim.cc.
+#ifndef STANDALONE_MUTEXES
+
+AdaptiveWaitQueue::AdaptiveWaitQueue() : m_Semaphore(0, false)
+{
+}
+
+AdaptiveWaitQueue::~AdaptiveWaitQueue() = default;
+
+void AdaptiveWaitQueue::wait()
+{
+    m_Semaphore.acquire();
+}
+
+void AdaptiveWaitQueue::wake(size_t n)
+{
+    m_Semaphore.release(n);
+}
+
+uintptr_t AdaptiveMutex::currentOwner()
+{
+    return reinterpret_cast<uintptr_t>(
+        Processor::information().getCurrentThread());
+}
+
+bool AdaptiveMutex::ownerRunning(uintptr_t owner)
+{
+    // The owner may have been freed since we loaded the lock word, so look
+    // for it amongst the other CPUs' current threads rather than at it.
+    return Processor::isRunningElsewhere(reinterpret_cast<Thread *>(owner));
+}
+
+void AdaptiveMutex::relax()
+{
+    Processor::pause();
+}
+
+#endif  // STANDALONE_MUTEXES
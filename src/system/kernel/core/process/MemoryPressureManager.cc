@@ -16,40 +16,216 @@
  * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
  * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
-
 #include "pedigree/kernel/process/MemoryPressureManager.h"
 #include "pedigree/kernel/Log.h"
+#include "pedigree/kernel/processor/PhysicalMemoryManager.h"
+#include "pedigree/kernel/time/Time.h"
 #include "pedigree/kernel/utilities/Iterator.h"
 #include "pedigree/kernel/utilities/utility.h"
 
+#if THREADS
+#include "pedigree/kernel/process/Process.h"
+#include "pedigree/kernel/process/Thread.h"
+#include "pedigree/kernel/processor/Processor.h"
+#include "pedigree/kernel/processor/ProcessorInformation.h"
+#endif
+
+/// Upper bound on background reclaim passes per wakeup.
+#define MAX_RECLAIM_PASSES 4
+
 MemoryPressureManager MemoryPressureManager::m_Instance;
 
 MemoryPressureHandler::MemoryPressureHandler() = default;
 MemoryPressureHandler::~MemoryPressureHandler() = default;
 
+size_t MemoryPressureHandler::reclaimablePages()
+{
+    return 0;
+}
+
+size_t MemoryPressureHandler::shrink(size_t nPages)
+{
+    return compact() ? 1 : 0;
+}
+
 bool MemoryPressureManager::compact()
 {
-    for (size_t i = 0; i < MAX_MEMPRESSURE_PRIORITY; ++i)
+    Time::Timestamp start = Time::getTicks();
+    ++m_Statistics.directReclaims;
+
+    // Shrink everything that can be shrunk before asking handlers one at a
+    // time; the later handlers (e.g. the process killer) are a last resort.
+    size_t released = reclaim(getMinWatermark());
+    bool bSuccess = released > 0;
+    m_Statistics.directPages += released;
+
+    if (!bSuccess)
     {
-        for (List<MemoryPressureHandler *>::Iterator it = m_Handlers[i].begin();
-             it != m_Handlers[i].end(); ++it)
+        for (size_t i = 0; i < MAX_MEMPRESSURE_PRIORITY && !bSuccess; ++i)
+        {
+            for (List<MemoryPressureHandler *>::Iterator it =
+                     m_Handlers[i].begin();
+                 it != m_Handlers[i].end(); ++it)
+            {
+                NOTICE("Compact: " << (*it)->getMemoryPressureDescription());
+                if ((*it)->compact())
+                {
+                    NOTICE("  -> pages released!");
+                    bSuccess = true;
+                    break;
+                }
+                NOTICE("  -> no pages released.");
+            }
+        }
+    }
+
+    if (!bSuccess)
+    {
+        ++m_Statistics.directFailures;
+    }
+
+    m_Statistics.stallTime += Time::getTicks() - start;
+    return bSuccess;
+}
+
+size_t MemoryPressureManager::reclaim(size_t targetFree)
+{
+    PhysicalMemoryManager &pmm = PhysicalMemoryManager::instance();
+
+    size_t totalReleased = 0;
+    for (size_t pass = 0; pass < MAX_RECLAIM_PASSES; ++pass)
+    {
+        size_t freePages = pmm.freePageCount();
+        if (freePages >= targetFree)
+        {
+            break;
+        }
+        size_t needed = targetFree - freePages;
+
+        size_t totalReclaimable = 0;
+        for (size_t i = 0; i < MAX_MEMPRESSURE_PRIORITY; ++i)
+        {
+            for (auto it = m_Handlers[i].begin(); it != m_Handlers[i].end();
+                 ++it)
+            {
+                totalReclaimable += (*it)->reclaimablePages();
+            }
+        }
+
+        if (!totalReclaimable)
+        {
+            break;
+        }
+
+        // Ask each handler for its share of what's needed, in priority
+        // order, stopping early if enough has been released.
+        size_t released = 0;
+        for (size_t i = 0; i < MAX_MEMPRESSURE_PRIORITY; ++i)
         {
-            NOTICE("Compact: " << (*it)->getMemoryPressureDescription());
-            if ((*it)->compact())
+            for (auto it = m_Handlers[i].begin(); it != m_Handlers[i].end();
+                 ++it)
             {
-                NOTICE("  -> pages released!");
-                return true;
+                size_t reclaimable = (*it)->reclaimablePages();
+                if (!reclaimable)
+                {
+                    continue;
+                }
+
+                size_t share = (needed * reclaimable) / totalReclaimable;
+                if (!share)
+                {
+                    share = 1;
+                }
+
+                released += (*it)->shrink(share);
+            }
+
+            if (pmm.freePageCount() >= targetFree)
+            {
+                break;
             }
-            NOTICE("  -> no pages released.");
+        }
+
+        totalReleased += released;
+        if (!released)
+        {
+            break;
         }
     }
 
-    return false;
+    return totalReleased;
+}
+
+MemoryPressureManager::MemoryPressureManager()
+    : m_Handlers(), m_Statistics()
+#if THREADS
+      ,
+      m_pReclaimThread(0), m_ReclaimWakeup(0, false), m_bWakeupPending(false)
+#endif
+{
 }
 
-MemoryPressureManager::MemoryPressureManager() = default;
 MemoryPressureManager::~MemoryPressureManager() = default;
 
+void MemoryPressureManager::initialise()
+{
+#if THREADS
+    if (m_pReclaimThread)
+    {
+        return;
+    }
+
+    Process *pParent = Processor::information().getCurrentThread()->getParent();
+    m_pReclaimThread = new Thread(pParent, reclaimTrampoline, this);
+    m_pReclaimThread->setName("MemoryPressureManager reclaim thread");
+    m_pReclaimThread->detach();
+#endif
+}
+
+void MemoryPressureManager::wakeReclaim()
+{
+#if THREADS
+    if (!m_pReclaimThread)
+    {
+        return;
+    }
+
+    if (!m_bWakeupPending.compareAndSwap(false, true))
+    {
+        return;
+    }
+
+    m_ReclaimWakeup.release();
+#endif
+}
+
+#if THREADS
+int MemoryPressureManager::reclaimTrampoline(void *p)
+{
+    reinterpret_cast<MemoryPressureManager *>(p)->reclaimThread();
+}
+
+void MemoryPressureManager::reclaimThread()
+{
+    while (true)
+    {
+        // Wake up when asked to, but also every so often in case the low
+        // mark was crossed while a wakeup was still pending.
+        m_ReclaimWakeup.acquire(1, 1);
+        m_bWakeupPending = false;
+
+        size_t freePages = PhysicalMemoryManager::instance().freePageCount();
+        if (freePages >= getLowWatermark())
+        {
+            continue;
+        }
+
+        ++m_Statistics.backgroundRuns;
+        m_Statistics.backgroundPages += reclaim(getHighWatermark());
+    }
+}
+#endif
+
 void MemoryPressureManager::registerHandler(
     size_t prio, MemoryPressureHandler *pHandler)
 {
@@ -22,6 +22,7 @@
 #include "pedigree/kernel/Log.h"
 #include "pedigree/kernel/Spinlock.h"
 #include "pedigree/kernel/Subsystem.h"
+#include "pedigree/kernel/debugger/SamplingProfiler.h"
 #include "pedigree/kernel/machine/Machine.h"
 #include "pedigree/kernel/machine/Trace.h"
 #include "pedigree/kernel/machine/SchedulerTimer.h"
@@ -36,6 +37,7 @@
 #include "pedigree/kernel/processor/ProcessorInformation.h"
 #include "pedigree/kernel/processor/VirtualAddressSpace.h"
 #include "pedigree/kernel/processor/state.h"
+#include "pedigree/kernel/time/Time.h"
 #include "pedigree/kernel/utilities/utility.h"
 #include "pedigree/kernel/debugger/commands/LocksCommand.h"
 
@@ -43,7 +45,8 @@
 
 PerProcessorScheduler::PerProcessorScheduler()
     : m_pSchedulingAlgorithm(0), m_NewThreadDataLock(false),
-      m_NewThreadDataCondition(), m_NewThreadData(), m_pIdleThread(0)
+      m_NewThreadDataCondition(), m_NewThreadData(), m_pIdleThread(0),
+      m_Statistics()
 #if ARM_BEAGLE
       ,
       m_TickCount(0)
@@ -130,6 +133,7 @@ int PerProcessorScheduler::processorAddThread(void *instance)
 void PerProcessorScheduler::initialise(Thread *pThread)
 {
     m_pSchedulingAlgorithm = new RoundRobin();
+    m_Statistics.lastSwitch = Time::getTicks();
 
     pThread->setStatus(Thread::Running);
     pThread->setCpuId(Processor::id());
@@ -166,6 +170,8 @@ void PerProcessorScheduler::schedule(
         FATAL("Missing a current thread in PerProcessorScheduler::schedule!");
     }
 
+    ++m_Statistics.scheduleCalls;
+
     // Grab the current thread's lock.
     pCurrentThread->getLock().acquire();
 
@@ -195,6 +201,7 @@ void PerProcessorScheduler::schedule(
             else
             {
                 pNextThread = m_pIdleThread;
+                ++m_Statistics.idleSchedules;
             }
         }
     }
@@ -239,6 +246,7 @@ void PerProcessorScheduler::schedule(
     // Update times.
     pCurrentThread->getParent()->trackTime(false);
     pNextThread->getParent()->recordTime(false);
+    accountSwitch(pCurrentThread, pNextThread, nextStatus);
 
     pNextThread->getLock().release();
 
@@ -705,6 +713,7 @@ void PerProcessorScheduler::addThread(Thread *pThread, SyscallState &state)
 
     pCurrentThread->getParent()->trackTime(false);
     pThread->getParent()->recordTime(false);
+    accountSwitch(pCurrentThread, pThread, Thread::Ready);
 
     EMIT_IF(SYSTEM_REQUIRES_ATOMIC_CONTEXT_SWITCH)
     {
@@ -787,6 +796,8 @@ void PerProcessorScheduler::killCurrentThread(Spinlock *pLock)
 
     pNextThread->getLock().exit();
 
+    accountSwitch(pThread, pNextThread, Thread::Zombie);
+
     // Pass in the lock atom we were given if possible, as the caller wants an
     // atomic release (i.e. once the thread is no longer able to be scheduled).
     deleteThreadThenRestoreState(
@@ -833,6 +844,11 @@ void PerProcessorScheduler::sleep(Spinlock *pLock)
 
 void PerProcessorScheduler::timer(uint64_t delta, InterruptState &state)
 {
+    if (UNLIKELY(SamplingProfiler::instance().isRunning()))
+    {
+        SamplingProfiler::instance().sample(state);
+    }
+
 #if ARM_BEAGLE  // Timer at 1 tick per ms, we want to run every 100 ms
     m_TickCount++;
     if ((m_TickCount % 100) == 0)
@@ -858,3 +874,58 @@ void PerProcessorScheduler::setIdle(Thread *pThread)
 {
     m_pIdleThread = pThread;
 }
+
+size_t PerProcessorScheduler::getReadyCount() const
+{
+    if (!m_pSchedulingAlgorithm)
+        return 0;
+    return m_pSchedulingAlgorithm->getReadyCount();
+}
+
+void PerProcessorScheduler::accountSwitch(
+    Thread *pFrom, Thread *pTo, Thread::Status fromStatus)
+{
+    Time::Timestamp now = Time::getTicks();
+    Time::Timestamp ran = now - m_Statistics.lastSwitch;
+    m_Statistics.lastSwitch = now;
+
+    if (pFrom == m_pIdleThread)
+        m_Statistics.idleTime += ran;
+    else
+        m_Statistics.busyTime += ran;
+
+    ThreadStatistics &from = pFrom->getStatistics();
+    from.runTime += ran;
+
+    if (pFrom == pTo)
+    {
+        // Rescheduled straight back onto the same thread.
+        from.readySince = 0;
+        return;
+    }
+
+    ++m_Statistics.contextSwitches;
+
+    // A thread still able to run was preempted; anything else gave up the
+    // processor itself.
+    if (fromStatus == Thread::Ready)
+        ++from.involuntarySwitches;
+    else
+        ++from.voluntarySwitches;
+
+    // readySince may be set by another processor at any time, so take it in
+    // one step rather than reading and then clearing it.
+    ThreadStatistics &to = pTo->getStatistics();
+    Time::Timestamp readySince = to.readySince;
+    while (!to.readySince.compareAndSwap(readySince, 0))
+        readySince = to.readySince;
+
+    if (readySince && readySince < now)
+    {
+        Time::Timestamp waited = now - readySince;
+        to.waitTime += waited;
+        if (pTo != m_pIdleThread)
+            m_Statistics.runDelay += waited;
+    }
+    ++to.timeslices;
+}
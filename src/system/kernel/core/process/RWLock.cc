@@ -0,0 +1,181 @@
+/*
+ * Copyright (c) 2008-2014, Pedigree Developers
+ *
+ * Please see the CONTRIB file in the root of the source tree for a full
+ * list of contributors.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "pedigree/kernel/process/RWLock.h"
+
+RWLock::RWLock()
+    : m_State(0), m_Owner(0), m_WritersWaiting(0), m_ReadSleepers(0),
+      m_WriteSleepers(0), m_ReadQueue(), m_WriteQueue()
+{
+}
+
+RWLock::~RWLock() = default;
+
+bool RWLock::worthSpinning(size_t state) const
+{
+    if (state & WriterHeld)
+    {
+        // An owner of zero means the writer is just now getting going.
+        uintptr_t owner = m_Owner;
+        return !owner || AdaptiveMutex::ownerRunning(owner);
+    }
+
+    // Readers don't record themselves anywhere, so assume they're making
+    // progress and leave it to the spin limit to stop us.
+    return true;
+}
+
+bool RWLock::acquireRead()
+{
+    while (true)
+    {
+        for (size_t i = 0; i < AdaptiveMutex::SpinLimit; ++i)
+        {
+            if (tryAcquireRead())
+            {
+                return true;
+            }
+
+            if (!worthSpinning(m_State))
+            {
+                break;
+            }
+
+            AdaptiveMutex::relax();
+        }
+
+        m_ReadSleepers += 1;
+        if (tryAcquireRead())
+        {
+            m_ReadSleepers -= 1;
+            return true;
+        }
+
+        m_ReadQueue.wait();
+        m_ReadSleepers -= 1;
+    }
+}
+
+bool RWLock::tryAcquireRead()
+{
+    while (true)
+    {
+        size_t state = m_State;
+        if ((state & WriterHeld) || m_WritersWaiting)
+        {
+            return false;
+        }
+
+        if (m_State.compareAndSwap(state, state + ReaderUnit))
+        {
+            return true;
+        }
+
+        // Lost a race with another reader - try again.
+    }
+}
+
+void RWLock::releaseRead()
+{
+    size_t state = (m_State -= ReaderUnit);
+    if (!state && m_WriteSleepers)
+    {
+        m_WriteQueue.wake();
+    }
+}
+
+bool RWLock::acquireWrite()
+{
+    // Holds back new readers from here on.
+    m_WritersWaiting += 1;
+
+    bool bAcquired = false;
+    while (!bAcquired)
+    {
+        for (size_t i = 0; i < AdaptiveMutex::SpinLimit; ++i)
+        {
+            if (m_State.compareAndSwap(0, WriterHeld))
+            {
+                bAcquired = true;
+                break;
+            }
+
+            if (!worthSpinning(m_State))
+            {
+                break;
+            }
+
+            AdaptiveMutex::relax();
+        }
+
+        if (bAcquired)
+        {
+            break;
+        }
+
+        m_WriteSleepers += 1;
+        if (m_State.compareAndSwap(0, WriterHeld))
+        {
+            m_WriteSleepers -= 1;
+            break;
+        }
+
+        m_WriteQueue.wait();
+        m_WriteSleepers -= 1;
+    }
+
+    m_Owner = AdaptiveMutex::currentOwner();
+    m_WritersWaiting -= 1;
+    return true;
+}
+
+bool RWLock::tryAcquireWrite()
+{
+    if (!m_State.compareAndSwap(0, WriterHeld))
+    {
+        return false;
+    }
+
+    m_Owner = AdaptiveMutex::currentOwner();
+    return true;
+}
+
+void RWLock::releaseWrite()
+{
+    m_Owner = 0;
+    m_State -= WriterHeld;
+
+    // Another writer gets the lock next if one wants it. Readers only get
+    // woken once no writers are left - the last writer out lets them in.
+    if (m_WritersWaiting)
+    {
+        if (m_WriteSleepers)
+        {
+            m_WriteQueue.wake();
+        }
+    }
+    else
+    {
+        size_t sleepers = m_ReadSleepers;
+        if (sleepers)
+        {
+            m_ReadQueue.wake(sleepers);
+        }
+    }
+}
@@ -100,6 +100,16 @@ void RoundRobin::threadStatusChanged(Thread *pThread)
     }
 }
 
+size_t RoundRobin::getReadyCount() const
+{
+    size_t count = 0;
+    for (size_t i = 0; i < MAX_PRIORITIES; i++)
+    {
+        count += m_pReadyQueues[i].count();
+    }
+    return count;
+}
+
 bool RoundRobin::isReady(Thread *pThread)
 {
     return pThread->getStatus() == Thread::Ready;
@@ -44,7 +44,7 @@ Scheduler Scheduler::m_Instance;
 
 Scheduler::Scheduler()
     : m_Processes(), m_NextPid(0), m_PTMap(), m_TPMap(), m_pKernelProcess(0),
-      m_pBspScheduler(0), m_SchedulerLock(false)
+      m_pBspScheduler(0), m_ProcessorSchedulers(), m_SchedulerLock(false)
 {
 }
 
@@ -72,6 +72,12 @@ bool Scheduler::initialise(Process *pKernelProcess)
         }
     }
 
+    for (List<PerProcessorScheduler *>::Iterator it = procList.begin();
+         it != procList.end(); ++it)
+    {
+        m_ProcessorSchedulers.pushBack(*it);
+    }
+
     pRoundRobin->initialise(procList);
 
     return true;
@@ -33,6 +33,7 @@
 #include "pedigree/kernel/processor/Processor.h"
 #include "pedigree/kernel/processor/ProcessorInformation.h"
 #include "pedigree/kernel/processor/state.h"
+#include "pedigree/kernel/time/Time.h"
 #include "pedigree/kernel/utilities/ExtensibleBitmap.h"
 #include "pedigree/kernel/utilities/Iterator.h"
 #include "pedigree/kernel/utilities/MemoryAllocator.h"
@@ -383,6 +384,12 @@ void Thread::setStatus(Thread::Status s)
 
     m_Status = s;
 
+    // Start the run queue wait clock; the scheduler stops it on switch-in.
+    if (s == Thread::Ready && previousStatus != Thread::Ready)
+    {
+        m_Statistics.readySince = Time::getTicks();
+    }
+
     if (s == Thread::Zombie)
     {
         // Wipe out any pending events that currently exist.
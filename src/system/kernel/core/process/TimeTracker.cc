@@ -18,10 +18,12 @@
  */
 
 #include "pedigree/kernel/process/TimeTracker.h"
+#include "pedigree/kernel/process/PerProcessorScheduler.h"
 #include "pedigree/kernel/process/Process.h"
 #include "pedigree/kernel/process/Thread.h"
 #include "pedigree/kernel/processor/Processor.h"
 #include "pedigree/kernel/processor/ProcessorInformation.h"
+#include "pedigree/kernel/time/Time.h"
 
 TimeTracker::TimeTracker(Process *pProcess, bool fromUserspace)
     : m_pProcess(pProcess), m_bFromUserspace(fromUserspace)
@@ -39,7 +41,11 @@ TimeTracker::TimeTracker(Process *pProcess, bool fromUserspace)
     }
 
     // Track time already spent wherever we were previously.
-    m_pProcess->trackTime(m_bFromUserspace);
+    Time::Timestamp spent = m_pProcess->trackTime(m_bFromUserspace);
+    if (m_bFromUserspace)
+    {
+        Processor::information().getScheduler().accountUserTime(spent);
+    }
 
     // Record current time for the next tracking.
     m_pProcess->recordTime(!m_bFromUserspace);
@@ -33,6 +33,28 @@ size_t ProcessorBase::isInitialised()
     return m_Initialised;
 }
 
+bool ProcessorBase::isRunningElsewhere(const Thread *pThread)
+{
+    EMIT_IF(!MULTIPROCESSOR)
+    {
+        return false;
+    }
+
+    // The list of processors is complete by the time we get here.
+    if (m_Initialised < 2)
+        return false;
+
+    ProcessorInformation &me = Processor::information();
+    for (size_t i = 0; i < m_ProcessorInformation.count(); i++)
+    {
+        ProcessorInformation *pInfo = m_ProcessorInformation[i];
+        if (pInfo != &me && pInfo->getCurrentThread() == pThread)
+            return true;
+    }
+
+    return false;
+}
+
 EnsureInterrupts::EnsureInterrupts(bool desired)
 {
     EMIT_IF(!PEDIGREE_BENCHMARK)
@@ -84,7 +84,7 @@ physical_uintptr_t HostedPhysicalMemoryManager::allocatePage(size_t pageConstrai
     // we need to not end up recursively trying to release the pressure.
     if (!bHandlingPressure)
     {
-        if (m_PageStack.freePages() < MemoryPressureManager::getHighWatermark())
+        if (m_PageStack.freePages() < MemoryPressureManager::getMinWatermark())
         {
             bHandlingPressure = true;
 
@@ -92,7 +92,7 @@ physical_uintptr_t HostedPhysicalMemoryManager::allocatePage(size_t pageConstrai
             m_Lock.release();
 
             WARNING_NOLOCK(
-                "Memory pressure encountered, performing a compact...");
+                "Memory pressure encountered, performing a direct reclaim...");
             if (!MemoryPressureManager::instance().compact())
                 ERROR_NOLOCK("Compact did not alleviate any memory pressure.");
             else
@@ -116,6 +116,8 @@ physical_uintptr_t HostedPhysicalMemoryManager::allocatePage(size_t pageConstrai
         panic("Out of memory.");
     }
 
+    size_t nFreePages = m_PageStack.freePages();
+
 #ifdef USE_BITMAP
     physical_uintptr_t ptr_bitmap = ptr / 0x1000;
     size_t idx = ptr_bitmap / 32;
@@ -130,6 +132,9 @@ physical_uintptr_t HostedPhysicalMemoryManager::allocatePage(size_t pageConstrai
 
     m_Lock.release();
 
+    // Wake up background reclaim if we're getting low.
+    MemoryPressureManager::instance().checkWatermarks(nFreePages);
+
 #if TRACK_PAGE_ALLOCATIONS
     if (Processor::m_Initialised == 2)
     {
@@ -22,6 +22,7 @@
 #include <fcntl.h>
 #include <memory.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
 #include <unistd.h>
@@ -29,6 +30,7 @@
 #include <elf.h>
 
 #include "pedigree/kernel/BootstrapInfo.h"
+#include "pedigree/kernel/machine/hosted/HostDiskImage.h"
 
 extern "C" void _main(BootstrapStruct_t &bs);
 
@@ -47,23 +49,23 @@ extern "C" int main(int argc, char *argv[])
     int initrd = -1;
     int configdb = -1;
     int kernel = -1;
-    int diskimage = -1;
     void *initrd_mapping = MAP_FAILED;
     void *configdb_mapping = MAP_FAILED;
     void *kernel_mapping = MAP_FAILED;
-    void *diskimage_mapping = MAP_FAILED;
     uintptr_t *module_region = (uintptr_t *) MAP_FAILED;
     size_t initrd_length = 0;
     size_t configdb_length = 0;
     size_t kernel_length = 0;
-    size_t diskimage_length = 0;
+    size_t disk_block_size = 0;
     Elf64_Ehdr *ehdr = 0;
     Elf64_Shdr *shdrs = 0;
     BootstrapStruct_t bs;
 
     if (argc < 3)
     {
-        fprintf(stderr, "Usage: kernel initrd config_database [diskimage]\n");
+        fprintf(
+            stderr,
+            "Usage: kernel initrd config_database [diskimage [blocksize]]\n");
         goto fail;
     }
 
@@ -165,38 +167,26 @@ extern "C" int main(int argc, char *argv[])
     bs.mods_addr = reinterpret_cast<uintptr_t>(module_region);
     bs.mods_count = 2;
 
+    // The disk image is not a module: the hosted diskimage driver reads and
+    // writes the file itself, through HostDiskImage.
     if (argc > 3)
     {
-        diskimage = open(argv[3], O_RDWR);
-        if (diskimage < 0)
-        {
-            fprintf(stderr, "Can't open disk image: %s\n", strerror(errno));
-            goto fail;
-        }
-
-        r = fstat(diskimage, &st);
-        if (r != 0)
+        if (argc > 4)
         {
-            fprintf(stderr, "Can't stat disk image: %s\n", strerror(errno));
-            goto fail;
+            disk_block_size = strtoul(argv[4], 0, 0);
         }
 
-        diskimage_length = st.st_size;
-        diskimage_mapping = mmap(
-            0, diskimage_length, PROT_READ | PROT_WRITE,
-            MAP_PRIVATE | MAP_NORESERVE, diskimage, 0);
-        if (diskimage_mapping == MAP_FAILED)
+        if (!HostDiskImage::open(argv[3], disk_block_size))
         {
-            fprintf(stderr, "Can't map disk image: %s\n", strerror(errno));
+            fprintf(stderr, "Can't open disk image: %s\n", strerror(errno));
             goto fail;
         }
-        fprintf(stderr, "disk image is at %p\n", diskimage_mapping);
-
-        // Add to the multiboot info.
-        bs.mods_count++;
-        module_region[8] = reinterpret_cast<uintptr_t>(diskimage_mapping);
-        module_region[9] =
-            reinterpret_cast<uintptr_t>(diskimage_mapping) + diskimage_length;
+        fprintf(
+            stderr, "disk image is at %p (%llu bytes, %zu byte blocks%s)\n",
+            HostDiskImage::getMapping(),
+            (unsigned long long) HostDiskImage::getSize(),
+            HostDiskImage::getBlockSize(),
+            HostDiskImage::isReadOnly() ? ", read-only" : "");
     }
 
     // Load ELF header to add ELF information.
@@ -219,7 +209,6 @@ extern "C" int main(int argc, char *argv[])
 
     fprintf(stderr, "Running main(), with mappings:\n");
     fprintf(stderr, " kernel: %p -> %p\n", kernel_mapping, add_ptr(kernel_mapping, kernel_length));
-    fprintf(stderr, " diskimage: %p -> %p\n", diskimage_mapping, add_ptr(diskimage_mapping, diskimage_length));
     fprintf(stderr, " modules: %p -> %p\n", module_region, add_ptr(module_region, 0x1000));
     fprintf(stderr, " configdb: %p -> %p\n", configdb_mapping, add_ptr(configdb_mapping, configdb_length));
     fprintf(stderr, " initrd: %p -> %p\n", initrd_mapping, add_ptr(initrd_mapping, initrd_length));
@@ -236,15 +225,13 @@ fail:
 cleanup:
     if (module_region != MAP_FAILED)
         munmap(module_region, 0x1000);
-    if (diskimage_mapping != MAP_FAILED)
-        munmap(diskimage_mapping, diskimage_length);
     if (kernel_mapping != MAP_FAILED)
         munmap(kernel_mapping, kernel_length);
     if (configdb_mapping != MAP_FAILED)
         munmap(configdb_mapping, configdb_length);
     if (initrd_mapping != MAP_FAILED)
         munmap(initrd_mapping, initrd_length);
-    close(diskimage);
+    HostDiskImage::close();
     close(kernel);
     close(configdb);
     close(initrd);
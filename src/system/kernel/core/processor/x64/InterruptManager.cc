@@ -33,6 +33,7 @@
 
 #if THREADS
 #include "pedigree/kernel/Subsystem.h"
+#include "pedigree/kernel/process/PerProcessorScheduler.h"
 #include "pedigree/kernel/process/Process.h"
 #include "pedigree/kernel/process/TimeTracker.h"
 #endif
@@ -136,6 +137,14 @@ void X64InterruptManager::interrupt(InterruptState &interruptState)
     TimeTracker tracker(0, !interruptState.kernelMode());
     size_t nIntNumber = interruptState.getInterruptNumber();
 
+#if THREADS
+    // The counters live in the scheduler, which exists once a thread does.
+    if (LIKELY(Processor::information().getCurrentThread() != 0))
+    {
+        Processor::information().getScheduler().accountInterrupt(nIntNumber);
+    }
+#endif
+
 #if DEBUGGER
     {
         InterruptHandler *pHandler;
@@ -22,6 +22,7 @@
 #include "pedigree/kernel/Log.h"
 #include "pedigree/kernel/Subsystem.h"
 #include "pedigree/kernel/compiler.h"
+#include "pedigree/kernel/process/PerProcessorScheduler.h"
 #include "pedigree/kernel/process/Process.h"
 #include "pedigree/kernel/process/Thread.h"
 #include "pedigree/kernel/process/TimeTracker.h"
@@ -60,6 +61,7 @@ void X64SyscallManager::syscall(SyscallState &syscallState)
 {
     SyscallHandler *pHandler;
     TimeTracker tracker(0, true);
+    Processor::information().getScheduler().accountSyscall();
 #if TIME_SYSCALLS
     Process *pProcess =
         Processor::information().getCurrentThread()->getParent();
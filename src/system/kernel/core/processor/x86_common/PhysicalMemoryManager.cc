@@ -92,7 +92,7 @@ X86CommonPhysicalMemoryManager::allocatePage(size_t pageConstraints)
     // we need to not end up recursively trying to release the pressure.
     if (!bHandlingPressure)
     {
-        if (m_PageStack.freePages() < MemoryPressureManager::getHighWatermark())
+        if (m_PageStack.freePages() < MemoryPressureManager::getMinWatermark())
         {
             bHandlingPressure = true;
 
@@ -100,7 +100,7 @@ X86CommonPhysicalMemoryManager::allocatePage(size_t pageConstraints)
             m_Lock.release();
 
             WARNING_NOLOCK(
-                "Memory pressure encountered, performing a compact...");
+                "Memory pressure encountered, performing a direct reclaim...");
             if (!MemoryPressureManager::instance().compact())
                 ERROR_NOLOCK("Compact did not alleviate any memory pressure.");
             else
@@ -124,6 +124,8 @@ X86CommonPhysicalMemoryManager::allocatePage(size_t pageConstraints)
         panic("Out of memory.");
     }
 
+    size_t nFreePages = m_PageStack.freePages();
+
     EMIT_IF(MEMORY_TRACING)
     {
         traceAllocation(
@@ -142,6 +144,9 @@ X86CommonPhysicalMemoryManager::allocatePage(size_t pageConstraints)
 
     m_Lock.release();
 
+    // Wake up background reclaim if we're getting low.
+    MemoryPressureManager::instance().checkWatermarks(nFreePages);
+
     EMIT_IF(TRACK_PAGE_ALLOCATIONS)\
     {
         if (Processor::m_Initialised == 2)
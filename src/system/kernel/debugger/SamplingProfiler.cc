@@ -0,0 +1,300 @@
+/*
+ * Copyright (c) 2008-2014, Pedigree Developers
+ *
+ * Please see the CONTRIB file in the root of the source tree for a full
+ * list of contributors.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "pedigree/kernel/debugger/SamplingProfiler.h"
+#include "pedigree/kernel/debugger/Backtrace.h"
+#include "pedigree/kernel/linker/KernelElf.h"
+#include "pedigree/kernel/process/Process.h"
+#include "pedigree/kernel/process/Thread.h"
+#include "pedigree/kernel/processor/Processor.h"
+#include "pedigree/kernel/processor/ProcessorInformation.h"
+#include "pedigree/kernel/processor/state.h"
+#include "pedigree/kernel/time/Time.h"
+#include "pedigree/kernel/utilities/utility.h"
+
+#include "../core/lib/instrument.h"
+
+SamplingProfiler SamplingProfiler::m_Instance;
+
+struct SamplingProfiler::CpuRing
+{
+    CpuRing() : samples(0), head(0), ticks(0), busy(false), backtrace()
+    {
+    }
+
+    ~CpuRing()
+    {
+        delete[] samples;
+    }
+
+    SampleRecord *samples;
+    /// Total samples ever written; the next slot is head % SamplesPerCpu.
+    size_t head;
+    size_t ticks;
+    /// Set while the ring is being written or read.
+    Atomic<bool> busy;
+    /// Kept here rather than on the (interrupt) stack, as it's quite large.
+    Backtrace backtrace;
+
+    size_t count() const
+    {
+        return head < SamplesPerCpu ? head : SamplesPerCpu;
+    }
+
+    void lock()
+    {
+        while (!busy.compareAndSwap(false, true))
+        {
+            Processor::pause();
+        }
+    }
+
+    void unlock()
+    {
+        busy.compareAndSwap(true, false);
+    }
+};
+
+/** Fills in \p record's stack with the backtrace from \p state. */
+static void unwind(Backtrace &bt, InterruptState &state, SampleRecord &record)
+{
+    record.frames[0] = state.getInstructionPointer();
+    record.depth = 1;
+
+    if (!state.kernelMode())
+    {
+        // Userspace stacks aren't ours to walk from an interrupt.
+        record.flags |= INSTRUMENT_SAMPLE_USER;
+        return;
+    }
+
+    bool bUnwound = false;
+#ifdef DWARF
+    // Backtrace would complain loudly (every tick!) without the table.
+    if (KernelElf::instance().debugFrameTable())
+    {
+        bt.performBacktrace(state);
+        bUnwound = true;
+    }
+#endif
+#if X86_COMMON || HOSTED
+    if (!bUnwound)
+    {
+        bt.performBpBacktrace(
+            state.getBasePointer(), state.getInstructionPointer());
+        bUnwound = true;
+    }
+#endif
+
+    if (!bUnwound)
+    {
+        return;
+    }
+
+    // Frame zero of a backtrace is the interrupted PC itself.
+    size_t depth = bt.numStackFrames();
+    if (depth > INSTRUMENT_SAMPLE_FRAMES)
+    {
+        depth = INSTRUMENT_SAMPLE_FRAMES;
+    }
+    for (size_t i = 1; i < depth; ++i)
+    {
+        record.frames[i] = bt.getReturnAddress(i);
+    }
+    if (depth > 1)
+    {
+        record.depth = depth;
+    }
+}
+
+SamplingProfiler::SamplingProfiler()
+    : m_Lock(false), m_pRings(0), m_nRings(0), m_bRunning(false),
+      m_Interval(1), m_Dropped(0)
+{
+}
+
+SamplingProfiler::~SamplingProfiler()
+{
+    delete[] m_pRings;
+}
+
+bool SamplingProfiler::start(size_t interval)
+{
+    if (!interval)
+    {
+        return false;
+    }
+
+    // Allocate outside of the lock - this is quite a lot of memory.
+    CpuRing *pRings = 0;
+    size_t nRings = Processor::getCount();
+    if (!m_pRings)
+    {
+        pRings = new CpuRing[nRings];
+        for (size_t i = 0; i < nRings; ++i)
+        {
+            pRings[i].samples = new SampleRecord[SamplesPerCpu];
+        }
+    }
+
+    m_Lock.acquire();
+    if (!m_pRings && pRings)
+    {
+        m_pRings = pRings;
+        m_nRings = nRings;
+        pRings = 0;
+    }
+    m_Interval = interval;
+    m_bRunning = true;
+    m_Lock.release();
+
+    // Lost a race with another start().
+    delete[] pRings;
+
+    return true;
+}
+
+void SamplingProfiler::stop()
+{
+    m_Lock.acquire();
+    m_bRunning = false;
+    m_Lock.release();
+}
+
+void SamplingProfiler::clear()
+{
+    m_Lock.acquire();
+    for (size_t i = 0; i < m_nRings; ++i)
+    {
+        CpuRing &ring = m_pRings[i];
+        ring.lock();
+        ring.head = 0;
+        ring.ticks = 0;
+        ring.unlock();
+    }
+    m_Dropped = 0;
+    m_Lock.release();
+}
+
+void SamplingProfiler::sample(InterruptState &state)
+{
+    if (!m_bRunning)
+    {
+        return;
+    }
+
+    size_t cpu = Processor::id();
+    if (UNLIKELY(cpu >= m_nRings))
+    {
+        return;
+    }
+
+    CpuRing &ring = m_pRings[cpu];
+    if ((++ring.ticks % m_Interval) != 0)
+    {
+        return;
+    }
+
+    // Someone is reading this ring - don't wait for them in an interrupt.
+    if (!ring.busy.compareAndSwap(false, true))
+    {
+        m_Dropped += 1;
+        return;
+    }
+
+    SampleRecord &record = ring.samples[ring.head % SamplesPerCpu];
+    record.magic = INSTRUMENT_SAMPLE_MAGIC;
+    record.flags = 0;
+    record.cpu = cpu;
+    record.process = 0;
+    record.thread = 0;
+    record.timestamp = Time::getTicks();
+
+    Thread *pThread = Processor::information().getCurrentThread();
+    if (pThread)
+    {
+        record.thread = pThread->getId();
+        if (pThread->getParent())
+        {
+            record.process = pThread->getParent()->getId();
+        }
+    }
+
+    unwind(ring.backtrace, state, record);
+
+    ++ring.head;
+    ring.unlock();
+}
+
+size_t SamplingProfiler::count()
+{
+    size_t total = 0;
+    for (size_t i = 0; i < m_nRings; ++i)
+    {
+        CpuRing &ring = m_pRings[i];
+        ring.lock();
+        total += ring.count();
+        ring.unlock();
+    }
+
+    return total;
+}
+
+size_t SamplingProfiler::streamSize()
+{
+    return sizeof(uint8_t) + (count() * sizeof(SampleRecord));
+}
+
+size_t SamplingProfiler::writeStream(uint8_t *pBuffer, size_t length)
+{
+    if (!length)
+    {
+        return 0;
+    }
+
+    *pBuffer = INSTRUMENT_GLOBAL_SAMPLES;
+    size_t offset = sizeof(uint8_t);
+
+    for (size_t i = 0; i < m_nRings; ++i)
+    {
+        CpuRing &ring = m_pRings[i];
+        ring.lock();
+
+        // Oldest first: once the ring has wrapped that's the slot that will
+        // be overwritten next.
+        size_t n = ring.count();
+        size_t first = ring.head - n;
+        for (size_t j = 0; j < n; ++j)
+        {
+            if ((length - offset) < sizeof(SampleRecord))
+            {
+                break;
+            }
+
+            MemoryCopy(
+                pBuffer + offset, &ring.samples[(first + j) % SamplesPerCpu],
+                sizeof(SampleRecord));
+            offset += sizeof(SampleRecord);
+        }
+
+        ring.unlock();
+    }
+
+    return offset;
+}
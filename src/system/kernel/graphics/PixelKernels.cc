@@ -0,0 +1,794 @@
+/*
+ * Copyright (c) 2008-2014, Pedigree Developers
+ *
+ * Please see the CONTRIB file in the root of the source tree for a full
+ * list of contributors.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "pedigree/kernel/graphics/PixelKernels.h"
+#include "pedigree/kernel/utilities/utility.h"
+
+// The vector kernels are built with per-function target attributes, so the
+// rest of the kernel can keep building with -mno-sse.
+#ifdef TARGET_IS_X86
+#define PIXEL_KERNELS_X86 1
+#define TARGET_SSE2 __attribute__((target("sse2")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define PIXEL_KERNELS_X86 0
+#endif
+
+// The kernel does not preserve vector registers when it is entered, so we
+// have to save (and later restore) the interrupted thread's state around
+// any vector kernel we call.
+#if PIXEL_KERNELS_X86 && !(HOSTED || UTILITY_LINUX)
+#define PIXEL_KERNELS_SAVE_STATE 1
+#else
+#define PIXEL_KERNELS_SAVE_STATE 0
+#endif
+
+/// Below this many pixels, saving vector state costs more than it saves.
+#define VECTOR_STATE_THRESHOLD 512
+
+/// At or above this many bytes "rep movs"/"rep stos" beat a vector loop.
+#define REP_STRING_THRESHOLD 2048
+
+namespace Graphics
+{
+static inline uint16_t packRgb565(uint32_t p)
+{
+    return ((p >> 8) & 0xF800) | ((p >> 5) & 0x07E0) | ((p >> 3) & 0x001F);
+}
+
+static inline uint32_t unpackRgb565(uint32_t p)
+{
+    uint32_t r = (p >> 11) & 0x1F;
+    uint32_t g = (p >> 5) & 0x3F;
+    uint32_t b = p & 0x1F;
+
+    // Replicate the high bits into the low bits so 0x1F maps to 0xFF.
+    r = (r << 3) | (r >> 2);
+    g = (g << 2) | (g >> 4);
+    b = (b << 3) | (b >> 2);
+
+    return 0xFF000000U | (r << 16) | (g << 8) | b;
+}
+
+/// Porter-Duff "over", with each channel computed as (x + 128) / 255 using
+/// the usual (x + (x >> 8)) >> 8 approximation (exact for x <= 255 * 255).
+static inline uint32_t blendPixel(uint32_t d, uint32_t s)
+{
+    uint32_t a = s >> 24;
+    uint32_t ia = 255 - a;
+
+    uint32_t rb = ((s & 0xFF00FF) * a) + ((d & 0xFF00FF) * ia) + 0x800080;
+    rb = ((rb + ((rb >> 8) & 0xFF00FF)) >> 8) & 0xFF00FF;
+
+    // Treating the source alpha channel as 0xFF gives a + da * (1 - a).
+    uint32_t ag = ((((s >> 8) & 0xFF) | 0xFF0000) * a) +
+                  (((d >> 8) & 0xFF00FF) * ia) + 0x800080;
+    ag = (ag + ((ag >> 8) & 0xFF00FF)) & 0xFF00FF00;
+
+    return ag | rb;
+}
+
+static void scalarCopy(void *dest, const void *src, size_t n)
+{
+    ForwardMemoryCopy(dest, src, n);
+}
+
+static void scalarFill16(uint16_t *dest, uint16_t colour, size_t n)
+{
+    WordSet(dest, colour, n);
+}
+
+static void scalarFill32(uint32_t *dest, uint32_t colour, size_t n)
+{
+    DoubleWordSet(dest, colour, n);
+}
+
+static void
+scalarArgb8888ToRgb565(uint16_t *dest, const uint32_t *src, size_t n)
+{
+    for (size_t i = 0; i < n; ++i)
+        dest[i] = packRgb565(src[i]);
+}
+
+static void
+scalarRgb565ToArgb8888(uint32_t *dest, const uint16_t *src, size_t n)
+{
+    for (size_t i = 0; i < n; ++i)
+        dest[i] = unpackRgb565(src[i]);
+}
+
+static void
+scalarRgb888ToArgb8888(uint32_t *dest, const uint8_t *src, size_t n)
+{
+    for (size_t i = 0; i < n; ++i, src += 3)
+        dest[i] = 0xFF000000U | (src[2] << 16) | (src[1] << 8) | src[0];
+}
+
+static void
+scalarArgb8888ToRgb888(uint8_t *dest, const uint32_t *src, size_t n)
+{
+    for (size_t i = 0; i < n; ++i, dest += 3)
+    {
+        dest[0] = src[i] & 0xFF;
+        dest[1] = (src[i] >> 8) & 0xFF;
+        dest[2] = (src[i] >> 16) & 0xFF;
+    }
+}
+
+static void
+scalarBlendArgb8888(uint32_t *dest, const uint32_t *src, size_t n)
+{
+    for (size_t i = 0; i < n; ++i)
+    {
+        uint32_t a = src[i] >> 24;
+        if (a == 0xFF)
+            dest[i] = src[i];
+        else if (a)
+            dest[i] = blendPixel(dest[i], src[i]);
+    }
+}
+
+static const PixelKernels g_ScalarKernels = {
+    KernelScalar,           "scalar",
+    scalarCopy,             scalarFill16,
+    scalarFill32,           scalarArgb8888ToRgb565,
+    scalarRgb565ToArgb8888, scalarRgb888ToArgb8888,
+    scalarArgb8888ToRgb888, scalarBlendArgb8888,
+};
+
+#if PIXEL_KERNELS_X86
+
+/// Vector types for one register width. The unaligned variants are how we
+/// load and store without requiring the caller to align anything.
+template <size_t Bytes>
+struct Vector
+{
+    typedef uint8_t u8 __attribute__((vector_size(Bytes)));
+    typedef uint16_t u16 __attribute__((vector_size(Bytes)));
+    typedef uint32_t u32 __attribute__((vector_size(Bytes)));
+
+    typedef uint8_t u8u
+        __attribute__((vector_size(Bytes), aligned(1), may_alias));
+    typedef uint16_t u16u
+        __attribute__((vector_size(Bytes), aligned(1), may_alias));
+    typedef uint32_t u32u
+        __attribute__((vector_size(Bytes), aligned(1), may_alias));
+
+    static const size_t lanes16 = Bytes / 2;
+    static const size_t lanes32 = Bytes / 4;
+};
+
+/// Constant shuffle masks. These must be compile-time constants, otherwise
+/// the compiler falls back to element-by-element shuffles.
+template <size_t Bytes>
+struct ShuffleMasks;
+
+template <>
+struct ShuffleMasks<16>
+{
+    /// Takes the low 16 bits of every 32-bit lane across two registers.
+    static constexpr Vector<16>::u16 narrow = {0, 2, 4, 6, 8, 10, 12, 14};
+    /// Interleaves the low (or high) halves of two registers.
+    static constexpr Vector<16>::u16 interleaveLow = {
+        0, 8, 1, 9, 2, 10, 3, 11};
+    static constexpr Vector<16>::u16 interleaveHigh = {
+        4, 12, 5, 13, 6, 14, 7, 15};
+};
+
+template <>
+struct ShuffleMasks<32>
+{
+    static constexpr Vector<32>::u16 narrow = {
+        0, 2, 4, 6, 8, 10, 12, 14, 16, 18, 20, 22, 24, 26, 28, 30};
+    static constexpr Vector<32>::u16 interleaveLow = {
+        0, 16, 1, 17, 2, 18, 3, 19, 4, 20, 5, 21, 6, 22, 7, 23};
+    static constexpr Vector<32>::u16 interleaveHigh = {
+        8, 24, 9, 25, 10, 26, 11, 27, 12, 28, 13, 29, 14, 30, 15, 31};
+};
+
+// These templates are only ever inlined into functions carrying a target
+// attribute; that is what makes the vector types map onto real registers.
+
+template <size_t Bytes>
+static ALWAYS_INLINE inline void
+vectorCopy(void *dest, const void *src, size_t n)
+{
+    typedef typename Vector<Bytes>::u8u V;
+
+    if (n >= REP_STRING_THRESHOLD)
+    {
+        ForwardMemoryCopy(dest, src, n);
+        return;
+    }
+
+    uint8_t *d = reinterpret_cast<uint8_t *>(dest);
+    const uint8_t *s = reinterpret_cast<const uint8_t *>(src);
+
+    size_t i = 0;
+    for (; (i + (Bytes * 4)) <= n; i += Bytes * 4)
+    {
+        V a = *reinterpret_cast<const V *>(s + i);
+        V b = *reinterpret_cast<const V *>(s + i + Bytes);
+        V c = *reinterpret_cast<const V *>(s + i + (Bytes * 2));
+        V e = *reinterpret_cast<const V *>(s + i + (Bytes * 3));
+        *reinterpret_cast<V *>(d + i) = a;
+        *reinterpret_cast<V *>(d + i + Bytes) = b;
+        *reinterpret_cast<V *>(d + i + (Bytes * 2)) = c;
+        *reinterpret_cast<V *>(d + i + (Bytes * 3)) = e;
+    }
+    for (; (i + Bytes) <= n; i += Bytes)
+        *reinterpret_cast<V *>(d + i) = *reinterpret_cast<const V *>(s + i);
+    for (; i < n; ++i)
+        d[i] = s[i];
+}
+
+template <size_t Bytes>
+static ALWAYS_INLINE inline void
+vectorFill16(uint16_t *dest, uint16_t colour, size_t n)
+{
+    typedef typename Vector<Bytes>::u16 V;
+    typedef typename Vector<Bytes>::u16u VU;
+
+    const size_t lanes = Vector<Bytes>::lanes16;
+
+    if ((n * sizeof(*dest)) >= REP_STRING_THRESHOLD)
+    {
+        WordSet(dest, colour, n);
+        return;
+    }
+
+    V v = colour - V{};
+
+    size_t i = 0;
+    for (; (i + (lanes * 4)) <= n; i += lanes * 4)
+    {
+        *reinterpret_cast<VU *>(dest + i) = v;
+        *reinterpret_cast<VU *>(dest + i + lanes) = v;
+        *reinterpret_cast<VU *>(dest + i + (lanes * 2)) = v;
+        *reinterpret_cast<VU *>(dest + i + (lanes * 3)) = v;
+    }
+    for (; (i + lanes) <= n; i += lanes)
+        *reinterpret_cast<VU *>(dest + i) = v;
+    for (; i < n; ++i)
+        dest[i] = colour;
+}
+
+template <size_t Bytes>
+static ALWAYS_INLINE inline void
+vectorFill32(uint32_t *dest, uint32_t colour, size_t n)
+{
+    typedef typename Vector<Bytes>::u32 V;
+    typedef typename Vector<Bytes>::u32u VU;
+
+    const size_t lanes = Vector<Bytes>::lanes32;
+
+    if ((n * sizeof(*dest)) >= REP_STRING_THRESHOLD)
+    {
+        DoubleWordSet(dest, colour, n);
+        return;
+    }
+
+    V v = colour - V{};
+
+    size_t i = 0;
+    for (; (i + (lanes * 4)) <= n; i += lanes * 4)
+    {
+        *reinterpret_cast<VU *>(dest + i) = v;
+        *reinterpret_cast<VU *>(dest + i + lanes) = v;
+        *reinterpret_cast<VU *>(dest + i + (lanes * 2)) = v;
+        *reinterpret_cast<VU *>(dest + i + (lanes * 3)) = v;
+    }
+    for (; (i + lanes) <= n; i += lanes)
+        *reinterpret_cast<VU *>(dest + i) = v;
+    for (; i < n; ++i)
+        dest[i] = colour;
+}
+
+template <size_t Bytes>
+static ALWAYS_INLINE inline void
+vectorArgb8888ToRgb565(uint16_t *dest, const uint32_t *src, size_t n)
+{
+    typedef typename Vector<Bytes>::u16 V16;
+    typedef typename Vector<Bytes>::u32 V32;
+    typedef typename Vector<Bytes>::u16u V16U;
+    typedef typename Vector<Bytes>::u32u V32U;
+    const size_t lanes = Vector<Bytes>::lanes32;
+
+    size_t i = 0;
+    for (; (i + (lanes * 2)) <= n; i += lanes * 2)
+    {
+        V32 a = *reinterpret_cast<const V32U *>(src + i);
+        V32 b = *reinterpret_cast<const V32U *>(src + i + lanes);
+
+        a = ((a >> 8) & 0xF800) | ((a >> 5) & 0x07E0) | ((a >> 3) & 0x001F);
+        b = ((b >> 8) & 0xF800) | ((b >> 5) & 0x07E0) | ((b >> 3) & 0x001F);
+
+        *reinterpret_cast<V16U *>(dest + i) = __builtin_shuffle(
+            reinterpret_cast<V16>(a), reinterpret_cast<V16>(b),
+            ShuffleMasks<Bytes>::narrow);
+    }
+    for (; i < n; ++i)
+        dest[i] = packRgb565(src[i]);
+}
+
+template <size_t Bytes>
+static ALWAYS_INLINE inline void
+vectorRgb565ToArgb8888(uint32_t *dest, const uint16_t *src, size_t n)
+{
+    typedef typename Vector<Bytes>::u16 V16;
+    typedef typename Vector<Bytes>::u32 V32;
+    typedef typename Vector<Bytes>::u16u V16U;
+    typedef typename Vector<Bytes>::u32u V32U;
+    const size_t lanes = Vector<Bytes>::lanes16;
+
+    // Expand each channel to 8 bits in 16-bit lanes, then interleave the
+    // green/blue and alpha/red lanes to form 32-bit pixels.
+    size_t i = 0;
+    for (; (i + lanes) <= n; i += lanes)
+    {
+        V16 v = *reinterpret_cast<const V16U *>(src + i);
+
+        V16 r = v >> 11;
+        V16 g = (v >> 5) & 0x3F;
+        V16 b = v & 0x1F;
+
+        r = (r << 3) | (r >> 2);
+        g = (g << 2) | (g >> 4);
+        b = (b << 3) | (b >> 2);
+
+        V16 gb = (g << 8) | b;
+        V16 ar = r | 0xFF00;
+
+        *reinterpret_cast<V32U *>(dest + i) = reinterpret_cast<V32>(
+            __builtin_shuffle(gb, ar, ShuffleMasks<Bytes>::interleaveLow));
+        *reinterpret_cast<V32U *>(dest + i + (lanes / 2)) =
+            reinterpret_cast<V32>(__builtin_shuffle(
+                gb, ar, ShuffleMasks<Bytes>::interleaveHigh));
+    }
+    for (; i < n; ++i)
+        dest[i] = unpackRgb565(src[i]);
+}
+
+template <size_t Bytes>
+static ALWAYS_INLINE inline void
+vectorBlendArgb8888(uint32_t *dest, const uint32_t *src, size_t n)
+{
+    typedef typename Vector<Bytes>::u16 V16;
+    typedef typename Vector<Bytes>::u32 V32;
+    typedef typename Vector<Bytes>::u32u V32U;
+    const size_t lanes = Vector<Bytes>::lanes32;
+
+    // Same arithmetic as blendPixel, but with each channel pair split into
+    // 16-bit lanes so we can use 16-bit multiplies.
+    size_t i = 0;
+    for (; (i + lanes) <= n; i += lanes)
+    {
+        V32 s = *reinterpret_cast<const V32U *>(src + i);
+        V32 d = *reinterpret_cast<const V32U *>(dest + i);
+
+        V32 a32 = s >> 24;
+        V16 a = reinterpret_cast<V16>(a32 | (a32 << 16));
+        V16 ia = 255 - a;
+
+        V16 rb = (reinterpret_cast<V16>(s & 0xFF00FF) * a) +
+                 (reinterpret_cast<V16>(d & 0xFF00FF) * ia) + 0x80;
+        rb = (rb + (rb >> 8)) >> 8;
+
+        V16 ag = (reinterpret_cast<V16>(((s >> 8) & 0xFF) | 0xFF0000) * a) +
+                 (reinterpret_cast<V16>((d >> 8) & 0xFF00FF) * ia) + 0x80;
+        ag = (ag + (ag >> 8)) & 0xFF00;
+
+        *reinterpret_cast<V32U *>(dest + i) =
+            reinterpret_cast<V32>(ag) | reinterpret_cast<V32>(rb);
+    }
+
+    scalarBlendArgb8888(dest + i, src + i, n - i);
+}
+
+/// 24-bit conversions need a byte shuffle, which only exists from SSSE3
+/// onwards, so these are only used by the AVX2 kernels.
+static ALWAYS_INLINE inline void
+vectorRgb888ToArgb8888(uint32_t *dest, const uint8_t *src, size_t n)
+{
+    typedef typename Vector<16>::u8 V8;
+    typedef typename Vector<16>::u8u V8U;
+    typedef typename Vector<16>::u32 V32;
+    typedef typename Vector<16>::u32u V32U;
+
+    const V8 expand = {0,  1,  2,  16, 3,  4,  5,  16,
+                       6,  7,  8,  16, 9,  10, 11, 16};
+    const V8 zero = V8{};
+
+    // Each load reads 16 bytes but only consumes 12 (four pixels), so stop
+    // while there are still six pixels left to avoid reading off the end.
+    size_t i = 0;
+    for (; (i + 6) <= n; i += 4)
+    {
+        V8 v = *reinterpret_cast<const V8U *>(src + (i * 3));
+        V32 p = reinterpret_cast<V32>(__builtin_shuffle(v, zero, expand));
+        *reinterpret_cast<V32U *>(dest + i) = p | 0xFF000000U;
+    }
+
+    scalarRgb888ToArgb8888(dest + i, src + (i * 3), n - i);
+}
+
+static ALWAYS_INLINE inline void
+vectorArgb8888ToRgb888(uint8_t *dest, const uint32_t *src, size_t n)
+{
+    typedef typename Vector<16>::u8 V8;
+    typedef typename Vector<16>::u8u V8U;
+    typedef typename Vector<16>::u32u V32U;
+
+    const V8 pack = {0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, 0, 0, 0, 0};
+
+    // Each store writes 16 bytes but only 12 are valid; the next iteration
+    // overwrites the excess, so stop while six pixels of room remain.
+    size_t i = 0;
+    for (; (i + 6) <= n; i += 4)
+    {
+        V8 v = reinterpret_cast<V8>(*reinterpret_cast<const V32U *>(src + i));
+        *reinterpret_cast<V8U *>(dest + (i * 3)) = __builtin_shuffle(v, pack);
+    }
+
+    scalarArgb8888ToRgb888(dest + (i * 3), src + i, n - i);
+}
+
+TARGET_SSE2 static void sse2Copy(void *dest, const void *src, size_t n)
+{
+    vectorCopy<16>(dest, src, n);
+}
+
+TARGET_SSE2 static void sse2Fill16(uint16_t *dest, uint16_t colour, size_t n)
+{
+    vectorFill16<16>(dest, colour, n);
+}
+
+TARGET_SSE2 static void sse2Fill32(uint32_t *dest, uint32_t colour, size_t n)
+{
+    vectorFill32<16>(dest, colour, n);
+}
+
+TARGET_SSE2 static void
+sse2Argb8888ToRgb565(uint16_t *dest, const uint32_t *src, size_t n)
+{
+    vectorArgb8888ToRgb565<16>(dest, src, n);
+}
+
+TARGET_SSE2 static void
+sse2Rgb565ToArgb8888(uint32_t *dest, const uint16_t *src, size_t n)
+{
+    vectorRgb565ToArgb8888<16>(dest, src, n);
+}
+
+TARGET_SSE2 static void
+sse2BlendArgb8888(uint32_t *dest, const uint32_t *src, size_t n)
+{
+    vectorBlendArgb8888<16>(dest, src, n);
+}
+
+TARGET_AVX2 static void avx2Copy(void *dest, const void *src, size_t n)
+{
+    vectorCopy<32>(dest, src, n);
+}
+
+TARGET_AVX2 static void avx2Fill16(uint16_t *dest, uint16_t colour, size_t n)
+{
+    vectorFill16<32>(dest, colour, n);
+}
+
+TARGET_AVX2 static void avx2Fill32(uint32_t *dest, uint32_t colour, size_t n)
+{
+    vectorFill32<32>(dest, colour, n);
+}
+
+TARGET_AVX2 static void
+avx2Argb8888ToRgb565(uint16_t *dest, const uint32_t *src, size_t n)
+{
+    vectorArgb8888ToRgb565<32>(dest, src, n);
+}
+
+TARGET_AVX2 static void
+avx2Rgb565ToArgb8888(uint32_t *dest, const uint16_t *src, size_t n)
+{
+    vectorRgb565ToArgb8888<32>(dest, src, n);
+}
+
+TARGET_AVX2 static void
+avx2Rgb888ToArgb8888(uint32_t *dest, const uint8_t *src, size_t n)
+{
+    vectorRgb888ToArgb8888(dest, src, n);
+}
+
+TARGET_AVX2 static void
+avx2Argb8888ToRgb888(uint8_t *dest, const uint32_t *src, size_t n)
+{
+    vectorArgb8888ToRgb888(dest, src, n);
+}
+
+TARGET_AVX2 static void
+avx2BlendArgb8888(uint32_t *dest, const uint32_t *src, size_t n)
+{
+    vectorBlendArgb8888<32>(dest, src, n);
+}
+
+static const PixelKernels g_Sse2Kernels = {
+    KernelSse2,           "sse2",
+    sse2Copy,             sse2Fill16,
+    sse2Fill32,           sse2Argb8888ToRgb565,
+    sse2Rgb565ToArgb8888, scalarRgb888ToArgb8888,
+    scalarArgb8888ToRgb888, sse2BlendArgb8888,
+};
+
+static const PixelKernels g_Avx2Kernels = {
+    KernelAvx2,           "avx2",
+    avx2Copy,             avx2Fill16,
+    avx2Fill32,           avx2Argb8888ToRgb565,
+    avx2Rgb565ToArgb8888, avx2Rgb888ToArgb8888,
+    avx2Argb8888ToRgb888, avx2BlendArgb8888,
+};
+
+static void
+cpuid(uint32_t leaf, uint32_t &eax, uint32_t &ebx, uint32_t &ecx, uint32_t &edx)
+{
+    asm volatile("cpuid"
+                 : "=a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx)
+                 : "a"(leaf), "c"(0));
+}
+
+static bool cpuHasSse2()
+{
+    uint32_t eax, ebx, ecx, edx;
+    cpuid(1, eax, ebx, ecx, edx);
+    return edx & (1 << 26);
+}
+
+static bool cpuHasAvx2()
+{
+    uint32_t eax, ebx, ecx, edx;
+    cpuid(0, eax, ebx, ecx, edx);
+    if (eax < 7)
+        return false;
+
+    // OSXSAVE must be set before XGETBV is usable, and the OS must have
+    // enabled saving of both the SSE and AVX state. The kernel proper never
+    // sets OSXSAVE, so this is only ever true for hosted/utility builds.
+    cpuid(1, eax, ebx, ecx, edx);
+    if ((ecx & ((1 << 27) | (1 << 28))) != ((1 << 27) | (1 << 28)))
+        return false;
+
+    uint32_t xcr0Low, xcr0High;
+    asm volatile("xgetbv" : "=a"(xcr0Low), "=d"(xcr0High) : "c"(0));
+    if ((xcr0Low & 0x6) != 0x6)
+        return false;
+
+    cpuid(7, eax, ebx, ecx, edx);
+    return ebx & (1 << 5);
+}
+
+#endif  // PIXEL_KERNELS_X86
+
+const PixelKernels *pixelKernels(KernelVariant variant)
+{
+    switch (variant)
+    {
+        case KernelScalar:
+            return &g_ScalarKernels;
+#if PIXEL_KERNELS_X86
+        case KernelSse2:
+            return cpuHasSse2() ? &g_Sse2Kernels : 0;
+        case KernelAvx2:
+            return cpuHasAvx2() ? &g_Avx2Kernels : 0;
+#endif
+        default:
+            return 0;
+    }
+}
+
+const PixelKernels &pixelKernels()
+{
+    // Racing here is harmless: every caller will pick the same kernels.
+    static const PixelKernels *s_pBest = 0;
+    if (UNLIKELY(!s_pBest))
+    {
+        const PixelKernels *pBest = &g_ScalarKernels;
+        for (size_t i = KernelScalar; i < KernelVariantCount; ++i)
+        {
+            const PixelKernels *p =
+                pixelKernels(static_cast<KernelVariant>(i));
+            if (p)
+                pBest = p;
+        }
+        s_pBest = pBest;
+    }
+
+    return *s_pBest;
+}
+
+#if PIXEL_KERNELS_SAVE_STATE
+/// Saves the current thread's x87/SSE state for the lifetime of the object
+/// if the given kernels will use vector registers.
+class VectorStateGuard
+{
+  public:
+    VectorStateGuard(const PixelKernels &kernels)
+        : m_bSaved(kernels.variant != KernelScalar)
+    {
+        if (m_bSaved)
+            asm volatile("fxsave %0" : "=m"(m_State));
+    }
+
+    ~VectorStateGuard()
+    {
+        if (m_bSaved)
+            asm volatile("fxrstor %0" ::"m"(m_State));
+    }
+
+  private:
+    NOT_COPYABLE_OR_ASSIGNABLE(VectorStateGuard);
+
+    uint8_t m_State[512] ALIGN(16);
+    bool m_bSaved;
+};
+#else
+class VectorStateGuard
+{
+  public:
+    VectorStateGuard(const PixelKernels &)
+    {
+    }
+};
+#endif
+
+/// Picks kernels for an operation touching the given number of pixels.
+static const PixelKernels &kernelsFor(size_t pixels)
+{
+#if PIXEL_KERNELS_SAVE_STATE
+    if (pixels < VECTOR_STATE_THRESHOLD)
+        return g_ScalarKernels;
+#endif
+    return pixelKernels();
+}
+
+static inline bool isArgbLayout(PixelFormat format)
+{
+    return (format == Bits32_Argb) || (format == Bits32_Rgb);
+}
+
+bool canConvertPixels(PixelFormat srcFormat, PixelFormat destFormat)
+{
+    if (srcFormat == destFormat)
+        return (srcFormat != Bits8_Idx);
+
+    if (isArgbLayout(srcFormat))
+        return isArgbLayout(destFormat) || (destFormat == Bits16_Rgb565) ||
+               (destFormat == Bits24_Rgb);
+    if (isArgbLayout(destFormat))
+        return (srcFormat == Bits16_Rgb565) || (srcFormat == Bits24_Rgb);
+
+    return false;
+}
+
+static void convertRow(
+    const PixelKernels &k, void *dest, PixelFormat destFormat,
+    const void *src, PixelFormat srcFormat, size_t n)
+{
+    if (isArgbLayout(srcFormat) && isArgbLayout(destFormat))
+        k.copy(dest, src, n * 4);
+    else if (srcFormat == destFormat)
+        k.copy(dest, src, n * bytesPerPixel(srcFormat));
+    else if (destFormat == Bits16_Rgb565)
+        k.argb8888ToRgb565(
+            reinterpret_cast<uint16_t *>(dest),
+            reinterpret_cast<const uint32_t *>(src), n);
+    else if (destFormat == Bits24_Rgb)
+        k.argb8888ToRgb888(
+            reinterpret_cast<uint8_t *>(dest),
+            reinterpret_cast<const uint32_t *>(src), n);
+    else if (srcFormat == Bits16_Rgb565)
+        k.rgb565ToArgb8888(
+            reinterpret_cast<uint32_t *>(dest),
+            reinterpret_cast<const uint16_t *>(src), n);
+    else if (srcFormat == Bits24_Rgb)
+        k.rgb888ToArgb8888(
+            reinterpret_cast<uint32_t *>(dest),
+            reinterpret_cast<const uint8_t *>(src), n);
+}
+
+void blitRect(
+    void *dest, size_t destPitch, const void *src, size_t srcPitch,
+    size_t widthBytes, size_t height)
+{
+    // Contiguous rows are better served by a single large copy.
+    if ((destPitch == widthBytes) && (srcPitch == widthBytes))
+    {
+        MemoryCopy(dest, src, widthBytes * height);
+        return;
+    }
+
+    const PixelKernels &k = kernelsFor((widthBytes * height) / 4);
+    VectorStateGuard guard(k);
+
+    uint8_t *d = reinterpret_cast<uint8_t *>(dest);
+    const uint8_t *s = reinterpret_cast<const uint8_t *>(src);
+    for (size_t y = 0; y < height; ++y, d += destPitch, s += srcPitch)
+        k.copy(d, s, widthBytes);
+}
+
+bool fillRect(
+    void *dest, size_t destPitch, size_t bytesPerPixel, uint32_t colour,
+    size_t width, size_t height)
+{
+    if ((bytesPerPixel != 2) && (bytesPerPixel != 4))
+        return false;
+
+    // Fill the whole thing in one go if the rows are contiguous.
+    if (destPitch == (width * bytesPerPixel))
+    {
+        width *= height;
+        height = 1;
+    }
+
+    const PixelKernels &k = kernelsFor(width * height);
+    VectorStateGuard guard(k);
+
+    uint8_t *d = reinterpret_cast<uint8_t *>(dest);
+    for (size_t y = 0; y < height; ++y, d += destPitch)
+    {
+        if (bytesPerPixel == 2)
+            k.fill16(reinterpret_cast<uint16_t *>(d), colour, width);
+        else
+            k.fill32(reinterpret_cast<uint32_t *>(d), colour, width);
+    }
+
+    return true;
+}
+
+bool convertRect(
+    void *dest, size_t destPitch, PixelFormat destFormat, const void *src,
+    size_t srcPitch, PixelFormat srcFormat, size_t width, size_t height)
+{
+    if (!canConvertPixels(srcFormat, destFormat))
+        return false;
+
+    const PixelKernels &k = kernelsFor(width * height);
+    VectorStateGuard guard(k);
+
+    uint8_t *d = reinterpret_cast<uint8_t *>(dest);
+    const uint8_t *s = reinterpret_cast<const uint8_t *>(src);
+    for (size_t y = 0; y < height; ++y, d += destPitch, s += srcPitch)
+        convertRow(k, d, destFormat, s, srcFormat, width);
+
+    return true;
+}
+
+void blendRect(
+    void *dest, size_t destPitch, const void *src, size_t srcPitch,
+    size_t width, size_t height)
+{
+    const PixelKernels &k = kernelsFor(width * height);
+    VectorStateGuard guard(k);
+
+    uint8_t *d = reinterpret_cast<uint8_t *>(dest);
+    const uint8_t *s = reinterpret_cast<const uint8_t *>(src);
+    for (size_t y = 0; y < height; ++y, d += destPitch, s += srcPitch)
+        k.blendArgb8888(
+            reinterpret_cast<uint32_t *>(d),
+            reinterpret_cast<const uint32_t *>(s), width);
+}
+}  // namespace Graphics
@@ -88,7 +88,9 @@ Elf::Elf()
       m_nDynamicSymbolTableSize(0), m_pDynamicStringTable(0),
       m_nDynamicStringTableSize(0), m_pSectionHeaders(0), m_nSectionHeaders(0),
       m_pProgramHeaders(0), m_nProgramHeaders(0), m_nPltSize(0), m_nEntry(0),
-      m_NeededLibraries(), m_SymbolTable(this), m_InitFunc(0), m_FiniFunc(0)
+      m_NeededLibraries(), m_SymbolTable(this), m_InitFunc(0), m_FiniFunc(0),
+      m_AddressIndex(), m_pAddressIndexTable(0),
+      m_AddressIndexState(AddressIndexNone)
 {
 }
 
@@ -125,7 +127,9 @@ Elf::Elf(const Elf &elf)
       m_pProgramHeaders(0), m_nProgramHeaders(elf.m_nProgramHeaders),
       m_nPltSize(elf.m_nPltSize), m_nEntry(elf.m_nEntry),
       m_NeededLibraries(elf.m_NeededLibraries), m_SymbolTable(this),
-      m_InitFunc(elf.m_InitFunc), m_FiniFunc(elf.m_FiniFunc)
+      m_InitFunc(elf.m_InitFunc), m_FiniFunc(elf.m_FiniFunc),
+      m_AddressIndex(), m_pAddressIndexTable(0),
+      m_AddressIndexState(AddressIndexNone)
 {
     // Copy the symbol table
     m_pSymbolTable = copy(elf.m_pSymbolTable, m_nSymbolTableSize);
@@ -1211,6 +1215,12 @@ Elf::lookupSymbol(uintptr_t addr, uintptr_t *startAddr, T *symbolTable)
         return 0;  // Just return null if we haven't got the needed tables.
     }
 
+    if (buildAddressIndex(symbolTable))
+    {
+        return m_AddressIndex.lookup(addr, startAddr);
+    }
+
+    // No index (yet) - scan the table. Slow, but safe from any context.
     T *pSymbol = symbolTable;
 
     const char *pStrtab = reinterpret_cast<const char *>(m_pStringTable);
@@ -1256,6 +1266,68 @@ Elf::lookupSymbol(uintptr_t addr, uintptr_t *startAddr, T *symbolTable)
     return 0;
 }
 
+void Elf::buildAddressIndex()
+{
+    if (m_pSymbolTable && m_pStringTable)
+    {
+        buildAddressIndex(m_pSymbolTable);
+    }
+}
+
+template <class T>
+bool Elf::buildAddressIndex(T *symbolTable)
+{
+    int state = __atomic_load_n(&m_AddressIndexState, __ATOMIC_ACQUIRE);
+    if (state == AddressIndexReady)
+    {
+        return m_pAddressIndexTable == symbolTable;
+    }
+    else if (state == AddressIndexBuilding)
+    {
+        // Someone else is building it, don't wait for them (we might be in
+        // a backtrace for the CPU doing so).
+        return false;
+    }
+
+    int expected = AddressIndexNone;
+    if (!__atomic_compare_exchange_n(
+            &m_AddressIndexState, &expected, AddressIndexBuilding, false,
+            __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+    {
+        return false;
+    }
+
+    const char *pStrtab = reinterpret_cast<const char *>(m_pStringTable);
+
+    // Same filtering as the linear scan in lookupSymbol.
+    T *pSymbol = symbolTable;
+    for (size_t i = 0; i < m_nSymbolTableSize / sizeof(T); i++, pSymbol++)
+    {
+        if (ST_TYPE(pSymbol->info) != STT_FUNC &&
+            ST_TYPE(pSymbol->info) != STT_NOTYPE)
+        {
+            continue;
+        }
+
+        if (ST_BIND(pSymbol->info) != STB_GLOBAL)
+        {
+            continue;
+        }
+
+        Elf_Xword size = pSymbol->size;
+        if (size == 0)
+            size = 0x100;
+
+        m_AddressIndex.insert(pSymbol->value, size, pStrtab + pSymbol->name);
+    }
+
+    m_AddressIndex.finalise();
+    m_pAddressIndexTable = symbolTable;
+
+    __atomic_store_n(&m_AddressIndexState, AddressIndexReady, __ATOMIC_RELEASE);
+    return true;
+}
+
 uintptr_t Elf::lookupSymbol(const char *pName)
 {
     return m_SymbolTable.lookup(String(pName), this);
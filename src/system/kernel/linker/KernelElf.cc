@@ -27,6 +27,7 @@
 #include "pedigree/kernel/processor/Processor.h"
 #include "pedigree/kernel/processor/ProcessorInformation.h"
 #include "pedigree/kernel/processor/VirtualAddressSpace.h"
+#include "pedigree/kernel/time/Time.h"
 #include "pedigree/kernel/utilities/MemoryTracing.h"
 #include "pedigree/kernel/utilities/MemoryCount.h"
 #include "pedigree/kernel/utilities/String.h"
@@ -37,8 +38,9 @@ KernelElf KernelElf::m_Instance;
 // Define to dump each module's dependencies in the serial log.
 #define DUMP_DEPENDENCIES 1
 
-// Define to 1 to load modules using threads.
-#define THREADED_MODULE_LOADING 0
+// Define to 1 to load modules using threads. Independent modules then run
+// concurrently, which only pays off if there's more than one CPU.
+#define THREADED_MODULE_LOADING MULTIPROCESSOR
 
 /**
  * Extend the given pointer by adding its canonical prefix again.
@@ -401,6 +403,13 @@ bool KernelElf::initialise(const BootstrapStruct_t &pBootstrap)
         }
     }
 
+    // Build the reverse lookup index now - backtraces can happen anywhere,
+    // including places that can't allocate.
+    if (m_pSymbolTable && m_pStringTable)
+    {
+        buildAddressIndex(m_pSymbolTable);
+    }
+
     return true;
 }
 
@@ -408,7 +417,10 @@ KernelElf::KernelElf()
     :
       m_AdditionalSectionContents("Kernel ELF Section Data"),
       m_AdditionalSectionHeaders(0),
-      m_Modules(), m_ModuleAllocator(), m_pSectionHeaders(0), m_pSymbolTable(0),
+      m_Modules(), m_ModuleNames(), m_ReadyModules(), m_nRunningModules(0),
+      m_bSilentExecution(false), m_ExecutionStart(0), m_ModuleRanges(),
+      m_ModuleAllocator(), m_pSectionHeaders(0),
+      m_pSymbolTable(0),
       m_ModuleProgress(0), m_ModuleAdjustmentLock(false),
       m_InitModule(nullptr)
 {
@@ -431,6 +443,8 @@ Module *KernelElf::loadModule(uint8_t *pModule, size_t len, bool silent)
 {
     MemoryCount guard(__PRETTY_FUNCTION__);
 
+    Time::Timestamp start = Time::getTicks();
+
     // The module memory allocator requires dynamic memory - this isn't
     // initialised until after our constructor is called, so check here if we've
     // loaded any modules yet. If not, we can initialise our memory allocator.
@@ -464,6 +478,13 @@ Module *KernelElf::loadModule(uint8_t *pModule, size_t len, bool silent)
         return 0;
     }
 
+    module->elf->buildAddressIndex();
+
+    lockModules();
+    m_ModuleRanges.insert(
+        module->loadBase, module->loadBase + module->loadSize, module);
+    unlockModules();
+
     //  Load the module debug table (if any)
     if (module->elf->debugFrameTableLength())
     {
@@ -557,6 +578,8 @@ Module *KernelElf::loadModule(uint8_t *pModule, size_t len, bool silent)
             reinterpret_cast<void *>(module->loadBase + module->loadSize));
     }
 
+    module->preloadTime = Time::getTicks() - start;
+
     if (!StringCompare(module->name.cstr(), "init"))
     {
         m_InitModule = module;
@@ -570,6 +593,12 @@ Module *KernelElf::loadModule(uint8_t *pModule, size_t len, bool silent)
         module->status = Module::Preloaded;
 
         m_Modules.pushBack(module);
+        if (!m_ModuleNames.insert(module->name, module))
+        {
+            WARNING(
+                "KERNELELF: a module named " << module->name
+                                             << " is already loaded");
+        }
     }
 
     return module;
@@ -579,36 +608,172 @@ void KernelElf::executeModules(bool silent, bool progress)
 {
     NOTICE("KERNELELF: executing " << m_Modules.count() << " modules...");
 
-    // keep trying until all modules were invoked
-    bool executedModule = true;
-    while (executedModule)
+    m_bSilentExecution = silent;
+    m_ExecutionStart = Time::getTicks();
+
+    // Resolve every dependency once, up front. From then on each module is
+    // executed exactly once, as soon as the last module it's waiting on has
+    // finished, which walks the dependency graph in topological order.
+    buildDependencyGraph();
+
+    // With threaded module loading this only starts the modules that have no
+    // dependencies; the rest are started as their dependencies finish.
+    dispatchReadyModules();
+}
+
+Module *KernelElf::findModule(const char *name)
+{
+    auto result = m_ModuleNames.lookup(HashedStringView(name));
+    if (!result.hasValue())
+    {
+        return nullptr;
+    }
+
+    return result.value();
+}
+
+void KernelElf::buildDependencyGraph()
+{
+    lockModules();
+
+    for (auto module : m_Modules)
     {
-        executedModule = false;
+        if (!module->isPending() || module->scheduled)
+        {
+            continue;
+        }
 
-        for (auto module : m_Modules)
+        module->scheduled = true;
+
+        // Optional dependencies only need to have finished executing.
+        for (size_t i = 0;
+             module->depends_opt && rebase(module, module->depends_opt)[i]; ++i)
         {
-            if (module->wasAttempted())
+            const char *depname =
+                rebase(module, rebase(module, module->depends_opt)[i]);
+
+            Module *dep = findModule(depname);
+            if (!dep)
             {
+                EMIT_IF(DUMP_DEPENDENCIES)
+                {
+                    WARNING("KernelElf: optional dependency '" << depname << "' (wanted by '" << module->name << "') doesn't even exist, skipping.");
+                }
                 continue;
             }
 
-            bool dependenciesSatisfied = moduleDependenciesSatisfied(module);
-
-            // Can we load this module yet?
-            if (dependenciesSatisfied)
+            if (dep->isPending() || dep->isExecuting())
             {
-                executeModule(module);
+                dep->optionalDependents.pushBack(module);
+                ++module->waitingOn;
+            }
+        }
+
+        // Mandatory dependencies must be active.
+        for (size_t i = 0;
+             module->depends && rebase(module, module->depends)[i]; ++i)
+        {
+            const char *depname =
+                rebase(module, rebase(module, module->depends)[i]);
 
-                g_BootProgressCurrent++;
-                if (g_BootProgressUpdate && !silent)
-                    g_BootProgressUpdate("moduleexec");
+            Module *dep = findModule(depname);
+            if (!dep || dep->isActive())
+            {
+                continue;
+            }
 
-                executedModule = true;
+            if (dep->isPending() || dep->isExecuting())
+            {
+                dep->dependents.pushBack(module);
+                ++module->waitingOn;
+            }
+            else
+            {
+                WARNING(
+                    "KernelElf: dependency '" << depname << "' (wanted by '"
+                                              << module->name
+                                              << "') failed to load.");
+                module->dependencyFailed = true;
             }
         }
+
+        if (!module->waitingOn)
+        {
+            m_ReadyModules.pushBack(module);
+        }
+    }
+
+    unlockModules();
+}
+
+void KernelElf::dispatchReadyModules()
+{
+    while (true)
+    {
+        lockModules();
+        if (!m_ReadyModules.count())
+        {
+            unlockModules();
+            break;
+        }
+
+        Module *module = m_ReadyModules.popFront();
+        ++m_nRunningModules;
+        unlockModules();
+
+        if (module->dependencyFailed)
+        {
+            // The module never ran, so there's nothing to unload.
+            WARNING(
+                "KERNELELF: Module " << module->name
+                                     << " not executed, a dependency failed.");
+
+            lockModules();
+            module->status = Module::Failed;
+            releaseDependents(module);
+            --m_nRunningModules;
+            unlockModules();
+
+            m_ModuleProgress.release();
+            continue;
+        }
+
+        module->status = Module::Executing;
+        executeModule(module);
+
+        g_BootProgressCurrent++;
+        if (g_BootProgressUpdate && !m_bSilentExecution)
+            g_BootProgressUpdate("moduleexec");
     }
 }
 
+void KernelElf::releaseDependents(Module *module)
+{
+    for (auto dependent : module->dependents)
+    {
+        if (!module->isActive())
+        {
+            dependent->dependencyFailed = true;
+        }
+
+        if (!--dependent->waitingOn)
+        {
+            m_ReadyModules.pushBack(dependent);
+        }
+    }
+
+    for (auto dependent : module->optionalDependents)
+    {
+        if (!--dependent->waitingOn)
+        {
+            m_ReadyModules.pushBack(dependent);
+        }
+    }
+
+    module->dependents.clear(true);
+    module->optionalDependents.clear(true);
+}
+
 Module *KernelElf::loadModule(struct ModuleInfo *info, bool silent)
 {
     /// \todo rewrite to the new module dependency logic
@@ -668,6 +833,12 @@ Module *KernelElf::loadModule(struct ModuleInfo *info, bool silent)
         module->status = Module::Preloaded;
 
         m_Modules.pushBack(module);
+        if (!m_ModuleNames.insert(module->name, module))
+        {
+            WARNING(
+                "KERNELELF: a module named " << module->name
+                                             << " is already loaded");
+        }
     }
 
     return module;
@@ -675,14 +846,11 @@ Module *KernelElf::loadModule(struct ModuleInfo *info, bool silent)
 
 void KernelElf::unloadModule(const char *name, bool silent, bool progress)
 {
-    String findName(name);
-    for (auto it : m_Modules)
+    Module *module = findModule(name);
+    if (module)
     {
-        if (it->name == findName)
-        {
-            unloadModule(it, silent, progress);
-            return;
-        }
+        unloadModule(module, silent, progress);
+        return;
     }
     ERROR("KERNELELF: Module " << name << " not found");
 }
@@ -769,6 +937,10 @@ void KernelElf::unloadModule(Module *module, bool silent, bool progress)
         }
 
         m_ModuleAllocator.free(module->loadBase, module->loadSize);
+
+        lockModules();
+        m_ModuleRanges.remove(module->loadBase, module);
+        unlockModules();
     }
 
     delete module->elf;
@@ -798,25 +970,13 @@ void KernelElf::unloadModules()
     }
 
     m_Modules.clear();
+    m_ModuleNames.clear();
 }
 
 bool KernelElf::moduleIsLoaded(char *name)
 {
-    // this should hash the name and make comparisons super fast
-    String compName(name);
-
-    for (auto module : m_Modules)
-    {
-        if (module->isLoaded())
-        {
-            if (module->name == compName)
-            {
-                return true;
-            }
-        }
-    }
-
-    return false;
+    Module *module = findModule(name);
+    return module && module->isLoaded();
 }
 
 char *KernelElf::getDependingModule(char *name)
@@ -859,24 +1019,13 @@ bool KernelElf::moduleDependenciesSatisfied(Module *module)
     {
         while (rebase(module, module->depends_opt)[i])
         {
-            String depname(
-                rebase(module, rebase(module, module->depends_opt)[i]));
-
-            bool exists = false;
-            bool attempted = false;
-            for (auto mod : m_Modules)
-            {
-                if (mod->name == depname)
-                {
-                    exists = true;
-                    attempted = mod->wasAttempted();
-                    break;
-                }
-            }
+            const char *depname =
+                rebase(module, rebase(module, module->depends_opt)[i]);
 
-            if (exists)
+            Module *mod = findModule(depname);
+            if (mod)
             {
-                if (!attempted)
+                if (!mod->wasAttempted())
                 {
                     WARNING("KernelElf: optional dependency '" << depname << "' (wanted by '" << module->name << "') hasn't been tried yet.");
                     // optional dependency hasn't yet been tried
@@ -904,19 +1053,15 @@ bool KernelElf::moduleDependenciesSatisfied(Module *module)
 
     while (rebase(module, module->depends)[i])
     {
-        String depname(rebase(module, rebase(module, module->depends)[i]));
+        const char *depname =
+            rebase(module, rebase(module, module->depends)[i]);
 
-        for (auto mod : m_Modules)
+        Module *mod = findModule(depname);
+        if (mod && !mod->isActive())
         {
-            if (mod->name == depname)
-            {
-                if (!mod->isActive())
-                {
-                    WARNING("KernelElf: dependency '" << depname << "' (wanted by '" << module->name << "') isn't active yet.");
-                    // module dependency is not yet active
-                    return false;
-                }
-            }
+            WARNING("KernelElf: dependency '" << depname << "' (wanted by '" << module->name << "') isn't active yet.");
+            // module dependency is not yet active
+            return false;
         }
 
         ++i;
@@ -929,6 +1074,8 @@ static int executeModuleThread(void *mod)
     Module *module = reinterpret_cast<Module *>(mod);
     module->status = Module::Executing;
 
+    Time::Timestamp start = Time::getTicks();
+
     NOTICE("running module: " << module->name);
 
     if (module->buffer)
@@ -990,6 +1137,8 @@ static int executeModuleThread(void *mod)
         bSuccess = module->entry();
     }
 
+    module->executeTime = Time::getTicks() - start;
+
     KernelElf::instance().updateModuleStatus(module, bSuccess);
 
     return 0;
@@ -1014,35 +1163,85 @@ bool KernelElf::executeModule(Module *module)
 
 void KernelElf::updateModuleStatus(Module *module, bool status)
 {
-    String moduleName(module->name);
     if (status)
     {
-        NOTICE("KERNELELF: Module " << moduleName << " finished executing");
-        module->status = Module::Active;
+        NOTICE(
+            "KERNELELF: Module " << module->name << " finished executing in "
+                                 << Dec
+                                 << (module->executeTime /
+                                     Time::Multiplier::Microsecond)
+                                 << "us");
     }
     else
     {
-        NOTICE("KERNELELF: Module " << moduleName << " failed, unloading.");
-        module->status = Module::Failed;
-        unloadModule(moduleName.cstr(), true, false);
+        NOTICE("KERNELELF: Module " << module->name << " failed, unloading.");
     }
 
+    lockModules();
+    module->status = status ? Module::Active : Module::Failed;
+    unlockModules();
+
+    // A failed module must be gone before anything waiting on it is released,
+    // or an optional dependent could start and resolve symbols against it
+    // while they're being freed.
+    if (!status)
+    {
+        unloadModule(module, true, false);
+    }
+
+    lockModules();
+    releaseDependents(module);
+    unlockModules();
+
+    EMIT_IF(THREADS && THREADED_MODULE_LOADING)
+    {
+        // Start anything that was only waiting on this module.
+        dispatchReadyModules();
+    }
+
+    lockModules();
+    --m_nRunningModules;
+    unlockModules();
+
     m_ModuleProgress.release();
 }
 
 void KernelElf::waitForModulesToLoad()
 {
-    for (size_t i = 0; i < m_Modules.count(); ++i)
+    // Each finished module releases the semaphore once; keep waiting until
+    // nothing is left running or waiting to be dispatched.
+    while (true)
     {
+        lockModules();
+        bool bDone = !m_nRunningModules && !m_ReadyModules.count();
+        unlockModules();
+
+        if (bDone)
+        {
+            break;
+        }
+
         m_ModuleProgress.acquire();
     }
 
+    NOTICE(
+        "KERNELELF: modules finished executing in "
+        << Dec
+        << ((Time::getTicks() - m_ExecutionStart) /
+            Time::Multiplier::Millisecond)
+        << "ms");
+
     NOTICE("SUCCESSFUL MODULES:");
     for (auto it : m_Modules)
     {
         if (it->isActive())
         {
-            NOTICE(" - " << it->name);
+            NOTICE(
+                " - " << it->name << " (load " << Dec
+                      << (it->preloadTime / Time::Multiplier::Microsecond)
+                      << "us, execute "
+                      << (it->executeTime / Time::Multiplier::Microsecond)
+                      << "us)");
         }
     }
 
@@ -1067,11 +1266,22 @@ void KernelElf::invokeInitModule()
     Module *mod = m_InitModule;
     m_InitModule = nullptr;
 
+    NOTICE(
+        "KERNELELF: invoking init "
+        << Dec << (Time::getTicks() / Time::Multiplier::Millisecond)
+        << "ms after boot");
+
     if (!moduleDependenciesSatisfied(mod))
     {
         FATAL("init module could not be invoked - its dependencies were not satisfied");
     }
 
+    // Counted like any dispatched module, as updateModuleStatus will
+    // uncount it once it finishes.
+    lockModules();
+    ++m_nRunningModules;
+    unlockModules();
+
     executeModuleThread(reinterpret_cast<void *>(mod));
 }
 
@@ -1091,25 +1301,19 @@ const char *KernelElf::globalLookupSymbol(uintptr_t addr, uintptr_t *startAddr)
         return ret;
     }
 
-    // OK, that didn't work. Try every module.
+    // OK, that didn't work. Find the module containing the address.
+    Module *module = nullptr;
     lockModules();
-    for (auto it : m_Modules)
-    {
-        if (!(it->isActive() || it->isExecuting()))
-        {
-            continue;
-        }
-
-        unlockModules();
+    bool bFound = m_ModuleRanges.lookup(addr, module);
+    unlockModules();
 
-        if ((ret = it->elf->lookupSymbol(addr, startAddr)))
+    if (bFound && (module->isActive() || module->isExecuting()))
+    {
+        if ((ret = module->elf->lookupSymbol(addr, startAddr)))
         {
             return ret;
         }
-
-        lockModules();
     }
-    unlockModules();
     WARNING_NOLOCK(
         "KERNELELF: GlobalLookupSymbol(" << Hex << addr << ") failed.");
     return 0;
@@ -1123,6 +1327,7 @@ bool KernelElf::hasPendingModules() const
         if (it->isPending())
         {
             NOTICE("Pending module: " << it->name);
+            hasPending = true;
         }
     }
     return hasPending;
@@ -0,0 +1,174 @@
+/*
+ * Copyright (c) 2008-2014, Pedigree Developers
+ *
+ * Please see the CONTRIB file in the root of the source tree for a full
+ * list of contributors.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+#include "pedigree/kernel/linker/SymbolAddressIndex.h"
+
+SymbolAddressIndex::SymbolAddressIndex() : m_Entries(), m_bFinalised(false)
+{
+}
+
+SymbolAddressIndex::~SymbolAddressIndex() = default;
+
+void SymbolAddressIndex::insert(uintptr_t start, size_t size, const char *name)
+{
+    Entry entry;
+    entry.start = start;
+    entry.end = start + size;
+    entry.maxEnd = entry.end;
+    entry.name = name;
+    entry.order = m_Entries.count();
+
+    m_Entries.pushBack(entry);
+    m_bFinalised = false;
+}
+
+bool SymbolAddressIndex::before(const Entry &a, const Entry &b)
+{
+    if (a.start != b.start)
+    {
+        return a.start < b.start;
+    }
+
+    return a.order < b.order;
+}
+
+void SymbolAddressIndex::siftDown(size_t root, size_t count)
+{
+    while (true)
+    {
+        size_t child = (root * 2) + 1;
+        if (child >= count)
+        {
+            break;
+        }
+
+        if ((child + 1) < count &&
+            before(m_Entries[child], m_Entries[child + 1]))
+        {
+            ++child;
+        }
+
+        if (!before(m_Entries[root], m_Entries[child]))
+        {
+            break;
+        }
+
+        m_Entries.swap(m_Entries.begin() + root, m_Entries.begin() + child);
+        root = child;
+    }
+}
+
+void SymbolAddressIndex::finalise()
+{
+    size_t count = m_Entries.count();
+
+    // Heapsort, as it needs no extra memory.
+    for (size_t i = count / 2; i > 0; --i)
+    {
+        siftDown(i - 1, count);
+    }
+    for (size_t end = count; end > 1; --end)
+    {
+        m_Entries.swap(m_Entries.begin(), m_Entries.begin() + (end - 1));
+        siftDown(0, end - 1);
+    }
+
+    uintptr_t maxEnd = 0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        Entry &entry = m_Entries[i];
+        if (entry.end > maxEnd)
+        {
+            maxEnd = entry.end;
+        }
+        entry.maxEnd = maxEnd;
+    }
+
+    m_bFinalised = true;
+}
+
+const char *
+SymbolAddressIndex::lookup(uintptr_t addr, uintptr_t *startAddr) const
+{
+    if (!m_bFinalised || !m_Entries.count())
+    {
+        return 0;
+    }
+
+    // Find the first entry starting after the address.
+    size_t lo = 0, hi = m_Entries.count();
+    while (lo < hi)
+    {
+        size_t mid = lo + ((hi - lo) / 2);
+        if (m_Entries[mid].start <= addr)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+
+    // Walk back to the nearest entry that contains the address. maxEnd lets
+    // us stop as soon as nothing further back could.
+    const Entry *pFound = 0;
+    for (size_t i = lo; i > 0; --i)
+    {
+        const Entry &entry = m_Entries[i - 1];
+        if (entry.maxEnd <= addr)
+        {
+            break;
+        }
+
+        if (pFound && entry.start != pFound->start)
+        {
+            break;
+        }
+
+        if (addr < entry.end)
+        {
+            pFound = &entry;
+        }
+    }
+
+    if (!pFound)
+    {
+        return 0;
+    }
+
+    if (startAddr)
+    {
+        *startAddr = pFound->start;
+    }
+
+    return pFound->name;
+}
+
+size_t SymbolAddressIndex::count() const
+{
+    return m_Entries.count();
+}
+
+void SymbolAddressIndex::clear()
+{
+    m_Entries.clear();
+    m_bFinalised = false;
+}
@@ -19,6 +19,7 @@
 
 #include "pedigree/kernel/machine/Framebuffer.h"
 #include "pedigree/kernel/Log.h"
+#include "pedigree/kernel/graphics/PixelKernels.h"
 #include "pedigree/kernel/processor/MemoryRegion.h"
 #include "pedigree/kernel/processor/PhysicalMemoryManager.h"
 #include "pedigree/kernel/processor/VirtualAddressSpace.h"
@@ -343,6 +344,14 @@ Graphics::Buffer *Framebuffer::swCreateBuffer(
         // the actual depth is 24 bits).
         MemoryCopy(pAddress, srcData, fullBufferSize);
     }
+    else if (
+        (Graphics::bytesPerPixel(destFormat) == destBytesPerPixel) &&
+        Graphics::convertRect(
+            pAddress, destBytesPerLine, destFormat, srcData,
+            sourceBytesPerLine, srcFormat, width, height))
+    {
+        // Converted by one of the pixel kernels.
+    }
     else
     {
         // Have to convert and pack each pixel, much slower than memcpy.
@@ -483,19 +492,18 @@ void Framebuffer::swBlit(
     else
     {
         // Line-by-line copy
-        for (size_t y1 = desty, y2 = srcy; y1 < (desty + height); y1++, y2++)
-        {
-            size_t sourceBufferOffset =
-                (y2 * sourceBytesPerLine) + (srcx * sourceBytesPerPixel);
-            size_t frameBufferOffset =
-                (y1 * bytesPerLine) + (destx * destBytesPerPixel);
+        size_t sourceBufferOffset =
+            (srcy * sourceBytesPerLine) + (srcx * sourceBytesPerPixel);
+        size_t frameBufferOffset =
+            (desty * bytesPerLine) + (destx * destBytesPerPixel);
 
-            void *dest =
-                reinterpret_cast<void *>(m_FramebufferBase + frameBufferOffset);
-            void *src = adjust_pointer(pSrc, sourceBufferOffset);
+        void *dest =
+            reinterpret_cast<void *>(m_FramebufferBase + frameBufferOffset);
+        void *src = adjust_pointer(pSrc, sourceBufferOffset);
 
-            MemoryCopy(dest, src, width * destBytesPerPixel);
-        }
+        Graphics::blitRect(
+            dest, bytesPerLine, src, sourceBytesPerLine,
+            width * destBytesPerPixel, height);
     }
 }
 
@@ -533,112 +541,36 @@ void Framebuffer::swRect(
     size_t bytesPerPixel = m_nBytesPerPixel;
     size_t bytesPerLine = m_nBytesPerLine;
 
-    // Can we just do an easy memset?
-    if (UNLIKELY((!x) && (width == m_nWidth)))
-    {
-        size_t frameBufferOffset = (y * bytesPerLine) + (x * bytesPerPixel);
+    size_t frameBufferOffset = (y * bytesPerLine) + (x * bytesPerPixel);
+    void *dest =
+        reinterpret_cast<void *>(m_FramebufferBase + frameBufferOffset);
 
-        void *dest =
-            reinterpret_cast<void *>(m_FramebufferBase + frameBufferOffset);
+    // 16- and 32-bit fills are handled by the pixel kernels.
+    if (Graphics::fillRect(
+            dest, bytesPerLine, bytesPerPixel, transformColour, width, height))
+        return;
 
-        size_t copySize = (bytesPerLine * height);
-        if (bytesPerPixel == 4)  /// \todo Handle 24-bit properly
-        {
-            if ((copySize % 8) == 0)  // QWORD boundary
-            {
-                uint64_t val = (static_cast<uint64_t>(transformColour) << 32) |
-                               transformColour;
-                QuadWordSet(dest, val, copySize / 8);
-            }
-            else
-                DoubleWordSet(dest, transformColour, copySize / 4);
-        }
-        else if (bytesPerPixel == 3)
+    // Line-by-line fill
+    for (size_t desty = y; desty < (y + height); desty++)
+    {
+        frameBufferOffset = (desty * bytesPerLine) + (x * bytesPerPixel);
+
+        if (bytesPerPixel == 3)
         {
-            // 24-bit has to set three bytes at a time and leave the top byte
-            // untouched. Painful.
-            for (size_t i = 0; i < (copySize / 3); i++)
+            // 24-bit has to set three bytes at a time and leave the top
+            // byte untouched. Painful.
+            for (size_t i = 0; i < width; i++)
             {
                 uint32_t *p = reinterpret_cast<uint32_t *>(
                     m_FramebufferBase + frameBufferOffset + (i * 3));
                 *p = (*p & 0xFF000000) | transformColour;
             }
         }
-        else if (bytesPerPixel == 2)
-        {
-            if ((copySize % 8) == 0)  // QWORD boundary
-            {
-                uint64_t val = (static_cast<uint64_t>(transformColour) << 48) |
-                               (static_cast<uint64_t>(transformColour) << 32) |
-                               (transformColour << 16) | transformColour;
-                QuadWordSet(dest, val, copySize / 8);
-            }
-            else if ((copySize % 4) == 0)  // DWORD boundary
-            {
-                uint32_t val = (transformColour << 16) | transformColour;
-                DoubleWordSet(dest, val, copySize / 4);
-            }
-            else
-                WordSet(dest, transformColour, copySize / 2);
-        }
         else
-            ByteSet(dest, transformColour, (bytesPerLine * height));
-    }
-    else
-    {
-        // Line-by-line fill
-        for (size_t desty = y; desty < (y + height); desty++)
         {
-            size_t frameBufferOffset =
-                (desty * bytesPerLine) + (x * bytesPerPixel);
-
-            void *dest =
+            dest =
                 reinterpret_cast<void *>(m_FramebufferBase + frameBufferOffset);
-
-            size_t copySize = width * bytesPerPixel;
-            if (bytesPerPixel == 4)  /// \todo Handle 24-bit properly
-            {
-                if ((copySize % 8) == 0)  // QWORD boundary
-                {
-                    uint64_t val =
-                        (static_cast<uint64_t>(transformColour) << 32) |
-                        transformColour;
-                    QuadWordSet(dest, val, copySize / 8);
-                }
-                else
-                    DoubleWordSet(dest, transformColour, copySize / 4);
-            }
-            else if (bytesPerPixel == 3)
-            {
-                // 24-bit has to set three bytes at a time and leave the top
-                // byte untouched. Painful.
-                for (size_t i = 0; i < (copySize / 3); i++)
-                {
-                    uint32_t *p = reinterpret_cast<uint32_t *>(
-                        m_FramebufferBase + frameBufferOffset + (i * 3));
-                    *p = (*p & 0xFF000000) | transformColour;
-                }
-            }
-            else if (bytesPerPixel == 2)
-            {
-                if ((copySize % 8) == 0)  // QWORD boundary
-                {
-                    uint64_t val =
-                        (static_cast<uint64_t>(transformColour) << 48) |
-                        (static_cast<uint64_t>(transformColour) << 32) |
-                        (transformColour << 16) | transformColour;
-                    QuadWordSet(dest, val, copySize / 8);
-                }
-                else if ((copySize % 4) == 0)  // DWORD boundary
-                {
-                    uint32_t val = (transformColour << 16) | transformColour;
-                    DoubleWordSet(dest, val, copySize / 4);
-                }
-                else
-                    WordSet(dest, transformColour, copySize / 2);
-            }
-            else
-                ByteSet(dest, transformColour, (width * bytesPerPixel));
+            ByteSet(dest, transformColour, (width * bytesPerPixel));
         }
     }
 }
@@ -0,0 +1,204 @@
+/*
+ * Copyright (c) 2008-2014, Pedigree Developers
+ *
+ * Please see the CONTRIB file in the root of the source tree for a full
+ * list of contributors.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+#include "pedigree/kernel/machine/hosted/HostDiskImage.h"
+
+namespace __pedigree_hosted
+{
+};
+using namespace __pedigree_hosted;
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+const size_t HostDiskImage::DefaultBlockSize;
+
+int HostDiskImage::m_Fd = -1;
+void *HostDiskImage::m_pMapping = 0;
+uint64_t HostDiskImage::m_Size = 0;
+size_t HostDiskImage::m_BlockSize = HostDiskImage::DefaultBlockSize;
+bool HostDiskImage::m_bReadOnly = false;
+
+bool HostDiskImage::open(const char *path, size_t blockSize)
+{
+    if (!blockSize)
+    {
+        blockSize = DefaultBlockSize;
+    }
+
+    if ((blockSize < 0x1000) || (blockSize & (blockSize - 1)))
+    {
+        errno = EINVAL;
+        return false;
+    }
+
+    bool readOnly = false;
+    int fd = ::open(path, O_RDWR);
+    if ((fd < 0) && ((errno == EACCES) || (errno == EROFS)))
+    {
+        fd = ::open(path, O_RDONLY);
+        readOnly = true;
+    }
+
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    // lseek rather than fstat so block devices report a usable size too.
+    off_t size = ::lseek(fd, 0, SEEK_END);
+    if (size <= 0)
+    {
+        int e = size ? errno : EINVAL;
+        ::close(fd);
+        errno = e;
+        return false;
+    }
+
+    // Blocks are copied between this mapping and the disk driver's Cache
+    // pages, which saves a system call per block. If the host won't map the
+    // image we fall back to pread/pwrite.
+    int flags = readOnly ? (MAP_PRIVATE | MAP_NORESERVE) : MAP_SHARED;
+    void *mapping = ::mmap(0, size, PROT_READ | PROT_WRITE, flags, fd, 0);
+    if (mapping == MAP_FAILED)
+    {
+        mapping = 0;
+    }
+
+    m_Fd = fd;
+    m_pMapping = mapping;
+    m_Size = size;
+    m_BlockSize = blockSize;
+    m_bReadOnly = readOnly;
+    return true;
+}
+
+void HostDiskImage::close()
+{
+    if (m_pMapping)
+    {
+        ::munmap(m_pMapping, m_Size);
+        m_pMapping = 0;
+    }
+
+    if (m_Fd >= 0)
+    {
+        ::close(m_Fd);
+        m_Fd = -1;
+    }
+
+    m_Size = 0;
+}
+
+size_t HostDiskImage::read(uint64_t location, void *buffer, size_t length)
+{
+    if ((m_Fd < 0) || (location >= m_Size))
+    {
+        return 0;
+    }
+
+    if (length > (m_Size - location))
+    {
+        length = m_Size - location;
+    }
+
+    size_t total = 0;
+    uint8_t *p = reinterpret_cast<uint8_t *>(buffer);
+    while (total < length)
+    {
+        ssize_t n = ::pread(m_Fd, p + total, length - total, location + total);
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        else if (n <= 0)
+        {
+            break;
+        }
+
+        total += n;
+    }
+
+    return total;
+}
+
+size_t
+HostDiskImage::write(uint64_t location, const void *buffer, size_t length)
+{
+    if ((m_Fd < 0) || m_bReadOnly || (location >= m_Size))
+    {
+        return 0;
+    }
+
+    if (length > (m_Size - location))
+    {
+        length = m_Size - location;
+    }
+
+    size_t total = 0;
+    const uint8_t *p = reinterpret_cast<const uint8_t *>(buffer);
+    while (total < length)
+    {
+        ssize_t n =
+            ::pwrite(m_Fd, p + total, length - total, location + total);
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        else if (n <= 0)
+        {
+            break;
+        }
+
+        total += n;
+    }
+
+    return total;
+}
+
+bool HostDiskImage::sync(uint64_t location, size_t length)
+{
+    if ((m_Fd < 0) || m_bReadOnly)
+    {
+        return false;
+    }
+
+    if (m_pMapping && (location < m_Size))
+    {
+        // msync wants a page-aligned start; block sizes are always at least
+        // a page so aligning to the block is enough.
+        uint64_t end = location + length;
+        if (end > m_Size)
+        {
+            end = m_Size;
+        }
+        location &= ~static_cast<uint64_t>(m_BlockSize - 1);
+
+        void *p = reinterpret_cast<uint8_t *>(m_pMapping) + location;
+        if (::msync(p, end - location, MS_SYNC) != 0)
+        {
+            return false;
+        }
+    }
+
+    return ::fsync(m_Fd) == 0;
+}
@@ -0,0 +1,392 @@
+/*
+ * Copyright (c) 2008-2014, Pedigree Developers
+ *
+ * Please see the CONTRIB file in the root of the source tree for a full
+ * list of contributors.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "pedigree/kernel/network/Checksum.h"
+#include "pedigree/kernel/utilities/utility.h"
+
+// As with the pixel kernels, vector code is built with per-function target
+// attributes so the rest of the kernel can keep building with -mno-sse.
+#ifdef TARGET_IS_X86
+#define CHECKSUM_X86 1
+#define TARGET_SSE2 __attribute__((target("sse2")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define CHECKSUM_X86 0
+#endif
+
+// The kernel does not preserve vector registers when it is entered, so the
+// vector kernels need the interrupted thread's state saved around them.
+#if CHECKSUM_X86 && !(HOSTED || UTILITY_LINUX)
+#define CHECKSUM_SAVE_STATE 1
+#else
+#define CHECKSUM_SAVE_STATE 0
+#endif
+
+/// Below this many bytes, saving vector state costs more than it saves. A
+/// full Ethernet frame is well under this, so the kernel's packet path runs
+/// the scalar kernel.
+#define VECTOR_STATE_THRESHOLD 4096
+
+typedef uint64_t unaligned_u64 __attribute__((aligned(1), may_alias));
+typedef uint32_t unaligned_u32 __attribute__((aligned(1), may_alias));
+typedef uint16_t unaligned_u16 __attribute__((aligned(1), may_alias));
+
+/// Folds a 64-bit ones' complement sum down to 16 bits.
+static ALWAYS_INLINE inline uint16_t fold(uint64_t sum)
+{
+    sum = (sum & 0xFFFFFFFFULL) + (sum >> 32);
+    sum = (sum & 0xFFFFFFFFULL) + (sum >> 32);
+    sum = (sum & 0xFFFF) + (sum >> 16);
+    sum = (sum & 0xFFFF) + (sum >> 16);
+    return static_cast<uint16_t>(sum);
+}
+
+/// Ones' complement addition: the carry out of the top wraps around.
+static ALWAYS_INLINE inline uint64_t addWithCarry(uint64_t sum, uint64_t v)
+{
+    sum += v;
+    return sum + (sum < v);
+}
+
+/// Sums (and optionally copies) whatever is left after the wide loops. The
+/// caller guarantees \p s is an even number of bytes into the buffer.
+template <bool Copy>
+static ALWAYS_INLINE inline uint64_t
+sumTail(uint8_t *d, const uint8_t *s, size_t n, uint64_t sum)
+{
+    for (; n >= 4; n -= 4, s += 4, d += 4)
+    {
+        uint32_t w = *reinterpret_cast<const unaligned_u32 *>(s);
+        if (Copy)
+            *reinterpret_cast<unaligned_u32 *>(d) = w;
+        sum += w;
+    }
+    if (n >= 2)
+    {
+        uint16_t w = *reinterpret_cast<const unaligned_u16 *>(s);
+        if (Copy)
+            *reinterpret_cast<unaligned_u16 *>(d) = w;
+        sum += w;
+        s += 2;
+        d += 2;
+        n -= 2;
+    }
+    if (n)
+    {
+        // A trailing byte is the first byte of a zero-padded word.
+        uint16_t w = 0;
+        *reinterpret_cast<uint8_t *>(&w) = *s;
+        if (Copy)
+            *d = *s;
+        sum += w;
+    }
+
+    return sum;
+}
+
+template <bool Copy>
+static ALWAYS_INLINE inline uint16_t
+scalarChecksum(void *dest, const void *src, size_t n)
+{
+    uint8_t *d = reinterpret_cast<uint8_t *>(dest);
+    const uint8_t *s = reinterpret_cast<const uint8_t *>(src);
+
+    // Two independent accumulators keep the carry chains apart.
+    uint64_t sumA = 0, sumB = 0;
+    for (; n >= 32; n -= 32, s += 32, d += 32)
+    {
+        const unaligned_u64 *in = reinterpret_cast<const unaligned_u64 *>(s);
+        uint64_t a = in[0], b = in[1], c = in[2], e = in[3];
+        if (Copy)
+        {
+            unaligned_u64 *out = reinterpret_cast<unaligned_u64 *>(d);
+            out[0] = a;
+            out[1] = b;
+            out[2] = c;
+            out[3] = e;
+        }
+        sumA = addWithCarry(sumA, a);
+        sumB = addWithCarry(sumB, b);
+        sumA = addWithCarry(sumA, c);
+        sumB = addWithCarry(sumB, e);
+    }
+    for (; n >= 8; n -= 8, s += 8, d += 8)
+    {
+        uint64_t a = *reinterpret_cast<const unaligned_u64 *>(s);
+        if (Copy)
+            *reinterpret_cast<unaligned_u64 *>(d) = a;
+        sumA = addWithCarry(sumA, a);
+    }
+
+    // Fold each accumulator first, so the tail can't overflow them.
+    uint64_t sum = static_cast<uint64_t>(fold(sumA)) + fold(sumB);
+    return fold(sumTail<Copy>(d, s, n, sum));
+}
+
+static uint16_t scalarSum(const void *buffer, size_t n)
+{
+    return scalarChecksum<false>(0, buffer, n);
+}
+
+static uint16_t scalarCopyAndSum(void *dest, const void *src, size_t n)
+{
+    return scalarChecksum<true>(dest, src, n);
+}
+
+static const ChecksumKernels g_ScalarKernels = {
+    ChecksumScalar,
+    "scalar",
+    scalarSum,
+    scalarCopyAndSum,
+};
+
+#if CHECKSUM_X86
+
+/// Iterations of the unrolled vector loop before the 32-bit lane sums have
+/// to be flushed; each iteration adds at most 4 * 0x1FFFE to a lane.
+#define VECTOR_FLUSH_INTERVAL 4096
+
+/// Vector types for one register width; the unaligned variant is how we
+/// load and store without requiring the caller to align anything.
+template <size_t Bytes>
+struct Vector
+{
+    typedef uint32_t u32 __attribute__((vector_size(Bytes)));
+    typedef uint32_t u32u
+        __attribute__((vector_size(Bytes), aligned(1), may_alias));
+
+    static const size_t lanes32 = Bytes / 4;
+};
+
+// These templates are only ever inlined into functions carrying a target
+// attribute; that is what makes the vector types map onto real registers.
+
+template <size_t Bytes, bool Copy>
+static ALWAYS_INLINE inline uint16_t
+vectorChecksum(void *dest, const void *src, size_t n)
+{
+    typedef typename Vector<Bytes>::u32 V;
+    typedef typename Vector<Bytes>::u32u VU;
+    const size_t lanes = Vector<Bytes>::lanes32;
+
+    uint8_t *d = reinterpret_cast<uint8_t *>(dest);
+    const uint8_t *s = reinterpret_cast<const uint8_t *>(src);
+
+    // Each 32-bit lane is split into its two 16-bit words, which are summed
+    // into 32-bit accumulators and folded into a 64-bit total now and then.
+    uint64_t sum = 0;
+    while (n >= Bytes * 4)
+    {
+        V acc = V{};
+        for (size_t i = 0; (i < VECTOR_FLUSH_INTERVAL) && (n >= Bytes * 4);
+             ++i, n -= Bytes * 4, s += Bytes * 4, d += Bytes * 4)
+        {
+            const VU *in = reinterpret_cast<const VU *>(s);
+            V a = in[0], b = in[1], c = in[2], e = in[3];
+            if (Copy)
+            {
+                VU *out = reinterpret_cast<VU *>(d);
+                out[0] = a;
+                out[1] = b;
+                out[2] = c;
+                out[3] = e;
+            }
+            acc += (a & 0xFFFF) + (a >> 16);
+            acc += (b & 0xFFFF) + (b >> 16);
+            acc += (c & 0xFFFF) + (c >> 16);
+            acc += (e & 0xFFFF) + (e >> 16);
+        }
+
+        for (size_t l = 0; l < lanes; ++l)
+            sum += acc[l];
+    }
+
+    for (; n >= Bytes; n -= Bytes, s += Bytes, d += Bytes)
+    {
+        V a = *reinterpret_cast<const VU *>(s);
+        if (Copy)
+            *reinterpret_cast<VU *>(d) = a;
+        V words = (a & 0xFFFF) + (a >> 16);
+        for (size_t l = 0; l < lanes; ++l)
+            sum += words[l];
+    }
+
+    return fold(sumTail<Copy>(d, s, n, sum));
+}
+
+static TARGET_SSE2 uint16_t sse2Sum(const void *buffer, size_t n)
+{
+    return vectorChecksum<16, false>(0, buffer, n);
+}
+
+static TARGET_SSE2 uint16_t
+sse2CopyAndSum(void *dest, const void *src, size_t n)
+{
+    return vectorChecksum<16, true>(dest, src, n);
+}
+
+static TARGET_AVX2 uint16_t avx2Sum(const void *buffer, size_t n)
+{
+    return vectorChecksum<32, false>(0, buffer, n);
+}
+
+static TARGET_AVX2 uint16_t
+avx2CopyAndSum(void *dest, const void *src, size_t n)
+{
+    return vectorChecksum<32, true>(dest, src, n);
+}
+
+static const ChecksumKernels g_Sse2Kernels = {
+    ChecksumSse2,
+    "sse2",
+    sse2Sum,
+    sse2CopyAndSum,
+};
+
+static const ChecksumKernels g_Avx2Kernels = {
+    ChecksumAvx2,
+    "avx2",
+    avx2Sum,
+    avx2CopyAndSum,
+};
+
+static void
+cpuid(uint32_t leaf, uint32_t &eax, uint32_t &ebx, uint32_t &ecx, uint32_t &edx)
+{
+    asm volatile("cpuid"
+                 : "=a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx)
+                 : "a"(leaf), "c"(0));
+}
+
+static bool cpuHasSse2()
+{
+    uint32_t eax, ebx, ecx, edx;
+    cpuid(1, eax, ebx, ecx, edx);
+    return edx & (1 << 26);
+}
+
+static bool cpuHasAvx2()
+{
+    uint32_t eax, ebx, ecx, edx;
+    cpuid(0, eax, ebx, ecx, edx);
+    if (eax < 7)
+        return false;
+
+    // Needs OSXSAVE and the OS saving SSE and AVX state; see PixelKernels.
+    cpuid(1, eax, ebx, ecx, edx);
+    if ((ecx & ((1 << 27) | (1 << 28))) != ((1 << 27) | (1 << 28)))
+        return false;
+
+    uint32_t xcr0Low, xcr0High;
+    asm volatile("xgetbv" : "=a"(xcr0Low), "=d"(xcr0High) : "c"(0));
+    if ((xcr0Low & 0x6) != 0x6)
+        return false;
+
+    cpuid(7, eax, ebx, ecx, edx);
+    return ebx & (1 << 5);
+}
+
+#endif  // CHECKSUM_X86
+
+const ChecksumKernels *checksumKernels(ChecksumVariant variant)
+{
+    switch (variant)
+    {
+        case ChecksumScalar:
+            return &g_ScalarKernels;
+#if CHECKSUM_X86
+        case ChecksumSse2:
+            return cpuHasSse2() ? &g_Sse2Kernels : 0;
+        case ChecksumAvx2:
+            return cpuHasAvx2() ? &g_Avx2Kernels : 0;
+#endif
+        default:
+            return 0;
+    }
+}
+
+const ChecksumKernels &checksumKernels()
+{
+    // Racing here is harmless: every caller will pick the same kernels.
+    static const ChecksumKernels *s_pBest = 0;
+    if (UNLIKELY(!s_pBest))
+    {
+        const ChecksumKernels *pBest = &g_ScalarKernels;
+        for (size_t i = ChecksumScalar; i < ChecksumVariantCount; ++i)
+        {
+            const ChecksumKernels *p =
+                checksumKernels(static_cast<ChecksumVariant>(i));
+            if (p)
+                pBest = p;
+        }
+        s_pBest = pBest;
+    }
+
+    return *s_pBest;
+}
+
+#if CHECKSUM_SAVE_STATE
+/// Saves the current thread's x87/SSE state for the lifetime of the object.
+class VectorStateGuard
+{
+  public:
+    VectorStateGuard()
+    {
+        asm volatile("fxsave %0" : "=m"(m_State));
+    }
+
+    ~VectorStateGuard()
+    {
+        asm volatile("fxrstor %0" ::"m"(m_State));
+    }
+
+  private:
+    NOT_COPYABLE_OR_ASSIGNABLE(VectorStateGuard);
+
+    uint8_t m_State[512] ALIGN(16);
+};
+#endif
+
+uint16_t checksumSum(const void *buffer, size_t n)
+{
+#if CHECKSUM_SAVE_STATE
+    const ChecksumKernels &k = checksumKernels();
+    if ((n < VECTOR_STATE_THRESHOLD) || (k.variant == ChecksumScalar))
+        return scalarSum(buffer, n);
+
+    VectorStateGuard guard;
+    return k.sum(buffer, n);
+#else
+    return checksumKernels().sum(buffer, n);
+#endif
+}
+
+uint16_t checksumCopyAndSum(void *dest, const void *src, size_t n)
+{
+#if CHECKSUM_SAVE_STATE
+    const ChecksumKernels &k = checksumKernels();
+    if ((n < VECTOR_STATE_THRESHOLD) || (k.variant == ChecksumScalar))
+        return scalarCopyAndSum(dest, src, n);
+
+    VectorStateGuard guard;
+    return k.copyAndSum(dest, src, n);
+#else
+    return checksumKernels().copyAndSum(dest, src, n);
+#endif
+}
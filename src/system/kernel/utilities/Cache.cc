@@ -51,17 +51,26 @@ static bool g_AllocatorInited = false;
 CacheManager *CacheManager::m_Instance = nullptr;
 
 #if THREADS
-static int trimTrampoline(void *p)
+bool CacheManagerPressureHandler::compact()
 {
-    CacheManager::instance().trimThread();
-    return 0;
+    return CacheManager::instance().trimAll(CACHE_NUM_THRESHOLD) > 0;
+}
+
+size_t CacheManagerPressureHandler::reclaimablePages()
+{
+    return CacheManager::instance().pageCount();
+}
+
+size_t CacheManagerPressureHandler::shrink(size_t nPages)
+{
+    return CacheManager::instance().trimAll(nPages);
 }
 #endif
 
 CacheManager::CacheManager()
     : RequestQueue(MakeConstantString("CacheManager")), m_Caches(),
 #if THREADS
-      m_pTrimThread(0),
+      m_PressureHandler(),
 #endif
       m_bActive(false)
 {
@@ -71,7 +80,7 @@ CacheManager::~CacheManager()
 {
     m_bActive = false;
 #if THREADS
-    m_pTrimThread->join();
+    MemoryPressureManager::instance().removeHandler(&m_PressureHandler);
 #endif
 
 #if !STANDALONE_CACHE
@@ -96,12 +105,13 @@ void CacheManager::initialise()
     // Call out to the base class initialise() so the RequestQueue goes live.
     RequestQueue::initialise();
 
-#if THREADS
-    // Create our main trim thread.
-    Process *pParent = Processor::information().getCurrentThread()->getParent();
     m_bActive = true;
-    m_pTrimThread = new Thread(pParent, trimTrampoline, 0);
-    m_pTrimThread->setName("CacheManager trim thread");
+
+#if THREADS
+    // Trimming happens on the MemoryPressureManager's reclaim thread, after
+    // memory mapped files have had a chance to unpin their pages.
+    MemoryPressureManager::instance().registerHandler(
+        MemoryPressureManager::MediumPriority, &m_PressureHandler);
 #endif
 }
 
@@ -123,7 +133,7 @@ void CacheManager::unregisterCache(Cache *pCache)
     }
 }
 
-bool CacheManager::trimAll(size_t count)
+size_t CacheManager::trimAll(size_t count)
 {
     size_t totalEvicted = 0;
     for (List<Cache *>::Iterator it = m_Caches.begin();
@@ -134,7 +144,19 @@ bool CacheManager::trimAll(size_t count)
         count -= evicted;
     }
 
-    return totalEvicted != 0;
+    return totalEvicted;
+}
+
+size_t CacheManager::pageCount()
+{
+    size_t total = 0;
+    for (List<Cache *>::Iterator it = m_Caches.begin(); it != m_Caches.end();
+         ++it)
+    {
+        total += (*it)->count();
+    }
+
+    return total;
 }
 
 void CacheManager::timer(uint64_t delta, InterruptState &state)
@@ -175,32 +197,6 @@ uint64_t CacheManager::executeRequest(
     return pCache->executeRequest(p1, p2, p3, p4, p5, p6, p7, p8);
 }
 
-#if THREADS
-void CacheManager::trimThread()
-{
-    while (m_bActive)
-    {
-        // Ask caches to trim if we're heading towards memory usage problems.
-        size_t currFree = PhysicalMemoryManager::instance().freePageCount();
-        size_t lowMark = MemoryPressureManager::getLowWatermark();
-        if (UNLIKELY(currFree <= lowMark))
-        {
-            // Start trimming. Trim more the closer to the high watermark we
-            // get.
-            NOTICE_NOLOCK("trimThread: free page count nears high watermark, "
-                          "automatically trimming");
-            // Increase as the amount of memory decreases beyond the low
-            // watermark.
-            size_t trimCount = (lowMark - currFree) + 1;
-            trimAll(trimCount);
-        }
-        else
-        {
-            Scheduler::instance().yield();
-        }
-    }
-}
-#endif
 
 Cache::Cache(size_t pageConstraints)
     : m_Pages(), m_PageFilter(0xe80000, 11), m_pLruHead(0), m_pLruTail(0),
@@ -85,6 +85,17 @@ const String MemoryPoolPressureHandler::getMemoryPressureDescription()
 
 bool MemoryPoolPressureHandler::compact()
 {
+    return m_Pool->trim() > 0;
+}
+
+size_t MemoryPoolPressureHandler::reclaimablePages()
+{
+    return m_Pool->unusedPages();
+}
+
+size_t MemoryPoolPressureHandler::shrink(size_t nPages)
+{
+    // Unused pages cost nothing to give back, so release all of them.
     return m_Pool->trim();
 }
 
@@ -228,8 +239,12 @@ uintptr_t MemoryPool::allocateDoer(bool canBlock)
     }
 #endif
 
-    uintptr_t result = poolBase + (n * 0x1000);
-    map(result);
+    uintptr_t result = poolBase + (n * m_BufferSize);
+    for (size_t off = 0; off < m_BufferSize;
+         off += PhysicalMemoryManager::getPageSize())
+    {
+        map(result + off);
+    }
 
     --m_BufferCount;
 
@@ -256,8 +271,46 @@ void MemoryPool::free(uintptr_t buffer)
     ++m_BufferCount;
 }
 
-bool MemoryPool::trim()
+bool MemoryPool::contains(uintptr_t buffer) const
+{
+    if (!m_bInitialised)
+        return false;
+
+    uintptr_t poolBase = reinterpret_cast<uintptr_t>(m_Pool.virtualAddress());
+    return (buffer >= poolBase) && (buffer < (poolBase + m_Pool.size()));
+}
+
+size_t MemoryPool::unusedPages() const
 {
+#if THREADS
+    // As for trim(), direct reclaim can call this from inside allocateDoer.
+    if (!m_Lock.tryAcquire())
+        return 0;
+#endif
+
+    size_t result = 0;
+    if (m_bInitialised)
+    {
+        size_t freeBytes = m_BufferCount * m_BufferSize;
+        result = freeBytes / PhysicalMemoryManager::getPageSize();
+    }
+
+#if THREADS
+    m_Lock.release();
+#endif
+
+    return result;
+}
+
+size_t MemoryPool::trim()
+{
+#if THREADS
+    // Direct reclaim can get here from inside allocateDoer (mapping a buffer
+    // may need memory), so a busy pool is skipped rather than waited on.
+    if (!m_Lock.tryAcquire())
+        return 0;
+#endif
+
     size_t poolSize = m_Pool.size();
     size_t nBuffers = poolSize / m_BufferSize;
     uintptr_t poolBase = reinterpret_cast<uintptr_t>(m_Pool.virtualAddress());
@@ -271,7 +324,7 @@ bool MemoryPool::trim()
         {
             if (!m_AllocBitmap.test(n))
             {
-                uintptr_t page = poolBase + (n * 0x1000);
+                uintptr_t page = poolBase + (n * m_BufferSize);
                 for (size_t off = 0; off < m_BufferSize;
                      off += PhysicalMemoryManager::getPageSize())
                 {
@@ -310,5 +363,9 @@ bool MemoryPool::trim()
         }
     }
 
-    return nFreed > 0;
+#if THREADS
+    m_Lock.release();
+#endif
+
+    return nFreed;
 }
@@ -0,0 +1,429 @@
+/*
+ * Copyright (c) 2008-2014, Pedigree Developers
+ *
+ * Please see the CONTRIB file in the root of the source tree for a full
+ * list of contributors.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+#include "pedigree/kernel/utilities/PageIndex.h"
+#include "pedigree/kernel/utilities/assert.h"
+#include "pedigree/kernel/utilities/utility.h"
+
+const size_t PageIndex::NodeShift;
+const size_t PageIndex::NodeSize;
+const size_t PageIndex::NodeMask;
+const size_t PageIndex::IndexBits;
+const size_t PageIndex::MaxDepth;
+
+PageIndex::Node::Node(size_t shift_) : present(0), tags(), shift(shift_)
+{
+    ByteSet(slots, 0, sizeof(slots));
+}
+
+PageIndex::PageIndex() : m_pRoot(nullptr), m_Count(0)
+{
+}
+
+PageIndex::~PageIndex()
+{
+    clear();
+}
+
+uintptr_t PageIndex::lookup(size_t index) const
+{
+    Node *leaf = findLeaf(index);
+    if (!leaf)
+    {
+        return 0;
+    }
+
+    return leaf->slots[index & NodeMask];
+}
+
+void PageIndex::insert(size_t index, uintptr_t value)
+{
+    assert(value);
+
+    grow(index);
+
+    Node *node = m_pRoot;
+    while (node->shift)
+    {
+        size_t slot = (index >> node->shift) & NodeMask;
+        if (!(node->present & (1ULL << slot)))
+        {
+            Node *child = new Node(node->shift - NodeShift);
+            node->slots[slot] = reinterpret_cast<uintptr_t>(child);
+            node->present |= 1ULL << slot;
+        }
+
+        node = reinterpret_cast<Node *>(node->slots[slot]);
+    }
+
+    size_t slot = index & NodeMask;
+    if (!(node->present & (1ULL << slot)))
+    {
+        node->present |= 1ULL << slot;
+        ++m_Count;
+    }
+    node->slots[slot] = value;
+}
+
+uintptr_t PageIndex::remove(size_t index)
+{
+    if (!m_pRoot)
+    {
+        return 0;
+    }
+
+    if (!covers(m_pRoot->shift, index))
+    {
+        return 0;
+    }
+
+    // Remember the path down so we can tidy up on the way back.
+    Node *path[MaxDepth];
+    size_t depth = 0;
+
+    Node *node = m_pRoot;
+    while (true)
+    {
+        size_t slot = (index >> node->shift) & NodeMask;
+        if (!(node->present & (1ULL << slot)))
+        {
+            return 0;
+        }
+
+        path[depth++] = node;
+        if (!node->shift)
+        {
+            break;
+        }
+
+        node = reinterpret_cast<Node *>(node->slots[slot]);
+    }
+
+    uintptr_t value = node->slots[index & NodeMask];
+    --m_Count;
+
+    // Clear the leaf slot, then work upwards freeing empty nodes and clearing
+    // tag bits for subtrees that no longer have anything tagged.
+    Node *child = nullptr;
+    while (depth--)
+    {
+        node = path[depth];
+        uint64_t bit = 1ULL << ((index >> node->shift) & NodeMask);
+
+        if (!child || !child->present)
+        {
+            delete child;
+            node->slots[(index >> node->shift) & NodeMask] = 0;
+            node->present &= ~bit;
+            for (size_t t = 0; t < TagCount; ++t)
+            {
+                node->tags[t] &= ~bit;
+            }
+        }
+        else
+        {
+            for (size_t t = 0; t < TagCount; ++t)
+            {
+                if (!child->tags[t])
+                {
+                    node->tags[t] &= ~bit;
+                }
+            }
+        }
+
+        child = node;
+    }
+
+    if (!m_pRoot->present)
+    {
+        delete m_pRoot;
+        m_pRoot = nullptr;
+    }
+
+    return value;
+}
+
+void PageIndex::clear()
+{
+    if (m_pRoot)
+    {
+        destroy(m_pRoot);
+        m_pRoot = nullptr;
+    }
+
+    m_Count = 0;
+}
+
+bool PageIndex::setTag(size_t index, Tag tag)
+{
+    if (!lookup(index))
+    {
+        return false;
+    }
+
+    Node *node = m_pRoot;
+    while (true)
+    {
+        size_t slot = (index >> node->shift) & NodeMask;
+        node->tags[tag] |= 1ULL << slot;
+        if (!node->shift)
+        {
+            break;
+        }
+
+        node = reinterpret_cast<Node *>(node->slots[slot]);
+    }
+
+    return true;
+}
+
+void PageIndex::clearTag(size_t index, Tag tag)
+{
+    if (!isTagged(index, tag))
+    {
+        return;
+    }
+
+    Node *path[MaxDepth];
+    size_t depth = 0;
+
+    Node *node = m_pRoot;
+    while (true)
+    {
+        path[depth++] = node;
+        if (!node->shift)
+        {
+            break;
+        }
+
+        node = reinterpret_cast<Node *>(
+            node->slots[(index >> node->shift) & NodeMask]);
+    }
+
+    // Only clear a parent's bit once nothing else beneath it is tagged.
+    while (depth--)
+    {
+        node = path[depth];
+        node->tags[tag] &= ~(1ULL << ((index >> node->shift) & NodeMask));
+        if (node->tags[tag])
+        {
+            break;
+        }
+    }
+}
+
+bool PageIndex::isTagged(size_t index, Tag tag) const
+{
+    Node *leaf = findLeaf(index);
+    if (!leaf)
+    {
+        return false;
+    }
+
+    return leaf->tags[tag] & (1ULL << (index & NodeMask));
+}
+
+bool PageIndex::anyTagged(Tag tag) const
+{
+    return m_pRoot && m_pRoot->tags[tag];
+}
+
+size_t PageIndex::gangLookup(
+    size_t first, size_t last, size_t max, size_t *indices,
+    uintptr_t *values) const
+{
+    return gather(first, last, TagCount, max, indices, values);
+}
+
+size_t PageIndex::gangLookupTagged(
+    size_t first, size_t last, Tag tag, size_t max, size_t *indices,
+    uintptr_t *values) const
+{
+    return gather(first, last, tag, max, indices, values);
+}
+
+void PageIndex::grow(size_t index)
+{
+    size_t shift = 0;
+    while (!covers(shift, index))
+    {
+        shift += NodeShift;
+    }
+
+    if (!m_pRoot)
+    {
+        m_pRoot = new Node(shift);
+        return;
+    }
+
+    while (m_pRoot->shift < shift)
+    {
+        Node *root = new Node(m_pRoot->shift + NodeShift);
+        root->slots[0] = reinterpret_cast<uintptr_t>(m_pRoot);
+        root->present = 1;
+        for (size_t t = 0; t < TagCount; ++t)
+        {
+            root->tags[t] = m_pRoot->tags[t] ? 1 : 0;
+        }
+
+        m_pRoot = root;
+    }
+}
+
+PageIndex::Node *PageIndex::findLeaf(size_t index) const
+{
+    Node *node = m_pRoot;
+    if (!node || !covers(node->shift, index))
+    {
+        return nullptr;
+    }
+
+    // Unused slots are always zero, so there's no need to check the bitmaps.
+    while (node->shift)
+    {
+        node = reinterpret_cast<Node *>(
+            node->slots[(index >> node->shift) & NodeMask]);
+        if (!node)
+        {
+            return nullptr;
+        }
+    }
+
+    return node;
+}
+
+PageIndex::Node *PageIndex::findNext(size_t &index, size_t tag) const
+{
+    if (!m_pRoot || !covers(m_pRoot->shift, index))
+    {
+        return nullptr;
+    }
+
+    Node *node = m_pRoot;
+    while (true)
+    {
+        size_t slot = (index >> node->shift) & NodeMask;
+        uint64_t bitmap = (tag == TagCount) ? node->present : node->tags[tag];
+        bitmap &= ~0ULL << slot;
+
+        if (!bitmap)
+        {
+            // Nothing left in this node; move on to the start of the next
+            // subtree of our parent and search again from the top.
+            if (node == m_pRoot)
+            {
+                return nullptr;
+            }
+
+            size_t span = node->shift + NodeShift;
+            size_t next = ((index >> span) + 1) << span;
+            if (next <= index || !covers(m_pRoot->shift, next))
+            {
+                return nullptr;
+            }
+
+            index = next;
+            node = m_pRoot;
+            continue;
+        }
+
+        size_t found = __builtin_ctzll(bitmap);
+        if (found != slot)
+        {
+            // Skipped ahead - everything below this slot starts from zero.
+            index &= ~((static_cast<size_t>(1) << node->shift) - 1);
+            index &= ~(NodeMask << node->shift);
+            index |= found << node->shift;
+        }
+
+        if (!node->shift)
+        {
+            return node;
+        }
+
+        node = reinterpret_cast<Node *>(node->slots[found]);
+    }
+}
+
+size_t PageIndex::gather(
+    size_t first, size_t last, size_t tag, size_t max, size_t *indices,
+    uintptr_t *values) const
+{
+    size_t n = 0;
+    size_t index = first;
+    while (n < max && index <= last)
+    {
+        Node *leaf = findNext(index, tag);
+        if (!leaf)
+        {
+            break;
+        }
+
+        // Take everything else this leaf has before going back to the root.
+        size_t base = index & ~NodeMask;
+        uint64_t bitmap = (tag == TagCount) ? leaf->present : leaf->tags[tag];
+        bitmap &= ~0ULL << (index & NodeMask);
+        while (bitmap && n < max)
+        {
+            size_t slot = __builtin_ctzll(bitmap);
+            bitmap &= bitmap - 1;
+
+            if ((base | slot) > last)
+            {
+                return n;
+            }
+
+            if (indices)
+            {
+                indices[n] = base | slot;
+            }
+            if (values)
+            {
+                values[n] = leaf->slots[slot];
+            }
+            ++n;
+        }
+
+        index = base + NodeSize;
+        if (index < base)
+        {
+            // Wrapped around past the largest index.
+            break;
+        }
+    }
+
+    return n;
+}
+
+void PageIndex::destroy(Node *node)
+{
+    if (node->shift)
+    {
+        uint64_t present = node->present;
+        while (present)
+        {
+            size_t slot = __builtin_ctzll(present);
+            present &= present - 1;
+            destroy(reinterpret_cast<Node *>(node->slots[slot]));
+        }
+    }
+
+    delete node;
+}
@@ -0,0 +1,574 @@
+/*
+ * Copyright (c) 2008-2014, Pedigree Developers
+ *
+ * Please see the CONTRIB file in the root of the source tree for a full
+ * list of contributors.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "pedigree/kernel/utilities/PageRing.h"
+#include "pedigree/kernel/LockGuard.h"
+#include "pedigree/kernel/utilities/utility.h"
+
+const size_t PageRing::PageSize;
+const size_t PageRing::DefaultSlotCount;
+
+ObjectPool<PageRing::Page, 256> PageRing::m_PagePool;
+
+/// Copies from a source pointer into a page, advancing the pointer.
+static size_t copyToPage(void *param, uint8_t *data, size_t length)
+{
+    const uint8_t *&src = *reinterpret_cast<const uint8_t **>(param);
+    MemoryCopy(data, src, length);
+    src += length;
+    return length;
+}
+
+/// Copies from a page out to a destination pointer, advancing the pointer.
+static size_t copyFromPage(void *param, uint8_t *data, size_t length)
+{
+    uint8_t *&dest = *reinterpret_cast<uint8_t **>(param);
+    MemoryCopy(dest, data, length);
+    dest += length;
+    return length;
+}
+
+PageRing::PageRing(size_t slotCount)
+    : m_SlotCount(slotCount ? slotCount : 1), m_Slots(0), m_Head(0),
+      m_Count(0), m_DataSize(0), m_Lock(false), m_WriteCondition(),
+      m_ReadCondition(), m_bCanRead(true), m_bCanWrite(true)
+{
+    m_Slots = new Slot[m_SlotCount];
+}
+
+PageRing::~PageRing()
+{
+    // Wake up all readers and writers to finish up existing operations.
+    disableReads();
+    disableWrites();
+
+    // Hand every page back.
+    wipe();
+
+    delete[] m_Slots;
+}
+
+size_t PageRing::write(const void *buffer, size_t count, bool block)
+{
+    const uint8_t *src = reinterpret_cast<const uint8_t *>(buffer);
+    return fill(count, copyToPage, &src, block);
+}
+
+size_t PageRing::read(void *buffer, size_t count, bool block)
+{
+    uint8_t *dest = reinterpret_cast<uint8_t *>(buffer);
+    return drain(count, copyFromPage, &dest, block);
+}
+
+size_t
+PageRing::fill(size_t count, PageCallback callback, void *param, bool block)
+{
+    if (!block)
+    {
+        if (!m_Lock.tryAcquire())
+        {
+            return 0;
+        }
+    }
+    else
+    {
+        m_Lock.acquire();
+    }
+
+    size_t countSoFar = 0;
+    while (count)
+    {
+        // Can we write?
+        if (!m_bCanWrite)
+        {
+            break;
+        }
+
+        // Merge into the last page if it has room and nobody else can see
+        // the bytes after its end.
+        if (m_Count)
+        {
+            Slot &tail = slot(m_Count - 1);
+            size_t end = tail.offset + tail.length;
+            if (end < PageSize && tail.page->refs == 1)
+            {
+                size_t wanted = PageSize - end;
+                if (wanted > count)
+                {
+                    wanted = count;
+                }
+
+                size_t done = callback(param, &tail.page->data[end], wanted);
+                tail.length += done;
+                m_DataSize += done;
+                countSoFar += done;
+                count -= done;
+
+                if (done)
+                {
+                    m_ReadCondition.signal();
+                }
+                if (done < wanted)
+                {
+                    break;
+                }
+                continue;
+            }
+        }
+
+        // Do we have a free slot?
+        if (m_Count >= m_SlotCount)
+        {
+            // Can any reader get us out of this situation?
+            if (!block || !m_bCanRead)
+            {
+                break;
+            }
+
+            ConditionVariable::WaitResult result =
+                m_WriteCondition.wait(m_Lock);
+            if (result.hasError())
+            {
+                break;
+            }
+            continue;
+        }
+
+        Page *page = allocatePage();
+        size_t wanted = count > PageSize ? PageSize : count;
+        size_t done = callback(param, page->data, wanted);
+        if (!done)
+        {
+            releasePage(page);
+            break;
+        }
+
+        push(page, 0, done);
+        countSoFar += done;
+        count -= done;
+
+        // Wake up a reader now, as we may need to block for space again.
+        m_ReadCondition.signal();
+
+        if (done < wanted)
+        {
+            break;
+        }
+    }
+
+    m_Lock.release();
+
+    return countSoFar;
+}
+
+size_t
+PageRing::drain(size_t count, PageCallback callback, void *param, bool block)
+{
+    if (!block)
+    {
+        if (!m_Lock.tryAcquire())
+        {
+            return 0;
+        }
+    }
+    else
+    {
+        m_Lock.acquire();
+    }
+
+    size_t countSoFar = 0;
+    while (count)
+    {
+        // Can we read?
+        if (!m_bCanRead)
+        {
+            break;
+        }
+
+        // Do we have anything to read?
+        if (!m_DataSize)
+        {
+            // Can any writer get us out of this situation?
+            if (!block || !m_bCanWrite)
+            {
+                break;
+            }
+
+            ConditionVariable::WaitResult result = m_ReadCondition.wait(m_Lock);
+            if (result.hasError())
+            {
+                break;
+            }
+            continue;
+        }
+
+        bool shortOperation = false;
+        size_t numberCopied = 0;
+        while (m_Count && count)
+        {
+            Slot &head = slot(0);
+            size_t wanted = head.length > count ? count : head.length;
+            size_t done =
+                callback(param, &head.page->data[head.offset], wanted);
+
+            head.offset += done;
+            head.length -= done;
+            m_DataSize -= done;
+            numberCopied += done;
+            count -= done;
+
+            if (!head.length)
+            {
+                pop();
+            }
+
+            if (done < wanted)
+            {
+                shortOperation = true;
+                break;
+            }
+        }
+
+        countSoFar += numberCopied;
+
+        if (numberCopied)
+        {
+            // Wake up a writer that was waiting for space to write.
+            m_WriteCondition.signal();
+        }
+
+        if (shortOperation)
+        {
+            break;
+        }
+
+        // Once we've read at least some bytes, don't block - just return what
+        // we've read so far if we loop back around and have no data.
+        block = false;
+    }
+
+    m_Lock.release();
+
+    return countSoFar;
+}
+
+size_t PageRing::splice(PageRing &dest, size_t count, bool block)
+{
+    return transfer(dest, count, block, true);
+}
+
+size_t PageRing::tee(PageRing &dest, size_t count, bool block)
+{
+    return transfer(dest, count, block, false);
+}
+
+void PageRing::disableWrites()
+{
+    LockGuard<Mutex> guard(m_Lock);
+    m_bCanWrite = false;
+
+    // All pending readers need to now return.
+    m_ReadCondition.broadcast();
+}
+
+void PageRing::disableReads()
+{
+    LockGuard<Mutex> guard(m_Lock);
+    m_bCanRead = false;
+
+    // All pending writers need to now return.
+    m_WriteCondition.broadcast();
+}
+
+bool PageRing::enableWrites()
+{
+    LockGuard<Mutex> guard(m_Lock);
+    bool previous = m_bCanWrite;
+    m_bCanWrite = true;
+    return previous;
+}
+
+bool PageRing::enableReads()
+{
+    LockGuard<Mutex> guard(m_Lock);
+    bool previous = m_bCanRead;
+    m_bCanRead = true;
+    return previous;
+}
+
+size_t PageRing::getDataSize()
+{
+    LockGuard<Mutex> guard(m_Lock);
+    return m_DataSize;
+}
+
+size_t PageRing::getSize() const
+{
+    return m_SlotCount * PageSize;
+}
+
+bool PageRing::canWrite(bool block)
+{
+    if (!block)
+    {
+        return m_bCanWrite && (m_Count < m_SlotCount);
+    }
+
+    LockGuard<Mutex> guard(m_Lock);
+
+    // We can get woken here if we stop being able to write.
+    while (m_bCanWrite && m_Count >= m_SlotCount)
+    {
+        ConditionVariable::WaitResult result = m_WriteCondition.wait(m_Lock);
+        if (result.hasError())
+        {
+            return false;
+        }
+    }
+
+    return m_bCanWrite;
+}
+
+bool PageRing::canRead(bool block)
+{
+    if (!block)
+    {
+        return m_bCanRead && (m_DataSize > 0);
+    }
+
+    LockGuard<Mutex> guard(m_Lock);
+
+    // We can get woken here if we stop being able to read.
+    while (m_bCanRead && !m_DataSize)
+    {
+        ConditionVariable::WaitResult result = m_ReadCondition.wait(m_Lock);
+        if (result.hasError())
+        {
+            return false;
+        }
+    }
+
+    return m_bCanRead;
+}
+
+void PageRing::wipe()
+{
+    LockGuard<Mutex> guard(m_Lock);
+
+    while (m_Count)
+    {
+        pop();
+    }
+    m_DataSize = 0;
+
+    // Notify writers that might have been waiting for space.
+    m_WriteCondition.broadcast();
+}
+
+size_t
+PageRing::transfer(PageRing &dest, size_t count, bool block, bool consume)
+{
+    if (&dest == this || !count)
+    {
+        return 0;
+    }
+
+    // Always lock in address order so two rings splicing into each other at
+    // the same time can't deadlock.
+    PageRing *first = this < &dest ? this : &dest;
+    PageRing *second = this < &dest ? &dest : this;
+
+    while (true)
+    {
+        if (block)
+        {
+            if (!waitForData() || !dest.waitForSpace())
+            {
+                return 0;
+            }
+
+            first->m_Lock.acquire();
+            second->m_Lock.acquire();
+        }
+        else
+        {
+            if (!first->m_Lock.tryAcquire())
+            {
+                return 0;
+            }
+            if (!second->m_Lock.tryAcquire())
+            {
+                first->m_Lock.release();
+                return 0;
+            }
+        }
+
+        size_t moved = transferLocked(dest, count, consume);
+
+        second->m_Lock.release();
+        first->m_Lock.release();
+
+        // Another thread may have beaten us to the data or the space since
+        // we waited, in which case just go around again.
+        if (moved || !block)
+        {
+            return moved;
+        }
+    }
+}
+
+size_t PageRing::transferLocked(PageRing &dest, size_t count, bool consume)
+{
+    if (!m_bCanRead || !dest.m_bCanWrite)
+    {
+        return 0;
+    }
+
+    size_t moved = 0;
+    size_t next = 0;
+    while (count && dest.m_Count < dest.m_SlotCount)
+    {
+        if (next >= m_Count)
+        {
+            break;
+        }
+
+        Slot &source = slot(next);
+        size_t length = source.length > count ? count : source.length;
+
+        if (consume && length == source.length)
+        {
+            // The whole slot moves, along with our reference to its page.
+            dest.push(source.page, source.offset, length);
+            m_Head = (m_Head + 1) % m_SlotCount;
+            --m_Count;
+        }
+        else
+        {
+            // Share the page; neither side can merge into it from now on.
+            source.page->refs += 1;
+            dest.push(source.page, source.offset, length);
+            if (consume)
+            {
+                source.offset += length;
+                source.length -= length;
+            }
+            else
+            {
+                ++next;
+            }
+        }
+
+        if (consume)
+        {
+            m_DataSize -= length;
+        }
+
+        moved += length;
+        count -= length;
+    }
+
+    if (moved)
+    {
+        dest.m_ReadCondition.signal();
+        if (consume)
+        {
+            m_WriteCondition.signal();
+        }
+    }
+
+    return moved;
+}
+
+bool PageRing::waitForData()
+{
+    LockGuard<Mutex> guard(m_Lock);
+
+    while (!m_DataSize)
+    {
+        // No writers means no data will ever arrive.
+        if (!m_bCanRead || !m_bCanWrite)
+        {
+            return false;
+        }
+
+        ConditionVariable::WaitResult result = m_ReadCondition.wait(m_Lock);
+        if (result.hasError())
+        {
+            return false;
+        }
+    }
+
+    return m_bCanRead;
+}
+
+bool PageRing::waitForSpace()
+{
+    LockGuard<Mutex> guard(m_Lock);
+
+    while (m_Count >= m_SlotCount)
+    {
+        // No readers means no space will ever be made.
+        if (!m_bCanWrite || !m_bCanRead)
+        {
+            return false;
+        }
+
+        ConditionVariable::WaitResult result = m_WriteCondition.wait(m_Lock);
+        if (result.hasError())
+        {
+            return false;
+        }
+    }
+
+    return m_bCanWrite;
+}
+
+void PageRing::push(Page *page, size_t offset, size_t length)
+{
+    Slot &tail = m_Slots[(m_Head + m_Count) % m_SlotCount];
+    tail.page = page;
+    tail.offset = offset;
+    tail.length = length;
+
+    ++m_Count;
+    m_DataSize += length;
+}
+
+void PageRing::pop()
+{
+    releasePage(m_Slots[m_Head].page);
+    m_Head = (m_Head + 1) % m_SlotCount;
+    --m_Count;
+}
+
+PageRing::Page *PageRing::allocatePage()
+{
+    Page *page = m_PagePool.allocate();
+    page->refs = Atomic<size_t>(1);
+    return page;
+}
+
+void PageRing::releasePage(Page *page)
+{
+    if ((page->refs -= 1) == 0)
+    {
+        m_PagePool.deallocate(page);
+    }
+}
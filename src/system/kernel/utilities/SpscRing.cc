@@ -0,0 +1,496 @@
+/*
+ * Copyright (c) 2008-2014, Pedigree Developers
+ *
+ * Please see the CONTRIB file in the root of the source tree for a full
+ * list of contributors.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+#include "pedigree/kernel/utilities/SpscRing.h"
+#include "pedigree/kernel/LockGuard.h"
+#include "pedigree/kernel/utilities/utility.h"
+
+#if THREADS
+#include "pedigree/kernel/process/Semaphore.h"
+#include "pedigree/kernel/process/Thread.h"
+#endif
+
+const size_t SpscRing::MinimumSize;
+const size_t SpscRing::DefaultSize;
+
+SpscRing::SpscRing(size_t size)
+    : m_pData(0), m_Size(MinimumSize), m_Head(0), m_Padding(), m_Tail(0),
+      m_WriteLock(false), m_ReadLock(false), m_WaitLock(false),
+      m_WriteCondition(), m_ReadCondition(), m_ReadersWaiting(0),
+      m_WritersWaiting(0), m_MonitorLock(false), m_MonitorTargets(),
+      m_nMonitorTargets(0), m_bCanRead(true), m_bCanWrite(true)
+{
+    // Power-of-two sizes let the counters wrap naturally.
+    while (m_Size < size)
+    {
+        m_Size <<= 1;
+    }
+}
+
+SpscRing::~SpscRing()
+{
+    // Wake up all readers and writers to finish up existing operations.
+    disableReads();
+    disableWrites();
+
+    // Clean up monitor targets.
+    m_MonitorLock.acquire();
+    for (auto pTarget : m_MonitorTargets)
+    {
+#if THREADS
+        if (pTarget->pSemaphore)
+        {
+            pTarget->pSemaphore->release();
+        }
+#endif
+        delete pTarget;
+    }
+    m_MonitorTargets.clear();
+    m_MonitorLock.release();
+
+    delete[] m_pData;
+}
+
+size_t SpscRing::write(const void *buffer, size_t count, bool block)
+{
+    if (!block)
+    {
+        if (!m_WriteLock.tryAcquire())
+        {
+            // can't lock the ring for writing
+            return 0;
+        }
+    }
+    else
+    {
+        m_WriteLock.acquire();
+    }
+
+    if (!m_pData && count)
+    {
+        // Readers only look at the storage once the head has moved, which
+        // happens after this (with release semantics).
+        m_pData = new uint8_t[m_Size];
+    }
+
+    const uint8_t *src = reinterpret_cast<const uint8_t *>(buffer);
+    size_t countSoFar = 0;
+    while (count)
+    {
+        // Can we write?
+        if (!__atomic_load_n(&m_bCanWrite, __ATOMIC_RELAXED))
+        {
+            break;
+        }
+
+        size_t head = m_Head;
+        size_t tail = __atomic_load_n(&m_Tail, __ATOMIC_ACQUIRE);
+        size_t space = m_Size - (head - tail);
+        if (!space)
+        {
+            // Can any reader get us out of this situation?
+            if (!block || !waitForSpace())
+            {
+                break;
+            }
+            continue;
+        }
+
+        size_t n = count < space ? count : space;
+        size_t offset = head & (m_Size - 1);
+        size_t first = m_Size - offset;
+        if (first > n)
+        {
+            first = n;
+        }
+        MemoryCopy(&m_pData[offset], src, first);
+        if (first < n)
+        {
+            MemoryCopy(m_pData, &src[first], n - first);
+        }
+
+        __atomic_store_n(&m_Head, head + n, __ATOMIC_RELEASE);
+
+        countSoFar += n;
+        src += n;
+        count -= n;
+
+        // Wake up a reader now, as we may need to block for space again.
+        wakeReaders();
+    }
+
+    m_WriteLock.release();
+
+    if (countSoFar)
+    {
+        // We've updated the ring, so send events.
+        notifyMonitors();
+    }
+
+    return countSoFar;
+}
+
+size_t SpscRing::read(void *buffer, size_t count, bool block)
+{
+    if (!block)
+    {
+        if (!m_ReadLock.tryAcquire())
+        {
+            // can't lock the ring for reading
+            return 0;
+        }
+    }
+    else
+    {
+        m_ReadLock.acquire();
+    }
+
+    uint8_t *dest = reinterpret_cast<uint8_t *>(buffer);
+    size_t countSoFar = 0;
+    while (count)
+    {
+        // Can we read?
+        if (!__atomic_load_n(&m_bCanRead, __ATOMIC_RELAXED))
+        {
+            break;
+        }
+
+        size_t tail = m_Tail;
+        size_t available = __atomic_load_n(&m_Head, __ATOMIC_ACQUIRE) - tail;
+        if (!available)
+        {
+            // Only block if we haven't read anything yet.
+            if (countSoFar || !block || !waitForData())
+            {
+                break;
+            }
+            continue;
+        }
+
+        size_t n = count < available ? count : available;
+        size_t offset = tail & (m_Size - 1);
+        size_t first = m_Size - offset;
+        if (first > n)
+        {
+            first = n;
+        }
+        MemoryCopy(dest, &m_pData[offset], first);
+        if (first < n)
+        {
+            MemoryCopy(&dest[first], m_pData, n - first);
+        }
+
+        __atomic_store_n(&m_Tail, tail + n, __ATOMIC_RELEASE);
+
+        countSoFar += n;
+        dest += n;
+        count -= n;
+
+        wakeWriters();
+    }
+
+    m_ReadLock.release();
+
+    if (countSoFar)
+    {
+        notifyMonitors();
+    }
+
+    return countSoFar;
+}
+
+void SpscRing::disableWrites()
+{
+    __atomic_store_n(&m_bCanWrite, false, __ATOMIC_SEQ_CST);
+    wakeAll();
+}
+
+void SpscRing::disableReads()
+{
+    __atomic_store_n(&m_bCanRead, false, __ATOMIC_SEQ_CST);
+    wakeAll();
+}
+
+bool SpscRing::enableWrites()
+{
+    return __atomic_exchange_n(&m_bCanWrite, true, __ATOMIC_SEQ_CST);
+}
+
+bool SpscRing::enableReads()
+{
+    return __atomic_exchange_n(&m_bCanRead, true, __ATOMIC_SEQ_CST);
+}
+
+size_t SpscRing::getDataSize() const
+{
+    size_t tail = __atomic_load_n(&m_Tail, __ATOMIC_ACQUIRE);
+    return __atomic_load_n(&m_Head, __ATOMIC_ACQUIRE) - tail;
+}
+
+size_t SpscRing::getSize() const
+{
+    return m_Size;
+}
+
+bool SpscRing::canWrite(bool block)
+{
+    if (!__atomic_load_n(&m_bCanWrite, __ATOMIC_RELAXED))
+    {
+        return false;
+    }
+
+    if (getDataSize() < m_Size)
+    {
+        return true;
+    }
+
+    if (!block)
+    {
+        return false;
+    }
+
+    // We can get woken here if we stop being able to write.
+    return waitForSpace() && __atomic_load_n(&m_bCanWrite, __ATOMIC_RELAXED);
+}
+
+bool SpscRing::canRead(bool block)
+{
+    if (!__atomic_load_n(&m_bCanRead, __ATOMIC_RELAXED))
+    {
+        return false;
+    }
+
+    if (getDataSize())
+    {
+        return true;
+    }
+
+    if (!block)
+    {
+        return false;
+    }
+
+    // We can get woken here if we stop being able to read.
+    return waitForData() && __atomic_load_n(&m_bCanRead, __ATOMIC_RELAXED);
+}
+
+void SpscRing::wipe()
+{
+    // Discarding data is a consumer operation.
+    LockGuard<Mutex> guard(m_ReadLock);
+    __atomic_store_n(
+        &m_Tail, __atomic_load_n(&m_Head, __ATOMIC_ACQUIRE), __ATOMIC_RELEASE);
+
+    // Notify writers that might have been waiting for space.
+    wakeWriters();
+}
+
+void SpscRing::monitor(Thread *pThread, Event *pEvent)
+{
+#if THREADS
+    MonitorTarget *pTarget = new MonitorTarget;
+    pTarget->pThread = pThread;
+    pTarget->pEvent = pEvent;
+    pTarget->pSemaphore = 0;
+
+    LockGuard<Mutex> guard(m_MonitorLock);
+    m_MonitorTargets.pushBack(pTarget);
+    __atomic_add_fetch(&m_nMonitorTargets, 1, __ATOMIC_SEQ_CST);
+#endif
+}
+
+void SpscRing::monitor(Semaphore *pSemaphore)
+{
+#if THREADS
+    MonitorTarget *pTarget = new MonitorTarget;
+    pTarget->pThread = 0;
+    pTarget->pEvent = 0;
+    pTarget->pSemaphore = pSemaphore;
+
+    LockGuard<Mutex> guard(m_MonitorLock);
+    m_MonitorTargets.pushBack(pTarget);
+    __atomic_add_fetch(&m_nMonitorTargets, 1, __ATOMIC_SEQ_CST);
+#endif
+}
+
+void SpscRing::cullMonitorTargets(Semaphore *pSemaphore)
+{
+#if THREADS
+    LockGuard<Mutex> guard(m_MonitorLock);
+    for (auto it = m_MonitorTargets.begin(); it != m_MonitorTargets.end();)
+    {
+        MonitorTarget *pMT = *it;
+
+        if (pMT->pSemaphore == pSemaphore)
+        {
+            delete pMT;
+            it = m_MonitorTargets.erase(it);
+            __atomic_sub_fetch(&m_nMonitorTargets, 1, __ATOMIC_SEQ_CST);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+#endif
+}
+
+void SpscRing::cullMonitorTargets(Event *pEvent)
+{
+#if THREADS
+    LockGuard<Mutex> guard(m_MonitorLock);
+    for (auto it = m_MonitorTargets.begin(); it != m_MonitorTargets.end();)
+    {
+        MonitorTarget *pMT = *it;
+
+        if (pMT->pEvent == pEvent)
+        {
+            delete pMT;
+            it = m_MonitorTargets.erase(it);
+            __atomic_sub_fetch(&m_nMonitorTargets, 1, __ATOMIC_SEQ_CST);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+#endif
+}
+
+void SpscRing::notifyMonitors()
+{
+#if THREADS
+    // Pairs with the increment in monitor(): either the monitor sees our
+    // data when it checks the ring, or we see the monitor here.
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (!__atomic_load_n(&m_nMonitorTargets, __ATOMIC_RELAXED))
+    {
+        return;
+    }
+
+    LockGuard<Mutex> guard(m_MonitorLock);
+    for (auto pMT : m_MonitorTargets)
+    {
+        if (pMT->pThread)
+        {
+            pMT->pThread->sendEvent(pMT->pEvent);
+        }
+        else if (pMT->pSemaphore)
+        {
+            pMT->pSemaphore->release();
+        }
+        delete pMT;
+    }
+    m_MonitorTargets.clear();
+    __atomic_store_n(&m_nMonitorTargets, 0, __ATOMIC_SEQ_CST);
+#endif
+}
+
+bool SpscRing::waitForData()
+{
+    LockGuard<Mutex> guard(m_WaitLock);
+
+    // Announce ourselves before checking, so a writer that publishes after
+    // our check is guaranteed to see us and take the wait lock.
+    __atomic_add_fetch(&m_ReadersWaiting, 1, __ATOMIC_SEQ_CST);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    bool result = true;
+    while (__atomic_load_n(&m_bCanRead, __ATOMIC_RELAXED) && !getDataSize())
+    {
+        // Can any writer get us out of this situation?
+        if (!__atomic_load_n(&m_bCanWrite, __ATOMIC_RELAXED))
+        {
+            result = false;
+            break;
+        }
+
+        ConditionVariable::WaitResult waitResult =
+            m_ReadCondition.wait(m_WaitLock);
+        if (waitResult.hasError())
+        {
+            result = false;
+            break;
+        }
+    }
+
+    __atomic_sub_fetch(&m_ReadersWaiting, 1, __ATOMIC_SEQ_CST);
+    return result;
+}
+
+bool SpscRing::waitForSpace()
+{
+    LockGuard<Mutex> guard(m_WaitLock);
+
+    __atomic_add_fetch(&m_WritersWaiting, 1, __ATOMIC_SEQ_CST);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    bool result = true;
+    while (__atomic_load_n(&m_bCanWrite, __ATOMIC_RELAXED) &&
+           getDataSize() >= m_Size)
+    {
+        // Can any reader get us out of this situation?
+        if (!__atomic_load_n(&m_bCanRead, __ATOMIC_RELAXED))
+        {
+            result = false;
+            break;
+        }
+
+        ConditionVariable::WaitResult waitResult =
+            m_WriteCondition.wait(m_WaitLock);
+        if (waitResult.hasError())
+        {
+            result = false;
+            break;
+        }
+    }
+
+    __atomic_sub_fetch(&m_WritersWaiting, 1, __ATOMIC_SEQ_CST);
+    return result;
+}
+
+void SpscRing::wakeReaders()
+{
+    // Pairs with the fence in waitForData().
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&m_ReadersWaiting, __ATOMIC_RELAXED))
+    {
+        LockGuard<Mutex> guard(m_WaitLock);
+        m_ReadCondition.broadcast();
+    }
+}
+
+void SpscRing::wakeWriters()
+{
+    // Pairs with the fence in waitForSpace().
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&m_WritersWaiting, __ATOMIC_RELAXED))
+    {
+        LockGuard<Mutex> guard(m_WaitLock);
+        m_WriteCondition.broadcast();
+    }
+}
+
+void SpscRing::wakeAll()
+{
+    LockGuard<Mutex> guard(m_WaitLock);
+    m_ReadCondition.broadcast();
+    m_WriteCondition.broadcast();
+}
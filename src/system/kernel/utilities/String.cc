@@ -28,8 +28,9 @@
 /** Minimum size to remain allocated for a String, to avoid tiny heap allocations. */
 #define STRING_MINIMUM_ALLOCATION_SIZE 64UL
 
-String::String()
-    : m_Data(nullptr), m_Length(0), m_Size(0), m_Hash(0)
+const size_t String::InlineSize;
+
+String::String() : m_Heap(), m_Length(0), m_Hash(0), m_bInline(false)
 {
 }
 
@@ -77,15 +78,23 @@ void String::move(String &&other)
 {
     clear();
 
-    // take ownership of the object
-    m_Data = other.m_Data;
+    // take ownership of the object (inline contents are simply copied)
+    if (other.m_bInline)
+    {
+        MemoryCopy(m_Inline, other.m_Inline, InlineSize);
+    }
+    else
+    {
+        m_Heap = other.m_Heap;
+    }
+    m_bInline = other.m_bInline;
     m_Length = other.m_Length;
-    m_Size = other.m_Size;
     m_Hash = other.m_Hash;
 
     // free other string but don't destroy the heap pointer if we had one
     // as it is now owned by this new instance
-    other.m_Data = 0;
+    other.m_bInline = false;
+    other.m_Heap.data = nullptr;
     other.clear();
 }
 
@@ -117,8 +126,6 @@ String &String::operator=(const Cord &x)
 
 String &String::operator+=(const String &x)
 {
-    assert(assignable());
-
     size_t newLength = x.length() + m_Length;
 
     reserve(newLength + 1);
@@ -139,13 +146,11 @@ String &String::operator+=(const String &x)
 
 String &String::operator+=(const char *s)
 {
-    assert(assignable());
-
     size_t slen = StringLength(s);
     size_t newLength = slen + m_Length;
 
     reserve(slen + m_Length + 1);
-    MemoryCopy(&m_Data[m_Length], s, slen + 1);
+    MemoryCopy(&extract()[m_Length], s, slen + 1);
     m_Length += slen;
 
     m_Hash = 0;
@@ -239,31 +244,6 @@ char String::operator[](size_t i) const
     return buf[i];
 }
 
-uint32_t String::hash() const
-{
-    if (!m_Hash)
-    {
-        return computeHash();
-    }
-
-    return m_Hash;
-}
-
-uint32_t String::hash()
-{
-    if (!m_Hash)
-    {
-        computeHash();
-    }
-
-    return m_Hash;
-}
-
-uint32_t String::maybeHash() const
-{
-    return m_Hash;
-}
-
 size_t String::nextCharacter(size_t c) const
 {
     const char *buf = extract();
@@ -278,15 +258,26 @@ size_t String::prevCharacter(size_t c) const
 
 void String::assign(const String &x)
 {
-    assert(assignable());
-
     if (extract() && x.extract())
     {
         assert(extract() != x.extract());
     }
 
-    reserve(x.size(), false);
-    MemoryCopy(m_Data, x.extract(), x.size());
+    if (x.m_bInline && !m_bInline && !m_Heap.data)
+    {
+        // Common case: copying a short string into an empty one.
+        MemoryCopy(m_Inline, x.m_Inline, InlineSize);
+        m_bInline = true;
+    }
+    else if (x.m_Length)
+    {
+        reserve(x.m_Length + 1, false);
+        MemoryCopy(extract(), x.extract(), x.m_Length + 1);
+    }
+    else if (extract())
+    {
+        *extract() = 0;
+    }
     m_Length = x.length();
 
     // no need to recompute in this case
@@ -303,8 +294,6 @@ void String::assign(const String &x)
 
 void String::assign(const Cord &x)
 {
-    assert(assignable());
-
     reserve(x.length() + 1);
 
     size_t offset = 0;
@@ -326,10 +315,8 @@ void String::assign(const Cord &x)
 
 void String::assign(const char *s, size_t len, bool unsafe)
 {
-    assert(assignable());
-
     // Trying to assign self to self?
-    assert((m_Data == nullptr) || (m_Data && (m_Data != s)));
+    assert((extract() == nullptr) || (extract() != s));
 
     size_t copyLength = 0;
     size_t origLength = len;
@@ -368,15 +355,14 @@ void String::assign(const char *s, size_t len, bool unsafe)
 
     if (!m_Length)
     {
-        delete [] m_Data;
-        m_Data = 0;
-        m_Size = 0;
+        clear();
     }
     else
     {
         reserve(copyLength + 1, false);
-        MemoryCopy(m_Data, s, copyLength);
-        m_Data[copyLength] = '\0';
+        char *buf = extract();
+        MemoryCopy(buf, s, copyLength);
+        buf[copyLength] = '\0';
     }
 
 #if ADDITIONAL_CHECKS
@@ -399,83 +385,110 @@ void String::reserve(size_t size)
 
 void String::reserve(size_t size, bool zero)
 {
-    assert(resizable());
-
-    size = pedigree_std::max(size, STRING_MINIMUM_ALLOCATION_SIZE);
+    char *oldData = extract();
+    size_t oldSize = this->size();
+    if (size <= oldSize)
+    {
+        return;
+    }
 
-    if (size > m_Size)
+    if (!oldData && size <= InlineSize)
     {
-        char *tmp = m_Data;
-        m_Data = new char[size];
-        if (tmp)
+        // Nothing allocated yet, and it fits inline.
+        m_bInline = true;
+        if (zero)
         {
-            MemoryCopy(m_Data, tmp, m_Size > size ? size : m_Size);
-            delete[] tmp;
+            ByteSet(m_Inline, 0, InlineSize);
         }
-        else if (zero)
+        return;
+    }
+
+    size = pedigree_std::max(size, STRING_MINIMUM_ALLOCATION_SIZE);
+
+    char *newData = new char[size];
+    if (oldData)
+    {
+        MemoryCopy(newData, oldData, oldSize);
+        if (!m_bInline)
         {
-            ByteSet(m_Data, 0, size);
+            delete[] oldData;
         }
-        m_Size = size;
     }
+    else if (zero)
+    {
+        ByteSet(newData, 0, size);
+    }
+
+    m_bInline = false;
+    m_Heap.data = newData;
+    m_Heap.size = size;
 }
 
 void String::downsize()
 {
-    assert(resizable());
+    if (m_bInline || !m_Heap.data)
+    {
+        return;
+    }
 
-    size_t newSize = pedigree_std::max(m_Length + 1, STRING_MINIMUM_ALLOCATION_SIZE);
+    char *oldData = m_Heap.data;
 
-    char *oldData = m_Data;
+    if (m_Length < InlineSize)
+    {
+        // Short enough to move back inline (oldData is saved, so it's safe
+        // to overwrite the heap pointer).
+        MemoryCopy(m_Inline, oldData, m_Length + 1);
+        m_bInline = true;
+    }
+    else
+    {
+        size_t newSize =
+            pedigree_std::max(m_Length + 1, STRING_MINIMUM_ALLOCATION_SIZE);
 
-    m_Data = new char[newSize];
-    MemoryCopy(m_Data, oldData, newSize);
+        m_Heap.data = new char[newSize];
+        MemoryCopy(m_Heap.data, oldData, m_Length + 1);
+        m_Heap.size = newSize;
+    }
 
     delete [] oldData;
-
-    m_Size = newSize;
 }
 
 void String::clear()
 {
-    assert(assignable());
-
-    if (m_Data)
+    if (!m_bInline)
     {
-        delete[] m_Data;
+        delete[] m_Heap.data;
     }
-    m_Data = 0;
+    m_bInline = false;
+    m_Heap.data = nullptr;
+    m_Heap.size = 0;
     m_Length = 0;
-    m_Size = 0;
     m_Hash = 0;
 }
 
 void String::ltrim(size_t n)
 {
-    assert(assignable());
-
     if (n > m_Length)
     {
         clear();
         return;
     }
 
-    MemoryCopy(m_Data, &m_Data[n], m_Length - n);
+    char *buf = extract();
+    MemoryCopy(buf, &buf[n], m_Length - n);
     m_Length -= n;
-    m_Data[m_Length] = 0;
+    buf[m_Length] = 0;
 }
 
 void String::rtrim(size_t n)
 {
-    assert(assignable());
-
     if (n > m_Length)
     {
         clear();
         return;
     }
 
-    m_Data[m_Length - n] = 0;
+    extract()[m_Length - n] = 0;
     m_Length -= n;
 }
 
@@ -488,8 +501,6 @@ String String::split(size_t offset)
 
 void String::split(size_t offset, String &back)
 {
-    assert(assignable());
-
     if (offset >= m_Length)
     {
         back.clear();
@@ -510,16 +521,12 @@ void String::split(size_t offset, String &back)
 
 void String::strip()
 {
-    assert(assignable());
-
     lstrip();
     rstrip();
 }
 
 void String::lstrip()
 {
-    assert(assignable());
-
     char *buf = extract();
     if (!buf)
     {
@@ -535,7 +542,8 @@ void String::lstrip()
     while (n < m_Length && iswhitespace(buf[n]))
         n++;
 
-    // Move the data to cover up the whitespace and avoid reallocating m_Data
+    // Move the data to cover up the whitespace and avoid reallocating the
+    // buffer
     m_Length -= n;
     MemoryCopy(buf, (buf + n), m_Length);
     buf[m_Length] = 0;
@@ -548,8 +556,6 @@ void String::lstrip()
 
 void String::rstrip()
 {
-    assert(assignable());
-
     char *buf = extract();
     if (!buf)
     {
@@ -564,7 +570,7 @@ void String::rstrip()
     while (n > 0 && iswhitespace(buf[n - 1]))
         n--;
 
-    // m_Size is still valid - it's the size of the buffer. m_Length is now
+    // size() is still valid - it's the size of the buffer. m_Length is now
     // updated to contain the proper length of the string, but the buffer is
     // not reallocated.
     m_Length = n;
@@ -680,8 +686,6 @@ void String::tokenise(char token, Vector<String> &output) const
 
 void String::lchomp()
 {
-    assert(assignable());
-
     char *buf = extract();
 
     StringCopy(buf, &buf[1]);
@@ -695,8 +699,6 @@ void String::lchomp()
 
 void String::chomp()
 {
-    assert(assignable());
-
     char *buf = extract();
 
     m_Length--;
@@ -710,12 +712,10 @@ void String::chomp()
 
 void String::Format(const char *fmt, ...)
 {
-    assert(assignable());
-
     reserve(256);
     va_list vl;
     va_start(vl, fmt);
-    m_Length = VStringFormat(m_Data, fmt, vl);
+    m_Length = VStringFormat(extract(), fmt, vl);
     va_end(vl);
 
     m_Hash = 0;
@@ -805,11 +805,6 @@ bool String::iswhitespace(const char c) const
     return (c <= ' ' || c == '\x7f');
 }
 
-char *String::extract() const
-{
-    return m_Data;
-}
-
 ssize_t String::find(const char c) const
 {
     if (!m_Length)
@@ -888,22 +883,3 @@ StringView String::view() const
     return StringView(buf, m_Length, m_Hash, true);
 }
 
-bool String::resizable() const
-{
-    return true;
-}
-
-bool String::assignable() const
-{
-    return true;
-}
-
-void String::setLength(size_t n)
-{
-    m_Length = n;
-}
-
-void String::setSize(size_t n)
-{
-    m_Size = n;
-}
@@ -0,0 +1,218 @@
+/*
+ * Copyright (c) 2008-2014, Pedigree Developers
+ *
+ * Please see the CONTRIB file in the root of the source tree for a full
+ * list of contributors.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+// Measures the futex paths used by pthread mutexes and condition variables:
+// the latency of handing control back and forth between two threads, and the
+// cost of waking many threads blocked on one condition variable.
+
+#define DEFAULT_ROUNDTRIPS 10000
+#define DEFAULT_WAITERS 16
+#define DEFAULT_BROADCASTS 200
+
+static pthread_mutex_t g_Lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_Cond = PTHREAD_COND_INITIALIZER;
+
+/// Ping-pong: whose turn it is (0 or 1), and how many round trips remain.
+static int g_Turn = 0;
+static int g_Remaining = 0;
+
+/// Broadcast: the generation waiters wait for, and how many have seen it.
+static int g_Generation = 0;
+static int g_Awake = 0;
+static int g_Stop = 0;
+static pthread_cond_t g_AwakeCond = PTHREAD_COND_INITIALIZER;
+
+static uint64_t microseconds()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (tv.tv_sec * 1000000ULL) + tv.tv_usec;
+}
+
+static void *pong(void *arg)
+{
+    (void) arg;
+
+    pthread_mutex_lock(&g_Lock);
+    while (g_Remaining)
+    {
+        while (g_Turn != 1 && g_Remaining)
+        {
+            pthread_cond_wait(&g_Cond, &g_Lock);
+        }
+
+        g_Turn = 0;
+        pthread_cond_signal(&g_Cond);
+    }
+    pthread_mutex_unlock(&g_Lock);
+
+    return NULL;
+}
+
+static void pingPong(int roundTrips)
+{
+    pthread_t thread;
+
+    g_Turn = 0;
+    g_Remaining = roundTrips;
+    pthread_create(&thread, NULL, pong, NULL);
+
+    uint64_t start = microseconds();
+
+    pthread_mutex_lock(&g_Lock);
+    while (g_Remaining)
+    {
+        g_Turn = 1;
+        pthread_cond_signal(&g_Cond);
+        while (g_Turn != 0)
+        {
+            pthread_cond_wait(&g_Cond, &g_Lock);
+        }
+        --g_Remaining;
+    }
+    pthread_cond_signal(&g_Cond);
+    pthread_mutex_unlock(&g_Lock);
+
+    uint64_t elapsed = microseconds() - start;
+
+    pthread_join(thread, NULL);
+
+    printf(
+        "ping-pong: %d round trips in %llu us (%llu ns per round trip)\n",
+        roundTrips, (unsigned long long) elapsed,
+        (unsigned long long) ((elapsed * 1000) / roundTrips));
+}
+
+static void *broadcastWaiter(void *arg)
+{
+    (void) arg;
+
+    int seen = 0;
+
+    pthread_mutex_lock(&g_Lock);
+    while (!g_Stop)
+    {
+        while (g_Generation == seen && !g_Stop)
+        {
+            pthread_cond_wait(&g_Cond, &g_Lock);
+        }
+
+        seen = g_Generation;
+        ++g_Awake;
+        pthread_cond_signal(&g_AwakeCond);
+    }
+    pthread_mutex_unlock(&g_Lock);
+
+    return NULL;
+}
+
+static void broadcast(int waiters, int broadcasts)
+{
+    pthread_t *threads = malloc(sizeof(pthread_t) * waiters);
+    if (!threads)
+    {
+        return;
+    }
+
+    g_Generation = 0;
+    g_Stop = 0;
+    for (int i = 0; i < waiters; ++i)
+    {
+        pthread_create(&threads[i], NULL, broadcastWaiter, NULL);
+    }
+
+    uint64_t total = 0, worst = 0;
+    for (int i = 0; i < broadcasts; ++i)
+    {
+        pthread_mutex_lock(&g_Lock);
+        g_Awake = 0;
+        ++g_Generation;
+
+        uint64_t start = microseconds();
+        pthread_cond_broadcast(&g_Cond);
+        while (g_Awake < waiters)
+        {
+            pthread_cond_wait(&g_AwakeCond, &g_Lock);
+        }
+        uint64_t elapsed = microseconds() - start;
+        pthread_mutex_unlock(&g_Lock);
+
+        total += elapsed;
+        if (elapsed > worst)
+        {
+            worst = elapsed;
+        }
+    }
+
+    pthread_mutex_lock(&g_Lock);
+    g_Stop = 1;
+    pthread_cond_broadcast(&g_Cond);
+    pthread_mutex_unlock(&g_Lock);
+
+    for (int i = 0; i < waiters; ++i)
+    {
+        pthread_join(threads[i], NULL);
+    }
+    free(threads);
+
+    printf(
+        "broadcast: %d waiters, %d broadcasts, average %llu us, worst %llu "
+        "us to wake all\n",
+        waiters, broadcasts, (unsigned long long) (total / broadcasts),
+        (unsigned long long) worst);
+}
+
+int main(int argc, char *argv[])
+{
+    int roundTrips = DEFAULT_ROUNDTRIPS;
+    int waiters = DEFAULT_WAITERS;
+    int broadcasts = DEFAULT_BROADCASTS;
+
+    if (argc > 1)
+    {
+        roundTrips = atoi(argv[1]);
+    }
+    if (argc > 2)
+    {
+        waiters = atoi(argv[2]);
+    }
+    if (argc > 3)
+    {
+        broadcasts = atoi(argv[3]);
+    }
+
+    if (roundTrips <= 0 || waiters <= 0 || broadcasts <= 0)
+    {
+        fprintf(
+            stderr, "usage: %s [round trips] [waiters] [broadcasts]\n",
+            argv[0]);
+        return 1;
+    }
+
+    pingPong(roundTrips);
+    broadcast(waiters, broadcasts);
+
+    return 0;
+}
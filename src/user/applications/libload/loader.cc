@@ -27,6 +27,7 @@
 #include <sys/klog.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
+#include <sys/time.h>
 #include <unistd.h>
 
 #include <list>
@@ -68,6 +69,7 @@ typedef struct _object_meta
           dyn_strtab_sz(0), rela(0), rel(0), rela_sz(0), rel_sz(0),
           uses_rela(false), got(0), plt_rela(0), plt_rel(0), init_func(0),
           fini_func(0), plt_sz(0), hash(0), hash_buckets(0), hash_chains(0),
+          gnu_hash(0), gnu_bloom(0), gnu_buckets(0), gnu_chains(0),
           preloads(), objects(), parent(0)
     {
     }
@@ -132,12 +134,57 @@ typedef struct _object_meta
     const Elf_Word *hash_buckets;
     const Elf_Word *hash_chains;
 
+    const ElfGnuHash_t *gnu_hash;
+    const uintptr_t *gnu_bloom;
+    const Elf_Word *gnu_buckets;
+    const Elf_Word *gnu_chains;
+
     std::list<struct _object_meta *> preloads;
     std::list<struct _object_meta *> objects;
 
     struct _object_meta *parent;
 } object_meta_t;
 
+/** Hashes of a symbol name, computed once per lookup rather than once for
+ * every object searched. The SysV hash is only needed for objects without a
+ * GNU hash table, so it is computed on demand. */
+typedef struct _symbol_hashes
+{
+    _symbol_hashes(const char *symbol);
+
+    const char *name;
+    uint32_t gnu;
+    size_t elf;
+    bool has_elf;
+} symbol_hashes_t;
+
+/** Result of searching the global scope (preloads, the main object, then the
+ * objects it loaded) for a symbol. */
+typedef struct _symbol_cache_entry
+{
+    _symbol_cache_entry() : owner(0), sym(), weak(false)
+    {
+    }
+
+    /// Object providing the symbol, or null if nothing does.
+    struct _object_meta *owner;
+    ElfSymbol_t sym;
+    /// Only a weak definition exists.
+    bool weak;
+} symbol_cache_entry_t;
+
+/** Counters reported with LD_DEBUG=statistics. */
+typedef struct _load_statistics
+{
+    size_t relocations;
+    size_t lookups;
+    size_t cache_hits;
+    size_t objects_searched;
+    size_t bloom_rejections;
+    size_t chain_probes;
+    uint64_t relocation_time;
+} load_statistics_t;
+
 #define IS_NOT_PAGE_ALIGNED(x) (((x) & (getpagesize() - 1)) != 0)
 
 extern "C" void *pedigree_sys_request_mem(size_t len);
@@ -157,6 +204,10 @@ bool lookupSymbol(
     const char *symbol, object_meta_t *meta, ElfSymbol_t &sym, bool bWeak,
     bool bGlobal = true);
 
+bool lookupSymbol(
+    symbol_hashes_t &hashes, object_meta_t *meta, ElfSymbol_t &sym,
+    bool bWeak, bool bGlobal = true);
+
 void doRelocation(object_meta_t *meta);
 
 uintptr_t doThisRelocation(ElfRel_t rel, object_meta_t *meta);
@@ -165,6 +216,9 @@ uintptr_t doThisRelocation(ElfRela_t rel, object_meta_t *meta);
 std::string symbolName(
     const ElfSymbol_t &sym, object_meta_t *meta, bool bNoDynamic = false);
 
+const char *symbolNameRaw(
+    const ElfSymbol_t &sym, object_meta_t *meta, bool bNoDynamic = false);
+
 std::string findObject(std::string name, bool envpath);
 
 extern "C" void *_libload_dlopen(const char *file, int mode);
@@ -181,6 +235,12 @@ std::set<std::string> g_LoadedObjects;
 
 std::map<std::string, uintptr_t> g_LibLoadSymbols;
 
+/// Global scope lookups, invalidated whenever an object is loaded.
+std::map<std::string, symbol_cache_entry_t> g_SymbolCache;
+
+load_statistics_t g_Statistics;
+bool g_bStatistics = false;
+
 extern char __elf_start;
 extern char __start_bss;
 extern char __end_bss;
@@ -203,6 +263,29 @@ size_t elfhash(const char *name)
     return h;
 }
 
+uint32_t gnuhash(const char *name)
+{
+    uint32_t h = 5381;
+    while (*name)
+    {
+        h = (h << 5) + h + static_cast<uint8_t>(*name++);
+    }
+
+    return h;
+}
+
+_symbol_hashes::_symbol_hashes(const char *symbol)
+    : name(symbol), gnu(gnuhash(symbol)), elf(0), has_elf(false)
+{
+}
+
+static uint64_t microseconds()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (tv.tv_sec * 1000000ULL) + tv.tv_usec;
+}
+
 extern char **environ;
 
 /**
@@ -246,6 +329,8 @@ extern "C" int main(int argc, const char *argv[])
     klog(LOG_INFO, "libload.so starting...");
 #endif
 
+    uint64_t startTime = microseconds();
+
     char *ld_libpath = getenv("LD_LIBRARY_PATH");
     char *ld_preload = getenv("LD_PRELOAD");
     char *ld_debug = getenv("LD_DEBUG");
@@ -271,7 +356,9 @@ extern "C" int main(int argc, const char *argv[])
         }
     }
 
-    if (ld_debug)
+    g_bStatistics = ld_debug && strstr(ld_debug, "statistics");
+
+    if (ld_debug && strcmp(ld_debug, "statistics"))
     {
         fprintf(stderr, "libload.so: search path is\n");
         for (std::list<std::string>::iterator it = g_lSearchPaths.begin();
@@ -356,6 +443,8 @@ extern "C" int main(int argc, const char *argv[])
     klog(LOG_INFO, "libload.so relocating dependencies");
 #endif
 
+    uint64_t relocStartTime = microseconds();
+
     // Relocate preloads.
     for (std::list<struct _object_meta *>::iterator it = meta->preloads.begin();
          it != meta->preloads.end(); ++it)
@@ -377,6 +466,32 @@ extern "C" int main(int argc, const char *argv[])
     // Do initial relocation of the binary (non-GOT entries)
     doRelocation(meta);
 
+    g_Statistics.relocation_time = microseconds() - relocStartTime;
+
+    if (g_bStatistics)
+    {
+        uint64_t totalTime = microseconds() - startTime;
+        fprintf(stderr, "libload.so: runtime linker statistics:\n");
+        fprintf(
+            stderr, "  total startup time in dynamic loader: %llu us\n",
+            static_cast<unsigned long long>(totalTime));
+        fprintf(
+            stderr, "            time needed for relocation: %llu us\n",
+            static_cast<unsigned long long>(g_Statistics.relocation_time));
+        fprintf(
+            stderr, "                 number of relocations: %zd\n",
+            g_Statistics.relocations);
+        fprintf(
+            stderr, "  number of symbol lookups: %zd (%zd from cache)\n",
+            g_Statistics.lookups, g_Statistics.cache_hits);
+        fprintf(
+            stderr,
+            "  objects searched: %zd, bloom rejections: %zd, "
+            "chain probes: %zd\n",
+            g_Statistics.objects_searched, g_Statistics.bloom_rejections,
+            g_Statistics.chain_probes);
+    }
+
     // All done - run the program!
     meta->running = true;
 
@@ -529,6 +644,9 @@ bool loadSharedObjectHelper(
         parent->objects.push_back(object);
         g_LoadedObjects.insert(object->filename);
 
+        // The global scope just changed.
+        g_SymbolCache.clear();
+
         if (object->needed.size())
         {
             for (std::list<std::string>::iterator it = object->needed.begin();
@@ -1006,6 +1124,22 @@ bool loadObject(const char *filename, object_meta_t *meta, bool envpath)
                      (sizeof(Elf_Word) * meta->hash->nbucket)];
             }
         }
+        else if (meta->shdrs[i].type == SHT_GNU_HASH)
+        {
+            uintptr_t vaddr = meta->shdrs[meta->shdrs[i].link].addr;
+            if (((uintptr_t) meta->dyn_symtab) == vaddr)
+            {
+                const char *base = &pBuffer[meta->shdrs[i].offset];
+                meta->gnu_hash = (const ElfGnuHash_t *) base;
+                meta->gnu_bloom =
+                    (const uintptr_t *) &base[sizeof(ElfGnuHash_t)];
+                meta->gnu_buckets =
+                    (const Elf_Word *) &meta
+                        ->gnu_bloom[meta->gnu_hash->bloom_size];
+                meta->gnu_chains =
+                    &meta->gnu_buckets[meta->gnu_hash->nbuckets];
+            }
+        }
     }
 
     // Patch up the GOT so we can start resolving symbols when needed.
@@ -1021,80 +1155,148 @@ bool loadObject(const char *filename, object_meta_t *meta, bool envpath)
     return true;
 }
 
-bool lookupSymbol(
-    const char *symbol, object_meta_t *meta, ElfSymbol_t &sym, bool bWeak,
-    bool bGlobal)
+/** Whether a symbol with a matching name satisfies the given pass of a
+ * lookup: local (and optionally weak) definitions first, then global ones. */
+static bool symbolAcceptable(const ElfSymbol_t &sym, bool bWeak, bool bGlobal)
 {
-    if (!meta)
+    if (bGlobal)
     {
-        return false;
+        return (ST_BIND(sym.info) == STB_GLOBAL) && sym.shndx;
     }
 
-    // Allow preloads to override the main object symbol table, as well as any
-    // others.
-    for (std::list<object_meta_t *>::iterator it = meta->preloads.begin();
-         it != meta->preloads.end(); ++it)
+    if ((ST_BIND(sym.info) == STB_LOCAL) && sym.shndx)
     {
-        if (lookupSymbol(symbol, *it, sym, false))
-            return true;
+        return true;
     }
 
-    std::string sname(symbol);
+    return bWeak && (ST_BIND(sym.info) == STB_WEAK);
+}
 
-    size_t hash = elfhash(symbol);
-    size_t y = meta->hash_buckets[hash % meta->hash->nbucket];
-    if (y > meta->hash->nchain)
+/** Searches the dynamic symbol table of one object, using its GNU hash table
+ * (and bloom filter) where present and the SysV one otherwise. */
+static bool findInObject(
+    symbol_hashes_t &hashes, object_meta_t *meta, ElfSymbol_t &sym,
+    bool bWeak, bool bGlobal)
+{
+    if (meta->gnu_hash)
     {
-        return false;
-    }
+        const ElfGnuHash_t *gh = meta->gnu_hash;
+        if (!(gh->nbuckets && gh->bloom_size))
+        {
+            return false;
+        }
 
-    // Try a local lookup first.
-    do
-    {
-        sym = meta->dyn_symtab[y];
-        if (symbolName(sym, meta) == sname)
+        // Bloom filter: two bits per symbol in one word. If either is clear,
+        // the object certainly doesn't define the symbol.
+        const size_t bits = sizeof(uintptr_t) * 8;
+        uintptr_t word = meta->gnu_bloom[(hashes.gnu / bits) % gh->bloom_size];
+        uintptr_t one = 1;
+        uintptr_t mask = (one << (hashes.gnu % bits)) |
+                         (one << ((hashes.gnu >> gh->bloom_shift) % bits));
+        if ((word & mask) != mask)
         {
-            if (ST_BIND(sym.info) == STB_LOCAL)
+            ++g_Statistics.bloom_rejections;
+            return false;
+        }
+
+        Elf_Word idx = meta->gnu_buckets[hashes.gnu % gh->nbuckets];
+        if (idx < gh->symoffset)
+        {
+            return false;
+        }
+
+        // Chains hold the hash of each symbol with the low bit marking the
+        // end of the chain, so most names never need to be compared.
+        while (true)
+        {
+            ++g_Statistics.chain_probes;
+            Elf_Word chainHash = meta->gnu_chains[idx - gh->symoffset];
+            if ((chainHash | 1) == (hashes.gnu | 1))
             {
-                if (sym.shndx)
+                const ElfSymbol_t &candidate = meta->dyn_symtab[idx];
+                if (!strcmp(symbolNameRaw(candidate, meta), hashes.name) &&
+                    symbolAcceptable(candidate, bWeak, bGlobal))
                 {
-                    break;
+                    sym = candidate;
+                    return true;
                 }
             }
-            if (bWeak)
+
+            if (chainHash & 1)
             {
-                if (ST_BIND(sym.info) == STB_WEAK)
-                {
-                    // sym.value = ~0UL;
-                    break;
-                }
+                break;
             }
+
+            ++idx;
         }
-        y = meta->hash_chains[y];
-    } while (y != 0);
 
-    // No local symbols found - try a global lookup.
-    if ((bGlobal) && (y == 0))
+        return false;
+    }
+
+    if (!meta->hash || !meta->hash->nbucket)
     {
-        y = meta->hash_buckets[hash % meta->hash->nbucket];
-        do
+        return false;
+    }
+
+    if (!hashes.has_elf)
+    {
+        hashes.elf = elfhash(hashes.name);
+        hashes.has_elf = true;
+    }
+
+    for (Elf_Word y = meta->hash_buckets[hashes.elf % meta->hash->nbucket];
+         y && (y < meta->hash->nchain); y = meta->hash_chains[y])
+    {
+        ++g_Statistics.chain_probes;
+        const ElfSymbol_t &candidate = meta->dyn_symtab[y];
+        if (!strcmp(symbolNameRaw(candidate, meta), hashes.name) &&
+            symbolAcceptable(candidate, bWeak, bGlobal))
         {
-            sym = meta->dyn_symtab[y];
-            if (symbolName(sym, meta) == sname)
-            {
-                if (ST_BIND(sym.info) == STB_GLOBAL)
-                {
-                    if (sym.shndx)
-                    {
-                        break;
-                    }
-                }
-            }
-            y = meta->hash_chains[y];
-        } while (y != 0);
+            sym = candidate;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool lookupSymbol(
+    const char *symbol, object_meta_t *meta, ElfSymbol_t &sym, bool bWeak,
+    bool bGlobal)
+{
+    symbol_hashes_t hashes(symbol);
+    return lookupSymbol(hashes, meta, sym, bWeak, bGlobal);
+}
+
+bool lookupSymbol(
+    symbol_hashes_t &hashes, object_meta_t *meta, ElfSymbol_t &sym,
+    bool bWeak, bool bGlobal)
+{
+    if (!meta)
+    {
+        return false;
+    }
+
+    // Allow preloads to override the main object symbol table, as well as any
+    // others.
+    for (std::list<object_meta_t *>::iterator it = meta->preloads.begin();
+         it != meta->preloads.end(); ++it)
+    {
+        if (lookupSymbol(hashes, *it, sym, false))
+            return true;
+    }
+
+    ++g_Statistics.objects_searched;
+
+    // Try a local lookup first, and if no local symbols are found, a global
+    // lookup.
+    bool bFound = findInObject(hashes, meta, sym, bWeak, false);
+    if (!bFound && bGlobal)
+    {
+        bFound = findInObject(hashes, meta, sym, false, true);
     }
 
-    if (y != 0)
+    if (bFound)
     {
         // Patch up the value.
         if (ST_TYPE(sym.info) < 3)
@@ -1106,53 +1308,132 @@ bool lookupSymbol(
         }
     }
 
-    return y != 0;
+    return bFound;
 }
 
-bool findSymbol(
-    const char *symbol, object_meta_t *meta, ElfSymbol_t &sym,
-    LookupPolicy policy)
+static bool isPreload(object_meta_t *ext_meta, object_meta_t *meta)
 {
-    if (!meta)
+    for (std::list<object_meta_t *>::iterator it = ext_meta->preloads.begin();
+         it != ext_meta->preloads.end(); ++it)
     {
-        return false;
+        if (*it == meta)
+            return true;
     }
 
-    // Do we override or not?
-    std::map<std::string, uintptr_t>::iterator it =
-        g_LibLoadSymbols.find(std::string(symbol));
-    if (it != g_LibLoadSymbols.end())
+    return false;
+}
+
+static bool isInGlobalScope(object_meta_t *ext_meta, object_meta_t *meta)
+{
+    if (meta == ext_meta)
+        return true;
+
+    for (std::list<object_meta_t *>::iterator it = ext_meta->objects.begin();
+         it != ext_meta->objects.end(); ++it)
     {
-        if (it->first == symbol)
-        {
-            sym.value = it->second;
+        if (*it == meta)
             return true;
+    }
+
+    return false;
+}
+
+/** Searches the global scope for a symbol, in the order findSymbol does but
+ * without regard for which object is asking. The answer is the same for
+ * every object, so it's cached until the next object is loaded. */
+static const symbol_cache_entry_t &
+globalLookup(symbol_hashes_t &hashes, object_meta_t *ext_meta)
+{
+    std::map<std::string, symbol_cache_entry_t>::iterator cached =
+        g_SymbolCache.find(std::string(hashes.name));
+    if (cached != g_SymbolCache.end())
+    {
+        ++g_Statistics.cache_hits;
+        return cached->second;
+    }
+
+    symbol_cache_entry_t entry;
+
+    // Strong definitions: preloads, then the main object, then the rest.
+    for (std::list<object_meta_t *>::iterator it = ext_meta->preloads.begin();
+         it != ext_meta->preloads.end(); ++it)
+    {
+        if (lookupSymbol(hashes, *it, entry.sym, false))
+        {
+            entry.owner = *it;
+            break;
         }
     }
 
-    object_meta_t *ext_meta = meta;
-    while (ext_meta->parent)
+    if (!entry.owner && lookupSymbol(hashes, ext_meta, entry.sym, false))
     {
-        ext_meta = ext_meta->parent;
+        entry.owner = ext_meta;
+    }
+
+    if (!entry.owner)
+    {
+        for (std::list<object_meta_t *>::iterator it =
+                 ext_meta->objects.begin();
+             it != ext_meta->objects.end(); ++it)
+        {
+            if (lookupSymbol(hashes, *it, entry.sym, false))
+            {
+                entry.owner = *it;
+                break;
+            }
+        }
+    }
+
+    // Weak definitions: the loaded objects, then the main object.
+    if (!entry.owner)
+    {
+        for (std::list<object_meta_t *>::iterator it =
+                 ext_meta->objects.begin();
+             it != ext_meta->objects.end(); ++it)
+        {
+            if (lookupSymbol(hashes, *it, entry.sym, true))
+            {
+                entry.owner = *it;
+                entry.weak = true;
+                break;
+            }
+        }
+    }
+
+    if (!entry.owner && lookupSymbol(hashes, ext_meta, entry.sym, true))
+    {
+        entry.owner = ext_meta;
+        entry.weak = true;
     }
 
+    return g_SymbolCache
+        .insert(std::make_pair(std::string(hashes.name), entry))
+        .first->second;
+}
+
+/** The full lookup order of findSymbol, for when the asking object is the
+ * one the global scope would otherwise find (and must sometimes skip). */
+static bool findSymbolUncached(
+    symbol_hashes_t &hashes, object_meta_t *meta, object_meta_t *ext_meta,
+    ElfSymbol_t &sym, LookupPolicy policy)
+{
     // Try preloads.
     for (std::list<object_meta_t *>::iterator it = ext_meta->preloads.begin();
          it != ext_meta->preloads.end(); ++it)
     {
-        if (lookupSymbol(symbol, *it, sym, false))
+        if (lookupSymbol(hashes, *it, sym, false))
             return true;
     }
 
     // If we are allowed, check for non-weak symbols in this binary.
     if (policy != NotThisObject && policy != LocalLast)
     {
-        if (lookupSymbol(symbol, meta, sym, false, false))
+        if (lookupSymbol(hashes, meta, sym, false, false))
             return true;
     }
 
     // Try the parent object.
-    if ((meta != ext_meta) && lookupSymbol(symbol, ext_meta, sym, false))
+    if ((meta != ext_meta) && lookupSymbol(hashes, ext_meta, sym, false))
         return true;
 
     // Now, try any loaded objects we might have.
@@ -1162,7 +1443,7 @@ bool findSymbol(
         if (*it == meta)
             continue;  // Already handling.
 
-        if (lookupSymbol(symbol, *it, sym, false))
+        if (lookupSymbol(hashes, *it, sym, false))
         {
             return true;
         }
@@ -1171,7 +1452,7 @@ bool findSymbol(
     // Try a local lookup if not found.
     if (policy == LocalLast)
     {
-        if (lookupSymbol(symbol, meta, sym, false, false))
+        if (lookupSymbol(hashes, meta, sym, false, false))
             return true;
     }
 
@@ -1182,36 +1463,104 @@ bool findSymbol(
         if (*it == meta)
             continue;  // Already handling this object.
 
-        if (lookupSymbol(symbol, *it, sym, true))
+        if (lookupSymbol(hashes, *it, sym, true))
         {
             return true;
         }
     }
 
     // Try weak symbols in the parent object.
-    if ((meta != ext_meta) && lookupSymbol(symbol, ext_meta, sym, true))
+    if ((meta != ext_meta) && lookupSymbol(hashes, ext_meta, sym, true))
         return true;
 
     // No luck? Try weak symbols in the main object.
     if (policy != NotThisObject)
     {
-        if (lookupSymbol(symbol, meta, sym, true))
+        if (lookupSymbol(hashes, meta, sym, true))
             return true;
     }
 
     return false;
 }
 
+bool findSymbol(
+    const char *symbol, object_meta_t *meta, ElfSymbol_t &sym,
+    LookupPolicy policy)
+{
+    if (!meta)
+    {
+        return false;
+    }
+
+    ++g_Statistics.lookups;
+
+    // Do we override or not?
+    std::map<std::string, uintptr_t>::iterator it =
+        g_LibLoadSymbols.find(std::string(symbol));
+    if (it != g_LibLoadSymbols.end())
+    {
+        if (it->first == symbol)
+        {
+            sym.value = it->second;
+            return true;
+        }
+    }
+
+    object_meta_t *ext_meta = meta;
+    while (ext_meta->parent)
+    {
+        ext_meta = ext_meta->parent;
+    }
+
+    symbol_hashes_t hashes(symbol);
+
+    // The global scope gives the answer unless this object is the one it
+    // found, in which case the lookup policy decides whether to skip it.
+    const symbol_cache_entry_t &entry = globalLookup(hashes, ext_meta);
+    if ((entry.owner == meta) || !isInGlobalScope(ext_meta, meta))
+    {
+        return findSymbolUncached(hashes, meta, ext_meta, sym, policy);
+    }
+
+    // Preloads always win.
+    if (entry.owner && !entry.weak && isPreload(ext_meta, entry.owner))
+    {
+        sym = entry.sym;
+        return true;
+    }
+
+    // Local definitions come before anything else in the global scope.
+    if (policy == LocalFirst)
+    {
+        if (lookupSymbol(hashes, meta, sym, false, false))
+            return true;
+    }
+
+    if (entry.owner)
+    {
+        sym = entry.sym;
+        return true;
+    }
+
+    return false;
+}
+
 std::string
 symbolName(const ElfSymbol_t &sym, object_meta_t *meta, bool bNoDynamic)
+{
+    return std::string(symbolNameRaw(sym, meta, bNoDynamic));
+}
+
+const char *
+symbolNameRaw(const ElfSymbol_t &sym, object_meta_t *meta, bool bNoDynamic)
 {
     if (!meta)
     {
-        return std::string("");
+        return "";
     }
     else if (sym.name == 0)
     {
-        return std::string("");
+        return "";
     }
 
     const char *strtab = meta->strtab;
@@ -1225,8 +1574,7 @@ symbolName(const ElfSymbol_t &sym, object_meta_t *meta, bool bNoDynamic)
         strtab = meta->dyn_strtab;
     }
 
-    const char *name = strtab + sym.name;
-    return std::string(name);
+    return strtab + sym.name;
 }
 
 void doRelocation(object_meta_t *meta)
@@ -1339,6 +1687,8 @@ void doRelocation(object_meta_t *meta)
 
 uintptr_t doThisRelocation(ElfRel_t rel, object_meta_t *meta)
 {
+    ++g_Statistics.relocations;
+
     const ElfSymbol_t *symtab = meta->symtab;
     if (meta->dyn_symtab)
     {
@@ -1449,6 +1799,8 @@ uintptr_t doThisRelocation(ElfRel_t rel, object_meta_t *meta)
 
 uintptr_t doThisRelocation(ElfRela_t rel, object_meta_t *meta)
 {
+    ++g_Statistics.relocations;
+
     const ElfSymbol_t *symtab = meta->symtab;
     if (meta->dyn_symtab)
     {
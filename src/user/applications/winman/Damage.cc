@@ -0,0 +1,300 @@
+/*
+ * Copyright (c) 2008-2014, Pedigree Developers
+ *
+ * Please see the CONTRIB file in the root of the source tree for a full
+ * list of contributors.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "Damage.h"
+
+bool DamageRect::intersects(const DamageRect &other) const
+{
+    if (empty() || other.empty())
+    {
+        return false;
+    }
+
+    return (x < other.getX2()) && (other.x < getX2()) && (y < other.getY2()) &&
+           (other.y < getY2());
+}
+
+bool DamageRect::contains(const DamageRect &other) const
+{
+    if (other.empty())
+    {
+        return true;
+    }
+
+    return (x <= other.x) && (y <= other.y) && (getX2() >= other.getX2()) &&
+           (getY2() >= other.getY2());
+}
+
+DamageRect DamageRect::intersection(const DamageRect &other) const
+{
+    if (!intersects(other))
+    {
+        return DamageRect();
+    }
+
+    size_t newX = x > other.x ? x : other.x;
+    size_t newY = y > other.y ? y : other.y;
+    size_t newX2 = getX2() < other.getX2() ? getX2() : other.getX2();
+    size_t newY2 = getY2() < other.getY2() ? getY2() : other.getY2();
+
+    return DamageRect(newX, newY, newX2 - newX, newY2 - newY);
+}
+
+DamageRect DamageRect::bounds(const DamageRect &other) const
+{
+    if (empty())
+    {
+        return other;
+    }
+    else if (other.empty())
+    {
+        return *this;
+    }
+
+    size_t newX = x < other.x ? x : other.x;
+    size_t newY = y < other.y ? y : other.y;
+    size_t newX2 = getX2() > other.getX2() ? getX2() : other.getX2();
+    size_t newY2 = getY2() > other.getY2() ? getY2() : other.getY2();
+
+    return DamageRect(newX, newY, newX2 - newX, newY2 - newY);
+}
+
+DamageRegion::DamageRegion() : m_Rects()
+{
+}
+
+DamageRegion::~DamageRegion()
+{
+}
+
+void DamageRegion::split(
+    const DamageRect &rt, const DamageRect &hole, RectList_t &out)
+{
+    DamageRect overlap = rt.intersection(hole);
+    if (overlap.empty())
+    {
+        out.push_back(rt);
+        return;
+    }
+
+    // Full-width bands above and below the overlap, then the pieces to the
+    // left and right of it within the overlap's rows.
+    if (overlap.y > rt.y)
+    {
+        out.push_back(DamageRect(rt.x, rt.y, rt.w, overlap.y - rt.y));
+    }
+    if (overlap.getY2() < rt.getY2())
+    {
+        out.push_back(DamageRect(
+            rt.x, overlap.getY2(), rt.w, rt.getY2() - overlap.getY2()));
+    }
+    if (overlap.x > rt.x)
+    {
+        out.push_back(
+            DamageRect(rt.x, overlap.y, overlap.x - rt.x, overlap.h));
+    }
+    if (overlap.getX2() < rt.getX2())
+    {
+        out.push_back(DamageRect(
+            overlap.getX2(), overlap.y, rt.getX2() - overlap.getX2(),
+            overlap.h));
+    }
+}
+
+bool DamageRegion::coalesce(const DamageRect &rt)
+{
+    for (RectList_t::iterator it = m_Rects.begin(); it != m_Rects.end(); ++it)
+    {
+        DamageRect &existing = *it;
+        if ((existing.y == rt.y) && (existing.h == rt.h))
+        {
+            if (existing.getX2() == rt.x)
+            {
+                existing.w += rt.w;
+                return true;
+            }
+            else if (rt.getX2() == existing.x)
+            {
+                existing.x = rt.x;
+                existing.w += rt.w;
+                return true;
+            }
+        }
+        else if ((existing.x == rt.x) && (existing.w == rt.w))
+        {
+            if (existing.getY2() == rt.y)
+            {
+                existing.h += rt.h;
+                return true;
+            }
+            else if (rt.getY2() == existing.y)
+            {
+                existing.y = rt.y;
+                existing.h += rt.h;
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+void DamageRegion::add(const DamageRect &rt)
+{
+    if (rt.empty())
+    {
+        return;
+    }
+
+    // Drop any existing rectangles the new one swallows entirely.
+    for (RectList_t::iterator it = m_Rects.begin(); it != m_Rects.end();)
+    {
+        if (rt.contains(*it))
+        {
+            it = m_Rects.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+
+    // Cut away the parts of the new rectangle that are already damaged.
+    RectList_t pieces, remaining;
+    pieces.push_back(rt);
+    for (size_t i = 0; i < m_Rects.size() && !pieces.empty(); ++i)
+    {
+        remaining.clear();
+        for (size_t j = 0; j < pieces.size(); ++j)
+        {
+            split(pieces[j], m_Rects[i], remaining);
+        }
+        pieces.swap(remaining);
+    }
+
+    for (size_t i = 0; i < pieces.size(); ++i)
+    {
+        if (!coalesce(pieces[i]))
+        {
+            m_Rects.push_back(pieces[i]);
+        }
+    }
+
+    if (m_Rects.size() > MaxRects)
+    {
+        DamageRect all = bounds();
+        m_Rects.clear();
+        m_Rects.push_back(all);
+    }
+}
+
+void DamageRegion::add(const DamageRegion &other)
+{
+    for (size_t i = 0; i < other.m_Rects.size(); ++i)
+    {
+        add(other.m_Rects[i]);
+    }
+}
+
+void DamageRegion::subtract(const DamageRect &rt)
+{
+    if (rt.empty())
+    {
+        return;
+    }
+
+    RectList_t result;
+    for (size_t i = 0; i < m_Rects.size(); ++i)
+    {
+        split(m_Rects[i], rt, result);
+    }
+    m_Rects.swap(result);
+}
+
+void DamageRegion::intersect(const DamageRect &rt)
+{
+    RectList_t result;
+    for (size_t i = 0; i < m_Rects.size(); ++i)
+    {
+        DamageRect overlap = m_Rects[i].intersection(rt);
+        if (!overlap.empty())
+        {
+            result.push_back(overlap);
+        }
+    }
+    m_Rects.swap(result);
+}
+
+void DamageRegion::translate(size_t dx, size_t dy)
+{
+    for (size_t i = 0; i < m_Rects.size(); ++i)
+    {
+        m_Rects[i].x += dx;
+        m_Rects[i].y += dy;
+    }
+}
+
+bool DamageRegion::intersects(const DamageRect &rt) const
+{
+    for (size_t i = 0; i < m_Rects.size(); ++i)
+    {
+        if (m_Rects[i].intersects(rt))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool DamageRegion::contains(const DamageRect &rt) const
+{
+    // Whatever is left after removing our coverage is the uncovered part.
+    DamageRegion uncovered;
+    uncovered.m_Rects.push_back(rt);
+    for (size_t i = 0; i < m_Rects.size() && !uncovered.empty(); ++i)
+    {
+        uncovered.subtract(m_Rects[i]);
+    }
+
+    return uncovered.empty();
+}
+
+size_t DamageRegion::area() const
+{
+    // Rectangles never overlap, so the area is a straight sum.
+    size_t total = 0;
+    for (size_t i = 0; i < m_Rects.size(); ++i)
+    {
+        total += m_Rects[i].area();
+    }
+
+    return total;
+}
+
+DamageRect DamageRegion::bounds() const
+{
+    DamageRect result;
+    for (size_t i = 0; i < m_Rects.size(); ++i)
+    {
+        result = result.bounds(m_Rects[i]);
+    }
+
+    return result;
+}
@@ -0,0 +1,155 @@
+/*
+ * Copyright (c) 2008-2014, Pedigree Developers
+ *
+ * Please see the CONTRIB file in the root of the source tree for a full
+ * list of contributors.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef _WINMAN_DAMAGE_H
+#define _WINMAN_DAMAGE_H
+
+#include <stddef.h>
+
+#include <vector>
+
+/** \addtogroup PedigreeGUI
+ *  @{
+ */
+
+/**
+ * DamageRect: a simple rectangle for region arithmetic. Unlike
+ * PedigreeGraphics::Rect this is a plain value type, so regions can be built
+ * and thrown away every frame without any overhead.
+ */
+struct DamageRect
+{
+    DamageRect() : x(0), y(0), w(0), h(0)
+    {
+    }
+
+    DamageRect(size_t x_, size_t y_, size_t w_, size_t h_)
+        : x(x_), y(y_), w(w_), h(h_)
+    {
+    }
+
+    size_t getX2() const
+    {
+        return x + w;
+    }
+    size_t getY2() const
+    {
+        return y + h;
+    }
+
+    bool empty() const
+    {
+        return !w || !h;
+    }
+
+    size_t area() const
+    {
+        return w * h;
+    }
+
+    bool intersects(const DamageRect &other) const;
+
+    bool contains(const DamageRect &other) const;
+
+    /// Returns the overlap between this rectangle and the other (may be empty).
+    DamageRect intersection(const DamageRect &other) const;
+
+    /// Returns the smallest rectangle that covers both rectangles.
+    DamageRect bounds(const DamageRect &other) const;
+
+    size_t x, y;
+    size_t w, h;
+};
+
+/**
+ * DamageRegion: a set of non-overlapping rectangles describing the parts of
+ * the screen (or a window) that need to be redrawn.
+ *
+ * Unlike DirtyRectangle, two small updates at opposite corners of the screen
+ * stay as two small rectangles rather than growing into the whole screen.
+ * The number of rectangles is capped; once the cap is hit the region falls
+ * back to its bounding box, which is always a correct (if pessimistic)
+ * answer.
+ */
+class DamageRegion
+{
+  public:
+    typedef std::vector<DamageRect> RectList_t;
+
+    /// Past this many rectangles, the region collapses to its bounds.
+    static const size_t MaxRects = 32;
+
+    DamageRegion();
+    ~DamageRegion();
+
+    /// Union the given rectangle into the region.
+    void add(const DamageRect &rt);
+
+    /// Union another region into this region.
+    void add(const DamageRegion &other);
+
+    /// Remove the given rectangle from the region.
+    void subtract(const DamageRect &rt);
+
+    /// Clip the region to the given rectangle.
+    void intersect(const DamageRect &rt);
+
+    /// Move every rectangle in the region by the given offset.
+    void translate(size_t dx, size_t dy);
+
+    bool intersects(const DamageRect &rt) const;
+
+    /// Whether the given rectangle is entirely covered by the region.
+    bool contains(const DamageRect &rt) const;
+
+    /// Total number of pixels covered by the region.
+    size_t area() const;
+
+    /// Smallest rectangle covering the entire region.
+    DamageRect bounds() const;
+
+    bool empty() const
+    {
+        return m_Rects.empty();
+    }
+
+    void clear()
+    {
+        m_Rects.clear();
+    }
+
+    const RectList_t &getRects() const
+    {
+        return m_Rects;
+    }
+
+  private:
+    /// Splits \p rt into up to four pieces that do not overlap \p hole.
+    static void
+    split(const DamageRect &rt, const DamageRect &hole, RectList_t &out);
+
+    /// Extends an existing rectangle if \p rt shares a full edge with it.
+    bool coalesce(const DamageRect &rt);
+
+    RectList_t m_Rects;
+};
+
+/** @} */
+
+#endif
@@ -81,7 +81,7 @@ void WObject::bump(ssize_t bumpX, ssize_t bumpY)
 Window::Window(
     uint64_t handle, int sock, struct sockaddr *sa, size_t sa_len,
     ::Container *pParent)
-    : m_Handle(handle), m_pParent(pParent), m_Framebuffer(0), m_Dirty(),
+    : m_Handle(handle), m_pParent(pParent), m_Framebuffer(0), m_Damage(),
       m_bPendingDecoration(false), m_bFocus(false), m_bRefresh(true),
       m_nRegionWidth(0), m_nRegionHeight(0), m_Socket(sock), m_Sa(sa),
       m_SaLen(sa_len)
@@ -209,9 +209,12 @@ void Window::setDirty(PedigreeGraphics::Rect &dirty)
         realH = clientH - realY;
     }
 
-    m_Dirty.update(
+    // Clients often send several small updates between frames (e.g. a
+    // cursor blink and a line of output); keep them all rather than only
+    // the most recent one.
+    m_Damage.add(DamageRect(
         realX + WINDOW_CLIENT_START_X, realY + WINDOW_CLIENT_START_Y, realW,
-        realH);
+        realH));
 }
 
 void Window::render(cairo_t *cr)
@@ -237,41 +240,24 @@ void Window::render(cairo_t *cr)
             (uint8_t *) pBuffer, CAIRO_FORMAT_ARGB32, regionWidth, regionHeight,
             stride);
 
-        PedigreeGraphics::Rect realDirty = getDirty();
-        size_t dirtyX = realDirty.getX();
-        size_t dirtyY = realDirty.getY();
-        size_t dirtyWidth = realDirty.getW();
-        size_t dirtyHeight = realDirty.getH();
-
-        // Adjust if the dirty rectangle is outside of the window area.
-        if (dirtyX < WINDOW_CLIENT_START_X)
-        {
-            dirtyX = WINDOW_CLIENT_START_X;
-        }
-        if (dirtyY < WINDOW_CLIENT_START_Y)
-        {
-            dirtyY = WINDOW_CLIENT_START_Y;
-        }
-        if ((dirtyX + dirtyWidth) > regionWidth)
-        {
-            dirtyWidth = regionWidth;
-        }
-        if ((dirtyY + dirtyHeight) > regionHeight)
-        {
-            dirtyHeight = regionHeight;
-        }
-
-        // Fix the dirty rectangle after adjustments.
-        realDirty.update(dirtyX, dirtyY, dirtyWidth, dirtyHeight);
+        // Only the client area can be updated from the client framebuffer.
+        DamageRegion damage = getDamage();
+        damage.intersect(DamageRect(
+            WINDOW_CLIENT_START_X, WINDOW_CLIENT_START_Y, regionWidth,
+            regionHeight));
 
         cairo_set_source_surface(
             cr, surface, me.getX() + WINDOW_CLIENT_START_X,
             me.getY() + WINDOW_CLIENT_START_Y);
 
-        // Clip to the dirty rectangle (don't update anything more)
-        cairo_rectangle(
-            cr, me.getX() + realDirty.getX(), me.getY() + realDirty.getY(),
-            realDirty.getW(), realDirty.getH());
+        // Clip to the damaged rectangles (don't update anything more)
+        const DamageRegion::RectList_t &rects = damage.getRects();
+        for (size_t i = 0; i < rects.size(); ++i)
+        {
+            cairo_rectangle(
+                cr, me.getX() + rects[i].x, me.getY() + rects[i].y,
+                rects[i].w, rects[i].h);
+        }
         cairo_clip(cr);
 
         // Clip to the window only (fixes rendering glitches during resize)
@@ -288,19 +274,9 @@ void Window::render(cairo_t *cr)
         cairo_restore(cr);
 
         // No longer dirty - rendered.
-        m_Dirty.update(0, 0, 0, 0);
+        m_Damage.clear();
 
-        // Send back a response to ACK any pending redraw that's waiting.
-        // We wait until after we perform the redraw to permit the client to
-        // continue, as it doesn't make sense for the client to keep hitting
-        // us with redraw messages when we aren't ready.
-        LibUiProtocol::WindowManagerMessage ackmsg;
-        memset(&ackmsg, 0, sizeof(ackmsg));
-        ackmsg.messageCode = LibUiProtocol::RequestRedraw;
-        ackmsg.widgetHandle = m_Handle;
-        ackmsg.messageSize = 0;
-        ackmsg.isResponse = true;
-        sendMessage((const char *) &ackmsg, sizeof(ackmsg));
+        ackRedraw();
     }
 
     if (m_bPendingDecoration)
@@ -358,6 +334,39 @@ void Window::render(cairo_t *cr)
     m_bPendingDecoration = false;
 }
 
+void Window::cull()
+{
+    if (!isDirty())
+    {
+        return;
+    }
+
+    // Nothing of the window is visible, so there is nothing to composite, but
+    // the client is still waiting to hear that its redraw was handled.
+    m_Damage.clear();
+    m_bPendingDecoration = false;
+
+    if (getFramebuffer() && m_bRefresh)
+    {
+        ackRedraw();
+    }
+}
+
+void Window::ackRedraw()
+{
+    // Send back a response to ACK any pending redraw that's waiting.
+    // We wait until after we perform the redraw to permit the client to
+    // continue, as it doesn't make sense for the client to keep hitting
+    // us with redraw messages when we aren't ready.
+    LibUiProtocol::WindowManagerMessage ackmsg;
+    memset(&ackmsg, 0, sizeof(ackmsg));
+    ackmsg.messageCode = LibUiProtocol::RequestRedraw;
+    ackmsg.widgetHandle = m_Handle;
+    ackmsg.messageSize = 0;
+    ackmsg.isResponse = true;
+    sendMessage((const char *) &ackmsg, sizeof(ackmsg));
+}
+
 void Window::focus()
 {
     m_bFocus = true;
@@ -44,6 +44,7 @@
 #include <map>
 #include <queue>
 #include <set>
+#include <vector>
 
 #include "pedigree/native/graphics/Graphics.h"
 #include "pedigree/native/input/Input.h"
@@ -147,14 +148,29 @@ void startClient()
     }
 }
 
-void fps()
+/**
+ * Called once per composited frame with the number of pixels that frame
+ * redrew and how long (in microseconds) it took to compose and flush. Logs
+ * frame rate and damage statistics every few seconds.
+ */
+void fps(size_t damagedPixels, uint64_t composeTime)
 {
     static unsigned int frames = 0;
     static unsigned int start_time = 0;
+    static uint64_t totalDamage = 0;
+    static uint64_t totalCompose = 0;
+    static uint64_t maxCompose = 0;
 
     struct timeval now;
     gettimeofday(&now, NULL);
     frames++;
+    totalDamage += damagedPixels;
+    totalCompose += composeTime;
+    if (composeTime > maxCompose)
+    {
+        maxCompose = composeTime;
+    }
+
     if (!start_time)
     {
         start_time = now.tv_sec;
@@ -166,8 +182,24 @@ void fps()
         klog(
             LOG_INFO, "%d frames in %3.1f seconds = %6.3f FPS", frames, seconds,
             fps);
+
+        uint64_t screenPixels = g_nWidth * g_nHeight;
+        uint64_t avgDamage = totalDamage / frames;
+        uint64_t damagePercent =
+            screenPixels ? (avgDamage * 100) / screenPixels : 0;
+        klog(
+            LOG_INFO,
+            "  damage: %llu px/frame (%llu%% of screen), compose: %llu "
+            "us/frame (max %llu us)",
+            (unsigned long long) avgDamage, (unsigned long long) damagePercent,
+            (unsigned long long) (totalCompose / frames),
+            (unsigned long long) maxCompose);
+
         start_time = now.tv_sec;
         frames = 0;
+        totalDamage = 0;
+        totalCompose = 0;
+        maxCompose = 0;
     }
 }
 
@@ -1227,7 +1259,6 @@ int main(int argc, char *argv[])
     startClient();
 
     // Main loop: logic & message handling goes here!
-    DirtyRectangle renderDirty;
     g_bAlive = true;
     while (g_bAlive)
     {
@@ -1238,47 +1269,119 @@ int main(int argc, char *argv[])
         if ((!g_PendingWindows.empty()) || g_StatusField.length() ||
             g_bCursorUpdate)
         {
-            // Render each window, also ensuring the wallpaper is rendered again
-            // so that windows with alpha look correct.
-            std::set<WObject *>::iterator it = g_PendingWindows.begin();
+            struct timeval composeStart;
+            gettimeofday(&composeStart, NULL);
+
+            // Anything outside the root container (e.g. under the info panel,
+            // or off the edge of the screen) can never be seen.
+            PedigreeGraphics::Rect rootRect =
+                g_pRootContainer->getCopyDimensions();
+            DamageRect visible(
+                rootRect.getX(), rootRect.getY(), rootRect.getW(),
+                rootRect.getH());
+
             size_t nDirty = g_StatusField.length() ? 1 : 0;
             if (g_bCursorUpdate)
                 ++nDirty;
+
+            // Containers render all of their children, so collect their
+            // damage first; windows entirely inside a pending container are
+            // then left for the container to composite.
+            DamageRegion frameDamage;
+            DamageRegion containerDamage;
+            std::vector<WObject *> toRender;
+            std::set<WObject *>::iterator it = g_PendingWindows.begin();
             for (; it != g_PendingWindows.end(); ++it)
             {
-                Window *pWindow = 0;
                 if ((*it)->getType() == WObject::Window)
                 {
-                    pWindow = static_cast<Window *>(*it);
+                    continue;
                 }
 
-                if (pWindow && !pWindow->isDirty())
+                PedigreeGraphics::Rect rt = (*it)->getCopyDimensions();
+                DamageRect damage =
+                    DamageRect(rt.getX(), rt.getY(), rt.getW(), rt.getH())
+                        .intersection(visible);
+                if (damage.empty())
                 {
                     continue;
                 }
-                else
+
+                ++nDirty;
+                containerDamage.add(damage);
+                toRender.push_back(*it);
+            }
+            frameDamage.add(containerDamage);
+
+            for (it = g_PendingWindows.begin(); it != g_PendingWindows.end();
+                 ++it)
+            {
+                if ((*it)->getType() != WObject::Window)
                 {
-                    ++nDirty;
+                    continue;
                 }
 
-                PedigreeGraphics::Rect rt = (*it)->getCopyDimensions();
-                PedigreeGraphics::Rect dirty = rt;
-                if (pWindow)
+                Window *pWindow = static_cast<Window *>(*it);
+                if (!pWindow->isDirty())
                 {
-                    dirty = pWindow->getDirty();
+                    continue;
                 }
 
-                // Render wallpaper.
+                PedigreeGraphics::Rect rt = pWindow->getCopyDimensions();
+                DamageRegion damage = pWindow->getDamage();
+                damage.translate(rt.getX(), rt.getY());
+                damage.intersect(visible);
+
+                if (damage.empty())
+                {
+                    // Entirely hidden - nothing to composite.
+                    pWindow->cull();
+                    continue;
+                }
+
+                ++nDirty;
+                frameDamage.add(damage);
+
+                bool bCovered = false;
+                const DamageRegion::RectList_t &rects = damage.getRects();
+                for (size_t i = 0; i < rects.size(); ++i)
+                {
+                    bCovered = containerDamage.contains(rects[i]);
+                    if (!bCovered)
+                    {
+                        break;
+                    }
+                }
+
+                if (!bCovered)
+                {
+                    toRender.push_back(pWindow);
+                }
+            }
+
+            // Empty out the list in full.
+            g_PendingWindows.clear();
+
+            // Only do rendering if we actually did some rendering!
+            if (!nDirty)
+            {
+                continue;
+            }
+
+            // Render the wallpaper under each damaged area exactly once, so
+            // that windows with alpha look correct.
+            const DamageRegion::RectList_t &rects = frameDamage.getRects();
+            for (size_t i = 0; i < rects.size(); ++i)
+            {
+                const DamageRect &dirty = rects[i];
                 if (wallpaper)
                 {
                     wallpaper->renderPartial(
-                        cr, rt.getX() + dirty.getX(), rt.getY() + dirty.getY(),
-                        0, 0, dirty.getW(), dirty.getH(), g_nWidth, g_nHeight);
+                        cr, dirty.x, dirty.y, 0, 0, dirty.w, dirty.h, g_nWidth,
+                        g_nHeight);
 #if DEBUG_REDRAWS
                     cairo_set_source_rgba(cr, 0, 0, 1.0, 1.0);
-                    cairo_rectangle(
-                        cr, rt.getX() + dirty.getX(), rt.getY() + dirty.getY(),
-                        dirty.getW(), dirty.getH());
+                    cairo_rectangle(cr, dirty.x, dirty.y, dirty.w, dirty.h);
                     cairo_stroke(cr);
 #endif
                 }
@@ -1286,39 +1389,24 @@ int main(int argc, char *argv[])
                 {
                     // Boring background.
                     cairo_set_source_rgba(cr, 0, 0, 1.0, 1.0);
-                    cairo_rectangle(
-                        cr, rt.getX() + dirty.getX(), rt.getY() + dirty.getY(),
-                        dirty.getW(), dirty.getH());
+                    cairo_rectangle(cr, dirty.x, dirty.y, dirty.w, dirty.h);
 #if DEBUG_REDRAWS
                     cairo_stroke_preserve(cr);
 #endif
                     cairo_fill(cr);
                 }
-
-                // Render window.
-                (*it)->render(cr);
-
-                // Update the dirty rectangle.
-                renderDirty.point(
-                    rt.getX() + dirty.getX(), rt.getX() + dirty.getY());
-                renderDirty.point(
-                    rt.getX() + dirty.getX() + dirty.getW(),
-                    rt.getX() + dirty.getY() + dirty.getH());
             }
 
-            // Empty out the list in full.
-            g_PendingWindows.clear();
-
-            // Only do rendering if we actually did some rendering!
-            if (!nDirty)
+            // Composite windows over the top.
+            for (size_t i = 0; i < toRender.size(); ++i)
             {
-                renderDirty.reset();
-                continue;
+                toRender[i]->render(cr);
             }
 
             if (g_StatusField.length())
             {
                 infoPanel(cr);
+                frameDamage.add(DamageRect(0, g_nHeight - 24, g_nWidth, 24));
             }
 
 #if 0
@@ -1331,8 +1419,7 @@ int main(int argc, char *argv[])
                     32,
                     32);
             cairo_fill(cr);
-            renderDirty.point(g_CursorX, g_CursorY);
-            renderDirty.point(g_CursorX + 32, g_CursorY + 32);
+            frameDamage.add(DamageRect(g_CursorX, g_CursorY, 32, 32));
 
             // We'll want to redraw the area we just obstructed shortly.
             g_LastCursorX = g_CursorX;
@@ -1346,13 +1433,20 @@ int main(int argc, char *argv[])
             // is in the framebuffer ready to send to the device.
             cairo_surface_flush(surface);
 
-            // Submit a redraw to the graphics card.
-            pFramebuffer->flush(
-                renderDirty.getX(), renderDirty.getY(), renderDirty.getWidth(),
-                renderDirty.getHeight());
+            // Submit a redraw to the graphics card for only the damaged areas.
+            for (size_t i = 0; i < rects.size(); ++i)
+            {
+                pFramebuffer->flush(
+                    rects[i].x, rects[i].y, rects[i].w, rects[i].h);
+            }
+
+            struct timeval composeEnd;
+            gettimeofday(&composeEnd, NULL);
+            uint64_t composeTime =
+                ((composeEnd.tv_sec - composeStart.tv_sec) * 1000000ULL) +
+                composeEnd.tv_usec - composeStart.tv_usec;
 
-            // Wipe out the dirty rectangle - we're all done.
-            renderDirty.reset();
+            fps(frameDamage.area(), composeTime);
         }
     }
 
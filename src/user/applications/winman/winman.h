@@ -33,6 +33,8 @@
 
 #include <cairo/cairo.h>
 
+#include "Damage.h"
+
 /** \addtogroup PedigreeGUI
  *  @{
  */
@@ -215,6 +217,10 @@ class Window : public WObject
 
     virtual void render(cairo_t *cr);
 
+    /// Drops all pending damage without compositing it, for a window that is
+    /// entirely hidden. Any waiting client redraw is still acknowledged.
+    void cull();
+
     virtual void
     resize(ssize_t horizDistance, ssize_t vertDistance, WObject *pChild = 0);
 
@@ -255,19 +261,23 @@ class Window : public WObject
         m_pParent = p;
     }
 
+    /// Accumulates client-area damage (in client coordinates) until the
+    /// window is next rendered.
     void setDirty(PedigreeGraphics::Rect &dirty);
 
-    PedigreeGraphics::Rect getDirty() const
+    /// Damage pending for this window, relative to the window's origin.
+    DamageRegion getDamage() const
     {
         // Different behaviour if we are waiting on a window redecoration
         if (m_bPendingDecoration)
         {
             // Redraw ALL the things.
             PedigreeGraphics::Rect rt = getCopyDimensions();
-            rt.update(0, 0, rt.getW(), rt.getH());
-            return rt;
+            DamageRegion all;
+            all.add(DamageRect(0, 0, rt.getW(), rt.getH()));
+            return all;
         }
-        return m_Dirty;
+        return m_Damage;
     }
 
     bool isDirty() const
@@ -278,11 +288,11 @@ class Window : public WObject
   private:
     bool isClientDirty() const
     {
-        return !(
-            m_Dirty.getX() == 0 && m_Dirty.getY() == 0 && m_Dirty.getW() == 0 &&
-            m_Dirty.getH() == 0);
+        return !m_Damage.empty();
     }
 
+    void ackRedraw();
+
     uint64_t m_Handle;
 
     ::Container *m_pParent;
@@ -291,7 +301,7 @@ class Window : public WObject
 
     std::string m_sWindowTitle;
 
-    PedigreeGraphics::Rect m_Dirty;
+    DamageRegion m_Damage;
 
     bool m_bPendingDecoration;
 
@@ -27,6 +27,7 @@
 #include "pedigree/native/graphics/Graphics.h"
 
 #include <map>
+#include <vector>
 
 #include <cairo/cairo.h>
 
@@ -61,6 +62,20 @@ class Font
         return m_Baseline;
     }
 
+    /**
+     * Renders a single cell from the glyph atlas directly into an ARGB32
+     * buffer, rather than going through cairo and pango. The cell is fully
+     * painted (background included) and clipped to the buffer.
+     *
+     * Returns false if the glyph could not be rasterised, in which case the
+     * caller should fall back to render().
+     */
+    bool blit(
+        uint8_t *pBuffer, size_t bufferStride, size_t bufferWidth,
+        size_t bufferHeight, uint32_t c, size_t x, size_t y, uint32_t f,
+        uint32_t b, bool bBold = false, bool bItalic = false,
+        bool bUnderline = false);
+
     const char *precache(uint32_t c);
 
     void updateCairo(cairo_t *pCairo);
@@ -69,12 +84,36 @@ class Font
     Font(const Font &);
     Font &operator=(const Font &);
 
+    /// Glyph styles that the atlas keys on, in addition to the codepoint.
+    enum GlyphStyle
+    {
+        StyleBold = 0x1,
+        StyleItalic = 0x2,
+        StyleUnderline = 0x4,
+
+        StyleCount = 0x8
+    };
+
+    /// Returns the coverage mask for the given glyph, rasterising it if
+    /// needed. Each mask is exactly one cell in size.
+    const uint8_t *getGlyph(uint32_t c, size_t style);
+
+    /// Rasterises the given glyph into a new atlas slot.
+    ssize_t rasterise(uint32_t c, size_t style);
+
     size_t m_CellWidth;
     size_t m_CellHeight;
     size_t m_Baseline;
 
     std::map<uint32_t, char *> m_ConversionCache;
 
+    /// Glyph atlas: one cell-sized 8-bit coverage mask per slot.
+    std::vector<uint8_t> m_Atlas;
+    /// Fast slot lookup for printable ASCII (-1 if not yet rasterised).
+    ssize_t m_AsciiSlots[StyleCount][128];
+    /// Slot lookup for everything else, keyed by (codepoint << 3) | style.
+    std::map<uint64_t, ssize_t> m_GlyphSlots;
+
     // opaque pointer that allows the .cc files to refer to pango etc without
     // requiring clients to also see the headers
     struct FontLibraries *m_FontLibraries;
@@ -24,6 +24,7 @@
 #include "tui.h"
 
 #include <string>
+#include <vector>
 
 #include "pedigree/native/graphics/Graphics.h"
 
@@ -54,6 +55,15 @@ class Xterm
     /** Writes the given UTF-32 character to the Xterm. */
     void write(uint32_t utf32, DirtyRectangle &rect);
 
+    /**
+     * Writes a run of printable ASCII (0x20 - 0x7E) to the Xterm in one go,
+     * bypassing the escape sequence state machine. Returns the number of
+     * characters consumed, which is zero if the Xterm is part-way through a
+     * control sequence (or in a mode where characters are translated), in
+     * which case the caller must fall back to write() for each character.
+     */
+    size_t writeAscii(const char *pStr, size_t len, DirtyRectangle &rect);
+
     /** Performs a full re-render. */
     void renderAll(DirtyRectangle &rect);
 
@@ -111,6 +121,14 @@ class Xterm
         m_pBoldFont = pBoldFont;
     }
 
+    /** Moves the view \p n lines back (positive) or forward (negative)
+     * through the scrollback history. Any output returns to the live
+     * screen. */
+    void scrollView(ssize_t n, DirtyRectangle &rect)
+    {
+        m_pWindows[m_ActiveBuffer]->scrollView(n, rect);
+    }
+
   private:
     class Window
     {
@@ -137,6 +155,36 @@ class Xterm
             uint32_t utf32;
         };
 
+        /**
+         * A line that has scrolled off the top of the screen. Trailing blank
+         * cells are dropped, and attributes are stored as runs rather than
+         * per cell, as they rarely change more than a few times per line.
+         */
+        class ScrollbackLine
+        {
+          public:
+            ScrollbackLine() : text(), attributes()
+            {
+            }
+
+            /** Encodes \p n cells of a screen row. */
+            void store(const TermChar *pRow, size_t n);
+
+            /** Decodes into \p n cells of a screen row. */
+            void load(TermChar *pRow, size_t n) const;
+
+          private:
+            struct AttributeRun
+            {
+                uint16_t length;
+                uint8_t flags;
+                uint8_t fore, back;
+            };
+
+            std::vector<uint32_t> text;
+            std::vector<AttributeRun> attributes;
+        };
+
       public:
         Window(
             size_t nRows, size_t nCols, PedigreeGraphics::Framebuffer *pFb,
@@ -157,11 +205,16 @@ class Xterm
 
         void setMargins(size_t left, size_t right);
 
+        /** Moves the view through the scrollback history. */
+        void scrollView(ssize_t n, DirtyRectangle &rect);
+
         void setChar(uint32_t utf32, size_t x, size_t y);
         TermChar getChar(size_t x = ~0UL, size_t y = ~0UL);
 
         void fillChar(uint32_t utf32, DirtyRectangle &rect);
         void addChar(uint32_t utf32, DirtyRectangle &rect);
+        /** Adds a run of printable ASCII, as if by addChar for each. */
+        void addAsciiRun(const char *pStr, size_t len, DirtyRectangle &rect);
 
         void setCursorRelOrigin(size_t x, size_t y, DirtyRectangle &rect);
         void setCursor(size_t x, size_t y, DirtyRectangle &rect);
@@ -199,12 +252,21 @@ class Xterm
         void cursorTabBack(DirtyRectangle &rect);
 
         void renderAll(DirtyRectangle &rect, Window *pPrevious);
+        /** Renders a cell. With no flags this is deferred like renderArea;
+         * with flags (i.e. the cursor) pending rows are drawn first and the
+         * cell is then drawn immediately. */
         void render(
             DirtyRectangle &rect, size_t flags = 0, size_t x = ~0UL,
             size_t y = ~0UL);
+        /** Marks an area as needing to be redrawn. Nothing is drawn until
+         * the next flushRender(). */
         void renderArea(
             DirtyRectangle &rect, size_t x = ~0UL, size_t y = ~0UL,
             size_t w = ~0UL, size_t h = ~0UL);
+        /** Marks \p n cells of row \p y, from column \p x, for redraw. */
+        void renderRun(DirtyRectangle &rect, size_t x, size_t y, size_t n);
+        /** Draws every row marked for redraw since the last flush. */
+        void flushRender(DirtyRectangle &rect);
 
         void scrollRegionUp(size_t n, DirtyRectangle &rect);
         void scrollRegionDown(size_t n, DirtyRectangle &rect);
@@ -269,6 +331,41 @@ class Xterm
         Window(const Window &);
         Window &operator=(const Window &);
 
+        /** Returns the given screen row (scrolling only rotates rows). */
+        TermChar *getRow(size_t y)
+        {
+            return &m_pBuffer[m_pRowMap[y] * m_Stride];
+        }
+
+        /** Returns the row to display at \p y, which may come from the
+         * scrollback history if the view has been scrolled back. */
+        const TermChar *getDisplayRow(size_t y);
+
+        /** Draws \p n cells of the given displayed row immediately. */
+        void drawRun(
+            DirtyRectangle &rect, const TermChar *pRow, size_t x, size_t y,
+            size_t n);
+
+        /** Draws a single cell immediately, with cairo if needed. */
+        void drawCell(DirtyRectangle &rect, TermChar c, size_t x, size_t y);
+
+        /** Fills the given rows of the screen with blanks. */
+        void blankRows(size_t y, size_t n);
+
+        /** Allocates row tracking for the current height. */
+        void resetRows();
+
+        /** Saves a row that is scrolling off the top into the history. */
+        void pushScrollback(const TermChar *pRow);
+
+        /** Resolves the actual colours to draw the given cell with. */
+        void getColours(const TermChar &c, uint32_t &fg, uint32_t &bg);
+
+        /** Blits a cell straight into the cairo surface's pixel data from
+         * the font's glyph atlas. The caller handles flushing the surface
+         * beforehand and marking it dirty afterwards. */
+        bool blitCell(uint8_t *pData, const TermChar &c, size_t x, size_t y);
+
         TermChar *m_pBuffer;
         size_t m_BufferLength;
 
@@ -285,8 +382,26 @@ class Xterm
         ssize_t m_ScrollStart, m_ScrollEnd;
         ssize_t m_LeftMargin, m_RightMargin;
 
-        TermChar *m_pInsert;
-        TermChar *m_pView;
+        /// Maps screen rows to rows of m_pBuffer, so scrolling is a rotation
+        /// of this table rather than a copy of the cells.
+        size_t *m_pRowMap;
+
+        /// Columns of each screen row awaiting a redraw (left > right if the
+        /// row is clean).
+        size_t *m_pDirtyLeft;
+        size_t *m_pDirtyRight;
+        bool m_bDirty;
+
+        /// Scrollback history, as a ring of at most m_nMaxScrollback lines.
+        std::vector<ScrollbackLine> m_Scrollback;
+        size_t m_ScrollbackHead;
+        size_t m_ScrollbackCount;
+
+        /// Number of lines the view is scrolled back into the history.
+        size_t m_ViewOffset;
+
+        /// Decoded history row used while the view is scrolled back.
+        TermChar *m_pHistoryRow;
 
         uint8_t m_Fg, m_Bg;
         uint8_t m_Flags;
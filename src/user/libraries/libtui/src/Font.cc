@@ -45,12 +45,53 @@ struct FontLibraries
     cairo_t *m_Cairo;
 };
 
+static PangoAttrList *
+createAttributes(bool bBold, bool bItalic, bool bUnderline)
+{
+    PangoAttrList *attrs = pango_attr_list_new();
+    if (bBold)
+    {
+        PangoAttribute *attr = pango_attr_weight_new(PANGO_WEIGHT_BOLD);
+        pango_attr_list_insert(attrs, attr);
+    }
+    if (bItalic)
+    {
+        PangoAttribute *attr = pango_attr_style_new(PANGO_STYLE_OBLIQUE);
+        pango_attr_list_insert(attrs, attr);
+    }
+    if (bUnderline)
+    {
+        PangoAttribute *attr = pango_attr_underline_new(PANGO_UNDERLINE_SINGLE);
+        pango_attr_list_insert(attrs, attr);
+    }
+
+    return attrs;
+}
+
+/// Blends one 8-bit channel of two premultiplied pixels by coverage.
+static inline uint32_t
+blendChannel(uint32_t fg, uint32_t bg, uint32_t coverage, size_t shift)
+{
+    uint32_t f = (fg >> shift) & 0xFF;
+    uint32_t b = (bg >> shift) & 0xFF;
+    uint32_t v = (f * coverage) + (b * (255 - coverage)) + 127;
+    return ((v + (v >> 8)) >> 8) << shift;
+}
+
 Font::Font(
     cairo_t *pCairo, size_t requestedSize, const char *pFilename, bool bCache,
     size_t nWidth)
     : m_CellWidth(0), m_CellHeight(0), m_Baseline(requestedSize),
-      m_ConversionCache()
+      m_ConversionCache(), m_Atlas(), m_GlyphSlots()
 {
+    for (size_t style = 0; style < StyleCount; ++style)
+    {
+        for (size_t c = 0; c < 128; ++c)
+        {
+            m_AsciiSlots[style][c] = -1;
+        }
+    }
+
     m_FontLibraries = new FontLibraries();
     m_FontLibraries->m_FontDesc = pango_font_description_from_string(pFilename);
     m_FontLibraries->m_Cairo = pCairo;
@@ -87,6 +128,13 @@ Font::Font(
     {
         precache(c);
     }
+
+    // Rasterise the common case up front so plain text never has to wait on
+    // pango; other styles and codepoints are added to the atlas on demand.
+    for (uint32_t c = 32; c < 127; ++c)
+    {
+        getGlyph(c, 0);
+    }
 }
 
 Font::~Font()
@@ -128,22 +176,7 @@ size_t Font::render(
     const char *s, size_t x, size_t y, uint32_t f, uint32_t b, bool bBack,
     bool bBold, bool bItalic, bool bUnderline)
 {
-    PangoAttrList *attrs = pango_attr_list_new();
-    if (bBold)
-    {
-        PangoAttribute *attr = pango_attr_weight_new(PANGO_WEIGHT_BOLD);
-        pango_attr_list_insert(attrs, attr);
-    }
-    if (bItalic)
-    {
-        PangoAttribute *attr = pango_attr_style_new(PANGO_STYLE_OBLIQUE);
-        pango_attr_list_insert(attrs, attr);
-    }
-    if (bUnderline)
-    {
-        PangoAttribute *attr = pango_attr_underline_new(PANGO_UNDERLINE_SINGLE);
-        pango_attr_list_insert(attrs, attr);
-    }
+    PangoAttrList *attrs = createAttributes(bBold, bItalic, bUnderline);
 
     cairo_save(m_FontLibraries->m_Cairo);
     PangoLayout *layout = pango_cairo_create_layout(m_FontLibraries->m_Cairo);
@@ -194,6 +227,161 @@ size_t Font::render(
     return width;
 }
 
+bool Font::blit(
+    uint8_t *pBuffer, size_t bufferStride, size_t bufferWidth,
+    size_t bufferHeight, uint32_t c, size_t x, size_t y, uint32_t f,
+    uint32_t b, bool bBold, bool bItalic, bool bUnderline)
+{
+    size_t style = (bBold ? StyleBold : 0) | (bItalic ? StyleItalic : 0) |
+                   (bUnderline ? StyleUnderline : 0);
+    const uint8_t *mask = getGlyph(c, style);
+    if (!mask)
+    {
+        return false;
+    }
+
+    if ((x >= bufferWidth) || (y >= bufferHeight))
+    {
+        return true;
+    }
+
+    size_t w = m_CellWidth;
+    size_t h = m_CellHeight;
+    if ((x + w) > bufferWidth)
+    {
+        w = bufferWidth - x;
+    }
+    if ((y + h) > bufferHeight)
+    {
+        h = bufferHeight - y;
+    }
+
+    // The buffer is premultiplied ARGB32. Match render(): the background is
+    // painted at 80% opacity, and the glyph is composited over it opaquely.
+    uint32_t bgAlpha = 204;
+    uint32_t bg = (bgAlpha << 24) |
+                  ((((b >> 16) & 0xFF) * bgAlpha / 255) << 16) |
+                  ((((b >> 8) & 0xFF) * bgAlpha / 255) << 8) |
+                  ((b & 0xFF) * bgAlpha / 255);
+    uint32_t fg = 0xFF000000 | (f & 0xFFFFFF);
+
+    for (size_t row = 0; row < h; ++row)
+    {
+        uint32_t *out =
+            reinterpret_cast<uint32_t *>(pBuffer + ((y + row) * bufferStride)) +
+            x;
+        const uint8_t *coverage = &mask[row * m_CellWidth];
+        for (size_t col = 0; col < w; ++col)
+        {
+            uint32_t m = coverage[col];
+            if (!m)
+            {
+                out[col] = bg;
+            }
+            else if (m == 0xFF)
+            {
+                out[col] = fg;
+            }
+            else
+            {
+                out[col] = blendChannel(fg, bg, m, 24) |
+                           blendChannel(fg, bg, m, 16) |
+                           blendChannel(fg, bg, m, 8) |
+                           blendChannel(fg, bg, m, 0);
+            }
+        }
+    }
+
+    return true;
+}
+
+const uint8_t *Font::getGlyph(uint32_t c, size_t style)
+{
+    ssize_t slot = -1;
+    if (c < 128)
+    {
+        slot = m_AsciiSlots[style][c];
+        if (slot < 0)
+        {
+            slot = m_AsciiSlots[style][c] = rasterise(c, style);
+        }
+    }
+    else
+    {
+        uint64_t key = (static_cast<uint64_t>(c) << 3) | style;
+        std::map<uint64_t, ssize_t>::iterator it = m_GlyphSlots.find(key);
+        if (it == m_GlyphSlots.end())
+        {
+            slot = m_GlyphSlots[key] = rasterise(c, style);
+        }
+        else
+        {
+            slot = it->second;
+        }
+    }
+
+    if (slot < 0)
+    {
+        return 0;
+    }
+
+    return &m_Atlas[slot * m_CellWidth * m_CellHeight];
+}
+
+ssize_t Font::rasterise(uint32_t c, size_t style)
+{
+    const char *utf8 = precache(c);
+    if (!utf8 || !m_CellWidth || !m_CellHeight)
+    {
+        return -1;
+    }
+
+    cairo_surface_t *surface = cairo_image_surface_create(
+        CAIRO_FORMAT_A8, m_CellWidth, m_CellHeight);
+    if (cairo_surface_status(surface) != CAIRO_STATUS_SUCCESS)
+    {
+        cairo_surface_destroy(surface);
+        return -1;
+    }
+
+    cairo_t *cr = cairo_create(surface);
+
+    PangoAttrList *attrs = createAttributes(
+        style & StyleBold, style & StyleItalic, style & StyleUnderline);
+    PangoLayout *layout = pango_cairo_create_layout(cr);
+    pango_layout_set_attributes(layout, attrs);
+    pango_layout_set_font_description(layout, m_FontLibraries->m_FontDesc);
+    pango_layout_set_text(layout, utf8, -1);
+    pango_attr_list_unref(attrs);
+
+    cairo_set_operator(cr, CAIRO_OPERATOR_OVER);
+    cairo_set_source_rgba(cr, 1.0, 1.0, 1.0, 1.0);
+    cairo_move_to(cr, 0, 0);
+    pango_cairo_show_layout(cr, layout);
+
+    g_object_unref(layout);
+    cairo_destroy(cr);
+    cairo_surface_flush(surface);
+
+    // Copy the glyph out of the surface (which has its own stride) into a
+    // tightly-packed atlas slot.
+    size_t cellSize = m_CellWidth * m_CellHeight;
+    ssize_t slot = m_Atlas.size() / cellSize;
+    m_Atlas.resize(m_Atlas.size() + cellSize);
+
+    const uint8_t *data = cairo_image_surface_get_data(surface);
+    size_t stride = cairo_image_surface_get_stride(surface);
+    uint8_t *dest = &m_Atlas[slot * cellSize];
+    for (size_t row = 0; row < m_CellHeight; ++row)
+    {
+        memcpy(&dest[row * m_CellWidth], &data[row * stride], m_CellWidth);
+    }
+
+    cairo_surface_destroy(surface);
+
+    return slot;
+}
+
 const char *Font::precache(uint32_t c)
 {
     if (m_FontLibraries->m_Iconv == (iconv_t) -1)
@@ -281,6 +281,27 @@ void Terminal::write(const char *pStr, DirtyRectangle &rect)
     // klog(LOG_NOTICE, "Beginning write...");
     while (!m_Cancel && (*pStr || m_WriteBufferLen))
     {
+#ifndef NEW_XTERM
+        // Hand runs of printable ASCII to the Xterm in one go - this is the
+        // vast majority of terminal output.
+        if (!m_WriteBufferLen)
+        {
+            size_t runLength = 0;
+            while ((pStr[runLength] >= ' ') && (pStr[runLength] <= '~'))
+                ++runLength;
+
+            if (runLength)
+            {
+                size_t consumed = m_pXterm->writeAscii(pStr, runLength, rect);
+                if (consumed)
+                {
+                    pStr += consumed;
+                    continue;
+                }
+            }
+        }
+#endif
+
         // Fill the buffer.
         while (*pStr && !m_Cancel)
         {
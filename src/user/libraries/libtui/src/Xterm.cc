@@ -20,6 +20,7 @@
 #include "Xterm.h"
 #include "Font.h"
 #include "Terminal.h"
+#include <algorithm>
 #include <string.h>
 #include <sys/klog.h>
 #include <time.h>
@@ -156,6 +157,22 @@ void Xterm::processKey(uint64_t key)
         // Handle specially.
         uint32_t utf32 = key & ~0UL;
         char *str = reinterpret_cast<char *>(&utf32);
+
+        // Shift+Up/Down page through the scrollback rather than going to the
+        // application.
+        if ((key & Keyboard::Shift) &&
+            (!strncmp(str, "up", 2) || !strncmp(str, "down", 4)))
+        {
+            ssize_t lines = getRows() / 2;
+            if (!lines)
+                lines = 1;
+
+            DirtyRectangle rect;
+            scrollView(!strncmp(str, "up", 2) ? lines : -lines, rect);
+            m_pTui->redraw(rect);
+            return;
+        }
+
         if (!strncmp(str, "left", 4))
         {
             m_pT->addToQueue('\e');
@@ -1551,6 +1568,27 @@ void Xterm::write(uint32_t utf32, DirtyRectangle &rect)
     m_pT->addToQueue(0, true);
 }
 
+size_t Xterm::writeAscii(const char *pStr, size_t len, DirtyRectangle &rect)
+{
+    // Only text in the ground state can skip the state machine. Line drawing
+    // mode translates characters, so it has to go the slow way too.
+    Window *pWindow = m_pWindows[m_ActiveBuffer];
+    if (m_Flags || pWindow->getLineRenderMode())
+    {
+        return 0;
+    }
+
+#ifdef XTERM_DEBUG_EXTRA
+    klog(LOG_INFO, "XTerm::writeAscii(%zd)", len);
+#endif
+
+    pWindow->addAsciiRun(pStr, len, rect);
+
+    m_pT->addToQueue(0, true);
+
+    return len;
+}
+
 void Xterm::renderAll(DirtyRectangle &rect)
 {
     m_pWindows[m_ActiveBuffer]->renderAll(rect, m_pWindows[m_ActiveBuffer]);
@@ -1564,9 +1602,11 @@ Xterm::Window::Window(
       m_Width(nCols), m_Height(nRows), m_Stride(XTERM_MIN_WIDTH),
       m_OffsetLeft(offsetLeft), m_OffsetTop(offsetTop),
       m_nMaxScrollback(nMaxScrollback), m_CursorX(0), m_CursorY(0),
-      m_ScrollStart(0), m_ScrollEnd(nRows - 1), m_pInsert(0), m_pView(0),
-      m_Fg(g_DefaultFg), m_Bg(g_DefaultBg), m_Flags(0), m_bCursorFilled(true),
-      m_bLineRender(false), m_pParentXterm(parent)
+      m_ScrollStart(0), m_ScrollEnd(nRows - 1), m_pRowMap(0),
+      m_pDirtyLeft(0), m_pDirtyRight(0), m_bDirty(false), m_Scrollback(),
+      m_ScrollbackHead(0), m_ScrollbackCount(0), m_ViewOffset(0),
+      m_pHistoryRow(0), m_Fg(g_DefaultFg), m_Bg(g_DefaultBg), m_Flags(0),
+      m_bCursorFilled(true), m_bLineRender(false), m_pParentXterm(parent)
 {
 #ifdef XTERM_DEBUG
     klog(LOG_INFO, "Xterm::Window::Window() dimensions %zdx%zd", nCols, nRows);
@@ -1608,7 +1648,7 @@ Xterm::Window::Window(
         cairo_restore(m_pParentXterm->m_pCairo);
     }
 
-    m_pInsert = m_pView = m_pBuffer;
+    resetRows();
 
     m_LeftMargin = 0;
     m_RightMargin = m_Width;
@@ -1617,6 +1657,166 @@ Xterm::Window::Window(
 Xterm::Window::~Window()
 {
     free(m_pBuffer);
+    delete[] m_pRowMap;
+    delete[] m_pDirtyLeft;
+    delete[] m_pDirtyRight;
+    delete[] m_pHistoryRow;
+}
+
+void Xterm::Window::resetRows()
+{
+    delete[] m_pRowMap;
+    delete[] m_pDirtyLeft;
+    delete[] m_pDirtyRight;
+    delete[] m_pHistoryRow;
+
+    m_pRowMap = new size_t[m_Height];
+    m_pDirtyLeft = new size_t[m_Height];
+    m_pDirtyRight = new size_t[m_Height];
+    m_pHistoryRow = new TermChar[m_Stride];
+    for (size_t y = 0; y < m_Height; ++y)
+    {
+        m_pRowMap[y] = y;
+        m_pDirtyLeft[y] = ~0UL;
+        m_pDirtyRight[y] = 0;
+    }
+
+    m_bDirty = false;
+    m_ViewOffset = 0;
+}
+
+void Xterm::Window::blankRows(size_t y, size_t n)
+{
+    TermChar blank;
+    blank.fore = m_Fg;
+    blank.back = m_Bg;
+    blank.utf32 = ' ';
+    blank.flags = 0;
+    for (size_t r = y; r < (y + n) && r < m_Height; ++r)
+    {
+        TermChar *pRow = getRow(r);
+        for (size_t x = 0; x < m_Stride; ++x)
+            pRow[x] = blank;
+    }
+}
+
+void Xterm::Window::pushScrollback(const TermChar *pRow)
+{
+    if (!m_nMaxScrollback)
+        return;
+
+    size_t idx;
+    if (m_ScrollbackCount < m_nMaxScrollback)
+    {
+        idx = (m_ScrollbackHead + m_ScrollbackCount) % m_nMaxScrollback;
+        if (idx >= m_Scrollback.size())
+            m_Scrollback.push_back(ScrollbackLine());
+        ++m_ScrollbackCount;
+    }
+    else
+    {
+        // Full - the oldest line makes way (reusing its storage).
+        idx = m_ScrollbackHead;
+        m_ScrollbackHead = (m_ScrollbackHead + 1) % m_nMaxScrollback;
+    }
+
+    m_Scrollback[idx].store(pRow, m_Width);
+}
+
+const Xterm::Window::TermChar *Xterm::Window::getDisplayRow(size_t y)
+{
+    if (y >= m_ViewOffset)
+        return getRow(y - m_ViewOffset);
+
+    // Lines back from the newest line in the history.
+    size_t back = m_ViewOffset - y;
+    size_t idx = (m_ScrollbackHead + m_ScrollbackCount - back) %
+                 m_nMaxScrollback;
+    m_Scrollback[idx].load(m_pHistoryRow, m_Width);
+    return m_pHistoryRow;
+}
+
+void Xterm::Window::scrollView(ssize_t n, DirtyRectangle &rect)
+{
+    ssize_t offset = static_cast<ssize_t>(m_ViewOffset) + n;
+    if (offset < 0)
+        offset = 0;
+    if (offset > static_cast<ssize_t>(m_ScrollbackCount))
+        offset = m_ScrollbackCount;
+
+    if (static_cast<size_t>(offset) == m_ViewOffset)
+        return;
+
+    m_ViewOffset = offset;
+    renderArea(rect);
+    flushRender(rect);
+
+    // The cursor is only visible on the live screen.
+    if (!m_ViewOffset)
+        showCursor(rect);
+}
+
+void Xterm::Window::ScrollbackLine::store(const TermChar *pRow, size_t n)
+{
+    // Trailing blanks are implied, so don't store them.
+    while (n)
+    {
+        const TermChar &c = pRow[n - 1];
+        if (c.utf32 != ' ' || c.flags || c.fore != g_DefaultFg ||
+            c.back != g_DefaultBg)
+            break;
+        --n;
+    }
+
+    text.resize(n);
+    attributes.clear();
+    for (size_t i = 0; i < n; ++i)
+    {
+        const TermChar &c = pRow[i];
+        text[i] = c.utf32;
+
+        if (attributes.size())
+        {
+            AttributeRun &last = attributes.back();
+            if (last.flags == c.flags && last.fore == c.fore &&
+                last.back == c.back && last.length < 0xFFFF)
+            {
+                ++last.length;
+                continue;
+            }
+        }
+
+        AttributeRun run;
+        run.length = 1;
+        run.flags = c.flags;
+        run.fore = c.fore;
+        run.back = c.back;
+        attributes.push_back(run);
+    }
+}
+
+void Xterm::Window::ScrollbackLine::load(TermChar *pRow, size_t n) const
+{
+    size_t x = 0;
+    for (size_t r = 0; r < attributes.size() && x < n; ++r)
+    {
+        const AttributeRun &run = attributes[r];
+        for (size_t i = 0; i < run.length && x < n; ++i, ++x)
+        {
+            pRow[x].flags = run.flags;
+            pRow[x].fore = run.fore;
+            pRow[x].back = run.back;
+            pRow[x].utf32 = text[x];
+        }
+    }
+
+    TermChar blank;
+    blank.fore = g_DefaultFg;
+    blank.back = g_DefaultBg;
+    blank.utf32 = ' ';
+    blank.flags = 0;
+    for (; x < n; ++x)
+        pRow[x] = blank;
 }
 
 void Xterm::Window::showCursor(DirtyRectangle &rect)
@@ -1634,6 +1834,13 @@ void Xterm::Window::hideCursor(DirtyRectangle &rect)
     klog(LOG_INFO, "Xterm::Window::hideCursor");
 #endif
 
+    // Output always brings the view back to the live screen.
+    if (m_ViewOffset)
+    {
+        m_ViewOffset = 0;
+        renderArea(rect);
+    }
+
     render(rect);
 }
 
@@ -1702,13 +1909,14 @@ void Xterm::Window::resize(size_t nWidth, size_t nHeight, bool bActive)
             if (c >= cols)
                 break;
 
-            newBuf[r * m_Stride + c] = m_pInsert[r * previousStride + c];
+            newBuf[r * m_Stride + c] =
+                m_pBuffer[m_pRowMap[r] * previousStride + c];
         }
     }
 
     free(m_pBuffer);
 
-    m_pInsert = m_pView = m_pBuffer = newBuf;
+    m_pBuffer = newBuf;
     m_BufferLength = rows * m_Stride;
 
     if (m_RightMargin > (ssize_t) cols)
@@ -1721,6 +1929,7 @@ void Xterm::Window::resize(size_t nWidth, size_t nHeight, bool bActive)
     m_Height = rows;
     m_ScrollStart = 0;
     m_ScrollEnd = rows - 1;
+    resetRows();
     if (m_CursorX >= m_RightMargin)
         m_CursorX = m_RightMargin - 1;
     if (m_CursorY > m_ScrollEnd)
@@ -1800,23 +2009,33 @@ void Xterm::Window::setMargins(size_t left, size_t right)
 
 void Xterm::Window::renderAll(DirtyRectangle &rect, Xterm::Window *pPrevious)
 {
-    TermChar *pOld = (pPrevious) ? pPrevious->m_pInsert : 0;
-    TermChar *pNew = m_pInsert;
+    if (pPrevious == this)
+        pPrevious = 0;
+
+    // The screen must actually show the previous window for the comparison
+    // below to be valid.
+    if (pPrevious)
+        pPrevious->flushRender(rect);
 
     // "Cleverer" full redraw - only redraw those glyphs that are different from
     // the previous window.
     for (size_t y = 0; y < m_Height; y++)
     {
-        for (size_t x = 0; x < m_Width; --x)
+        const TermChar *pNew = getDisplayRow(y);
+        const TermChar *pOld = 0;
+        if (pPrevious && (y < pPrevious->m_Height))
+            pOld = pPrevious->getDisplayRow(y);
+
+        for (size_t x = 0; x < m_Width; ++x)
         {
-            if ((!pOld) || (pOld[y * m_Stride + x] != pNew[y * m_Stride + x]) ||
-                (m_pParentXterm->getModes() !=
-                 pPrevious->m_pParentXterm->getModes()))
+            if ((!pOld) || (pOld[x] != pNew[x]))
             {
-                render(rect, 0, x, y);
+                renderRun(rect, x, y, 1);
             }
         }
     }
+
+    flushRender(rect);
 }
 
 void Xterm::Window::renderArea(
@@ -1833,21 +2052,149 @@ void Xterm::Window::renderArea(
 
     for (size_t cy = y; cy < (y + h); ++cy)
     {
-        for (size_t cx = x; cx < (x + w); ++cx)
+        renderRun(rect, x, cy, w);
+    }
+}
+
+void Xterm::Window::renderRun(
+    DirtyRectangle &rect, size_t x, size_t y, size_t n)
+{
+    if (y >= m_Height || x >= m_Width || !n)
+    {
+        return;
+    }
+    if ((x + n) > m_Width)
+    {
+        n = m_Width - x;
+    }
+
+    if (x < m_pDirtyLeft[y])
+        m_pDirtyLeft[y] = x;
+    if ((x + n) > m_pDirtyRight[y])
+        m_pDirtyRight[y] = x + n;
+    m_bDirty = true;
+}
+
+void Xterm::Window::flushRender(DirtyRectangle &rect)
+{
+    if (!m_bDirty)
+        return;
+
+    for (size_t y = 0; y < m_Height; ++y)
+    {
+        size_t left = m_pDirtyLeft[y];
+        size_t right = m_pDirtyRight[y];
+        if (left >= right)
+            continue;
+
+        drawRun(rect, getDisplayRow(y), left, y, right - left);
+
+        m_pDirtyLeft[y] = ~0UL;
+        m_pDirtyRight[y] = 0;
+    }
+
+    m_bDirty = false;
+}
+
+void Xterm::Window::drawRun(
+    DirtyRectangle &rect, const TermChar *pRow, size_t x, size_t y, size_t n)
+{
+    cairo_surface_t *pSurface = m_pParentXterm->m_pCairoSurface;
+    uint8_t *pData = pSurface ? cairo_image_surface_get_data(pSurface) : 0;
+    if (!pData)
+    {
+        for (size_t i = 0; i < n; ++i)
+        {
+            drawCell(rect, pRow[x + i], x + i, y);
+        }
+        return;
+    }
+
+    // We're about to write into the surface behind cairo's back.
+    cairo_surface_flush(pSurface);
+
+    Font *pFont = m_pParentXterm->m_pNormalFont;
+    for (size_t i = 0; i < n; ++i)
+    {
+        if (!blitCell(pData, pRow[x + i], x + i, y))
         {
-            render(rect, 0, cx, cy);
+            // Couldn't get a glyph for this cell, let cairo handle it.
+            drawCell(rect, pRow[x + i], x + i, y);
         }
     }
+
+    size_t left = (x * pFont->getWidth()) + m_OffsetLeft;
+    size_t top = (y * pFont->getHeight()) + m_OffsetTop;
+    size_t right = ((x + n) * pFont->getWidth()) + m_OffsetLeft;
+    size_t bottom = ((y + 1) * pFont->getHeight()) + m_OffsetTop;
+
+    rect.point(left, top);
+    rect.point(right, bottom);
+    cairo_surface_mark_dirty_rectangle(
+        pSurface, left, top, right - left, bottom - top);
+}
+
+void Xterm::Window::getColours(const TermChar &c, uint32_t &fg, uint32_t &bg)
+{
+    fg = g_Colours[c.fore];
+    if (c.flags & XTERM_BRIGHTFG)
+        fg = g_BrightColours[c.fore];
+    bg = g_Colours[c.back];
+    if (c.flags & XTERM_BRIGHTBG)
+        bg = g_BrightColours[c.back];
+
+    if (c.flags & XTERM_INVERSE)
+    {
+        uint32_t tmp = fg;
+        fg = bg;
+        bg = tmp;
+    }
+
+    if (m_pParentXterm->getModes() & Screen)
+    {
+        // DECSCNM only applies to cells without custom color.
+        if (c.fore == g_DefaultFg && c.back == g_DefaultBg)
+        {
+            uint32_t tmp = fg;
+            fg = bg;
+            bg = tmp;
+        }
+    }
+}
+
+bool Xterm::Window::blitCell(
+    uint8_t *pData, const TermChar &c, size_t x, size_t y)
+{
+    if (c.flags & XTERM_BORDER)
+    {
+        // Borders are drawn with cairo.
+        return false;
+    }
+
+    uint32_t fg, bg;
+    getColours(c, fg, bg);
+
+    cairo_surface_t *pSurface = m_pParentXterm->m_pCairoSurface;
+    Font *pFont = m_pParentXterm->m_pNormalFont;
+    return pFont->blit(
+        pData, cairo_image_surface_get_stride(pSurface),
+        cairo_image_surface_get_width(pSurface),
+        cairo_image_surface_get_height(pSurface), c.utf32,
+        (x * pFont->getWidth()) + m_OffsetLeft,
+        (y * pFont->getHeight()) + m_OffsetTop, fg, bg,
+        (c.flags & XTERM_BOLD) == XTERM_BOLD,
+        (c.flags & XTERM_ITALIC) == XTERM_ITALIC,
+        (c.flags & XTERM_UNDERLINE) == XTERM_UNDERLINE);
 }
 
 void Xterm::Window::setChar(uint32_t utf32, size_t x, size_t y)
 {
-    if (x > m_Stride)
+    if (x >= m_Stride)
         return;
-    if (y > m_Height)
+    if (y >= m_Height)
         return;
 
-    TermChar *c = &m_pInsert[y * m_Stride + x];
+    TermChar *c = &getRow(y)[x];
 
     c->fore = m_Fg;
     c->back = m_Bg;
@@ -1862,7 +2209,7 @@ Xterm::Window::TermChar Xterm::Window::getChar(size_t x, size_t y)
         x = m_CursorX;
     if (y == ~0UL)
         y = m_CursorY;
-    return m_pInsert[y * m_Stride + x];
+    return getRow(y)[x];
 }
 
 void Xterm::Window::cursorDown(size_t n, DirtyRectangle &rect)
@@ -1952,40 +2299,37 @@ void Xterm::Window::render(
         x = m_CursorX;
     if (y == ~0UL)
         y = m_CursorY;
-    if (x > m_Width || y > m_Height)
+    if (x >= m_Width || y >= m_Height)
     {
         return;
     }
 
-    TermChar c = m_pView[y * m_Stride + x];
-
-    c.flags |= flags;
-
-    uint32_t fg = g_Colours[c.fore];
-    if (c.flags & XTERM_BRIGHTFG)
-        fg = g_BrightColours[c.fore];
-    uint32_t bg = g_Colours[c.back];
-    if (c.flags & XTERM_BRIGHTBG)
-        bg = g_BrightColours[c.back];
-
-    if (c.flags & XTERM_INVERSE)
+    if (!flags)
     {
-        uint32_t tmp = fg;
-        fg = bg;
-        bg = tmp;
+        renderRun(rect, x, y, 1);
+        return;
     }
 
-    if (m_pParentXterm->getModes() & Screen)
+    // Bring everything else up to date so the cell isn't drawn over later.
+    flushRender(rect);
+
+    // No cursor while looking at the history.
+    if (m_ViewOffset)
     {
-        // DECSCNM only applies to cells without custom color.
-        if (c.fore == g_DefaultFg && c.back == g_DefaultBg)
-        {
-            uint32_t tmp = fg;
-            fg = bg;
-            bg = tmp;
-        }
+        return;
     }
 
+    TermChar c = getRow(y)[x];
+    c.flags |= flags;
+    drawCell(rect, c, x, y);
+}
+
+void Xterm::Window::drawCell(
+    DirtyRectangle &rect, TermChar c, size_t x, size_t y)
+{
+    uint32_t fg, bg;
+    getColours(c, fg, bg);
+
     uint32_t utf32 = c.utf32;
 
     // Ensure the painted area is marked dirty.
@@ -1997,6 +2341,23 @@ void Xterm::Window::render(
         ((y + 1) * m_pParentXterm->m_pNormalFont->getHeight()) + m_OffsetTop);
 
     Font *pFont = m_pParentXterm->m_pNormalFont;
+
+    // Fast path: straight from the glyph atlas into the surface.
+    cairo_surface_t *pSurface = m_pParentXterm->m_pCairoSurface;
+    uint8_t *pData = pSurface ? cairo_image_surface_get_data(pSurface) : 0;
+    if (pData)
+    {
+        cairo_surface_flush(pSurface);
+        if (blitCell(pData, c, x, y))
+        {
+            cairo_surface_mark_dirty_rectangle(
+                pSurface, (x * pFont->getWidth()) + m_OffsetLeft,
+                (y * pFont->getHeight()) + m_OffsetTop, pFont->getWidth(),
+                pFont->getHeight());
+            return;
+        }
+    }
+
     bool bBold = (c.flags & XTERM_BOLD) == XTERM_BOLD;
     bool bItalic = (c.flags & XTERM_ITALIC) == XTERM_ITALIC;
     bool bUnderline = (c.flags & XTERM_UNDERLINE) == XTERM_UNDERLINE;
@@ -2037,87 +2398,28 @@ void Xterm::Window::scrollRegionUp(size_t numRows, DirtyRectangle &rect)
     klog(LOG_INFO, "Xterm::Window::scrollRegionUp(%zd)", numRows);
 #endif
 
-    size_t targetY = m_ScrollStart;
-    size_t sourceY = m_ScrollStart + numRows;
-
-    size_t movedRows = (m_ScrollEnd + 1) - sourceY;
-    size_t blankFrom = (m_ScrollEnd + 1) - numRows;
-    size_t blankLength = (m_ScrollEnd + 1) - blankFrom;
-
-    // Because we need to bitblit to copy, we need to flush anything that hasn't
-    // been written just yet.
-    rect.point(
-        m_OffsetLeft,
-        m_OffsetTop + (targetY + m_pParentXterm->m_pNormalFont->getHeight()));
-    rect.point(
-        m_OffsetLeft + m_FbWidth,
-        m_OffsetTop + ((blankFrom + blankLength) *
-                       m_pParentXterm->m_pNormalFont->getHeight()));
-    m_pParentXterm->m_pTui->redraw(rect);
-    rect.reset();
-
-    cairo_save(m_pParentXterm->m_pCairo);
-
-    cairo_set_operator(m_pParentXterm->m_pCairo, CAIRO_OPERATOR_SOURCE);
-
-    // Copying the scroll region.
-    cairo_rectangle(
-        m_pParentXterm->m_pCairo, m_OffsetLeft,
-        m_OffsetTop + (targetY * m_pParentXterm->m_pNormalFont->getHeight()),
-        m_FbWidth - m_OffsetLeft,
-        movedRows * m_pParentXterm->m_pNormalFont->getHeight());
-
-    cairo_push_group(m_pParentXterm->m_pCairo);
-    cairo_set_source_surface(
-        m_pParentXterm->m_pCairo, m_pParentXterm->m_pCairoSurface, 0,
-        -((double) (numRows * m_pParentXterm->m_pNormalFont->getHeight())));
-    cairo_fill_preserve(m_pParentXterm->m_pCairo);
-    cairo_pop_group_to_source(m_pParentXterm->m_pCairo);
-
-    // cairo_fill(m_pParentXterm->m_pCairo);
+    size_t regionRows = (m_ScrollEnd + 1) - m_ScrollStart;
+    if (numRows > regionRows)
+        numRows = regionRows;
+    if (!numRows)
+        return;
 
-    size_t bg = m_Bg;
-    if ((m_pParentXterm->getModes() & Screen) && (bg == g_DefaultBg))
+    // Lines leaving the top of the main screen go into the history. The
+    // alternate screen (and scroll regions) don't keep history.
+    if (!m_ScrollStart && (m_pParentXterm->m_pWindows[0] == this))
     {
-        bg = m_Fg;
+        for (size_t i = 0; i < numRows; ++i)
+            pushScrollback(getRow(i));
     }
 
-    cairo_set_source_rgba(
-        m_pParentXterm->m_pCairo, ((g_Colours[bg] >> 16) & 0xFF) / 256.0,
-        ((g_Colours[bg] >> 8) & 0xFF) / 256.0, ((g_Colours[bg]) & 0xFF) / 256.0,
-        0.8);
-
-    // Blanking the region that used to exist.
-    cairo_rectangle(
-        m_pParentXterm->m_pCairo, m_OffsetLeft,
-        m_OffsetTop + (blankFrom * m_pParentXterm->m_pNormalFont->getHeight()),
-        m_FbWidth - m_OffsetLeft,
-        blankLength * m_pParentXterm->m_pNormalFont->getHeight());
-    // cairo_fill(m_pParentXterm->m_pCairo);
-
-    cairo_restore(m_pParentXterm->m_pCairo);
-
-    rect.point(
-        m_OffsetLeft,
-        m_OffsetTop + (targetY + m_pParentXterm->m_pNormalFont->getHeight()));
-    rect.point(
-        m_FbWidth, m_OffsetTop + ((blankFrom + blankLength) *
-                                  m_pParentXterm->m_pNormalFont->getHeight()));
-
-    memmove(
-        &m_pInsert[targetY * m_Stride], &m_pInsert[sourceY * m_Stride],
-        movedRows * m_Stride * sizeof(TermChar));
-
-    TermChar blank;
-    blank.fore = m_Fg;
-    blank.back = m_Bg;
-    blank.utf32 = ' ';
-    blank.flags = 0;
-    for (size_t i = blankFrom * m_Stride;
-         i < (blankFrom + blankLength) * m_Stride; i++)
-        m_pInsert[i] = blank;
+    // Scrolling is just a rotation of the row map. The rows rotated to the
+    // bottom become the blank lines.
+    std::rotate(
+        &m_pRowMap[m_ScrollStart], &m_pRowMap[m_ScrollStart + numRows],
+        &m_pRowMap[m_ScrollEnd + 1]);
+    blankRows((m_ScrollEnd + 1) - numRows, numRows);
 
-    renderArea(rect, 0, targetY, m_Width, movedRows + blankLength);
+    renderArea(rect, 0, m_ScrollStart, m_Width, regionRows);
 }
 
 void Xterm::Window::scrollRegionDown(size_t numRows, DirtyRectangle &rect)
@@ -2126,86 +2428,18 @@ void Xterm::Window::scrollRegionDown(size_t numRows, DirtyRectangle &rect)
     klog(LOG_INFO, "Xterm::Window::scrollRegionDown(%zd)", numRows);
 #endif
 
-    size_t targetY = m_ScrollStart + numRows;
-    size_t sourceY = m_ScrollStart;
-
-    size_t movedRows = (m_ScrollEnd + 1) - targetY;
-    size_t blankFrom = sourceY;
-    size_t blankLength = numRows;
-
-    // Because we need to bitblit to copy, we need to flush anything that hasn't
-    // been written just yet.
-    rect.point(
-        m_OffsetLeft,
-        m_OffsetTop + (sourceY + m_pParentXterm->m_pNormalFont->getHeight()));
-    rect.point(
-        m_OffsetLeft + m_FbWidth,
-        m_OffsetTop + (movedRows * m_pParentXterm->m_pNormalFont->getHeight()));
-    m_pParentXterm->m_pTui->redraw(rect);
-    rect.reset();
-
-    cairo_save(m_pParentXterm->m_pCairo);
-
-    cairo_set_operator(m_pParentXterm->m_pCairo, CAIRO_OPERATOR_SOURCE);
-
-    // Copying the scroll region.
-    cairo_rectangle(
-        m_pParentXterm->m_pCairo, m_OffsetLeft,
-        m_OffsetTop + (targetY * m_pParentXterm->m_pNormalFont->getHeight()),
-        m_FbWidth - m_OffsetLeft,
-        movedRows * m_pParentXterm->m_pNormalFont->getHeight());
-
-    cairo_push_group(m_pParentXterm->m_pCairo);
-    cairo_set_source_surface(
-        m_pParentXterm->m_pCairo, m_pParentXterm->m_pCairoSurface, 0,
-        (double) (numRows * m_pParentXterm->m_pNormalFont->getHeight()));
-    cairo_fill_preserve(m_pParentXterm->m_pCairo);
-    cairo_pop_group_to_source(m_pParentXterm->m_pCairo);
-
-    // cairo_fill(m_pParentXterm->m_pCairo);
-
-    size_t bg = m_Bg;
-    if ((m_pParentXterm->getModes() & Screen) && (bg == g_DefaultBg))
-    {
-        bg = m_Fg;
-    }
-
-    cairo_set_source_rgba(
-        m_pParentXterm->m_pCairo, ((g_Colours[bg] >> 16) & 0xFF) / 256.0,
-        ((g_Colours[bg] >> 8) & 0xFF) / 256.0, ((g_Colours[bg]) & 0xFF) / 256.0,
-        0.8);
-
-    // Blanking the region that used to exist.
-    cairo_rectangle(
-        m_pParentXterm->m_pCairo, m_OffsetLeft,
-        m_OffsetTop + (blankFrom * m_pParentXterm->m_pNormalFont->getHeight()),
-        m_FbWidth - m_OffsetLeft,
-        blankLength * m_pParentXterm->m_pNormalFont->getHeight());
-    // cairo_fill(m_pParentXterm->m_pCairo);
-
-    cairo_restore(m_pParentXterm->m_pCairo);
-
-    rect.point(
-        m_OffsetLeft,
-        m_OffsetTop + (targetY + m_pParentXterm->m_pNormalFont->getHeight()));
-    rect.point(
-        m_FbWidth, m_OffsetTop + ((blankFrom + blankLength) *
-                                  m_pParentXterm->m_pNormalFont->getHeight()));
-
-    memmove(
-        &m_pInsert[targetY * m_Stride], &m_pInsert[sourceY * m_Stride],
-        movedRows * m_Stride * sizeof(TermChar));
+    size_t regionRows = (m_ScrollEnd + 1) - m_ScrollStart;
+    if (numRows > regionRows)
+        numRows = regionRows;
+    if (!numRows)
+        return;
 
-    TermChar blank;
-    blank.fore = m_Fg;
-    blank.back = m_Bg;
-    blank.utf32 = ' ';
-    blank.flags = 0;
-    for (size_t i = blankFrom * m_Stride;
-         i < (blankFrom + blankLength) * m_Stride; i++)
-        m_pInsert[i] = blank;
+    std::rotate(
+        &m_pRowMap[m_ScrollStart], &m_pRowMap[(m_ScrollEnd + 1) - numRows],
+        &m_pRowMap[m_ScrollEnd + 1]);
+    blankRows(m_ScrollStart, numRows);
 
-    renderArea(rect, 0, blankFrom, m_Width, movedRows + blankLength);
+    renderArea(rect, 0, m_ScrollStart, m_Width, regionRows);
 }
 
 void Xterm::Window::setCursorRelOrigin(size_t x, size_t y, DirtyRectangle &rect)
@@ -2421,6 +2655,70 @@ void Xterm::Window::addChar(uint32_t utf32, DirtyRectangle &rect)
     }
 }
 
+void Xterm::Window::addAsciiRun(
+    const char *pStr, size_t len, DirtyRectangle &rect)
+{
+#ifdef XTERM_DEBUG_EXTRA
+    klog(
+        LOG_INFO, "Xterm::Window::addAsciiRun(%zd) [@ %zd, %zd]", len,
+        m_CursorX, m_CursorY);
+#endif
+
+    if (m_pParentXterm->getModes() & Insert)
+    {
+        // Every character shifts the rest of the line, no shortcuts here.
+        for (size_t i = 0; i < len; ++i)
+        {
+            addChar(static_cast<uint8_t>(pStr[i]), rect);
+        }
+        return;
+    }
+
+    TermChar tc;
+    tc.fore = m_Fg;
+    tc.back = m_Bg;
+    tc.flags = m_Flags;
+
+    while (len)
+    {
+        checkWrap(rect);
+
+        if (m_CursorX >= (ssize_t) m_Stride)
+            return;
+
+        // checkWrap leaves us inside the margins; fill up to the right margin
+        // in one go. Without autowrap, the last cell is simply overwritten.
+        size_t count = m_RightMargin - m_CursorX;
+        if (count > len)
+            count = len;
+
+        // Update the row, tracking the span that actually changed.
+        TermChar *pRow = getRow(m_CursorY);
+        size_t first = ~0UL, last = 0;
+        for (size_t i = 0; i < count; ++i)
+        {
+            size_t x = m_CursorX + i;
+            tc.utf32 = static_cast<uint8_t>(pStr[i]);
+            if (pRow[x] != tc)
+            {
+                pRow[x] = tc;
+                if (first == ~0UL)
+                    first = x;
+                last = x;
+            }
+        }
+
+        if (first != ~0UL)
+        {
+            renderRun(rect, first, m_CursorY, (last - first) + 1);
+        }
+
+        m_CursorX += count;
+        pStr += count;
+        len -= count;
+    }
+}
+
 void Xterm::Window::scrollUp(size_t n, DirtyRectangle &rect)
 {
 #ifdef XTERM_DEBUG
@@ -2817,8 +3115,7 @@ void Xterm::Window::deleteCharacters(size_t n, DirtyRectangle &rect)
     // Shift all the characters across from the end of the delete area to the
     // start.
     memmove(
-        &m_pInsert[(m_CursorY * m_Stride) + deleteStart],
-        &m_pInsert[(m_CursorY * m_Stride) + deleteEnd],
+        &getRow(m_CursorY)[deleteStart], &getRow(m_CursorY)[deleteEnd],
         numChars * sizeof(TermChar));
 
     // Now that the characters have been shifted, clear the space after
@@ -2880,8 +3177,7 @@ void Xterm::Window::insertCharacters(size_t n, DirtyRectangle &rect)
 
     // Shift characters.
     memmove(
-        &m_pInsert[(m_CursorY * m_Stride) + insertEnd],
-        &m_pInsert[(m_CursorY * m_Stride) + insertStart],
+        &getRow(m_CursorY)[insertEnd], &getRow(m_CursorY)[insertStart],
         numChars * sizeof(TermChar));
 
     // Now that the characters have been shifted, clear the space inside the
@@ -2964,6 +3260,9 @@ void Xterm::Window::lineRender(uint32_t utf32, DirtyRectangle &rect)
 {
     klog(LOG_NOTICE, "line render: %c", utf32);
 
+    // Drawn directly, so pending cells mustn't be drawn over it later.
+    flushRender(rect);
+
     size_t left = m_OffsetLeft +
                   (m_LeftMargin * m_pParentXterm->m_pNormalFont->getWidth()) +
                   (m_CursorX * m_pParentXterm->m_pNormalFont->getWidth());
@@ -3294,7 +3593,7 @@ void Xterm::Window::invert(DirtyRectangle &rect)
     {
         for (size_t x = 0; x < m_Width; x++)
         {
-            TermChar *pChar = &m_pView[(y * m_Stride) + x];
+            TermChar *pChar = &getRow(y)[x];
             if ((pChar->fore == g_DefaultFg) && (pChar->back == g_DefaultBg))
             {
                 uint8_t fore = pChar->fore;
@@ -21,6 +21,7 @@
 #include <stdint.h>
 #include <string.h>
 #include <sys/klog.h>
+#include <sys/time.h>
 #include <unistd.h>
 
 #include <Font.h>
@@ -43,8 +44,46 @@ struct TuiLocal
 
     Font *pNormalFont = nullptr;
     Font *pBoldFont = nullptr;
+
+    /// Output throughput tracking (see throughput()).
+    uint64_t nBytesWritten = 0;
+    uint64_t nWriteTime = 0;
 };
 
+/// Log terminal output throughput once this much has been written.
+#define TUI_THROUGHPUT_INTERVAL (4 * 1024 * 1024)
+
+static uint64_t microseconds()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (tv.tv_sec * 1000000ULL) + tv.tv_usec;
+}
+
+/**
+ * Accounts for a write of \p bytes to the terminal (including the redraw)
+ * that took \p time microseconds, and periodically logs the throughput. This
+ * makes it easy to measure e.g. `cat` of a large file.
+ */
+static void throughput(TuiLocal *pLocal, size_t bytes, uint64_t time)
+{
+    pLocal->nBytesWritten += bytes;
+    pLocal->nWriteTime += time;
+
+    if (pLocal->nBytesWritten >= TUI_THROUGHPUT_INTERVAL)
+    {
+        uint64_t kib = pLocal->nBytesWritten / 1024;
+        uint64_t ms = pLocal->nWriteTime / 1000;
+        klog(
+            LOG_INFO, "TUI: wrote %llu KiB in %llu ms = %llu KiB/s",
+            (unsigned long long) kib, (unsigned long long) ms,
+            (unsigned long long) (ms ? (kib * 1000) / ms : 0));
+
+        pLocal->nBytesWritten = 0;
+        pLocal->nWriteTime = 0;
+    }
+}
+
 Tui::Tui(TuiRedrawer *pRedrawer)
     : m_LocalData(nullptr), m_pWidget(nullptr), m_pRedrawer(pRedrawer)
 {
@@ -320,6 +359,8 @@ void Tui::run()
         }
 
         bool bShouldRedraw = false;
+        ssize_t len = 0;
+        uint64_t writeStart = 0;
 
         DirtyRectangle dirtyRect;
         if (m_LocalData->pTerminal)
@@ -328,9 +369,10 @@ void Tui::run()
             if (FD_ISSET(fd, &fds))
             {
                 // Something to read.
-                ssize_t len = read(fd, buffer, maxBuffSz);
+                len = read(fd, buffer, maxBuffSz);
                 if (len > 0)
                 {
+                    writeStart = microseconds();
                     buffer[len] = 0;
                     m_LocalData->pTerminal->write(buffer, dirtyRect);
                     bShouldRedraw = true;
@@ -341,6 +383,7 @@ void Tui::run()
         if (bShouldRedraw)
         {
             redraw(dirtyRect);
+            throughput(m_LocalData, len, microseconds() - writeStart);
         }
     }
 